@@ -0,0 +1,5 @@
+BRICKRED_INSTALL_PREFIX = /usr/local
+BRICKRED_COMPILE_FLAG =  -DBRICKRED_BUILD_ZLIB
+BRICKRED_LINK_FLAG = 
+BRICKRED_LINK_LIB =  -lz
+BRICKRED_BUILD_TEST = yes
@@ -6,18 +6,22 @@ usage()
     echo '-h --help            print usage'
     echo '--prefix=<prefix>    install prefix'
     echo '--build-test         build test programs'
+    echo '--with-zlib          build websocket permessage-deflate with zlib'
     exit 1
 }
 
 brickred_install_prefix='/usr/local'
 brickred_compile_flag=
 brickred_link_flag=
+brickred_link_lib=
 brickred_build_test='no'
+brickred_with_zlib='no'
 
 options=`getopt -o h -l \
 help,\
 prefix:,\
-build-test\
+build-test,\
+with-zlib\
  -- "$@"`
 eval set -- "$options"
 
@@ -27,6 +31,7 @@ do
     -h|--help) usage;;
     --prefix) brickred_install_prefix=$2; shift;;
     --build-test) brickred_build_test=yes;;
+    --with-zlib) brickred_with_zlib=yes;;
     --) shift; break;;
     *) usage;;
     esac
@@ -49,8 +54,22 @@ then
     exit 1
 fi
 
+# check zlib
+if [ "$brickred_with_zlib" = 'yes' ]
+then
+    echo '#include <zlib.h>' | g++ -E -x c++ - >/dev/null 2>&1
+    if [ $? -ne 0 ]
+    then
+        echo 'can not find zlib.h'
+        exit 1
+    fi
+    brickred_compile_flag="$brickred_compile_flag -DBRICKRED_BUILD_ZLIB"
+    brickred_link_lib="$brickred_link_lib -lz"
+fi
+
 # output
 echo "BRICKRED_INSTALL_PREFIX = $brickred_install_prefix" >config.mak
 echo "BRICKRED_COMPILE_FLAG = $brickred_compile_flag" >>config.mak
 echo "BRICKRED_LINK_FLAG = $brickred_link_flag" >>config.mak
+echo "BRICKRED_LINK_LIB = $brickred_link_lib" >>config.mak
 echo "BRICKRED_BUILD_TEST = $brickred_build_test" >>config.mak
@@ -11,6 +11,8 @@ src/brickred/io_service.cc \
 src/brickred/log_async_sink.cc \
 src/brickred/log_core.cc \
 src/brickred/log_file_sink.cc \
+src/brickred/log_record.cc \
+src/brickred/log_sink.cc \
 src/brickred/log_stderr_sink.cc \
 src/brickred/mutex.cc \
 src/brickred/random.cc \
@@ -31,11 +33,20 @@ src/brickred/codec/mt19937.cc \
 src/brickred/codec/sha1.cc \
 src/brickred/codec/sha256.cc \
 src/brickred/codec/url.cc \
+src/brickred/codec/utf8.cc \
+src/brickred/protocol/http_client.cc \
+src/brickred/protocol/http_header_map.cc \
 src/brickred/protocol/http_message.cc \
 src/brickred/protocol/http_protocol.cc \
 src/brickred/protocol/http_request.cc \
+src/brickred/protocol/http_request_view.cc \
 src/brickred/protocol/http_response.cc \
+src/brickred/protocol/http_router.cc \
+src/brickred/protocol/http_server.cc \
+src/brickred/protocol/web_socket_deflate.cc \
+src/brickred/protocol/web_socket_mask.cc \
 src/brickred/protocol/web_socket_protocol.cc \
+src/brickred/protocol/web_socket_server.cc \
 
 LINK_TYPE = static
 INCLUDE = -Isrc
@@ -4,7 +4,7 @@ TARGET = bin/base64_encode
 SRCS = src/test/base64_encode.cc
 LINK_TYPE = exec
 INCLUDE = $(BRICKRED_COMPILE_FLAG) -Isrc
-LIB = $(BRICKRED_LINK_FLAG) -Lbuild -lbrickred -pthread -lrt
+LIB = $(BRICKRED_LINK_FLAG) -Lbuild -lbrickred -pthread -lrt $(BRICKRED_LINK_LIB)
 DEPFILE = build/libbrickred.a
 BUILD_DIR = build
 
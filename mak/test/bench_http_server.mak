@@ -0,0 +1,12 @@
+include config.mak
+
+TARGET = bin/bench_http_server
+SRCS = src/test/bench_http_server.cc
+LINK_TYPE = exec
+INCLUDE = -Isrc
+CPP_FLAG = $(BRICKRED_COMPILE_FLAG)
+LIB = $(BRICKRED_LINK_FLAG) -Lbuild -lbrickred -lbrtest -pthread -lrt $(BRICKRED_LINK_LIB)
+DEPFILE = build/libbrickred.a build/libbrtest.a
+BUILD_DIR = build
+
+include mak/main.mak
@@ -5,7 +5,7 @@ SRCS = src/test/broadcast_server.cc
 LINK_TYPE = exec
 INCLUDE = -Isrc
 CPP_FLAG = $(BRICKRED_COMPILE_FLAG)
-LIB = $(BRICKRED_LINK_FLAG) -Lbuild -lbrickred -lbrtest -pthread -lrt
+LIB = $(BRICKRED_LINK_FLAG) -Lbuild -lbrickred -lbrtest -pthread -lrt $(BRICKRED_LINK_LIB)
 DEPFILE = build/libbrickred.a build/libbrtest.a
 BUILD_DIR = build
 
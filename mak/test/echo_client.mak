@@ -5,7 +5,7 @@ SRCS = src/test/echo_client.cc
 LINK_TYPE = exec
 INCLUDE = -Isrc
 CPP_FLAG = $(BRICKRED_COMPILE_FLAG)
-LIB = $(BRICKRED_LINK_FLAG) -Lbuild -lbrickred -pthread -lrt
+LIB = $(BRICKRED_LINK_FLAG) -Lbuild -lbrickred -pthread -lrt $(BRICKRED_LINK_LIB)
 DEPFILE = build/libbrickred.a
 BUILD_DIR = build
 
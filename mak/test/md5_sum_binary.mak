@@ -4,7 +4,7 @@ TARGET = bin/md5_sum_binary
 SRCS = src/test/md5_sum_binary.cc
 LINK_TYPE = exec
 INCLUDE = $(BRICKRED_COMPILE_FLAG) -Isrc
-LIB = $(BRICKRED_LINK_FLAG) -Lbuild -lbrickred -pthread -lrt
+LIB = $(BRICKRED_LINK_FLAG) -Lbuild -lbrickred -pthread -lrt $(BRICKRED_LINK_LIB)
 DEPFILE = build/libbrickred.a
 BUILD_DIR = build
 
@@ -0,0 +1,12 @@
+include config.mak
+
+TARGET = bin/zerocopy_server
+SRCS = src/test/zerocopy_server.cc
+LINK_TYPE = exec
+INCLUDE = -Isrc
+CPP_FLAG = $(BRICKRED_COMPILE_FLAG)
+LIB = $(BRICKRED_LINK_FLAG) -Lbuild -lbrickred -pthread -lrt $(BRICKRED_LINK_LIB)
+DEPFILE = build/libbrickred.a
+BUILD_DIR = build
+
+include mak/main.mak
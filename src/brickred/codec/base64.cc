@@ -3,12 +3,28 @@
 #include <cstdint>
 #include <vector>
 
+#if defined(__x86_64__) || defined(__i386__)
+#define BRICKRED_CODEC_BASE64_X86
+#include <immintrin.h>
+#endif
+
 namespace brickred::codec {
 
-static const char s_encode_table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-                                     "abcdefghijklmnopqrstuvwxyz"
-                                     "0123456789+/";
-static const int8_t s_decode_table[] = {
+namespace {
+
+using EncodeFunc = int (*)(const char *in, size_t in_size,
+                           char *out, size_t out_size, bool url_safe);
+using DecodeFunc = int (*)(const char *in, size_t in_size,
+                           char *out, size_t out_size, bool url_safe);
+
+const char s_encode_table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                              "abcdefghijklmnopqrstuvwxyz"
+                              "0123456789+/";
+const char s_url_encode_table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                                  "abcdefghijklmnopqrstuvwxyz"
+                                  "0123456789-_";
+// indexed by c - 43, -2 is '='
+const int8_t s_decode_table[] = {
     62, -1, -1, -1, 63, 52, 53, 54, 55, 56,
     57, 58, 59, 60, 61, -1, -1, -1, -2, -1,
     -1, -1,  0,  1,  2,  3,  4,  5,  6,  7,
@@ -18,10 +34,22 @@ static const int8_t s_decode_table[] = {
     32, 33, 34, 35, 36, 37, 38, 39, 40, 41,
     42, 43, 44, 45, 46, 47, 48, 49, 50, 51
 };
+const int8_t s_url_decode_table[] = {
+    -1, -1, 62, -1, -1, 52, 53, 54, 55, 56,
+    57, 58, 59, 60, 61, -1, -1, -1, -2, -1,
+    -1, -1,  0,  1,  2,  3,  4,  5,  6,  7,
+     8,  9, 10, 11, 12, 13, 14, 15, 16, 17,
+    18, 19, 20, 21, 22, 23, 24, 25, -1, -1,
+    -1, -1, 63, -1, 26, 27, 28, 29, 30, 31,
+    32, 33, 34, 35, 36, 37, 38, 39, 40, 41,
+    42, 43, 44, 45, 46, 47, 48, 49, 50, 51
+};
 
-int base64Encode(const char *in, size_t in_size,
-                 char *out, size_t out_size)
+int encodeScalar(const char *in, size_t in_size,
+                 char *out, size_t out_size, bool url_safe)
 {
+    const char *encode_table = url_safe ? s_url_encode_table
+                                        : s_encode_table;
     uint8_t b[3];
     const char *out_start = out;
     const char *out_end = out + out_size;
@@ -48,66 +76,59 @@ int base64Encode(const char *in, size_t in_size,
 
         in_size -= b_len;
 
-        // overflow
-        if (out_end - out < 4) {
+        // overflow, url safe text has no padding
+        if (out_end - out < (url_safe ? b_len + 1 : 4)) {
             return -1;
         }
 
-        *out++ = s_encode_table[b[0] >> 2];
-        *out++ = s_encode_table[((b[0] & 0x03) << 4) |
-                                ((b[1] & 0xf0) >> 4)];
-        *out++ = (b_len > 1)
-               ? s_encode_table[((b[1] & 0x0f) << 2) |
-                                ((b[2] & 0xc0) >> 6)]
-               : '=';
-        *out++ = (b_len > 2)
-               ? s_encode_table[b[2] & 0x3f]
-               : '=';
+        *out++ = encode_table[b[0] >> 2];
+        *out++ = encode_table[((b[0] & 0x03) << 4) |
+                              ((b[1] & 0xf0) >> 4)];
+        if (b_len > 1) {
+            *out++ = encode_table[((b[1] & 0x0f) << 2) |
+                                  ((b[2] & 0xc0) >> 6)];
+        } else if (!url_safe) {
+            *out++ = '=';
+        }
+        if (b_len > 2) {
+            *out++ = encode_table[b[2] & 0x3f];
+        } else if (!url_safe) {
+            *out++ = '=';
+        }
     }
 
     return out - out_start;
 }
 
-std::string base64Encode(const std::string &str)
-{
-    return base64Encode(str.c_str(), str.size());
-}
-
-std::string base64Encode(const char *buffer, size_t size)
-{
-    if (size == 0) {
-        return std::string();
-    }
-
-    std::vector<char> output(((size + 2) / 3) * 4);
-    int count = base64Encode(buffer, size, output.data(), output.size());
-    if (count <= 0) {
-        return std::string();
-    } else {
-        return std::string(output.data(), count);
-    }
-}
-
-int base64Decode(const char *in, size_t in_size,
-                 char *out, size_t out_size)
+int decodeScalar(const char *in, size_t in_size,
+                 char *out, size_t out_size, bool url_safe)
 {
+    const int8_t *decode_table = url_safe ? s_url_decode_table
+                                          : s_decode_table;
     uint8_t b[4];
     const char *out_start = out;
     const char *out_end = out + out_size;
 
     while (in_size > 0) {
+        size_t quantum_size = 4;
         if (in_size < 4) {
-            return -1;
+            // url safe text may omit the padding of the last quantum
+            if (!url_safe || in_size < 2) {
+                return -1;
+            }
+            quantum_size = in_size;
         }
 
         int b_len = 0;
+        b[2] = 0;
+        b[3] = 0;
 
-        for (int i = 0; i < 4; ++i) {
+        for (size_t i = 0; i < quantum_size; ++i) {
             char c = *in++;
             if (c == '=') {
                 b[i] = 0;
                 // after '=' can only be '='
-                for (int j = i + 1; j < 4; ++j) {
+                for (size_t j = i + 1; j < quantum_size; ++j) {
                     char c2 = *in++;
                     if (c2 != '=') {
                         return -1;
@@ -122,7 +143,7 @@ int base64Decode(const char *in, size_t in_size,
             } else if (c < 43 || c > 122) {
                 return -1;
             } else {
-                int8_t v = s_decode_table[c - 43];
+                int8_t v = decode_table[c - 43];
                 if (v < 0) {
                     return -1;
                 }
@@ -163,12 +184,401 @@ int base64Decode(const char *in, size_t in_size,
             *out++ = b[2] << 6 | b[3];
         }
 
-        in_size -= 4;
+        in_size -= quantum_size;
     }
 
     return out - out_start;
 }
 
+#ifdef BRICKRED_CODEC_BASE64_X86
+// the vector algorithms of Mula and Lemire (2018), "Faster Base64
+// Encoding and Decoding Using AVX2 Instructions", the scalar functions
+// finish the text, so the last quantum which may be padded is never
+// seen by the vector loops
+struct VectorTables {
+    // added to the 6 bit value selected by its range to make the char
+    int8_t encode_offset[16];
+    // a char is invalid if the lookups by its low and high nibbles
+    // share a bit
+    uint8_t decode_low[16];
+    uint8_t decode_high[16];
+    // added to the char selected by its high nibble to make the value,
+    // the high nibble of the special char is moved by special_delta
+    // since it shares the nibble with chars of other offsets
+    int8_t decode_offset[16];
+    char decode_special;
+    int8_t decode_special_delta;
+};
+
+const VectorTables s_vector_tables[2] = {
+    {
+        {
+            'a' - 26, '0' - 52, '0' - 52, '0' - 52,
+            '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+            '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+            '/' - 63, 'A', 0, 0
+        },
+        {
+            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+            0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a
+        },
+        {
+            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10
+        },
+        {
+            0, 63 - '/', 62 - '+', 52 - '0',
+            0 - 'A', 0 - 'A', 26 - 'a', 26 - 'a',
+            0, 0, 0, 0, 0, 0, 0, 0
+        },
+        '/', -1
+    },
+    {
+        {
+            'a' - 26, '0' - 52, '0' - 52, '0' - 52,
+            '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+            '0' - 52, '0' - 52, '0' - 52, '-' - 62,
+            '_' - 63, 'A', 0, 0
+        },
+        {
+            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+            0x11, 0x11, 0x13, 0x3b, 0x3b, 0x3a, 0x3b, 0x33
+        },
+        {
+            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x20,
+            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10
+        },
+        {
+            0, 0, 62 - '-', 52 - '0',
+            0 - 'A', 0 - 'A', 26 - 'a', 26 - 'a',
+            63 - '_', 0, 0, 0, 0, 0, 0, 0
+        },
+        '_', 3
+    }
+};
+
+// 12 bytes in each 16 byte lane to 16 chars
+__attribute__((target("sse4.1")))
+inline __m128i encodeBlockSse41(__m128i input, __m128i encode_offset)
+{
+    // the 3 bytes of each 32 bit word as b1 b0 b2 b1
+    input = _mm_shuffle_epi8(input, _mm_setr_epi8(
+        1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+    // move the 4 6 bit values to the low bits of the 4 bytes
+    __m128i ac = _mm_mulhi_epu16(
+        _mm_and_si128(input, _mm_set1_epi32(0x0fc0fc00)),
+        _mm_set1_epi32(0x04000040));
+    __m128i bd = _mm_mullo_epi16(
+        _mm_and_si128(input, _mm_set1_epi32(0x003f03f0)),
+        _mm_set1_epi32(0x01000010));
+    __m128i values = _mm_or_si128(ac, bd);
+
+    // 0 for 26 ~ 51, 1 ~ 10 for 52 ~ 61, 11 and 12 for 62 and 63,
+    // 13 for 0 ~ 25
+    __m128i range = _mm_subs_epu8(values, _mm_set1_epi8(51));
+    range = _mm_or_si128(range, _mm_and_si128(
+        _mm_cmpgt_epi8(_mm_set1_epi8(26), values), _mm_set1_epi8(13)));
+
+    return _mm_add_epi8(values, _mm_shuffle_epi8(encode_offset, range));
+}
+
+__attribute__((target("avx2")))
+inline __m256i encodeBlockAvx2(__m256i input, __m256i encode_offset)
+{
+    input = _mm256_shuffle_epi8(input, _mm256_setr_epi8(
+        1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+        1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+    __m256i ac = _mm256_mulhi_epu16(
+        _mm256_and_si256(input, _mm256_set1_epi32(0x0fc0fc00)),
+        _mm256_set1_epi32(0x04000040));
+    __m256i bd = _mm256_mullo_epi16(
+        _mm256_and_si256(input, _mm256_set1_epi32(0x003f03f0)),
+        _mm256_set1_epi32(0x01000010));
+    __m256i values = _mm256_or_si256(ac, bd);
+
+    __m256i range = _mm256_subs_epu8(values, _mm256_set1_epi8(51));
+    range = _mm256_or_si256(range, _mm256_and_si256(
+        _mm256_cmpgt_epi8(_mm256_set1_epi8(26), values),
+        _mm256_set1_epi8(13)));
+
+    return _mm256_add_epi8(values,
+        _mm256_shuffle_epi8(encode_offset, range));
+}
+
+__attribute__((target("sse4.1")))
+int encodeSse41(const char *in, size_t in_size,
+                char *out, size_t out_size, bool url_safe)
+{
+    const VectorTables &t = s_vector_tables[url_safe ? 1 : 0];
+    const __m128i encode_offset =
+        _mm_loadu_si128((const __m128i *)t.encode_offset);
+    const char *out_start = out;
+
+    // a block reads 16 bytes for 12
+    while (in_size >= 16 && out_size >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)in);
+        _mm_storeu_si128((__m128i *)out, encodeBlockSse41(v, encode_offset));
+        in += 12;
+        in_size -= 12;
+        out += 16;
+        out_size -= 16;
+    }
+
+    int ret = encodeScalar(in, in_size, out, out_size, url_safe);
+    if (ret < 0) {
+        return -1;
+    }
+
+    return out - out_start + ret;
+}
+
+__attribute__((target("avx2")))
+int encodeAvx2(const char *in, size_t in_size,
+               char *out, size_t out_size, bool url_safe)
+{
+    const VectorTables &t = s_vector_tables[url_safe ? 1 : 0];
+    const __m256i encode_offset = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((const __m128i *)t.encode_offset));
+    const char *out_start = out;
+
+    // a block reads 28 bytes for 24
+    while (in_size >= 28 && out_size >= 32) {
+        __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(
+            _mm_loadu_si128((const __m128i *)in)),
+            _mm_loadu_si128((const __m128i *)(in + 12)), 1);
+        _mm256_storeu_si256((__m256i *)out,
+                            encodeBlockAvx2(v, encode_offset));
+        in += 24;
+        in_size -= 24;
+        out += 32;
+        out_size -= 32;
+    }
+
+    int ret = encodeSse41(in, in_size, out, out_size, url_safe);
+    if (ret < 0) {
+        return -1;
+    }
+
+    return out - out_start + ret;
+}
+
+__attribute__((target("sse4.1")))
+int decodeSse41(const char *in, size_t in_size,
+                char *out, size_t out_size, bool url_safe)
+{
+    const VectorTables &t = s_vector_tables[url_safe ? 1 : 0];
+    const __m128i decode_low =
+        _mm_loadu_si128((const __m128i *)t.decode_low);
+    const __m128i decode_high =
+        _mm_loadu_si128((const __m128i *)t.decode_high);
+    const __m128i decode_offset =
+        _mm_loadu_si128((const __m128i *)t.decode_offset);
+    const __m128i special = _mm_set1_epi8(t.decode_special);
+    const __m128i special_delta = _mm_set1_epi8(t.decode_special_delta);
+    const __m128i low_nibble = _mm_set1_epi8(0x0f);
+    const char *out_start = out;
+
+    // a block writes 16 bytes for 12
+    while (in_size >= 16 + 4 && out_size >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)in);
+        __m128i high = _mm_and_si128(_mm_srli_epi32(v, 4), low_nibble);
+        __m128i low = _mm_and_si128(v, low_nibble);
+        if (_mm_testz_si128(_mm_shuffle_epi8(decode_low, low),
+                            _mm_shuffle_epi8(decode_high, high)) == 0) {
+            return -1;
+        }
+
+        high = _mm_add_epi8(high, _mm_and_si128(
+            _mm_cmpeq_epi8(v, special), special_delta));
+        v = _mm_add_epi8(v, _mm_shuffle_epi8(decode_offset, high));
+        // pack the 4 6 bit values of each 32 bit word to 3 bytes
+        v = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));
+        v = _mm_madd_epi16(v, _mm_set1_epi32(0x00011000));
+        v = _mm_shuffle_epi8(v, _mm_setr_epi8(
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+        _mm_storeu_si128((__m128i *)out, v);
+
+        in += 16;
+        in_size -= 16;
+        out += 12;
+        out_size -= 12;
+    }
+
+    int ret = decodeScalar(in, in_size, out, out_size, url_safe);
+    if (ret < 0) {
+        return -1;
+    }
+
+    return out - out_start + ret;
+}
+
+__attribute__((target("avx2")))
+int decodeAvx2(const char *in, size_t in_size,
+               char *out, size_t out_size, bool url_safe)
+{
+    const VectorTables &t = s_vector_tables[url_safe ? 1 : 0];
+    const __m256i decode_low = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((const __m128i *)t.decode_low));
+    const __m256i decode_high = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((const __m128i *)t.decode_high));
+    const __m256i decode_offset = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((const __m128i *)t.decode_offset));
+    const __m256i special = _mm256_set1_epi8(t.decode_special);
+    const __m256i special_delta =
+        _mm256_set1_epi8(t.decode_special_delta);
+    const __m256i low_nibble = _mm256_set1_epi8(0x0f);
+    const char *out_start = out;
+
+    // a block writes 32 bytes for 24
+    while (in_size >= 32 + 4 && out_size >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)in);
+        __m256i high = _mm256_and_si256(_mm256_srli_epi32(v, 4),
+                                        low_nibble);
+        __m256i low = _mm256_and_si256(v, low_nibble);
+        if (_mm256_testz_si256(_mm256_shuffle_epi8(decode_low, low),
+                               _mm256_shuffle_epi8(decode_high, high)) == 0) {
+            return -1;
+        }
+
+        high = _mm256_add_epi8(high, _mm256_and_si256(
+            _mm256_cmpeq_epi8(v, special), special_delta));
+        v = _mm256_add_epi8(v, _mm256_shuffle_epi8(decode_offset, high));
+        v = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+        v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00011000));
+        v = _mm256_shuffle_epi8(v, _mm256_setr_epi8(
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+        // join the 12 bytes of the two lanes
+        v = _mm256_permutevar8x32_epi32(v,
+            _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+        _mm256_storeu_si256((__m256i *)out, v);
+
+        in += 32;
+        in_size -= 32;
+        out += 24;
+        out_size -= 24;
+    }
+
+    int ret = decodeSse41(in, in_size, out, out_size, url_safe);
+    if (ret < 0) {
+        return -1;
+    }
+
+    return out - out_start + ret;
+}
+#endif
+
+bool isSupported(Base64Impl impl)
+{
+    switch (impl) {
+    case Base64Impl::SCALAR:
+        return true;
+#ifdef BRICKRED_CODEC_BASE64_X86
+    case Base64Impl::SSE41:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse4.1");
+    case Base64Impl::AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+EncodeFunc getEncodeFunc(Base64Impl impl)
+{
+    switch (impl) {
+    case Base64Impl::SCALAR:
+        return encodeScalar;
+#ifdef BRICKRED_CODEC_BASE64_X86
+    case Base64Impl::SSE41:
+        return encodeSse41;
+    case Base64Impl::AVX2:
+        return encodeAvx2;
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+DecodeFunc getDecodeFunc(Base64Impl impl)
+{
+    switch (impl) {
+    case Base64Impl::SCALAR:
+        return decodeScalar;
+#ifdef BRICKRED_CODEC_BASE64_X86
+    case Base64Impl::SSE41:
+        return decodeSse41;
+    case Base64Impl::AVX2:
+        return decodeAvx2;
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+Base64Impl selectImpl()
+{
+    if (isSupported(Base64Impl::AVX2)) {
+        return Base64Impl::AVX2;
+    }
+    if (isSupported(Base64Impl::SSE41)) {
+        return Base64Impl::SSE41;
+    }
+    return Base64Impl::SCALAR;
+}
+
+int encode(const char *in, size_t in_size,
+           char *out, size_t out_size, bool url_safe)
+{
+    static const EncodeFunc s_encode_func = getEncodeFunc(base64GetImpl());
+
+    return s_encode_func(in, in_size, out, out_size, url_safe);
+}
+
+int decode(const char *in, size_t in_size,
+           char *out, size_t out_size, bool url_safe)
+{
+    static const DecodeFunc s_decode_func = getDecodeFunc(base64GetImpl());
+
+    return s_decode_func(in, in_size, out, out_size, url_safe);
+}
+
+} // namespace
+
+int base64Encode(const char *in, size_t in_size,
+                 char *out, size_t out_size)
+{
+    return encode(in, in_size, out, out_size, false);
+}
+
+std::string base64Encode(const std::string &str)
+{
+    return base64Encode(str.c_str(), str.size());
+}
+
+std::string base64Encode(const char *buffer, size_t size)
+{
+    if (size == 0) {
+        return std::string();
+    }
+
+    std::vector<char> output(((size + 2) / 3) * 4);
+    int count = base64Encode(buffer, size, output.data(), output.size());
+    if (count <= 0) {
+        return std::string();
+    } else {
+        return std::string(output.data(), count);
+    }
+}
+
+int base64Decode(const char *in, size_t in_size,
+                 char *out, size_t out_size)
+{
+    return decode(in, in_size, out, out_size, false);
+}
+
 std::string base64Decode(const std::string &str)
 {
     return base64Decode(str.c_str(), str.size());
@@ -192,4 +602,112 @@ std::string base64Decode(const char *buffer, size_t size)
     }
 }
 
+int base64UrlEncode(const char *in, size_t in_size,
+                    char *out, size_t out_size)
+{
+    return encode(in, in_size, out, out_size, true);
+}
+
+std::string base64UrlEncode(const std::string &str)
+{
+    return base64UrlEncode(str.c_str(), str.size());
+}
+
+std::string base64UrlEncode(const char *buffer, size_t size)
+{
+    if (size == 0) {
+        return std::string();
+    }
+
+    std::vector<char> output((size * 4 + 2) / 3);
+    int count = base64UrlEncode(buffer, size, output.data(), output.size());
+    if (count <= 0) {
+        return std::string();
+    } else {
+        return std::string(output.data(), count);
+    }
+}
+
+int base64UrlDecode(const char *in, size_t in_size,
+                    char *out, size_t out_size)
+{
+    return decode(in, in_size, out, out_size, true);
+}
+
+std::string base64UrlDecode(const std::string &str)
+{
+    return base64UrlDecode(str.c_str(), str.size());
+}
+
+std::string base64UrlDecode(const char *buffer, size_t size)
+{
+    if (size == 0) {
+        return std::string();
+    }
+    if (size % 4 == 1) {
+        return std::string();
+    }
+
+    std::vector<char> output((size + 3) / 4 * 3);
+    int count = base64UrlDecode(buffer, size, output.data(), output.size());
+    if (count <= 0) {
+        return std::string();
+    } else {
+        return std::string(output.data(), count);
+    }
+}
+
+Base64Impl base64GetImpl()
+{
+    static const Base64Impl s_impl = selectImpl();
+
+    return s_impl;
+}
+
+const char *base64GetImplName(Base64Impl impl)
+{
+    static const char *s_impl_names[] = {
+        "auto", "scalar", "sse4.1", "avx2"
+    };
+    static_assert(sizeof(s_impl_names) / sizeof(s_impl_names[0]) ==
+                  (size_t)Base64Impl::MAX);
+
+    if (impl < Base64Impl::AUTO || impl >= Base64Impl::MAX) {
+        return "unknown";
+    }
+    return s_impl_names[(int)impl];
+}
+
+bool base64EncodeWith(Base64Impl impl, bool url_safe,
+                      const char *in, size_t in_size,
+                      char *out, size_t out_size, int *result)
+{
+    if (Base64Impl::AUTO == impl) {
+        impl = base64GetImpl();
+    }
+    if (isSupported(impl) == false) {
+        return false;
+    }
+
+    *result = getEncodeFunc(impl)(in, in_size, out, out_size, url_safe);
+
+    return true;
+}
+
+bool base64DecodeWith(Base64Impl impl, bool url_safe,
+                      const char *in, size_t in_size,
+                      char *out, size_t out_size, int *result)
+{
+    if (Base64Impl::AUTO == impl) {
+        impl = base64GetImpl();
+    }
+    if (isSupported(impl) == false) {
+        return false;
+    }
+
+    *result = getDecodeFunc(impl)(in, in_size, out, out_size, url_safe);
+
+    return true;
+}
+
 } // namespace brickred::codec
@@ -6,6 +6,14 @@
 
 namespace brickred::codec {
 
+enum class Base64Impl {
+    AUTO = 0,
+    SCALAR,
+    SSE41,
+    AVX2,
+    MAX
+};
+
 int base64Encode(const char *in, size_t in_size,
                  char *out, size_t out_size);
 std::string base64Encode(const std::string &str);
@@ -16,6 +24,32 @@ int base64Decode(const char *in, size_t in_size,
 std::string base64Decode(const std::string &str);
 std::string base64Decode(const char *buffer, size_t size);
 
+// url and filename safe alphabet of rfc 4648, '-' and '_' take the place
+// of '+' and '/', encode omits the padding and decode accepts text
+// with or without it
+int base64UrlEncode(const char *in, size_t in_size,
+                    char *out, size_t out_size);
+std::string base64UrlEncode(const std::string &str);
+std::string base64UrlEncode(const char *buffer, size_t size);
+
+int base64UrlDecode(const char *in, size_t in_size,
+                    char *out, size_t out_size);
+std::string base64UrlDecode(const std::string &str);
+std::string base64UrlDecode(const char *buffer, size_t size);
+
+// the implementation used by the functions above, picked by the cpu
+// at startup
+Base64Impl base64GetImpl();
+const char *base64GetImplName(Base64Impl impl);
+// return false if the cpu does not support impl, result is the return
+// value of base64(Url)Encode() or base64(Url)Decode()
+bool base64EncodeWith(Base64Impl impl, bool url_safe,
+                      const char *in, size_t in_size,
+                      char *out, size_t out_size, int *result);
+bool base64DecodeWith(Base64Impl impl, bool url_safe,
+                      const char *in, size_t in_size,
+                      char *out, size_t out_size, int *result);
+
 } // namespace brickred::codec
 
 #endif
@@ -1,9 +1,18 @@
 #include <brickred/codec/md5.h>
 
+#include <cstdint>
 #include <cstdio>
 #include <cstring>
 #include <algorithm>
 
+#include <brickred/thread.h>
+#include <brickred/unique_ptr.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BRICKRED_CODEC_MD5_X86
+#include <immintrin.h>
+#endif
+
 namespace brickred::codec {
 
 Md5::Md5()
@@ -24,7 +33,11 @@ void Md5::reset()
     message_size_ = 0;
 }
 
-static void md5ProcessBlock(uint32_t *hash, const uint8_t *work_block)
+// the 64 steps on the 4 words of hash, T is uint32_t or a vector of
+// uint32_t lanes which hashes a block of each lane at once
+template <typename T>
+__attribute__((always_inline))
+static inline void md5Rounds(T hash[4], const T w[16])
 {
     #define ROTLEFT(_a, _b) (((_a) << (_b)) | ((_a) >> (32 - (_b))))
     #define F(_x, _y, _z) (((_x) & (_y)) | (~(_x) & (_z)))
@@ -57,19 +70,10 @@ static void md5ProcessBlock(uint32_t *hash, const uint8_t *work_block)
     }
 
 
-    uint32_t a = hash[0];
-    uint32_t b = hash[1];
-    uint32_t c = hash[2];
-    uint32_t d = hash[3];
-    uint32_t w[64];
-
-    // init arary w
-    for (int i = 0; i < 16; ++i) {
-        w[i] = ((uint32_t)work_block[i * 4 + 3] << 24) |
-               ((uint32_t)work_block[i * 4 + 2] << 16) |
-               ((uint32_t)work_block[i * 4 + 1] << 8) |
-               ((uint32_t)work_block[i * 4]);
-    }
+    T a = hash[0];
+    T b = hash[1];
+    T c = hash[2];
+    T d = hash[3];
 
     FF(a, b, c, d, w[0],   7, 0xd76aa478);
     FF(d, a, b, c, w[1],  12, 0xe8c7b756);
@@ -155,6 +159,34 @@ static void md5ProcessBlock(uint32_t *hash, const uint8_t *work_block)
     #undef ROTLEFT
 }
 
+static inline uint32_t md5LoadWord(const uint8_t *p)
+{
+    return ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) |
+           ((uint32_t)p[1] << 8) | ((uint32_t)p[0]);
+}
+
+static void md5ProcessBlock(uint32_t *hash, const uint8_t *work_block)
+{
+    uint32_t w[16];
+
+    // init arary w
+    for (int i = 0; i < 16; ++i) {
+        w[i] = md5LoadWord(work_block + i * 4);
+    }
+
+    md5Rounds(hash, w);
+}
+
+static void md5StoreHash(const uint32_t state[4], char hash[16])
+{
+    for (int i = 0; i < 4; ++i) {
+        hash[i * 4 + 3] = state[i] >> 24;
+        hash[i * 4 + 2] = state[i] >> 16;
+        hash[i * 4 + 1] = state[i] >> 8;
+        hash[i * 4] = state[i];
+    }
+}
+
 void Md5::update(const char *buffer, size_t size)
 {
     size_t wb_size = message_size_ & 63;
@@ -214,12 +246,7 @@ void Md5::digest(char hash[16])
         update((const char *)pad_len, 8);
     }
 
-    for (int i = 0; i < 4; ++i) {
-        hash[i * 4 + 3] = hash_[i] >> 24;
-        hash[i * 4 + 2] = hash_[i] >> 16;
-        hash[i * 4 + 1] = hash_[i] >> 8;
-        hash[i * 4] = hash_[i];
-    }
+    md5StoreHash(hash_, hash);
 }
 
 std::string Md5::digest()
@@ -266,4 +293,371 @@ std::string md5Binary(const char *buffer, size_t size)
     return std::string(hash, sizeof(hash));
 }
 
+///////////////////////////////////////////////////////////////////////////////
+namespace {
+
+using Md5BatchFunc = void (*)(const char *const buffers[],
+                              const size_t sizes[], size_t count,
+                              char hashes[][16]);
+
+#ifdef BRICKRED_CODEC_MD5_X86
+typedef uint32_t Md5Vec4 __attribute__((vector_size(16)));
+typedef uint32_t Md5Vec8 __attribute__((vector_size(32)));
+
+const uint32_t s_md5_init_hash[4] = {
+    0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476
+};
+
+// word i of the blocks of all lanes to w[i], the blocks are loaded
+// whole and transposed in registers, the generic shuffles turn to
+// unpack and permute instructions of the target
+__attribute__((always_inline))
+inline void md5LoadWords(Md5Vec4 w[16], const uint8_t *const blocks[4])
+{
+    for (int i = 0; i < 16; i += 4) {
+        Md5Vec4 r[4];
+        for (int l = 0; l < 4; ++l) {
+            ::memcpy(&r[l], blocks[l] + i * 4, sizeof(r[l]));
+        }
+        Md5Vec4 t0 = __builtin_shuffle(r[0], r[1], Md5Vec4{0, 4, 1, 5});
+        Md5Vec4 t1 = __builtin_shuffle(r[0], r[1], Md5Vec4{2, 6, 3, 7});
+        Md5Vec4 t2 = __builtin_shuffle(r[2], r[3], Md5Vec4{0, 4, 1, 5});
+        Md5Vec4 t3 = __builtin_shuffle(r[2], r[3], Md5Vec4{2, 6, 3, 7});
+        w[i] = __builtin_shuffle(t0, t2, Md5Vec4{0, 1, 4, 5});
+        w[i + 1] = __builtin_shuffle(t0, t2, Md5Vec4{2, 3, 6, 7});
+        w[i + 2] = __builtin_shuffle(t1, t3, Md5Vec4{0, 1, 4, 5});
+        w[i + 3] = __builtin_shuffle(t1, t3, Md5Vec4{2, 3, 6, 7});
+    }
+}
+
+__attribute__((always_inline))
+inline void md5LoadWords(Md5Vec8 w[16], const uint8_t *const blocks[8])
+{
+    const Md5Vec8 unpack_lo_32 = {0, 8, 1, 9, 4, 12, 5, 13};
+    const Md5Vec8 unpack_hi_32 = {2, 10, 3, 11, 6, 14, 7, 15};
+    const Md5Vec8 unpack_lo_64 = {0, 1, 8, 9, 4, 5, 12, 13};
+    const Md5Vec8 unpack_hi_64 = {2, 3, 10, 11, 6, 7, 14, 15};
+    const Md5Vec8 join_lo_128 = {0, 1, 2, 3, 8, 9, 10, 11};
+    const Md5Vec8 join_hi_128 = {4, 5, 6, 7, 12, 13, 14, 15};
+
+    for (int i = 0; i < 16; i += 8) {
+        Md5Vec8 r[8];
+        for (int l = 0; l < 8; ++l) {
+            ::memcpy(&r[l], blocks[l] + i * 4, sizeof(r[l]));
+        }
+        // 4x4 transposes in the 128 bit halves
+        Md5Vec8 t[8];
+        for (int l = 0; l < 8; l += 4) {
+            Md5Vec8 t0 = __builtin_shuffle(r[l], r[l + 1], unpack_lo_32);
+            Md5Vec8 t1 = __builtin_shuffle(r[l], r[l + 1], unpack_hi_32);
+            Md5Vec8 t2 = __builtin_shuffle(r[l + 2], r[l + 3], unpack_lo_32);
+            Md5Vec8 t3 = __builtin_shuffle(r[l + 2], r[l + 3], unpack_hi_32);
+            t[l] = __builtin_shuffle(t0, t2, unpack_lo_64);
+            t[l + 1] = __builtin_shuffle(t0, t2, unpack_hi_64);
+            t[l + 2] = __builtin_shuffle(t1, t3, unpack_lo_64);
+            t[l + 3] = __builtin_shuffle(t1, t3, unpack_hi_64);
+        }
+        // the low halves hold words 0 ~ 3 and the high halves 4 ~ 7
+        for (int j = 0; j < 4; ++j) {
+            w[i + j] = __builtin_shuffle(t[j], t[j + 4], join_lo_128);
+            w[i + j + 4] = __builtin_shuffle(t[j], t[j + 4], join_hi_128);
+        }
+    }
+}
+
+// a buffer hashed in a lane, the full blocks are read in place and the
+// last one or two blocks with the padding are built in tail
+struct Md5Lane {
+    const uint8_t *data;
+    size_t full_blocks;
+    uint8_t tail[128];
+    size_t tail_blocks;
+    size_t tail_index;
+    size_t stream;
+    bool idle;
+};
+
+void md5LaneStart(Md5Lane *lane, const char *buffer, size_t size,
+                  size_t stream)
+{
+    size_t left = size & 63;
+    uint64_t bit_size = (uint64_t)size * 8;
+
+    lane->data = (const uint8_t *)buffer;
+    lane->full_blocks = size / 64;
+    lane->tail_blocks = (left > 55) ? 2 : 1;
+    lane->tail_index = 0;
+    lane->stream = stream;
+    lane->idle = false;
+
+    ::memset(lane->tail, 0, sizeof(lane->tail));
+    ::memcpy(lane->tail, buffer + size - left, left);
+    lane->tail[left] = 0x80;
+    uint8_t *pad_len = lane->tail + lane->tail_blocks * 64 - 8;
+    for (int i = 0; i < 8; ++i) {
+        pad_len[i] = bit_size >> (i * 8);
+    }
+}
+
+// return nullptr if the buffer is done
+const uint8_t *md5LaneNextBlock(Md5Lane *lane)
+{
+    if (lane->full_blocks > 0) {
+        const uint8_t *block = lane->data;
+        lane->data += 64;
+        --lane->full_blocks;
+        return block;
+    }
+    if (lane->tail_index < lane->tail_blocks) {
+        return lane->tail + 64 * lane->tail_index++;
+    }
+    return nullptr;
+}
+
+// a lane takes the next buffer as soon as its buffer is done, so buffers
+// of any size keep all lanes busy until the last ones
+template <typename Vec, int Lanes>
+__attribute__((always_inline))
+inline void md5BatchLanes(const char *const buffers[], const size_t sizes[],
+                          size_t count, char hashes[][16])
+{
+    static const uint8_t s_idle_block[64] = { 0 };
+
+    Md5Lane lanes[Lanes];
+    const uint8_t *blocks[Lanes];
+    Vec hash[4];
+    size_t next = 0;
+    int active = 0;
+
+    for (int l = 0; l < Lanes; ++l) {
+        for (int i = 0; i < 4; ++i) {
+            hash[i][l] = s_md5_init_hash[i];
+        }
+        if (next < count) {
+            md5LaneStart(&lanes[l], buffers[next], sizes[next], next);
+            blocks[l] = md5LaneNextBlock(&lanes[l]);
+            ++next;
+            ++active;
+        } else {
+            lanes[l].idle = true;
+            blocks[l] = s_idle_block;
+        }
+    }
+
+    while (active > 0) {
+        Vec w[16];
+        md5LoadWords(w, blocks);
+        md5Rounds(hash, w);
+
+        for (int l = 0; l < Lanes; ++l) {
+            if (lanes[l].idle) {
+                continue;
+            }
+            blocks[l] = md5LaneNextBlock(&lanes[l]);
+            if (blocks[l] != nullptr) {
+                continue;
+            }
+
+            uint32_t state[4];
+            for (int i = 0; i < 4; ++i) {
+                state[i] = hash[i][l];
+                hash[i][l] = s_md5_init_hash[i];
+            }
+            md5StoreHash(state, hashes[lanes[l].stream]);
+
+            if (next < count) {
+                md5LaneStart(&lanes[l], buffers[next], sizes[next], next);
+                blocks[l] = md5LaneNextBlock(&lanes[l]);
+                ++next;
+            } else {
+                lanes[l].idle = true;
+                blocks[l] = s_idle_block;
+                --active;
+            }
+        }
+    }
+}
+
+#endif
+
+void md5BatchScalar(const char *const buffers[], const size_t sizes[],
+                    size_t count, char hashes[][16])
+{
+    Md5 ctx;
+
+    for (size_t i = 0; i < count; ++i) {
+        ctx.reset();
+        ctx.update(buffers[i], sizes[i]);
+        ctx.digest(hashes[i]);
+    }
+}
+
+#ifdef BRICKRED_CODEC_MD5_X86
+__attribute__((target("sse2")))
+void md5BatchSse2(const char *const buffers[], const size_t sizes[],
+                  size_t count, char hashes[][16])
+{
+    md5BatchLanes<Md5Vec4, 4>(buffers, sizes, count, hashes);
+}
+
+__attribute__((target("avx2")))
+void md5BatchAvx2(const char *const buffers[], const size_t sizes[],
+                  size_t count, char hashes[][16])
+{
+    md5BatchLanes<Md5Vec8, 8>(buffers, sizes, count, hashes);
+}
+#endif
+
+bool md5BatchIsSupported(Md5BatchImpl impl)
+{
+    switch (impl) {
+    case Md5BatchImpl::SCALAR:
+        return true;
+#ifdef BRICKRED_CODEC_MD5_X86
+    case Md5BatchImpl::SSE2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse2");
+    case Md5BatchImpl::AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+Md5BatchFunc md5BatchGetFunc(Md5BatchImpl impl)
+{
+    switch (impl) {
+    case Md5BatchImpl::SCALAR:
+        return md5BatchScalar;
+#ifdef BRICKRED_CODEC_MD5_X86
+    case Md5BatchImpl::SSE2:
+        return md5BatchSse2;
+    case Md5BatchImpl::AVX2:
+        return md5BatchAvx2;
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+Md5BatchImpl md5BatchSelectImpl()
+{
+    if (md5BatchIsSupported(Md5BatchImpl::AVX2)) {
+        return Md5BatchImpl::AVX2;
+    }
+    if (md5BatchIsSupported(Md5BatchImpl::SSE2)) {
+        return Md5BatchImpl::SSE2;
+    }
+    return Md5BatchImpl::SCALAR;
+}
+
+// a part of the batch hashed by a thread
+struct Md5BatchTask {
+    Thread thread;
+    const char *const *buffers;
+    const size_t *sizes;
+    size_t count;
+    char (*hashes)[16];
+
+    void run()
+    {
+        md5Batch(buffers, sizes, count, hashes);
+    }
+};
+
+} // namespace
+
+void md5Batch(const char *const buffers[], const size_t sizes[],
+              size_t count, char hashes[][16])
+{
+    static const Md5BatchFunc s_batch_func =
+        md5BatchGetFunc(md5BatchGetImpl());
+
+    s_batch_func(buffers, sizes, count, hashes);
+}
+
+void md5BatchParallel(const char *const buffers[], const size_t sizes[],
+                      size_t count, char hashes[][16], int thread_count)
+{
+    if (thread_count <= 1 || count <= 1) {
+        md5Batch(buffers, sizes, count, hashes);
+        return;
+    }
+    if ((size_t)thread_count > count) {
+        thread_count = count;
+    }
+
+    // every buffer costs at least a block
+    uint64_t total_bytes = 0;
+    for (size_t i = 0; i < count; ++i) {
+        total_bytes += sizes[i] + 64;
+    }
+
+    UniquePtr<Md5BatchTask[]> tasks(new Md5BatchTask[thread_count]);
+    uint64_t bytes = 0;
+    size_t begin = 0;
+
+    for (int t = 0; t < thread_count; ++t) {
+        uint64_t part_end = total_bytes * (t + 1) / thread_count;
+        size_t end = begin;
+        while (end < count && (t == thread_count - 1 || bytes < part_end)) {
+            bytes += sizes[end] + 64;
+            ++end;
+        }
+        tasks[t].buffers = buffers + begin;
+        tasks[t].sizes = sizes + begin;
+        tasks[t].count = end - begin;
+        tasks[t].hashes = hashes + begin;
+        begin = end;
+    }
+
+    for (int t = 1; t < thread_count; ++t) {
+        tasks[t].thread.start(BRICKRED_BIND_MEM_FUNC(
+            &Md5BatchTask::run, &tasks[t]));
+    }
+    tasks[0].run();
+    for (int t = 1; t < thread_count; ++t) {
+        tasks[t].thread.join();
+    }
+}
+
+Md5BatchImpl md5BatchGetImpl()
+{
+    static const Md5BatchImpl s_impl = md5BatchSelectImpl();
+
+    return s_impl;
+}
+
+const char *md5BatchGetImplName(Md5BatchImpl impl)
+{
+    static const char *s_impl_names[] = {
+        "auto", "scalar", "sse2", "avx2"
+    };
+    static_assert(sizeof(s_impl_names) / sizeof(s_impl_names[0]) ==
+                  (size_t)Md5BatchImpl::MAX);
+
+    if (impl < Md5BatchImpl::AUTO || impl >= Md5BatchImpl::MAX) {
+        return "unknown";
+    }
+    return s_impl_names[(int)impl];
+}
+
+bool md5BatchWith(Md5BatchImpl impl,
+                  const char *const buffers[], const size_t sizes[],
+                  size_t count, char hashes[][16])
+{
+    if (Md5BatchImpl::AUTO == impl) {
+        impl = md5BatchGetImpl();
+    }
+    if (md5BatchIsSupported(impl) == false) {
+        return false;
+    }
+
+    md5BatchGetFunc(impl)(buffers, sizes, count, hashes);
+
+    return true;
+}
+
 } // namespace brickred::codec
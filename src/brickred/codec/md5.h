@@ -9,6 +9,14 @@
 
 namespace brickred::codec {
 
+enum class Md5BatchImpl {
+    AUTO = 0,
+    SCALAR,
+    SSE2,
+    AVX2,
+    MAX
+};
+
 class Md5 final {
 public:
     Md5();
@@ -32,6 +40,25 @@ std::string md5(const char *buffer, size_t size);
 std::string md5Binary(const std::string &str);
 std::string md5Binary(const char *buffer, size_t size);
 
+// hash count independent buffers into hashes, the buffers are hashed
+// side by side in the lanes of a vector register (4 with sse2 and 8
+// with avx2), which hides the latency of the serial rounds of md5 and
+// is faster than Md5 for many small buffers
+void md5Batch(const char *const buffers[], const size_t sizes[],
+              size_t count, char hashes[][16]);
+// md5Batch() split by bytes between thread_count threads,
+// the calling thread is one of them
+void md5BatchParallel(const char *const buffers[], const size_t sizes[],
+                      size_t count, char hashes[][16], int thread_count);
+
+// the implementation used by md5Batch(), picked by the cpu at startup
+Md5BatchImpl md5BatchGetImpl();
+const char *md5BatchGetImplName(Md5BatchImpl impl);
+// return false if the cpu does not support impl
+bool md5BatchWith(Md5BatchImpl impl,
+                  const char *const buffers[], const size_t sizes[],
+                  size_t count, char hashes[][16]);
+
 } // namespace brickred::codec
 
 #endif
@@ -5,9 +5,18 @@
 #include <cstring>
 #include <algorithm>
 
+#if defined(__x86_64__) || defined(__i386__)
+#define BRICKRED_CODEC_SHA1_X86
+#include <immintrin.h>
+#endif
+
 namespace brickred::codec {
 
-Sha1::Sha1()
+using Sha1ProcessFunc = void (*)(uint32_t *hash, const uint8_t *blocks,
+                                 size_t count);
+
+Sha1::Sha1() :
+    impl_(getDefaultImpl())
 {
     reset();
 }
@@ -82,8 +91,172 @@ static void sha1ProcessBlock(uint32_t *hash, const uint8_t *work_block)
     #undef ROTL32
 }
 
+static void sha1ProcessBlocksScalar(uint32_t *hash, const uint8_t *blocks,
+                                    size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        sha1ProcessBlock(hash, blocks + i * 64);
+    }
+}
+
+#ifdef BRICKRED_CODEC_SHA1_X86
+// the function of sha1rnds4 must be an immediate, the switch is folded
+// when the loop below is unrolled
+__attribute__((target("sha,sse4.1")))
+static inline __m128i sha1Rounds4(__m128i abcd, __m128i e, int function)
+{
+    switch (function) {
+    case 0:
+        return _mm_sha1rnds4_epu32(abcd, e, 0);
+    case 1:
+        return _mm_sha1rnds4_epu32(abcd, e, 1);
+    case 2:
+        return _mm_sha1rnds4_epu32(abcd, e, 2);
+    default:
+        return _mm_sha1rnds4_epu32(abcd, e, 3);
+    }
+}
+
+// message words are reversed into lanes, w[0] is in the highest lane,
+// w[i] = rotl(w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16], 1) is computed by
+// sha1msg1, xor and sha1msg2 four words at a time
+__attribute__((target("sha,sse4.1")))
+static void sha1ProcessBlocksShaNi(uint32_t *hash, const uint8_t *blocks,
+                                   size_t count)
+{
+    const __m128i byte_mask = _mm_set_epi64x(
+        0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+
+    __m128i abcd = _mm_shuffle_epi32(
+        _mm_loadu_si128((const __m128i *)hash), 0x1b);
+    __m128i e0 = _mm_set_epi32(hash[4], 0, 0, 0);
+    __m128i e1;
+    __m128i msg[4];
+
+    for (size_t n = 0; n < count; ++n) {
+        const uint8_t *block = blocks + n * 64;
+        __m128i abcd_save = abcd;
+        __m128i e0_save = e0;
+
+        for (int i = 0; i < 4; ++i) {
+            msg[i] = _mm_shuffle_epi8(_mm_loadu_si128(
+                (const __m128i *)(block + i * 16)), byte_mask);
+        }
+
+        // 4 rounds per group, e of the next group is computed from
+        // a of the current one
+        e0 = _mm_add_epi32(e0, msg[0]);
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+        #pragma GCC unroll 19
+        for (int i = 1; i < 20; ++i) {
+            if (i >= 3 && i <= 18) {
+                msg[(i + 1) & 3] = _mm_sha1msg2_epu32(
+                    msg[(i + 1) & 3], msg[i & 3]);
+            }
+            if (i & 1) {
+                e1 = _mm_sha1nexte_epu32(e1, msg[i & 3]);
+                e0 = abcd;
+                abcd = sha1Rounds4(abcd, e1, i / 5);
+            } else {
+                e0 = _mm_sha1nexte_epu32(e0, msg[i & 3]);
+                e1 = abcd;
+                abcd = sha1Rounds4(abcd, e0, i / 5);
+            }
+            if (i <= 16) {
+                msg[(i - 1) & 3] = _mm_sha1msg1_epu32(
+                    msg[(i - 1) & 3], msg[i & 3]);
+            }
+            if (i >= 2 && i <= 17) {
+                msg[(i - 2) & 3] = _mm_xor_si128(
+                    msg[(i - 2) & 3], msg[i & 3]);
+            }
+        }
+
+        e0 = _mm_sha1nexte_epu32(e0, e0_save);
+        abcd = _mm_add_epi32(abcd, abcd_save);
+    }
+
+    _mm_storeu_si128((__m128i *)hash, _mm_shuffle_epi32(abcd, 0x1b));
+    hash[4] = _mm_extract_epi32(e0, 3);
+}
+#endif
+
+static bool sha1IsSupported(Sha1::Impl impl)
+{
+    switch (impl) {
+    case Sha1::Impl::SCALAR:
+        return true;
+#ifdef BRICKRED_CODEC_SHA1_X86
+    case Sha1::Impl::SHA_NI:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sha") &&
+               __builtin_cpu_supports("sse4.1");
+#endif
+    default:
+        return false;
+    }
+}
+
+static Sha1ProcessFunc sha1GetProcessFunc(Sha1::Impl impl)
+{
+    switch (impl) {
+#ifdef BRICKRED_CODEC_SHA1_X86
+    case Sha1::Impl::SHA_NI:
+        return sha1ProcessBlocksShaNi;
+#endif
+    default:
+        return sha1ProcessBlocksScalar;
+    }
+}
+
+static Sha1::Impl sha1SelectImpl()
+{
+    if (sha1IsSupported(Sha1::Impl::SHA_NI)) {
+        return Sha1::Impl::SHA_NI;
+    }
+    return Sha1::Impl::SCALAR;
+}
+
+bool Sha1::setImpl(Impl impl)
+{
+    if (Impl::AUTO == impl) {
+        impl = getDefaultImpl();
+    }
+    if (sha1IsSupported(impl) == false) {
+        return false;
+    }
+
+    impl_ = impl;
+
+    return true;
+}
+
+Sha1::Impl Sha1::getDefaultImpl()
+{
+    static const Impl s_impl = sha1SelectImpl();
+
+    return s_impl;
+}
+
+const char *Sha1::getImplName(Impl impl)
+{
+    static const char *s_impl_names[] = {
+        "auto", "scalar", "sha_ni"
+    };
+    static_assert(sizeof(s_impl_names) / sizeof(s_impl_names[0]) ==
+                  (size_t)Impl::MAX);
+
+    if (impl < Impl::AUTO || impl >= Impl::MAX) {
+        return "unknown";
+    }
+    return s_impl_names[(int)impl];
+}
+
 void Sha1::update(const char *buffer, size_t size)
 {
+    Sha1ProcessFunc process_blocks = sha1GetProcessFunc(impl_);
     size_t wb_size = message_size_ & 63;
     message_size_ += size;
 
@@ -97,16 +270,16 @@ void Sha1::update(const char *buffer, size_t size)
             return;
         }
         // process work block
-        sha1ProcessBlock(hash_, work_block_);
+        process_blocks(hash_, work_block_, 1);
         buffer += left;
         size -= left;
     }
 
     // process left 64-byte block data without copy
-    while (size >= 64) {
-        sha1ProcessBlock(hash_, (uint8_t *)buffer);
-        buffer += 64;
-        size -= 64;
+    if (size >= 64) {
+        process_blocks(hash_, (const uint8_t *)buffer, size / 64);
+        buffer += size & ~(size_t)63;
+        size &= 63;
     }
 
     // save leftover to work block
@@ -11,6 +11,13 @@ namespace brickred::codec {
 
 class Sha1 final {
 public:
+    enum class Impl {
+        AUTO = 0,
+        SCALAR,
+        SHA_NI,
+        MAX
+    };
+
     Sha1();
     ~Sha1();
     void reset();
@@ -19,12 +26,20 @@ public:
     void digest(char hash[20]);
     std::string digest();
 
+    // AUTO is the implementation picked by the cpu at startup,
+    // return false if the cpu does not support impl
+    bool setImpl(Impl impl);
+    Impl getImpl() const { return impl_; }
+    static Impl getDefaultImpl();
+    static const char *getImplName(Impl impl);
+
 private:
     BRICKRED_NONCOPYABLE(Sha1)
 
     uint32_t hash_[5];
     uint8_t work_block_[64];
     uint64_t message_size_;
+    Impl impl_;
 };
 
 std::string sha1(const std::string &str);
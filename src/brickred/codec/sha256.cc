@@ -5,9 +5,37 @@
 #include <cstring>
 #include <algorithm>
 
+#if defined(__x86_64__) || defined(__i386__)
+#define BRICKRED_CODEC_SHA256_X86
+#include <immintrin.h>
+#endif
+
 namespace brickred::codec {
 
-Sha256::Sha256()
+using Sha256ProcessFunc = void (*)(uint32_t *hash, const uint8_t *blocks,
+                                   size_t count);
+
+static const uint32_t s_sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+Sha256::Sha256() :
+    impl_(getDefaultImpl())
 {
     reset();
 }
@@ -31,24 +59,7 @@ void Sha256::reset()
 
 static void sha256ProcessBlock(uint32_t *hash, const uint8_t *work_block)
 {
-    static const uint32_t k[64] = {
-        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
-        0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
-        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
-        0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
-        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
-        0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
-        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
-        0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
-        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
-        0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
-        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
-        0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
-        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
-        0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
-        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
-        0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
-    };
+    const uint32_t *k = s_sha256_k;
 
     #define ROTLEFT(_a, _b) (((_a) << (_b)) | ((_a) >> (32 - (_b))))
     #define ROTRIGHT(_a, _b) (((_a) >> (_b)) | ((_a) << (32 - (_b))))
@@ -112,8 +123,150 @@ static void sha256ProcessBlock(uint32_t *hash, const uint8_t *work_block)
     #undef ROTLEFT
 }
 
+static void sha256ProcessBlocksScalar(uint32_t *hash, const uint8_t *blocks,
+                                      size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        sha256ProcessBlock(hash, blocks + i * 64);
+    }
+}
+
+#ifdef BRICKRED_CODEC_SHA256_X86
+// state is kept as abef and cdgh for sha256rnds2, message words
+// w[i] = sig1(w[i-2]) + w[i-7] + sig0(w[i-15]) + w[i-16] are computed by
+// sha256msg1, alignr and sha256msg2 four words at a time
+__attribute__((target("sha,sse4.1")))
+static void sha256ProcessBlocksShaNi(uint32_t *hash, const uint8_t *blocks,
+                                     size_t count)
+{
+    const __m128i byte_mask = _mm_set_epi64x(
+        0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    __m128i tmp = _mm_shuffle_epi32(
+        _mm_loadu_si128((const __m128i *)&hash[0]), 0xb1);
+    __m128i state1 = _mm_shuffle_epi32(
+        _mm_loadu_si128((const __m128i *)&hash[4]), 0x1b);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xf0);
+    __m128i msg[4];
+
+    for (size_t n = 0; n < count; ++n) {
+        const uint8_t *block = blocks + n * 64;
+        __m128i abef_save = state0;
+        __m128i cdgh_save = state1;
+
+        for (int i = 0; i < 4; ++i) {
+            msg[i] = _mm_shuffle_epi8(_mm_loadu_si128(
+                (const __m128i *)(block + i * 16)), byte_mask);
+        }
+
+        // 4 rounds per group
+        #pragma GCC unroll 16
+        for (int i = 0; i < 16; ++i) {
+            __m128i wk = _mm_add_epi32(msg[i & 3], _mm_loadu_si128(
+                (const __m128i *)&s_sha256_k[i * 4]));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+            if (i >= 3 && i <= 14) {
+                __m128i &next = msg[(i + 1) & 3];
+                next = _mm_add_epi32(next, _mm_alignr_epi8(
+                    msg[i & 3], msg[(i - 1) & 3], 4));
+                next = _mm_sha256msg2_epu32(next, msg[i & 3]);
+            }
+            state0 = _mm_sha256rnds2_epu32(state0, state1,
+                                           _mm_shuffle_epi32(wk, 0x0e));
+            if (i >= 1 && i <= 12) {
+                msg[(i - 1) & 3] = _mm_sha256msg1_epu32(
+                    msg[(i - 1) & 3], msg[i & 3]);
+            }
+        }
+
+        state0 = _mm_add_epi32(state0, abef_save);
+        state1 = _mm_add_epi32(state1, cdgh_save);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1b);
+    state1 = _mm_shuffle_epi32(state1, 0xb1);
+    _mm_storeu_si128((__m128i *)&hash[0],
+                     _mm_blend_epi16(tmp, state1, 0xf0));
+    _mm_storeu_si128((__m128i *)&hash[4],
+                     _mm_alignr_epi8(state1, tmp, 8));
+}
+#endif
+
+static bool sha256IsSupported(Sha256::Impl impl)
+{
+    switch (impl) {
+    case Sha256::Impl::SCALAR:
+        return true;
+#ifdef BRICKRED_CODEC_SHA256_X86
+    case Sha256::Impl::SHA_NI:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sha") &&
+               __builtin_cpu_supports("sse4.1");
+#endif
+    default:
+        return false;
+    }
+}
+
+static Sha256ProcessFunc sha256GetProcessFunc(Sha256::Impl impl)
+{
+    switch (impl) {
+#ifdef BRICKRED_CODEC_SHA256_X86
+    case Sha256::Impl::SHA_NI:
+        return sha256ProcessBlocksShaNi;
+#endif
+    default:
+        return sha256ProcessBlocksScalar;
+    }
+}
+
+static Sha256::Impl sha256SelectImpl()
+{
+    if (sha256IsSupported(Sha256::Impl::SHA_NI)) {
+        return Sha256::Impl::SHA_NI;
+    }
+    return Sha256::Impl::SCALAR;
+}
+
+bool Sha256::setImpl(Impl impl)
+{
+    if (Impl::AUTO == impl) {
+        impl = getDefaultImpl();
+    }
+    if (sha256IsSupported(impl) == false) {
+        return false;
+    }
+
+    impl_ = impl;
+
+    return true;
+}
+
+Sha256::Impl Sha256::getDefaultImpl()
+{
+    static const Impl s_impl = sha256SelectImpl();
+
+    return s_impl;
+}
+
+const char *Sha256::getImplName(Impl impl)
+{
+    static const char *s_impl_names[] = {
+        "auto", "scalar", "sha_ni"
+    };
+    static_assert(sizeof(s_impl_names) / sizeof(s_impl_names[0]) ==
+                  (size_t)Impl::MAX);
+
+    if (impl < Impl::AUTO || impl >= Impl::MAX) {
+        return "unknown";
+    }
+    return s_impl_names[(int)impl];
+}
+
 void Sha256::update(const char *buffer, size_t size)
 {
+    Sha256ProcessFunc process_blocks = sha256GetProcessFunc(impl_);
     size_t wb_size = message_size_ & 63;
     message_size_ += size;
 
@@ -127,16 +280,16 @@ void Sha256::update(const char *buffer, size_t size)
             return;
         }
         // process work block
-        sha256ProcessBlock(hash_, work_block_);
+        process_blocks(hash_, work_block_, 1);
         buffer += left;
         size -= left;
     }
 
     // process left 64-byte block data without copy
-    while (size >= 64) {
-        sha256ProcessBlock(hash_, (uint8_t *)buffer);
-        buffer += 64;
-        size -= 64;
+    if (size >= 64) {
+        process_blocks(hash_, (const uint8_t *)buffer, size / 64);
+        buffer += size & ~(size_t)63;
+        size &= 63;
     }
 
     // save leftover to work block
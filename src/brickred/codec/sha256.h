@@ -11,6 +11,13 @@ namespace brickred::codec {
 
 class Sha256 final {
 public:
+    enum class Impl {
+        AUTO = 0,
+        SCALAR,
+        SHA_NI,
+        MAX
+    };
+
     Sha256();
     ~Sha256();
     void reset();
@@ -19,12 +26,20 @@ public:
     void digest(char hash[32]);
     std::string digest();
 
+    // AUTO is the implementation picked by the cpu at startup,
+    // return false if the cpu does not support impl
+    bool setImpl(Impl impl);
+    Impl getImpl() const { return impl_; }
+    static Impl getDefaultImpl();
+    static const char *getImplName(Impl impl);
+
 private:
     BRICKRED_NONCOPYABLE(Sha256)
 
     uint32_t hash_[8];
     uint8_t work_block_[64];
     uint64_t message_size_;
+    Impl impl_;
 };
 
 std::string sha256(const std::string &str);
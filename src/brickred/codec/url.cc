@@ -1,9 +1,21 @@
 #include <brickred/codec/url.h>
 
+#include <cstdint>
+#include <cstring>
 #include <vector>
 
+#include <brickred/dynamic_buffer.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BRICKRED_CODEC_URL_X86
+#include <immintrin.h>
+#endif
+
 namespace brickred::codec {
 
+using UrlCodecFunc = int (*)(const char *in, size_t in_size,
+                             char *out, size_t out_size);
+
 static const char s_hex_to_letter[] = "0123456789ABCDEF";
 
 static bool isUnreservedChar(char in)
@@ -80,8 +92,8 @@ static int letterToHex(char in)
     return -1;
 }
 
-int urlEncode(const char *in, size_t in_size,
-              char *out, size_t out_size)
+static int urlEncodeScalar(const char *in, size_t in_size,
+                           char *out, size_t out_size)
 {
     const char *out_start = out;
     const char *out_end = out + out_size;
@@ -107,28 +119,8 @@ int urlEncode(const char *in, size_t in_size,
     return out - out_start;
 }
 
-std::string urlEncode(const std::string &str)
-{
-    return urlEncode(str.c_str(), str.size());
-}
-
-std::string urlEncode(const char *buffer, size_t size)
-{
-    if (size == 0) {
-        return std::string();
-    }
-
-    std::vector<char> output(size * 3);
-    int count = urlEncode(buffer, size, output.data(), output.size());
-    if (count <= 0) {
-        return std::string();
-    } else {
-        return std::string(output.data(), count);
-    }
-}
-
-int urlDecode(const char *in, size_t in_size,
-              char *out, size_t out_size)
+static int urlDecodeScalar(const char *in, size_t in_size,
+                           char *out, size_t out_size)
 {
     const char *out_start = out;
     const char *out_end = out + out_size;
@@ -159,6 +151,330 @@ int urlDecode(const char *in, size_t in_size,
     return out - out_start;
 }
 
+#ifdef BRICKRED_CODEC_URL_X86
+// a char is reserved if the lookups by its low and high nibbles share
+// a bit, the classes of high nibble 2 ~ 7 are the bits other than 0x10
+static const uint8_t s_reserved_low[16] = {
+    0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+    0x11, 0x11, 0x13, 0x3b, 0x3b, 0x3a, 0x1a, 0x33
+};
+static const uint8_t s_reserved_high[16] = {
+    0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x20,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10
+};
+
+static inline void urlEscape(char c, char *out)
+{
+    out[0] = '%';
+    out[1] = s_hex_to_letter[(unsigned char)c >> 4];
+    out[2] = s_hex_to_letter[(unsigned char)c & 0x0f];
+}
+
+// the 16 or 32 byte block is stored whole and the escape overwrites
+// the part of it after the unreserved run
+__attribute__((target("ssse3")))
+static int urlEncodeSsse3(const char *in, size_t in_size,
+                          char *out, size_t out_size)
+{
+    const __m128i reserved_low =
+        _mm_loadu_si128((const __m128i *)s_reserved_low);
+    const __m128i reserved_high =
+        _mm_loadu_si128((const __m128i *)s_reserved_high);
+    const __m128i low_nibble = _mm_set1_epi8(0x0f);
+    const char *out_start = out;
+
+    while (in_size >= 16 && out_size >= 16 + 3) {
+        __m128i v = _mm_loadu_si128((const __m128i *)in);
+        __m128i reserved = _mm_and_si128(
+            _mm_shuffle_epi8(reserved_low, _mm_and_si128(v, low_nibble)),
+            _mm_shuffle_epi8(reserved_high,
+                _mm_and_si128(_mm_srli_epi16(v, 4), low_nibble)));
+        unsigned int mask = _mm_movemask_epi8(
+            _mm_cmpeq_epi8(reserved, _mm_setzero_si128())) ^ 0xffff;
+        _mm_storeu_si128((__m128i *)out, v);
+        if (0 == mask) {
+            in += 16;
+            in_size -= 16;
+            out += 16;
+            out_size -= 16;
+            continue;
+        }
+
+        size_t run = __builtin_ctz(mask);
+        urlEscape(in[run], out + run);
+        in += run + 1;
+        in_size -= run + 1;
+        out += run + 3;
+        out_size -= run + 3;
+    }
+
+    int ret = urlEncodeScalar(in, in_size, out, out_size);
+    if (ret < 0) {
+        return -1;
+    }
+
+    return out - out_start + ret;
+}
+
+__attribute__((target("avx2")))
+static int urlEncodeAvx2(const char *in, size_t in_size,
+                         char *out, size_t out_size)
+{
+    const __m256i reserved_low = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((const __m128i *)s_reserved_low));
+    const __m256i reserved_high = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((const __m128i *)s_reserved_high));
+    const __m256i low_nibble = _mm256_set1_epi8(0x0f);
+    const char *out_start = out;
+
+    while (in_size >= 32 && out_size >= 32 + 3) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)in);
+        __m256i reserved = _mm256_and_si256(
+            _mm256_shuffle_epi8(reserved_low,
+                _mm256_and_si256(v, low_nibble)),
+            _mm256_shuffle_epi8(reserved_high,
+                _mm256_and_si256(_mm256_srli_epi16(v, 4), low_nibble)));
+        unsigned int mask = ~(unsigned int)_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(reserved, _mm256_setzero_si256()));
+        _mm256_storeu_si256((__m256i *)out, v);
+        if (0 == mask) {
+            in += 32;
+            in_size -= 32;
+            out += 32;
+            out_size -= 32;
+            continue;
+        }
+
+        size_t run = __builtin_ctz(mask);
+        urlEscape(in[run], out + run);
+        in += run + 1;
+        in_size -= run + 1;
+        out += run + 3;
+        out_size -= run + 3;
+    }
+
+    int ret = urlEncodeSsse3(in, in_size, out, out_size);
+    if (ret < 0) {
+        return -1;
+    }
+
+    return out - out_start + ret;
+}
+
+// the block can be stored whole before the escape at in + run only if
+// that overwrites no input not read yet, which happens in place
+static inline bool urlCanStoreBlock(const char *in, size_t in_size,
+                                    size_t run, const char *out,
+                                    size_t block_size)
+{
+    return (uintptr_t)out + block_size <= (uintptr_t)in + run ||
+           (uintptr_t)out >= (uintptr_t)in + in_size;
+}
+
+// decode the escape at in, return false if it is invalid
+static inline bool urlUnescape(const char *in, char *out)
+{
+    int high = letterToHex(in[1]);
+    int low = letterToHex(in[2]);
+    if (high < 0 || low < 0) {
+        return false;
+    }
+    *out = (char)(high * 0x10 + low);
+    return true;
+}
+
+__attribute__((target("ssse3")))
+static int urlDecodeSsse3(const char *in, size_t in_size,
+                          char *out, size_t out_size)
+{
+    const __m128i percent = _mm_set1_epi8('%');
+    const char *out_start = out;
+
+    while (in_size >= 16 && out_size >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)in);
+        unsigned int mask =
+            _mm_movemask_epi8(_mm_cmpeq_epi8(v, percent));
+        if (0 == mask) {
+            _mm_storeu_si128((__m128i *)out, v);
+            in += 16;
+            in_size -= 16;
+            out += 16;
+            out_size -= 16;
+            continue;
+        }
+
+        size_t run = __builtin_ctz(mask);
+        if (in_size - run < 3) {
+            return -1;
+        }
+        if (urlCanStoreBlock(in, in_size, run, out, 16)) {
+            _mm_storeu_si128((__m128i *)out, v);
+        } else {
+            ::memmove(out, in, run);
+        }
+        if (urlUnescape(in + run, out + run) == false) {
+            return -1;
+        }
+        in += run + 3;
+        in_size -= run + 3;
+        out += run + 1;
+        out_size -= run + 1;
+    }
+
+    int ret = urlDecodeScalar(in, in_size, out, out_size);
+    if (ret < 0) {
+        return -1;
+    }
+
+    return out - out_start + ret;
+}
+
+__attribute__((target("avx2")))
+static int urlDecodeAvx2(const char *in, size_t in_size,
+                         char *out, size_t out_size)
+{
+    const __m256i percent = _mm256_set1_epi8('%');
+    const char *out_start = out;
+
+    while (in_size >= 32 && out_size >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)in);
+        unsigned int mask =
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, percent));
+        if (0 == mask) {
+            _mm256_storeu_si256((__m256i *)out, v);
+            in += 32;
+            in_size -= 32;
+            out += 32;
+            out_size -= 32;
+            continue;
+        }
+
+        size_t run = __builtin_ctz(mask);
+        if (in_size - run < 3) {
+            return -1;
+        }
+        if (urlCanStoreBlock(in, in_size, run, out, 32)) {
+            _mm256_storeu_si256((__m256i *)out, v);
+        } else {
+            ::memmove(out, in, run);
+        }
+        if (urlUnescape(in + run, out + run) == false) {
+            return -1;
+        }
+        in += run + 3;
+        in_size -= run + 3;
+        out += run + 1;
+        out_size -= run + 1;
+    }
+
+    int ret = urlDecodeSsse3(in, in_size, out, out_size);
+    if (ret < 0) {
+        return -1;
+    }
+
+    return out - out_start + ret;
+}
+#endif
+
+static bool urlIsSupported(UrlImpl impl)
+{
+    switch (impl) {
+    case UrlImpl::SCALAR:
+        return true;
+#ifdef BRICKRED_CODEC_URL_X86
+    case UrlImpl::SSSE3:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("ssse3");
+    case UrlImpl::AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+static UrlCodecFunc urlGetEncodeFunc(UrlImpl impl)
+{
+    switch (impl) {
+    case UrlImpl::SCALAR:
+        return urlEncodeScalar;
+#ifdef BRICKRED_CODEC_URL_X86
+    case UrlImpl::SSSE3:
+        return urlEncodeSsse3;
+    case UrlImpl::AVX2:
+        return urlEncodeAvx2;
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+static UrlCodecFunc urlGetDecodeFunc(UrlImpl impl)
+{
+    switch (impl) {
+    case UrlImpl::SCALAR:
+        return urlDecodeScalar;
+#ifdef BRICKRED_CODEC_URL_X86
+    case UrlImpl::SSSE3:
+        return urlDecodeSsse3;
+    case UrlImpl::AVX2:
+        return urlDecodeAvx2;
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+static UrlImpl urlSelectImpl()
+{
+    if (urlIsSupported(UrlImpl::AVX2)) {
+        return UrlImpl::AVX2;
+    }
+    if (urlIsSupported(UrlImpl::SSSE3)) {
+        return UrlImpl::SSSE3;
+    }
+    return UrlImpl::SCALAR;
+}
+
+int urlEncode(const char *in, size_t in_size,
+              char *out, size_t out_size)
+{
+    static const UrlCodecFunc s_encode_func =
+        urlGetEncodeFunc(urlGetImpl());
+
+    return s_encode_func(in, in_size, out, out_size);
+}
+
+std::string urlEncode(const std::string &str)
+{
+    return urlEncode(str.c_str(), str.size());
+}
+
+std::string urlEncode(const char *buffer, size_t size)
+{
+    if (size == 0) {
+        return std::string();
+    }
+
+    std::vector<char> output(size * 3);
+    int count = urlEncode(buffer, size, output.data(), output.size());
+    if (count <= 0) {
+        return std::string();
+    } else {
+        return std::string(output.data(), count);
+    }
+}
+
+int urlDecode(const char *in, size_t in_size,
+              char *out, size_t out_size)
+{
+    static const UrlCodecFunc s_decode_func =
+        urlGetDecodeFunc(urlGetImpl());
+
+    return s_decode_func(in, in_size, out, out_size);
+}
+
 std::string urlDecode(const std::string &str)
 {
     return urlDecode(str.c_str(), str.size());
@@ -179,4 +495,69 @@ std::string urlDecode(const char *buffer, size_t size)
     }
 }
 
+bool urlDecode(DynamicBuffer *buffer)
+{
+    char *p = const_cast<char *>(buffer->readBegin());
+    size_t size = buffer->readableBytes();
+
+    int count = urlDecode(p, size, p, size);
+    if (count < 0) {
+        return false;
+    }
+    buffer->unwrite(size - count);
+
+    return true;
+}
+
+UrlImpl urlGetImpl()
+{
+    static const UrlImpl s_impl = urlSelectImpl();
+
+    return s_impl;
+}
+
+const char *urlGetImplName(UrlImpl impl)
+{
+    static const char *s_impl_names[] = {
+        "auto", "scalar", "ssse3", "avx2"
+    };
+    static_assert(sizeof(s_impl_names) / sizeof(s_impl_names[0]) ==
+                  (size_t)UrlImpl::MAX);
+
+    if (impl < UrlImpl::AUTO || impl >= UrlImpl::MAX) {
+        return "unknown";
+    }
+    return s_impl_names[(int)impl];
+}
+
+bool urlEncodeWith(UrlImpl impl, const char *in, size_t in_size,
+                   char *out, size_t out_size, int *result)
+{
+    if (UrlImpl::AUTO == impl) {
+        impl = urlGetImpl();
+    }
+    if (urlIsSupported(impl) == false) {
+        return false;
+    }
+
+    *result = urlGetEncodeFunc(impl)(in, in_size, out, out_size);
+
+    return true;
+}
+
+bool urlDecodeWith(UrlImpl impl, const char *in, size_t in_size,
+                   char *out, size_t out_size, int *result)
+{
+    if (UrlImpl::AUTO == impl) {
+        impl = urlGetImpl();
+    }
+    if (urlIsSupported(impl) == false) {
+        return false;
+    }
+
+    *result = urlGetDecodeFunc(impl)(in, in_size, out, out_size);
+
+    return true;
+}
+
 } // namespace brickred::codec
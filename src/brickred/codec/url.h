@@ -4,19 +4,43 @@
 #include <cstddef>
 #include <string>
 
+namespace brickred { class DynamicBuffer; }
+
 namespace brickred::codec {
 
+enum class UrlImpl {
+    AUTO = 0,
+    SCALAR,
+    SSSE3,
+    AVX2,
+    MAX
+};
+
 // RFC 3986 (like php rawurlencode())
 int urlEncode(const char *in, size_t in_size,
               char *out, size_t out_size);
 std::string urlEncode(const std::string &str);
 std::string urlEncode(const char *buffer, size_t size);
 
-// RFC 3986 (like php rawurldecode())
+// RFC 3986 (like php rawurldecode()), out can be in to decode in place
 int urlDecode(const char *in, size_t in_size,
               char *out, size_t out_size);
 std::string urlDecode(const std::string &str);
 std::string urlDecode(const char *buffer, size_t size);
+// decode the readable bytes of buffer in place, return false if they are
+// invalid, the readable bytes are left partly decoded then
+bool urlDecode(DynamicBuffer *buffer);
+
+// the implementation used by the functions above, picked by the cpu
+// at startup, runs of unreserved chars are copied a vector at a time
+UrlImpl urlGetImpl();
+const char *urlGetImplName(UrlImpl impl);
+// return false if the cpu does not support impl, result is the return
+// value of urlEncode() or urlDecode()
+bool urlEncodeWith(UrlImpl impl, const char *in, size_t in_size,
+                   char *out, size_t out_size, int *result);
+bool urlDecodeWith(UrlImpl impl, const char *in, size_t in_size,
+                   char *out, size_t out_size, int *result);
 
 } // namespace brickred::codec
 
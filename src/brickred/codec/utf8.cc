@@ -0,0 +1,513 @@
+#include <brickred/codec/utf8.h>
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BRICKRED_CODEC_UTF8_X86
+#include <immintrin.h>
+#endif
+
+namespace brickred::codec::utf8 {
+
+namespace {
+
+using ValidateFunc = bool (*)(const uint8_t *p, size_t size);
+
+// length of the sequence led by c, 0 if c can not lead one
+size_t sequenceLength(uint8_t c)
+{
+    if (c < 0x80) {
+        return 1;
+    } else if (c < 0xc2) {
+        return 0;
+    } else if (c < 0xe0) {
+        return 2;
+    } else if (c < 0xf0) {
+        return 3;
+    } else if (c < 0xf5) {
+        return 4;
+    } else {
+        return 0;
+    }
+}
+
+bool validateScalar(const uint8_t *p, size_t size)
+{
+    size_t i = 0;
+
+    while (i < size) {
+        // 8 ascii bytes at a time
+        if (size - i >= 8) {
+            uint64_t v;
+            ::memcpy(&v, p + i, 8);
+            if ((v & 0x8080808080808080ULL) == 0) {
+                i += 8;
+                continue;
+            }
+        }
+
+        uint8_t c = p[i];
+        if (c < 0x80) {
+            ++i;
+            continue;
+        }
+
+        size_t n = sequenceLength(c);
+        if (0 == n || size - i < n) {
+            return false;
+        }
+        // range of the second byte depends on the lead byte
+        uint8_t min = 0x80;
+        uint8_t max = 0xbf;
+        if (0xe0 == c) {
+            min = 0xa0;
+        } else if (0xed == c) {
+            max = 0x9f;
+        } else if (0xf0 == c) {
+            min = 0x90;
+        } else if (0xf4 == c) {
+            max = 0x8f;
+        }
+        if (p[i + 1] < min || p[i + 1] > max) {
+            return false;
+        }
+        for (size_t j = 2; j < n; ++j) {
+            if ((p[i + j] & 0xc0) != 0x80) {
+                return false;
+            }
+        }
+        i += n;
+    }
+
+    return true;
+}
+
+#ifdef BRICKRED_CODEC_UTF8_X86
+// the lookup algorithm of simdjson (Keiser and Lemire, 2021),
+// each pair of adjacent bytes is classified by three 16 entry tables
+// indexed by the high and low nibbles of the first byte and the high
+// nibble of the second byte, an error bit survives the and of the three
+// lookups only if the pair is invalid
+enum ErrorBit {
+    TOO_SHORT = 1 << 0,      // 11______ 0_______, 11______ 11______
+    TOO_LONG = 1 << 1,       // 0_______ 10______
+    OVERLONG_3 = 1 << 2,     // 11100000 100_____
+    TOO_LARGE = 1 << 3,      // 11110100 1001____ and larger
+    SURROGATE = 1 << 4,      // 11101101 101_____
+    OVERLONG_2 = 1 << 5,     // 1100000_ 10______
+    TOO_LARGE_1000 = 1 << 6, // 11110101 1000____ and larger
+    OVERLONG_4 = 1 << 6,     // 11110000 1000____
+    TWO_CONTS = 1 << 7,      // 10______ 10______
+    CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS
+};
+
+const uint8_t s_byte_1_high[16] = {
+    // 0_______ ________
+    TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+    TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+    // 10______ ________
+    TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+    // 1100____ ________
+    TOO_SHORT | OVERLONG_2,
+    // 1101____ ________
+    TOO_SHORT,
+    // 1110____ ________
+    TOO_SHORT | OVERLONG_3 | SURROGATE,
+    // 1111____ ________
+    TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4
+};
+
+const uint8_t s_byte_1_low[16] = {
+    // ____0000 ________
+    CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+    // ____0001 ________
+    CARRY | OVERLONG_2,
+    // ____001_ ________
+    CARRY,
+    CARRY,
+    // ____0100 ________
+    CARRY | TOO_LARGE,
+    // ____0101 ________
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    // ____011_ ________
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    // ____1___ ________
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    // ____1101 ________
+    CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+    CARRY | TOO_LARGE | TOO_LARGE_1000,
+    CARRY | TOO_LARGE | TOO_LARGE_1000
+};
+
+const uint8_t s_byte_2_high[16] = {
+    // ________ 0_______
+    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+    // ________ 1000____
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 |
+        OVERLONG_4,
+    // ________ 1001____
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+    // ________ 101_____
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+    // ________ 11______
+    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT
+};
+
+// a block ends in an incomplete sequence if any of its last 3 bytes is
+// greater than the value, only the tail of the array is used by sse
+const uint8_t s_incomplete_max[32] = {
+    255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 0xf0 - 1, 0xe0 - 1, 0xc0 - 1
+};
+
+struct Ssse3Tables {
+    __m128i byte_1_high;
+    __m128i byte_1_low;
+    __m128i byte_2_high;
+};
+
+__attribute__((target("ssse3")))
+inline __m128i checkBlockSsse3(const Ssse3Tables &t,
+                               __m128i input, __m128i prev_input)
+{
+    const __m128i low_nibble = _mm_set1_epi8(0x0f);
+
+    __m128i prev1 = _mm_alignr_epi8(input, prev_input, 15);
+    __m128i byte_1_high = _mm_shuffle_epi8(t.byte_1_high,
+        _mm_and_si128(_mm_srli_epi16(prev1, 4), low_nibble));
+    __m128i byte_1_low = _mm_shuffle_epi8(t.byte_1_low,
+        _mm_and_si128(prev1, low_nibble));
+    __m128i byte_2_high = _mm_shuffle_epi8(t.byte_2_high,
+        _mm_and_si128(_mm_srli_epi16(input, 4), low_nibble));
+    __m128i special_cases = _mm_and_si128(
+        _mm_and_si128(byte_1_high, byte_1_low), byte_2_high);
+
+    // the 3rd and 4th bytes of a sequence must be continuations, which
+    // are the only TWO_CONTS pairs allowed
+    __m128i prev2 = _mm_alignr_epi8(input, prev_input, 14);
+    __m128i prev3 = _mm_alignr_epi8(input, prev_input, 13);
+    __m128i is_third_byte = _mm_subs_epu8(prev2, _mm_set1_epi8(0xe0 - 0x80));
+    __m128i is_fourth_byte =
+        _mm_subs_epu8(prev3, _mm_set1_epi8((char)(0xf0 - 0x80)));
+    __m128i must_be_continuation = _mm_and_si128(
+        _mm_or_si128(is_third_byte, is_fourth_byte),
+        _mm_set1_epi8((char)0x80));
+
+    return _mm_xor_si128(must_be_continuation, special_cases);
+}
+
+__attribute__((target("ssse3")))
+bool validateSsse3(const uint8_t *p, size_t size)
+{
+    Ssse3Tables t;
+    t.byte_1_high = _mm_loadu_si128((const __m128i *)s_byte_1_high);
+    t.byte_1_low = _mm_loadu_si128((const __m128i *)s_byte_1_low);
+    t.byte_2_high = _mm_loadu_si128((const __m128i *)s_byte_2_high);
+    const __m128i incomplete_max =
+        _mm_loadu_si128((const __m128i *)(s_incomplete_max + 16));
+
+    __m128i error = _mm_setzero_si128();
+    __m128i prev_input = _mm_setzero_si128();
+    __m128i prev_incomplete = _mm_setzero_si128();
+    size_t i = 0;
+
+    for (; size - i >= 64; i += 64) {
+        __m128i v0 = _mm_loadu_si128((const __m128i *)(p + i));
+        __m128i v1 = _mm_loadu_si128((const __m128i *)(p + i + 16));
+        __m128i v2 = _mm_loadu_si128((const __m128i *)(p + i + 32));
+        __m128i v3 = _mm_loadu_si128((const __m128i *)(p + i + 48));
+        __m128i any = _mm_or_si128(_mm_or_si128(v0, v1),
+                                   _mm_or_si128(v2, v3));
+        // ascii block only has to close the sequence before it
+        if (_mm_movemask_epi8(any) == 0) {
+            error = _mm_or_si128(error, prev_incomplete);
+            prev_input = _mm_setzero_si128();
+            prev_incomplete = _mm_setzero_si128();
+            continue;
+        }
+        error = _mm_or_si128(error, checkBlockSsse3(t, v0, prev_input));
+        error = _mm_or_si128(error, checkBlockSsse3(t, v1, v0));
+        error = _mm_or_si128(error, checkBlockSsse3(t, v2, v1));
+        error = _mm_or_si128(error, checkBlockSsse3(t, v3, v2));
+        prev_incomplete = _mm_subs_epu8(v3, incomplete_max);
+        prev_input = v3;
+    }
+    for (; size - i >= 16; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+        error = _mm_or_si128(error, checkBlockSsse3(t, v, prev_input));
+        prev_incomplete = _mm_subs_epu8(v, incomplete_max);
+        prev_input = v;
+    }
+    if (i < size) {
+        // ascii padding fails a sequence left open by the tail
+        uint8_t tail[16] = { 0 };
+        ::memcpy(tail, p + i, size - i);
+        __m128i v = _mm_loadu_si128((const __m128i *)tail);
+        error = _mm_or_si128(error, checkBlockSsse3(t, v, prev_input));
+    } else {
+        error = _mm_or_si128(error, prev_incomplete);
+    }
+
+    return _mm_movemask_epi8(
+        _mm_cmpeq_epi8(error, _mm_setzero_si128())) == 0xffff;
+}
+
+struct Avx2Tables {
+    __m256i byte_1_high;
+    __m256i byte_1_low;
+    __m256i byte_2_high;
+};
+
+// bytes of input shifted right by n bytes across the lanes, the
+// missing bytes come from the end of prev_input
+#define BRICKRED_CODEC_UTF8_AVX2_PREV(input, prev_input, n) \
+    _mm256_alignr_epi8(input, \
+        _mm256_permute2x128_si256(prev_input, input, 0x21), 16 - (n))
+
+__attribute__((target("avx2")))
+inline __m256i checkBlockAvx2(const Avx2Tables &t,
+                              __m256i input, __m256i prev_input)
+{
+    const __m256i low_nibble = _mm256_set1_epi8(0x0f);
+
+    __m256i prev1 = BRICKRED_CODEC_UTF8_AVX2_PREV(input, prev_input, 1);
+    __m256i byte_1_high = _mm256_shuffle_epi8(t.byte_1_high,
+        _mm256_and_si256(_mm256_srli_epi16(prev1, 4), low_nibble));
+    __m256i byte_1_low = _mm256_shuffle_epi8(t.byte_1_low,
+        _mm256_and_si256(prev1, low_nibble));
+    __m256i byte_2_high = _mm256_shuffle_epi8(t.byte_2_high,
+        _mm256_and_si256(_mm256_srli_epi16(input, 4), low_nibble));
+    __m256i special_cases = _mm256_and_si256(
+        _mm256_and_si256(byte_1_high, byte_1_low), byte_2_high);
+
+    __m256i prev2 = BRICKRED_CODEC_UTF8_AVX2_PREV(input, prev_input, 2);
+    __m256i prev3 = BRICKRED_CODEC_UTF8_AVX2_PREV(input, prev_input, 3);
+    __m256i is_third_byte =
+        _mm256_subs_epu8(prev2, _mm256_set1_epi8(0xe0 - 0x80));
+    __m256i is_fourth_byte =
+        _mm256_subs_epu8(prev3, _mm256_set1_epi8((char)(0xf0 - 0x80)));
+    __m256i must_be_continuation = _mm256_and_si256(
+        _mm256_or_si256(is_third_byte, is_fourth_byte),
+        _mm256_set1_epi8((char)0x80));
+
+    return _mm256_xor_si256(must_be_continuation, special_cases);
+}
+
+#undef BRICKRED_CODEC_UTF8_AVX2_PREV
+
+__attribute__((target("avx2")))
+bool validateAvx2(const uint8_t *p, size_t size)
+{
+    Avx2Tables t;
+    t.byte_1_high = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((const __m128i *)s_byte_1_high));
+    t.byte_1_low = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((const __m128i *)s_byte_1_low));
+    t.byte_2_high = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((const __m128i *)s_byte_2_high));
+    const __m256i incomplete_max =
+        _mm256_loadu_si256((const __m256i *)s_incomplete_max);
+
+    __m256i error = _mm256_setzero_si256();
+    __m256i prev_input = _mm256_setzero_si256();
+    __m256i prev_incomplete = _mm256_setzero_si256();
+    size_t i = 0;
+
+    for (; size - i >= 64; i += 64) {
+        __m256i v0 = _mm256_loadu_si256((const __m256i *)(p + i));
+        __m256i v1 = _mm256_loadu_si256((const __m256i *)(p + i + 32));
+        // ascii block only has to close the sequence before it
+        if (_mm256_movemask_epi8(_mm256_or_si256(v0, v1)) == 0) {
+            error = _mm256_or_si256(error, prev_incomplete);
+            prev_input = _mm256_setzero_si256();
+            prev_incomplete = _mm256_setzero_si256();
+            continue;
+        }
+        error = _mm256_or_si256(error, checkBlockAvx2(t, v0, prev_input));
+        error = _mm256_or_si256(error, checkBlockAvx2(t, v1, v0));
+        prev_incomplete = _mm256_subs_epu8(v1, incomplete_max);
+        prev_input = v1;
+    }
+    if (i < size) {
+        // ascii padding fails a sequence left open by the tail
+        uint8_t tail[64] = { 0 };
+        ::memcpy(tail, p + i, size - i);
+        __m256i v0 = _mm256_loadu_si256((const __m256i *)tail);
+        __m256i v1 = _mm256_loadu_si256((const __m256i *)(tail + 32));
+        error = _mm256_or_si256(error, checkBlockAvx2(t, v0, prev_input));
+        error = _mm256_or_si256(error, checkBlockAvx2(t, v1, v0));
+    } else {
+        error = _mm256_or_si256(error, prev_incomplete);
+    }
+
+    return _mm256_testz_si256(error, error);
+}
+#endif
+
+bool isSupported(Impl impl)
+{
+    switch (impl) {
+    case Impl::SCALAR:
+        return true;
+#ifdef BRICKRED_CODEC_UTF8_X86
+    case Impl::SSSE3:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("ssse3");
+    case Impl::AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+ValidateFunc getValidateFunc(Impl impl)
+{
+    switch (impl) {
+    case Impl::SCALAR:
+        return validateScalar;
+#ifdef BRICKRED_CODEC_UTF8_X86
+    case Impl::SSSE3:
+        return validateSsse3;
+    case Impl::AVX2:
+        return validateAvx2;
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+Impl selectImpl()
+{
+    if (isSupported(Impl::AVX2)) {
+        return Impl::AVX2;
+    }
+    if (isSupported(Impl::SSSE3)) {
+        return Impl::SSSE3;
+    }
+    return Impl::SCALAR;
+}
+
+} // namespace
+
+bool validate(const char *buffer, size_t size)
+{
+    static const ValidateFunc s_validate_func = getValidateFunc(getImpl());
+
+    return s_validate_func((const uint8_t *)buffer, size);
+}
+
+Impl getImpl()
+{
+    static const Impl s_impl = selectImpl();
+
+    return s_impl;
+}
+
+const char *getImplName(Impl impl)
+{
+    static const char *s_impl_names[] = {
+        "auto", "scalar", "ssse3", "avx2"
+    };
+    static_assert(sizeof(s_impl_names) / sizeof(s_impl_names[0]) ==
+                  (size_t)Impl::MAX);
+
+    if (impl < Impl::AUTO || impl >= Impl::MAX) {
+        return "unknown";
+    }
+    return s_impl_names[(int)impl];
+}
+
+bool validateWith(Impl impl, const char *buffer, size_t size, bool *valid)
+{
+    if (Impl::AUTO == impl) {
+        impl = getImpl();
+    }
+    if (isSupported(impl) == false) {
+        return false;
+    }
+
+    *valid = getValidateFunc(impl)((const uint8_t *)buffer, size);
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+Validator::Validator() :
+    pending_size_(0), valid_(true)
+{
+    ::memset(pending_, 0, sizeof(pending_));
+}
+
+bool Validator::update(const char *buffer, size_t size)
+{
+    if (!valid_) {
+        return false;
+    }
+
+    const uint8_t *p = (const uint8_t *)buffer;
+
+    // complete the sequence left by the last piece
+    if (pending_size_ > 0) {
+        size_t length = sequenceLength(pending_[0]);
+        size_t copy_size = std::min(length - pending_size_, size);
+        ::memcpy(pending_ + pending_size_, p, copy_size);
+        pending_size_ += copy_size;
+        p += copy_size;
+        size -= copy_size;
+        if (pending_size_ < length) {
+            return true;
+        }
+        valid_ = validateScalar(pending_, pending_size_);
+        pending_size_ = 0;
+        if (!valid_) {
+            return false;
+        }
+    }
+
+    // keep the incomplete sequence at the end for the next piece,
+    // invalid bytes are left to validate()
+    size_t cut = size;
+    for (size_t i = 1; i <= 3 && i <= size; ++i) {
+        uint8_t c = p[size - i];
+        if ((c & 0xc0) != 0x80) {
+            if (sequenceLength(c) > i) {
+                cut = size - i;
+            }
+            break;
+        }
+    }
+
+    valid_ = validate((const char *)p, cut);
+    ::memcpy(pending_, p + cut, size - cut);
+    pending_size_ = size - cut;
+
+    return valid_;
+}
+
+bool Validator::finish()
+{
+    bool valid = valid_ && 0 == pending_size_;
+    reset();
+
+    return valid;
+}
+
+void Validator::reset()
+{
+    pending_size_ = 0;
+    valid_ = true;
+}
+
+} // namespace brickred::codec::utf8
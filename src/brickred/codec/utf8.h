@@ -0,0 +1,47 @@
+#ifndef BRICKRED_CODEC_UTF8_H
+#define BRICKRED_CODEC_UTF8_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace brickred::codec::utf8 {
+
+enum class Impl {
+    AUTO = 0,
+    SCALAR,
+    SSSE3,
+    AVX2,
+    MAX
+};
+
+// rfc 3629, overlong forms, surrogates and code points above U+10FFFF
+// are invalid
+bool validate(const char *buffer, size_t size);
+
+// the implementation used by validate(), picked by the cpu at startup
+Impl getImpl();
+const char *getImplName(Impl impl);
+// return false if the cpu does not support impl
+bool validateWith(Impl impl, const char *buffer, size_t size, bool *valid);
+
+// validates a text split into pieces at any byte
+class Validator final {
+public:
+    Validator();
+
+    // return false if the text is already invalid
+    bool update(const char *buffer, size_t size);
+    // return false if the text is invalid or ends in a sequence
+    bool finish();
+    void reset();
+
+private:
+    // incomplete sequence at the end of the last piece
+    uint8_t pending_[4];
+    size_t pending_size_;
+    bool valid_;
+};
+
+} // namespace brickred::codec::utf8
+
+#endif
@@ -73,6 +73,15 @@ void DynamicBuffer::write(size_t size)
     write_index_ += std::min(size, writableBytes());
 }
 
+void DynamicBuffer::unwrite(size_t size)
+{
+    write_index_ -= std::min(size, readableBytes());
+
+    if (read_index_ == write_index_) {
+        clear();
+    }
+}
+
 void DynamicBuffer::reserveWritableBytes(size_t size)
 {
     if (writableBytes() >= size) {
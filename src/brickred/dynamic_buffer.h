@@ -23,6 +23,8 @@ public:
     char *writeBegin();
     void read(size_t size);
     void write(size_t size);
+    // drop the last size readable bytes
+    void unwrite(size_t size);
     void reserveWritableBytes(size_t size);
     void clear();
 
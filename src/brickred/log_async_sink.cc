@@ -1,92 +1,490 @@
 #include <brickred/log_async_sink.h>
 
+#include <sys/uio.h>
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdint>
 #include <cstring>
+#include <vector>
 
-#include <brickred/concurrent_queue.h>
-#include <brickred/dynamic_buffer.h>
-#include <brickred/object_pool.h>
+#include <brickred/condition_variable.h>
+#include <brickred/log_record.h>
 #include <brickred/mutex.h>
 #include <brickred/thread.h>
 
 namespace brickred {
 
+namespace {
+
+// single producer single consumer ring of records,
+// shared by the logging thread and the log thread
+// record layout: [uint32 size][data][padding to 4 bytes]
+// the high bit of size marks a binary record of deferred format log
+class LogThreadBuffer {
+public:
+    explicit LogThreadBuffer(size_t capacity);
+    ~LogThreadBuffer();
+
+    // producer side
+    bool write(const char *buffer, size_t size, bool binary = false);
+    void closeProducer() { producer_closed_.store(true); }
+    bool isConsumerClosed() const
+    {
+        return consumer_closed_.load(std::memory_order_relaxed);
+    }
+
+    // consumer side
+    size_t peek(struct iovec *records, bool *binary, size_t max_count,
+                uint64_t *read_index);
+    void commitRead(uint64_t read_index)
+    {
+        read_index_.store(read_index, std::memory_order_release);
+    }
+    bool empty() const
+    {
+        return read_index_.load(std::memory_order_relaxed) ==
+               write_index_.load();
+    }
+    void closeConsumer() { consumer_closed_.store(true); }
+    bool isProducerClosed() const { return producer_closed_.load(); }
+
+    // both owners hold a reference
+    void retain() { ref_count_.fetch_add(1, std::memory_order_relaxed); }
+    void release()
+    {
+        if (ref_count_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+    size_t maxRecordSize() const { return capacity_ / 2 - 8; }
+
+private:
+    BRICKRED_NONCOPYABLE(LogThreadBuffer)
+
+    static const uint32_t WRAP_MARKER = 0xffffffff;
+    static const uint32_t BINARY_FLAG = 0x80000000;
+
+    char *buffer_;
+    size_t capacity_;
+    std::atomic<int> ref_count_;
+    std::atomic<bool> producer_closed_;
+    std::atomic<bool> consumer_closed_;
+    // keep the indexes on different cache lines
+    alignas(64) std::atomic<uint64_t> write_index_;
+    uint64_t cached_read_index_;
+    alignas(64) std::atomic<uint64_t> read_index_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+LogThreadBuffer::LogThreadBuffer(size_t capacity) :
+    buffer_(new char[capacity]), capacity_(capacity),
+    ref_count_(1), producer_closed_(false), consumer_closed_(false),
+    write_index_(0), cached_read_index_(0), read_index_(0)
+{
+}
+
+LogThreadBuffer::~LogThreadBuffer()
+{
+    delete[] buffer_;
+}
+
+bool LogThreadBuffer::write(const char *buffer, size_t size, bool binary)
+{
+    uint64_t write_index = write_index_.load(std::memory_order_relaxed);
+    size_t pos = write_index & (capacity_ - 1);
+    size_t record_size = (4 + size + 3) & ~(size_t)3;
+
+    // record can not be split, skip the tail space
+    size_t skip_size = 0;
+    if (capacity_ - pos < record_size) {
+        skip_size = capacity_ - pos;
+    }
+
+    if (write_index + skip_size + record_size >
+            cached_read_index_ + capacity_) {
+        cached_read_index_ = read_index_.load(std::memory_order_acquire);
+        if (write_index + skip_size + record_size >
+                cached_read_index_ + capacity_) {
+            return false;
+        }
+    }
+
+    if (skip_size > 0) {
+        uint32_t marker = WRAP_MARKER;
+        ::memcpy(buffer_ + pos, &marker, 4);
+        pos = 0;
+    }
+    uint32_t record_data_size = size;
+    if (binary) {
+        record_data_size |= BINARY_FLAG;
+    }
+    ::memcpy(buffer_ + pos, &record_data_size, 4);
+    ::memcpy(buffer_ + pos + 4, buffer, size);
+
+    // pairs with the load in LogAsyncSink::Impl::wait()
+    write_index_.store(write_index + skip_size + record_size);
+
+    return true;
+}
+
+size_t LogThreadBuffer::peek(struct iovec *records, bool *binary,
+                             size_t max_count, uint64_t *read_index)
+{
+    uint64_t write_index = write_index_.load(std::memory_order_acquire);
+    uint64_t index = read_index_.load(std::memory_order_relaxed);
+    size_t count = 0;
+
+    while (index < write_index && count < max_count) {
+        size_t pos = index & (capacity_ - 1);
+        uint32_t size = 0;
+        ::memcpy(&size, buffer_ + pos, 4);
+        if (WRAP_MARKER == size) {
+            index += capacity_ - pos;
+            continue;
+        }
+        binary[count] = (size & BINARY_FLAG) != 0;
+        size &= ~BINARY_FLAG;
+        records[count].iov_base = buffer_ + pos + 4;
+        records[count].iov_len = size;
+        ++count;
+        index += (4 + size + 3) & ~(size_t)3;
+    }
+    *read_index = index;
+
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// set at thread exit, logging from later destructors of the thread
+// falls back to a one-shot buffer
+thread_local bool s_thread_buffer_cache_destroyed = false;
+
+// thread buffers of the current thread, keyed by sink id so a new sink
+// allocated at the address of a destroyed one is not confused with it
+class LogThreadBufferCache {
+public:
+    LogThreadBufferCache() {}
+    ~LogThreadBufferCache();
+
+    LogThreadBuffer *find(uint64_t sink_id);
+    void add(uint64_t sink_id, LogThreadBuffer *buffer);
+
+private:
+    BRICKRED_NONCOPYABLE(LogThreadBufferCache)
+
+    struct Entry {
+        uint64_t sink_id;
+        LogThreadBuffer *buffer;
+    };
+    std::vector<Entry> entries_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+LogThreadBufferCache::~LogThreadBufferCache()
+{
+    s_thread_buffer_cache_destroyed = true;
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        entries_[i].buffer->closeProducer();
+        entries_[i].buffer->release();
+    }
+}
+
+LogThreadBuffer *LogThreadBufferCache::find(uint64_t sink_id)
+{
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        if (entries_[i].sink_id == sink_id) {
+            return entries_[i].buffer;
+        }
+    }
+
+    // drop buffers of destroyed sinks
+    for (size_t i = 0; i < entries_.size(); ) {
+        if (entries_[i].buffer->isConsumerClosed()) {
+            entries_[i].buffer->release();
+            entries_[i] = entries_.back();
+            entries_.pop_back();
+        } else {
+            ++i;
+        }
+    }
+
+    return nullptr;
+}
+
+void LogThreadBufferCache::add(uint64_t sink_id, LogThreadBuffer *buffer)
+{
+    Entry entry;
+    entry.sink_id = sink_id;
+    entry.buffer = buffer;
+    entries_.push_back(entry);
+}
+
+thread_local LogThreadBufferCache s_thread_buffer_cache;
+std::atomic<uint64_t> s_next_sink_id(1);
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
 class LogAsyncSink::Impl {
 public:
-    explicit Impl(LogSink *adapted_sink, size_t queue_size);
+    using LogThreadBufferVector = std::vector<LogThreadBuffer *>;
+
+    explicit Impl(LogSink *adapted_sink, size_t thread_buffer_size);
     ~Impl();
 
-    void log(const char *buffer, size_t size);
+    void log(const char *buffer, size_t size, bool binary);
 
     void logThreadFunc();
 
+private:
+    LogThreadBuffer *getThreadBuffer();
+    void formatBinaryRecords(struct iovec *records, const bool *binary,
+                             size_t count);
+    void addThreadBuffer(LogThreadBuffer *buffer);
+    void notify();
+    bool flush();
+    void wait();
+
 private:
     LogSink *adapted_sink_;
+    uint64_t sink_id_;
+    size_t thread_buffer_size_;
 
     Thread log_thread_;
-    ConcurrentQueue<DynamicBuffer *> queue_;
+    std::atomic<bool> stop_;
 
-    Mutex pool_mutex_;
-    ObjectPool<DynamicBuffer> pool_;
+    // protects thread_buffers_ and the sleeping log thread
+    Mutex mutex_;
+    ConditionVariable cond_;
+    std::atomic<bool> sleeping_;
+    LogThreadBufferVector thread_buffers_;
+    // owned by log thread
+    LogThreadBufferVector flush_buffers_;
+    std::vector<char> format_buffer_;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
-LogAsyncSink::Impl::Impl(LogSink *adapted_sink, size_t queue_size) :
-    adapted_sink_(adapted_sink), queue_(queue_size)
+LogAsyncSink::Impl::Impl(LogSink *adapted_sink,
+                         size_t thread_buffer_size) :
+    adapted_sink_(adapted_sink),
+    sink_id_(s_next_sink_id.fetch_add(1)),
+    thread_buffer_size_(64 * 1024),
+    stop_(false), sleeping_(false)
 {
+    while (thread_buffer_size_ < thread_buffer_size) {
+        thread_buffer_size_ *= 2;
+    }
+
     log_thread_.start(BRICKRED_BIND_MEM_FUNC(
         &LogAsyncSink::Impl::logThreadFunc, this));
 }
 
 LogAsyncSink::Impl::~Impl()
 {
-    queue_.push(nullptr);
+    stop_.store(true);
+    notify();
     log_thread_.join();
 
+    for (size_t i = 0; i < thread_buffers_.size(); ++i) {
+        thread_buffers_[i]->closeConsumer();
+        thread_buffers_[i]->release();
+    }
+
     delete adapted_sink_;
 }
 
-void LogAsyncSink::Impl::log(const char *buffer, size_t size)
+LogThreadBuffer *LogAsyncSink::Impl::getThreadBuffer()
+{
+    if (s_thread_buffer_cache_destroyed) {
+        return nullptr;
+    }
+    LogThreadBuffer *buffer = s_thread_buffer_cache.find(sink_id_);
+    if (buffer != nullptr) {
+        return buffer;
+    }
+
+    buffer = new LogThreadBuffer(thread_buffer_size_);
+    buffer->retain();
+    s_thread_buffer_cache.add(sink_id_, buffer);
+    addThreadBuffer(buffer);
+
+    return buffer;
+}
+
+void LogAsyncSink::Impl::addThreadBuffer(LogThreadBuffer *buffer)
+{
+    LockGuard lock(mutex_);
+    thread_buffers_.push_back(buffer);
+}
+
+void LogAsyncSink::Impl::notify()
+{
+    // pairs with the store in wait()
+    if (sleeping_.load()) {
+        LockGuard lock(mutex_);
+        cond_.notifyOne();
+    }
+}
+
+void LogAsyncSink::Impl::log(const char *buffer, size_t size, bool binary)
+{
+    LogThreadBuffer *thread_buffer = getThreadBuffer();
+    if (nullptr == thread_buffer) {
+        // thread is exiting, the buffer is released by log thread
+        thread_buffer = new LogThreadBuffer(thread_buffer_size_);
+        if (size <= thread_buffer->maxRecordSize()) {
+            thread_buffer->write(buffer, size, binary);
+        }
+        thread_buffer->closeProducer();
+        addThreadBuffer(thread_buffer);
+        notify();
+        return;
+    }
+    if (size > thread_buffer->maxRecordSize()) {
+        // binary record can not be truncated
+        if (binary) {
+            return;
+        }
+        size = thread_buffer->maxRecordSize();
+    }
+
+    while (thread_buffer->write(buffer, size, binary) == false) {
+        // buffer is full, wait for log thread
+        notify();
+        this_thread::yield();
+    }
+    notify();
+}
+
+void LogAsyncSink::Impl::formatBinaryRecords(struct iovec *records,
+    const bool *binary, size_t count)
+{
+    size_t total_size = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (binary[i]) {
+            LogRecordHeader header;
+            ::memcpy(&header, records[i].iov_base, sizeof(header));
+            total_size += std::max(header.max_log_size, 1);
+        }
+    }
+    if (0 == total_size) {
+        return;
+    }
+    if (format_buffer_.size() < total_size) {
+        format_buffer_.resize(total_size);
+    }
+
+    size_t offset = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (binary[i]) {
+            LogRecordHeader header;
+            ::memcpy(&header, records[i].iov_base, sizeof(header));
+            size_t buffer_size = std::max(header.max_log_size, 1);
+            char *buffer = &format_buffer_[offset];
+            records[i].iov_len = formatLogRecord(
+                (const char *)records[i].iov_base, records[i].iov_len,
+                buffer, buffer_size);
+            records[i].iov_base = buffer;
+            offset += buffer_size;
+        }
+    }
+}
+
+bool LogAsyncSink::Impl::flush()
 {
-    UniquePtr<DynamicBuffer> queue_buffer;
     {
-        LockGuard lock(pool_mutex_);
-        queue_buffer.reset(pool_.getObject());
+        LockGuard lock(mutex_);
+        flush_buffers_ = thread_buffers_;
     }
 
-    queue_buffer->reserveWritableBytes(size);
-    ::memcpy(queue_buffer->writeBegin(), buffer, size);
-    queue_buffer->write(size);
+    struct iovec records[IOV_MAX];
+    bool binary[IOV_MAX];
+    uint64_t read_indexes[64];
+    bool has_record = false;
+
+    // records of up to 64 threads are written in one batch
+    for (size_t start = 0; start < flush_buffers_.size(); start += 64) {
+        size_t end = std::min(start + 64, flush_buffers_.size());
+        size_t count = 0;
+        for (size_t i = start; i < end; ++i) {
+            count += flush_buffers_[i]->peek(records + count,
+                binary + count, (IOV_MAX - count) / (end - i),
+                &read_indexes[i - start]);
+        }
+        if (count == 0) {
+            continue;
+        }
+        formatBinaryRecords(records, binary, count);
+
+        adapted_sink_->logBatch(records, count);
+        for (size_t i = start; i < end; ++i) {
+            flush_buffers_[i]->commitRead(read_indexes[i - start]);
+        }
+        has_record = true;
+    }
 
-    queue_.push(queue_buffer.get());
-    queue_buffer.release();
+    // the buffers of exited threads are released after drained
+    for (size_t i = 0; i < flush_buffers_.size(); ++i) {
+        LogThreadBuffer *buffer = flush_buffers_[i];
+        if (buffer->isProducerClosed() && buffer->empty()) {
+            LockGuard lock(mutex_);
+            for (size_t j = 0; j < thread_buffers_.size(); ++j) {
+                if (thread_buffers_[j] == buffer) {
+                    thread_buffers_[j] = thread_buffers_.back();
+                    thread_buffers_.pop_back();
+                    buffer->release();
+                    break;
+                }
+            }
+        }
+    }
+
+    return has_record;
 }
 
-void LogAsyncSink::Impl::logThreadFunc()
+void LogAsyncSink::Impl::wait()
 {
-    for (;;) {
-        DynamicBuffer *queue_buffer_raw = nullptr;
-        queue_.pop(queue_buffer_raw);
+    LockGuard lock(mutex_);
 
-        if (nullptr == queue_buffer_raw) {
-            break;
+    sleeping_.store(true);
+    for (size_t i = 0; i < thread_buffers_.size(); ++i) {
+        if (thread_buffers_[i]->empty() == false) {
+            sleeping_.store(false);
+            return;
         }
-        UniquePtr<DynamicBuffer> queue_buffer(queue_buffer_raw);
+    }
+    if (stop_.load()) {
+        sleeping_.store(false);
+        return;
+    }
 
-        adapted_sink_->log(queue_buffer->readBegin(),
-                           queue_buffer->readableBytes());
-        queue_buffer->read(queue_buffer->readableBytes());
+    // timeout also picks up the buffers of exited threads
+    cond_.waitFor(mutex_, 100);
+    sleeping_.store(false);
+}
 
-        {
-            LockGuard lock(pool_mutex_);
-            pool_.returnObject(queue_buffer.get());
-            queue_buffer.release();
+void LogAsyncSink::Impl::logThreadFunc()
+{
+    for (;;) {
+        if (flush()) {
+            continue;
+        }
+        if (stop_.load()) {
+            // records written before stop
+            while (flush()) {
+            }
+            break;
         }
+        wait();
     }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-LogAsyncSink::LogAsyncSink(LogSink *adapted_sink, size_t queue_size) :
-    pimpl_(new Impl(adapted_sink, queue_size))
+LogAsyncSink::LogAsyncSink(LogSink *adapted_sink,
+                           size_t thread_buffer_size) :
+    pimpl_(new Impl(adapted_sink, thread_buffer_size))
 {
 }
 
@@ -96,7 +494,12 @@ LogAsyncSink::~LogAsyncSink()
 
 void LogAsyncSink::log(const char *buffer, size_t size)
 {
-    pimpl_->log(buffer, size);
+    pimpl_->log(buffer, size, false);
+}
+
+void LogAsyncSink::logRecord(const char *record, size_t size)
+{
+    pimpl_->log(record, size, true);
 }
 
 } // namespace brickred
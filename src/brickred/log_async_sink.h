@@ -9,12 +9,19 @@
 
 namespace brickred {
 
+// every logging thread owns a lock free buffer of thread_buffer_size bytes
+// (rounded up to power of 2, at least 64k), the log thread collects
+// records from all buffers and passes them to adapted_sink->logBatch(),
+// the caller blocks when its buffer is full
 class LogAsyncSink final : public LogSink {
 public:
-    LogAsyncSink(LogSink *adapted_sink, size_t queue_size = 100);
+    LogAsyncSink(LogSink *adapted_sink,
+                 size_t thread_buffer_size = 256 * 1024);
     ~LogAsyncSink() override;
 
     void log(const char *buffer, size_t size) override;
+    // deferred format records are formatted in log thread
+    void logRecord(const char *record, size_t size) override;
 
 private:
     BRICKRED_NONCOPYABLE(LogAsyncSink)
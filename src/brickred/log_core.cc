@@ -3,14 +3,85 @@
 #include <algorithm>
 #include <cstdarg>
 #include <cstdio>
+#include <cstring>
 #include <vector>
 
 #include <brickred/log_sink.h>
+#include <brickred/timestamp.h>
 
 namespace brickred {
 
 namespace {
 
+// format buffer of the calling thread, a nested log call from a sink
+// on the same thread gets a heap buffer instead
+class LogFormatBuffer {
+public:
+    explicit LogFormatBuffer(int size);
+    ~LogFormatBuffer();
+
+    char *get() const { return buffer_; }
+
+private:
+    BRICKRED_NONCOPYABLE(LogFormatBuffer)
+
+    char *buffer_;
+    bool is_thread_buffer_;
+};
+
+// plain thread locals stay valid after the holder is destroyed at
+// thread exit, then heap buffer is used
+thread_local char *s_thread_buffer = nullptr;
+thread_local int s_thread_buffer_size = 0;
+thread_local bool s_thread_buffer_in_use = false;
+
+class LogFormatBufferHolder {
+public:
+    LogFormatBufferHolder() {}
+    ~LogFormatBufferHolder()
+    {
+        delete[] s_thread_buffer;
+        s_thread_buffer = nullptr;
+        s_thread_buffer_size = 0;
+        s_thread_buffer_in_use = true;
+    }
+
+private:
+    BRICKRED_NONCOPYABLE(LogFormatBufferHolder)
+};
+
+thread_local LogFormatBufferHolder s_thread_buffer_holder;
+
+LogFormatBuffer::LogFormatBuffer(int size) :
+    buffer_(nullptr), is_thread_buffer_(false)
+{
+    if (s_thread_buffer_in_use) {
+        buffer_ = new char[size];
+        return;
+    }
+
+    if (s_thread_buffer_size < size) {
+        // register the holder to free the buffer at thread exit
+        (void)&s_thread_buffer_holder;
+        delete[] s_thread_buffer;
+        s_thread_buffer = new char[size];
+        s_thread_buffer_size = size;
+    }
+    buffer_ = s_thread_buffer;
+    is_thread_buffer_ = true;
+    s_thread_buffer_in_use = true;
+}
+
+LogFormatBuffer::~LogFormatBuffer()
+{
+    if (is_thread_buffer_) {
+        s_thread_buffer_in_use = false;
+    } else {
+        delete[] buffer_;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
 class Logger {
 public:
     using LogFormatter = LogCore::LogFormatter;
@@ -25,7 +96,9 @@ public:
     void log(int level, const char *filename, int line,
              const char *function, const char *format, va_list args);
     void plainLog(int level, const char *format, va_list args);
+    void logRecord(int level, char *record, size_t size);
     void setLevelFilter(int level_filter) { level_filter_ = level_filter; }
+    int getLevelFilter() const { return level_filter_; }
 
 private:
     LogFormatter formatter_;
@@ -71,7 +144,7 @@ void Logger::log(int level, const char *filename, int line,
         return;
     }
 
-    UniquePtr<char []> buffer(new char[max_log_size_]);
+    LogFormatBuffer buffer(max_log_size_);
     int32_t count = 0;
     bool buffer_ready = false;
 
@@ -107,7 +180,7 @@ void Logger::plainLog(int level, const char *format, va_list args)
         return;
     }
 
-    UniquePtr<char []> buffer(new char[max_log_size_]);
+    LogFormatBuffer buffer(max_log_size_);
     int count = 0;
     bool buffer_ready = false;
 
@@ -130,6 +203,26 @@ void Logger::plainLog(int level, const char *format, va_list args)
     }
 }
 
+void Logger::logRecord(int level, char *record, size_t size)
+{
+    if (level < level_filter_) {
+        return;
+    }
+
+    LogRecordHeader header;
+    ::memcpy(&header, record, sizeof(header));
+    header.formatter = formatter_;
+    header.max_log_size = max_log_size_;
+    ::memcpy(record, &header, sizeof(header));
+
+    for (size_t i = 0; i < sinks_.size(); ++i) {
+        if (level < sink_level_filters_[i]) {
+            continue;
+        }
+        sinks_[i]->logRecord(record, size);
+    }
+}
+
 } // namespace
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -154,8 +247,10 @@ public:
              const char *format, va_list args);
     void plainLog(int logger_id, int level,
                   const char *format, va_list args);
+    void logRecord(int logger_id, int level, char *record, size_t size);
 
     void setLevelFilter(int logger_id, int level_filter);
+    bool isLevelEnabled(int logger_id, int level) const;
 
 private:
     LoggerVector loggers_;
@@ -267,6 +362,31 @@ void LogCore::Impl::plainLog(int logger_id, int level,
     loggers_[logger_id]->plainLog(level, format, args);
 }
 
+void LogCore::Impl::logRecord(int logger_id, int level,
+                              char *record, size_t size)
+{
+    if (logger_id < 0 || logger_id >= (int)loggers_.size()) {
+        return;
+    }
+    if (nullptr == loggers_[logger_id]) {
+        return;
+    }
+
+    loggers_[logger_id]->logRecord(level, record, size);
+}
+
+bool LogCore::Impl::isLevelEnabled(int logger_id, int level) const
+{
+    if (logger_id < 0 || logger_id >= (int)loggers_.size()) {
+        return false;
+    }
+    if (nullptr == loggers_[logger_id]) {
+        return false;
+    }
+
+    return level >= loggers_[logger_id]->getLevelFilter();
+}
+
 void LogCore::Impl::setLevelFilter(int logger_id, int level_filter)
 {
     if (logger_id < 0 || logger_id >= (int)loggers_.size()) {
@@ -349,4 +469,31 @@ void LogCore::plainLog(int logger_id, int level,
     pimpl_->plainLog(logger_id, level, format, args);
 }
 
+void LogCore::logRecord(int logger_id, int level,
+                        char *record, size_t size)
+{
+    pimpl_->logRecord(logger_id, level, record, size);
+}
+
+void LogCore::setLevelFilter(int logger_id, int level_filter)
+{
+    pimpl_->setLevelFilter(logger_id, level_filter);
+}
+
+bool LogCore::isLevelEnabled(int logger_id, int level) const
+{
+    return pimpl_->isLevelEnabled(logger_id, level);
+}
+
+void LogCore::getLogTime(Timestamp *time) const
+{
+    time_t second = 0;
+    int64_t nanosecond = 0;
+    if (getFormattingLogRecordTime(&second, &nanosecond)) {
+        time->setTime(second, nanosecond);
+    } else {
+        time->setNow();
+    }
+}
+
 } // namespace brickred
@@ -5,9 +5,11 @@
 #include <cstdarg>
 
 #include <brickred/class_util.h>
+#include <brickred/log_record.h>
 #include <brickred/unique_ptr.h>
 
 namespace brickred { class LogSink; }
+namespace brickred { class Timestamp; }
 
 namespace brickred {
 
@@ -47,8 +49,26 @@ public:
     void plainLog(int logger_id, int level,
                   const char *format, va_list args);
 
+    // deferred format log, the calling thread only records the pointers
+    // of format, filename and function, the timestamp and a copy of the
+    // arguments, formatting is done when the sink writes the record
+    // (in log thread for LogAsyncSink), so format, filename and function
+    // must be string literals, strings are copied,
+    // at most 1024 bytes of arguments are recorded
+    template <typename... Args>
+    void deferredLog(int logger_id, int level,
+                     const char *filename, int line, const char *function,
+                     const char *format, const Args &... args);
+
     // change logger level filter
     void setLevelFilter(int logger_id, int level_filter);
+    bool isLevelEnabled(int logger_id, int level) const;
+
+    // time of the log call, formatter should use it instead of current time
+    // to get the correct time for deferred format log
+    void getLogTime(Timestamp *time) const;
+
+    void logRecord(int logger_id, int level, char *record, size_t size);
 
 private:
     BRICKRED_PRECREATED_SINGLETON(LogCore)
@@ -57,6 +77,24 @@ private:
     UniquePtr<Impl> pimpl_;
 };
 
+template <typename... Args>
+void LogCore::deferredLog(int logger_id, int level,
+                          const char *filename, int line,
+                          const char *function,
+                          const char *format, const Args &... args)
+{
+    if (isLevelEnabled(logger_id, level) == false) {
+        return;
+    }
+
+    alignas(LogRecordHeader) char record[sizeof(LogRecordHeader) + 1024];
+    LogRecordWriter writer(record, sizeof(record));
+    writer.writeHeader(level, filename, line, function, format);
+    (writer.writeArg(args), ...);
+
+    logRecord(logger_id, level, record, writer.size());
+}
+
 } // namespace brickred
 
 #endif
@@ -1,5 +1,8 @@
 #include <brickred/log_file_sink.h>
 
+#include <sys/uio.h>
+#include <cerrno>
+#include <climits>
 #include <cstdio>
 #include <cstring>
 
@@ -14,6 +17,7 @@ public:
     ~Impl();
 
     void log(const char *buffer, size_t size);
+    void logBatch(const struct iovec *records, int count);
     bool openFile();
 
 private:
@@ -75,6 +79,56 @@ void LogFileSink::Impl::log(const char *buffer, size_t size)
     ::fwrite(buffer, size, 1, fp_);
 }
 
+void LogFileSink::Impl::logBatch(const struct iovec *records, int count)
+{
+    if (openFile() == false) {
+        BRICKRED_INTERNAL_LOG_ERROR(
+            "open file %s failed: %s",
+            actual_file_path_.c_str(), ::strerror(errno));
+        return;
+    }
+
+    // fp_ is unbuffered, so it is safe to write to the fd directly
+    int fd = ::fileno(fp_);
+    struct iovec iov[IOV_MAX];
+    int iov_count = 0;
+
+    while (count > 0 || iov_count > 0) {
+        // refill
+        while (count > 0 && iov_count < IOV_MAX) {
+            iov[iov_count++] = *records++;
+            --count;
+        }
+
+        ssize_t write_size = ::writev(fd, iov, iov_count);
+        if (write_size < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            BRICKRED_INTERNAL_LOG_ERROR(
+                "write file %s failed: %s",
+                actual_file_path_.c_str(), ::strerror(errno));
+            return;
+        }
+
+        // skip written records, keep the rest of a partial one
+        int first = 0;
+        while (first < iov_count &&
+               (size_t)write_size >= iov[first].iov_len) {
+            write_size -= iov[first].iov_len;
+            ++first;
+        }
+        if (first < iov_count) {
+            iov[first].iov_base = (char *)iov[first].iov_base + write_size;
+            iov[first].iov_len -= write_size;
+        }
+        iov_count -= first;
+        for (int i = 0; i < iov_count; ++i) {
+            iov[i] = iov[first + i];
+        }
+    }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 LogFileSink::LogFileSink(const std::string &file_path) :
     pimpl_(new Impl(file_path))
@@ -90,6 +144,11 @@ void LogFileSink::log(const char *buffer, size_t size)
     pimpl_->log(buffer, size);
 }
 
+void LogFileSink::logBatch(const struct iovec *records, int count)
+{
+    pimpl_->logBatch(records, count);
+}
+
 bool LogFileSink::openFile()
 {
     return pimpl_->openFile();
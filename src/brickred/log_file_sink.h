@@ -16,6 +16,8 @@ public:
     ~LogFileSink() override;
 
     void log(const char *buffer, size_t size) override;
+    // records are written by writev in one system call
+    void logBatch(const struct iovec *records, int count) override;
     bool openFile();
 
 private:
@@ -0,0 +1,410 @@
+#include <brickred/log_record.h>
+
+#include <cstdio>
+#include <vector>
+
+namespace brickred {
+
+namespace {
+
+class LogRecordReader {
+public:
+    LogRecordReader(const char *buffer, size_t size) :
+        current_(buffer), end_(buffer + size)
+    {
+    }
+
+    ~LogRecordReader()
+    {
+    }
+
+    // return false if no more argument
+    bool readArg(LogRecordArgType *type, int64_t *i, uint64_t *u,
+                 double *d, const void **p, const char **str)
+    {
+        if (current_ >= end_) {
+            return false;
+        }
+        *type = (LogRecordArgType)*current_++;
+
+        switch (*type) {
+        case LogRecordArgType::INT64:
+            return read(i, sizeof(*i));
+        case LogRecordArgType::UINT64:
+            return read(u, sizeof(*u));
+        case LogRecordArgType::DOUBLE:
+            return read(d, sizeof(*d));
+        case LogRecordArgType::POINTER:
+            return read(p, sizeof(*p));
+        case LogRecordArgType::STRING: {
+            uint32_t size = 0;
+            if (read(&size, 4) == false ||
+                (size_t)(end_ - current_) < (size_t)size + 1) {
+                current_ = end_;
+                return false;
+            }
+            *str = current_;
+            current_ += size + 1;
+            return true;
+        }
+        default:
+            current_ = end_;
+            return false;
+        }
+    }
+
+private:
+    bool read(void *value, size_t size)
+    {
+        if ((size_t)(end_ - current_) < size) {
+            current_ = end_;
+            return false;
+        }
+        ::memcpy(value, current_, size);
+        current_ += size;
+        return true;
+    }
+
+private:
+    const char *current_;
+    const char *end_;
+};
+
+class LogRecordFormatter {
+public:
+    LogRecordFormatter(char *buffer, size_t buffer_size) :
+        buffer_(buffer), buffer_size_(buffer_size), count_(0)
+    {
+    }
+
+    ~LogRecordFormatter()
+    {
+    }
+
+    size_t format(const char *format, LogRecordReader &reader);
+
+private:
+    void append(const char *str, size_t size);
+    template <typename T>
+    void appendFormat(const char *spec, T value);
+    bool readInt(LogRecordReader &reader, int *value);
+
+private:
+    char *buffer_;
+    size_t buffer_size_;
+    size_t count_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+void LogRecordFormatter::append(const char *str, size_t size)
+{
+    if (count_ + 1 >= buffer_size_) {
+        return;
+    }
+    size = std::min(size, buffer_size_ - 1 - count_);
+    ::memcpy(buffer_ + count_, str, size);
+    count_ += size;
+    buffer_[count_] = '\0';
+}
+
+template <typename T>
+void LogRecordFormatter::appendFormat(const char *spec, T value)
+{
+    if (count_ + 1 >= buffer_size_) {
+        return;
+    }
+    int ret = ::snprintf(buffer_ + count_, buffer_size_ - count_,
+                         spec, value);
+    if (ret < 0) {
+        return;
+    }
+    count_ = std::min(count_ + ret, buffer_size_ - 1);
+}
+
+bool LogRecordFormatter::readInt(LogRecordReader &reader, int *value)
+{
+    LogRecordArgType type;
+    int64_t i = 0;
+    uint64_t u = 0;
+    double d = 0;
+    const void *p = nullptr;
+    const char *str = nullptr;
+
+    if (reader.readArg(&type, &i, &u, &d, &p, &str) == false) {
+        return false;
+    }
+    if (LogRecordArgType::INT64 == type) {
+        *value = (int)i;
+    } else if (LogRecordArgType::UINT64 == type) {
+        *value = (int)u;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+size_t LogRecordFormatter::format(const char *format, LogRecordReader &reader)
+{
+    if (buffer_size_ > 0) {
+        buffer_[0] = '\0';
+    }
+
+    const char *p = format;
+    while (*p != '\0') {
+        const char *percent = ::strchr(p, '%');
+        if (nullptr == percent) {
+            append(p, ::strlen(p));
+            break;
+        }
+        append(p, percent - p);
+        p = percent + 1;
+
+        if ('%' == *p) {
+            append("%", 1);
+            ++p;
+            continue;
+        }
+
+        // rebuild the conversion spec: %[flags][width][.precision]
+        // with the length modifier matching the recorded type
+        char spec[64];
+        size_t spec_size = 0;
+        spec[spec_size++] = '%';
+        while (*p != '\0' && ::strchr("-+ #0'", *p) != nullptr &&
+               spec_size < 16) {
+            spec[spec_size++] = *p++;
+        }
+        if ('*' == *p) {
+            int width = 0;
+            if (readInt(reader, &width) == false) {
+                append("(missing)", 9);
+                return count_;
+            }
+            spec_size += ::snprintf(spec + spec_size, 16, "%d", width);
+            ++p;
+        } else {
+            while (*p >= '0' && *p <= '9' && spec_size < 32) {
+                spec[spec_size++] = *p++;
+            }
+        }
+        if ('.' == *p) {
+            spec[spec_size++] = *p++;
+            if ('*' == *p) {
+                int precision = 0;
+                if (readInt(reader, &precision) == false) {
+                    append("(missing)", 9);
+                    return count_;
+                }
+                spec_size += ::snprintf(spec + spec_size, 16,
+                                        "%d", precision);
+                ++p;
+            } else {
+                while (*p >= '0' && *p <= '9' && spec_size < 48) {
+                    spec[spec_size++] = *p++;
+                }
+            }
+        }
+
+        // length modifier
+        int length = 0;
+        for (;;) {
+            if ('h' == *p) {
+                length -= 1;
+            } else if ('l' == *p || 'L' == *p || 'q' == *p ||
+                       'j' == *p || 'z' == *p || 't' == *p) {
+                length += 1;
+            } else {
+                break;
+            }
+            ++p;
+        }
+
+        char conversion = *p;
+        if ('\0' == conversion) {
+            break;
+        }
+        ++p;
+
+        LogRecordArgType type;
+        int64_t i = 0;
+        uint64_t u = 0;
+        double d = 0;
+        const void *ptr = nullptr;
+        const char *str = nullptr;
+        if (reader.readArg(&type, &i, &u, &d, &ptr, &str) == false) {
+            append("(missing)", 9);
+            return count_;
+        }
+        if (LogRecordArgType::INT64 == type) {
+            u = (uint64_t)i;
+        } else if (LogRecordArgType::UINT64 == type) {
+            i = (int64_t)u;
+        }
+        bool is_integer = LogRecordArgType::INT64 == type ||
+                          LogRecordArgType::UINT64 == type;
+
+        switch (conversion) {
+        case 'd':
+        case 'i':
+            if (!is_integer) {
+                append("(bad arg)", 9);
+                break;
+            }
+            if (-2 == length) {
+                i = (signed char)i;
+            } else if (-1 == length) {
+                i = (short)i;
+            } else if (0 == length) {
+                i = (int)i;
+            }
+            spec[spec_size++] = 'l';
+            spec[spec_size++] = 'l';
+            spec[spec_size++] = conversion;
+            spec[spec_size] = '\0';
+            appendFormat(spec, (long long)i);
+            break;
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+            if (!is_integer) {
+                append("(bad arg)", 9);
+                break;
+            }
+            if (-2 == length) {
+                u = (unsigned char)u;
+            } else if (-1 == length) {
+                u = (unsigned short)u;
+            } else if (0 == length) {
+                u = (unsigned int)u;
+            }
+            spec[spec_size++] = 'l';
+            spec[spec_size++] = 'l';
+            spec[spec_size++] = conversion;
+            spec[spec_size] = '\0';
+            appendFormat(spec, (unsigned long long)u);
+            break;
+        case 'c':
+            if (!is_integer) {
+                append("(bad arg)", 9);
+                break;
+            }
+            spec[spec_size++] = conversion;
+            spec[spec_size] = '\0';
+            appendFormat(spec, (int)i);
+            break;
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            if (LogRecordArgType::DOUBLE == type) {
+            } else if (LogRecordArgType::INT64 == type) {
+                d = (double)i;
+            } else if (LogRecordArgType::UINT64 == type) {
+                d = (double)u;
+            } else {
+                append("(bad arg)", 9);
+                break;
+            }
+            spec[spec_size++] = conversion;
+            spec[spec_size] = '\0';
+            appendFormat(spec, d);
+            break;
+        case 's':
+            if (type != LogRecordArgType::STRING) {
+                append("(bad arg)", 9);
+                break;
+            }
+            spec[spec_size++] = conversion;
+            spec[spec_size] = '\0';
+            appendFormat(spec, str);
+            break;
+        case 'p':
+            if (type != LogRecordArgType::POINTER) {
+                append("(bad arg)", 9);
+                break;
+            }
+            spec[spec_size++] = conversion;
+            spec[spec_size] = '\0';
+            appendFormat(spec, ptr);
+            break;
+        default:
+            append("(bad spec)", 10);
+            break;
+        }
+    }
+
+    return count_;
+}
+
+// the formatter takes va_list, so the message is passed by "%s"
+size_t callFormatter(LogRecordHeader::Formatter formatter,
+                     char *buffer, size_t buffer_size, int level,
+                     const char *filename, int line, const char *function,
+                     const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    size_t count = formatter(buffer, buffer_size, level,
+                             filename, line, function, format, args);
+    va_end(args);
+
+    return count;
+}
+
+thread_local const LogRecordHeader *s_formatting_record = nullptr;
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+size_t formatLogRecord(const char *record, size_t record_size,
+                       char *buffer, size_t buffer_size)
+{
+    if (record_size < sizeof(LogRecordHeader) || 0 == buffer_size) {
+        return 0;
+    }
+
+    LogRecordHeader header;
+    ::memcpy(&header, record, sizeof(header));
+    LogRecordReader reader(record + sizeof(header),
+                           record_size - sizeof(header));
+
+    if (nullptr == header.formatter) {
+        LogRecordFormatter formatter(buffer, buffer_size);
+        return formatter.format(header.format, reader);
+    }
+
+    // reused by the log thread
+    static thread_local std::vector<char> s_message;
+    if (s_message.size() < buffer_size) {
+        s_message.resize(buffer_size);
+    }
+    LogRecordFormatter formatter(&s_message[0], buffer_size);
+    formatter.format(header.format, reader);
+
+    s_formatting_record = &header;
+    size_t count = callFormatter(header.formatter, buffer, buffer_size,
+        header.level, header.filename, header.line, header.function,
+        "%s", &s_message[0]);
+    s_formatting_record = nullptr;
+
+    return std::min(count, buffer_size - 1);
+}
+
+bool getFormattingLogRecordTime(time_t *second, int64_t *nanosecond)
+{
+    if (nullptr == s_formatting_record) {
+        return false;
+    }
+    *second = s_formatting_record->second;
+    *nanosecond = s_formatting_record->nanosecond;
+
+    return true;
+}
+
+} // namespace brickred
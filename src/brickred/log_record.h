@@ -0,0 +1,170 @@
+#ifndef BRICKRED_LOG_RECORD_H
+#define BRICKRED_LOG_RECORD_H
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <type_traits>
+
+namespace brickred {
+
+// binary record of deferred format log:
+// [LogRecordHeader][tagged argument]...
+// the arguments are formatted by the format string when the record
+// is written by a sink
+struct LogRecordHeader {
+    using Formatter = size_t (*)(
+        char *buffer, size_t buffer_size, int level,
+        const char *filename, int line, const char *function,
+        const char *format, va_list args);
+
+    // filled by logger
+    Formatter formatter;
+    int32_t max_log_size;
+
+    int32_t level;
+    int32_t line;
+    const char *filename;
+    const char *function;
+    const char *format;
+    int64_t second;
+    int64_t nanosecond;
+};
+
+enum class LogRecordArgType : uint8_t {
+    INT64 = 1,
+    UINT64,
+    DOUBLE,
+    STRING,
+    POINTER,
+};
+
+template <typename T>
+struct LogRecordUnsupportedArg : std::false_type {};
+
+class LogRecordWriter final {
+public:
+    LogRecordWriter(char *buffer, size_t size) :
+        begin_(buffer), current_(buffer), end_(buffer + size), full_(false)
+    {
+    }
+
+    ~LogRecordWriter()
+    {
+    }
+
+    size_t size() const { return current_ - begin_; }
+
+    void writeHeader(int level, const char *filename, int line,
+                     const char *function, const char *format)
+    {
+        struct timespec tv;
+        ::clock_gettime(CLOCK_REALTIME, &tv);
+
+        LogRecordHeader header;
+        header.formatter = nullptr;
+        header.max_log_size = 0;
+        header.level = level;
+        header.line = line;
+        header.filename = filename;
+        header.function = function;
+        header.format = format;
+        header.second = tv.tv_sec;
+        header.nanosecond = tv.tv_nsec;
+        write(&header, sizeof(header));
+    }
+
+    template <typename T>
+    void writeArg(const T &value)
+    {
+        using U = typename std::decay<T>::type;
+        using Pointee = typename std::remove_cv<
+            typename std::remove_pointer<U>::type>::type;
+
+        if constexpr (std::is_enum<U>::value) {
+            writeArg((typename std::underlying_type<U>::type)value);
+        } else if constexpr (std::is_integral<U>::value &&
+                             std::is_signed<U>::value) {
+            int64_t v = value;
+            writeValue(LogRecordArgType::INT64, &v, sizeof(v));
+        } else if constexpr (std::is_integral<U>::value) {
+            uint64_t v = value;
+            writeValue(LogRecordArgType::UINT64, &v, sizeof(v));
+        } else if constexpr (std::is_floating_point<U>::value) {
+            double v = value;
+            writeValue(LogRecordArgType::DOUBLE, &v, sizeof(v));
+        } else if constexpr (std::is_pointer<U>::value &&
+                             std::is_same<Pointee, char>::value) {
+            const char *str = value;
+            if (nullptr == str) {
+                str = "(null)";
+            }
+            writeString(str, ::strlen(str));
+        } else if constexpr (std::is_pointer<U>::value ||
+                             std::is_null_pointer<U>::value) {
+            const void *v = (const void *)value;
+            writeValue(LogRecordArgType::POINTER, &v, sizeof(v));
+        } else {
+            static_assert(LogRecordUnsupportedArg<T>::value,
+                          "unsupported deferred log argument type");
+        }
+    }
+
+    void writeArg(const std::string &value)
+    {
+        writeString(value.c_str(), value.size());
+    }
+
+private:
+    void write(const void *data, size_t size)
+    {
+        ::memcpy(current_, data, size);
+        current_ += size;
+    }
+
+    void writeValue(LogRecordArgType type, const void *value, size_t size)
+    {
+        if (full_ || (size_t)(end_ - current_) < 1 + size) {
+            full_ = true;
+            return;
+        }
+        *current_++ = (char)type;
+        write(value, size);
+    }
+
+    // [size][string]['\0'], long string is truncated to fit the record
+    void writeString(const char *str, size_t size)
+    {
+        if (full_ || (size_t)(end_ - current_) < 1 + 4 + 1) {
+            full_ = true;
+            return;
+        }
+        size = std::min(size, (size_t)(end_ - current_) - 1 - 4 - 1);
+        uint32_t string_size = size;
+        *current_++ = (char)LogRecordArgType::STRING;
+        write(&string_size, 4);
+        write(str, size);
+        *current_++ = '\0';
+    }
+
+private:
+    char *begin_;
+    char *current_;
+    char *end_;
+    // the rest arguments are dropped
+    bool full_;
+};
+
+// format the record into buffer, return the size without the trailing '\0'
+size_t formatLogRecord(const char *record, size_t record_size,
+                       char *buffer, size_t buffer_size);
+// time of the record being formatted in current thread
+bool getFormattingLogRecordTime(time_t *second, int64_t *nanosecond);
+
+} // namespace brickred
+
+#endif
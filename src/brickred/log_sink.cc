@@ -0,0 +1,35 @@
+#include <brickred/log_sink.h>
+
+#include <sys/uio.h>
+#include <cstring>
+
+#include <brickred/log_record.h>
+#include <brickred/unique_ptr.h>
+
+namespace brickred {
+
+void LogSink::logBatch(const struct iovec *records, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        log((const char *)records[i].iov_base, records[i].iov_len);
+    }
+}
+
+void LogSink::logRecord(const char *record, size_t size)
+{
+    LogRecordHeader header;
+    if (size < sizeof(header)) {
+        return;
+    }
+    ::memcpy(&header, record, sizeof(header));
+    if (header.max_log_size <= 0) {
+        return;
+    }
+
+    UniquePtr<char []> buffer(new char[header.max_log_size]);
+    size_t count = formatLogRecord(record, size,
+                                   buffer.get(), header.max_log_size);
+    log(buffer.get(), count);
+}
+
+} // namespace brickred
@@ -5,6 +5,8 @@
 
 #include <brickred/class_util.h>
 
+struct iovec;
+
 namespace brickred {
 
 class LogSink {
@@ -13,6 +15,11 @@ public:
     virtual ~LogSink() {}
 
     virtual void log(const char *buffer, size_t size) = 0;
+    // each iovec is one record, default calls log() one by one
+    virtual void logBatch(const struct iovec *records, int count);
+    // binary record of deferred format log (see log_record.h),
+    // default formats it and calls log()
+    virtual void logRecord(const char *record, size_t size);
 
 private:
     BRICKRED_NONCOPYABLE(LogSink)
@@ -0,0 +1,769 @@
+#include <brickred/protocol/http_client.h>
+
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <brickred/dynamic_buffer.h>
+#include <brickred/io_service.h>
+#include <brickred/socket_address.h>
+#include <brickred/string_util.h>
+#include <brickred/tcp_service.h>
+#include <brickred/timestamp.h>
+#include <brickred/protocol/http_protocol.h>
+#include <brickred/protocol/http_request.h>
+#include <brickred/protocol/http_response.h>
+
+namespace brickred::protocol {
+
+namespace {
+
+// idle connections are checked in this interval
+const int s_idle_check_interval_ms = 1000;
+
+} // namespace
+
+class HttpClient::Impl {
+public:
+    using RequestId = HttpClient::RequestId;
+    using ResultCode = HttpClient::ResultCode;
+    using ResponseCallback = HttpClient::ResponseCallback;
+    using TimerId = IOService::TimerId;
+    using SocketId = TcpService::SocketId;
+
+    class Host;
+
+    class Request {
+    public:
+        Request() : id_(0), timer_id_(-1), head_(false),
+            idempotent_(false), retried_(false),
+            result_(ResultCode::OK) {}
+
+        RequestId id_;
+        TimerId timer_id_;
+        bool head_;
+        bool idempotent_;
+        // sent again after a reused connection is found closed
+        bool retried_;
+        // result of the request finished inside sendRequest()
+        ResultCode result_;
+        DynamicBuffer data_;
+        ResponseCallback response_cb_;
+    };
+
+    class Connection {
+    public:
+        Connection(Host *host, SocketId socket_id) :
+            host_(host), socket_id_(socket_id), connected_(false),
+            reused_(false), response_started_(false) {}
+
+        Host *host_;
+        SocketId socket_id_;
+        bool connected_;
+        // a response is received on it
+        bool reused_;
+        // bytes of the next response are received
+        bool response_started_;
+        HttpProtocol protocol_;
+        // sent requests waiting for the response, in order
+        std::deque<Request *> requests_;
+        Timestamp idle_time_;
+    };
+
+    class Host {
+    public:
+        Host() : connecting_count_(0) {}
+
+        SocketAddress addr_;
+        std::string host_header_;
+        // requests waiting for a connection
+        std::deque<Request *> requests_;
+        std::vector<Connection *> connections_;
+        int connecting_count_;
+    };
+
+    using HostMap = std::unordered_map<std::string, Host *>;
+    using ConnectionMap = std::unordered_map<SocketId, Connection *>;
+    using RequestMap = std::unordered_map<RequestId, Request *>;
+    using TimerMap = std::unordered_map<TimerId, RequestId>;
+
+    Impl(HttpClient *thiz, IOService &io_service);
+    ~Impl();
+
+    IOService *getIOService() const;
+
+    RequestId sendRequest(const SocketAddress &addr,
+                          const HttpRequest &request,
+                          const ResponseCallback &response_cb,
+                          int timeout_ms);
+
+    size_t getConnectionCount() const;
+    size_t getPendingRequestCount() const;
+
+    void setMaxConnectionsPerHost(int count);
+    void setMaxPipelinePerConnection(int count);
+    void setConnectTimeout(int timeout_ms);
+    void setIdleTimeout(int timeout_ms);
+    void setBodyMaxSize(size_t size);
+
+private:
+    Host *getHost(const SocketAddress &addr);
+    void dispatch(Host *host);
+    bool openConnection(Host *host);
+    void closeConnection(Connection *conn, ResultCode result);
+    void retryRequests(Connection *conn);
+    void finishRequest(Request *request, ResultCode result,
+                       HttpResponse *response);
+    void failWaitingRequests(Host *host, ResultCode result);
+
+    void onNewConnection(TcpService *service,
+                         SocketId from_socket_id, SocketId socket_id);
+    void onRecvMessage(TcpService *service,
+                       SocketId socket_id, DynamicBuffer *buffer);
+    void onPeerClose(TcpService *service, SocketId socket_id);
+    void onError(TcpService *service, SocketId socket_id, int error);
+    void onRequestTimeout(TimerId timer_id);
+    void onIdleCheck(TimerId timer_id);
+    void onDeferredFinish(TimerId timer_id);
+
+private:
+    HttpClient *thiz_;
+    IOService *io_service_;
+    TcpService tcp_service_;
+    int max_connections_per_host_;
+    int max_pipeline_per_connection_;
+    int connect_timeout_ms_;
+    int idle_timeout_ms_;
+    size_t body_max_size_;
+
+    RequestId next_request_id_;
+    HostMap hosts_;
+    ConnectionMap connections_;
+    RequestMap requests_;
+    TimerMap timers_;
+    TimerId idle_check_timer_id_;
+    // requests finished inside sendRequest() are called back later,
+    // the caller has not got the request id yet
+    bool in_send_request_;
+    std::vector<Request *> deferred_requests_;
+    TimerId deferred_timer_id_;
+    std::string host_key_;
+    HttpResponse response_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+HttpClient::Impl::Impl(HttpClient *thiz, IOService &io_service) :
+    thiz_(thiz), io_service_(&io_service), tcp_service_(io_service),
+    max_connections_per_host_(0),
+    max_pipeline_per_connection_(0),
+    connect_timeout_ms_(0),
+    idle_timeout_ms_(0),
+    body_max_size_(0),
+    next_request_id_(0),
+    in_send_request_(false),
+    deferred_timer_id_(-1)
+{
+    tcp_service_.setNewConnectionCallback(BRICKRED_BIND_MEM_FUNC(
+        &HttpClient::Impl::onNewConnection, this));
+    tcp_service_.setRecvMessageCallback(BRICKRED_BIND_MEM_FUNC(
+        &HttpClient::Impl::onRecvMessage, this));
+    tcp_service_.setPeerCloseCallback(BRICKRED_BIND_MEM_FUNC(
+        &HttpClient::Impl::onPeerClose, this));
+    tcp_service_.setErrorCallback(BRICKRED_BIND_MEM_FUNC(
+        &HttpClient::Impl::onError, this));
+
+    idle_check_timer_id_ = io_service_->startTimer(s_idle_check_interval_ms,
+        BRICKRED_BIND_MEM_FUNC(&HttpClient::Impl::onIdleCheck, this));
+}
+
+HttpClient::Impl::~Impl()
+{
+    io_service_->stopTimer(idle_check_timer_id_);
+    if (deferred_timer_id_ != -1) {
+        io_service_->stopTimer(deferred_timer_id_);
+    }
+
+    // callbacks are not called
+    for (size_t i = 0; i < deferred_requests_.size(); ++i) {
+        delete deferred_requests_[i];
+    }
+    for (RequestMap::iterator iter = requests_.begin();
+         iter != requests_.end(); ++iter) {
+        if (iter->second->timer_id_ != -1) {
+            io_service_->stopTimer(iter->second->timer_id_);
+        }
+        delete iter->second;
+    }
+    for (ConnectionMap::iterator iter = connections_.begin();
+         iter != connections_.end(); ++iter) {
+        delete iter->second;
+    }
+    for (HostMap::iterator iter = hosts_.begin();
+         iter != hosts_.end(); ++iter) {
+        delete iter->second;
+    }
+}
+
+IOService *HttpClient::Impl::getIOService() const
+{
+    return io_service_;
+}
+
+size_t HttpClient::Impl::getConnectionCount() const
+{
+    return connections_.size();
+}
+
+size_t HttpClient::Impl::getPendingRequestCount() const
+{
+    return requests_.size();
+}
+
+void HttpClient::Impl::setMaxConnectionsPerHost(int count)
+{
+    if (count <= 0) {
+        return;
+    }
+    max_connections_per_host_ = count;
+}
+
+void HttpClient::Impl::setMaxPipelinePerConnection(int count)
+{
+    if (count <= 0) {
+        return;
+    }
+    max_pipeline_per_connection_ = count;
+}
+
+void HttpClient::Impl::setConnectTimeout(int timeout_ms)
+{
+    connect_timeout_ms_ = timeout_ms;
+}
+
+void HttpClient::Impl::setIdleTimeout(int timeout_ms)
+{
+    idle_timeout_ms_ = timeout_ms;
+}
+
+void HttpClient::Impl::setBodyMaxSize(size_t size)
+{
+    body_max_size_ = size;
+}
+
+HttpClient::Impl::Host *HttpClient::Impl::getHost(const SocketAddress &addr)
+{
+    // reused to avoid allocation on the lookup
+    host_key_.clear();
+    host_key_.append(addr.getIp());
+    host_key_.push_back(':');
+    host_key_.append(string_util::toString(addr.getPort()));
+
+    HostMap::iterator iter = hosts_.find(host_key_);
+    if (iter != hosts_.end()) {
+        return iter->second;
+    }
+
+    Host *host = new Host();
+    host->addr_ = addr;
+    if (SocketAddress::Protocol::IP_V6 == addr.getProtocol()) {
+        host->host_header_ = "[" + addr.getIp() + "]:" +
+            string_util::toString(addr.getPort());
+    } else {
+        host->host_header_ = host_key_;
+    }
+    hosts_.insert(std::make_pair(host_key_, host));
+
+    return host;
+}
+
+HttpClient::Impl::RequestId HttpClient::Impl::sendRequest(
+    const SocketAddress &addr, const HttpRequest &request,
+    const ResponseCallback &response_cb, int timeout_ms)
+{
+    if (SocketAddress::Protocol::UNKNOWN == addr.getProtocol() ||
+        HttpMessage::Version::UNKNOWN == request.getVersion()) {
+        return -1;
+    }
+
+    Host *host = getHost(addr);
+
+    UniquePtr<Request> req(new Request());
+    req->id_ = ++next_request_id_;
+    req->head_ = HttpRequest::Method::HEAD == request.getMethod();
+    req->idempotent_ = HttpRequest::Method::POST != request.getMethod() &&
+        HttpRequest::Method::PATCH != request.getMethod();
+    req->response_cb_ = response_cb;
+    if (request.hasHeader(HttpMessage::KnownHeader::HOST)) {
+        HttpProtocol::writeMessage(request, &req->data_);
+    } else {
+        HttpRequest host_request = request;
+        host_request.setHeader("Host", host->host_header_);
+        HttpProtocol::writeMessage(host_request, &req->data_);
+    }
+
+    if (timeout_ms > 0) {
+        req->timer_id_ = io_service_->startTimer(timeout_ms,
+            BRICKRED_BIND_MEM_FUNC(&HttpClient::Impl::onRequestTimeout,
+                                   this), 1);
+        timers_[req->timer_id_] = req->id_;
+    }
+
+    RequestId request_id = req->id_;
+    requests_[request_id] = req.get();
+    host->requests_.push_back(req.release());
+    in_send_request_ = true;
+    dispatch(host);
+    in_send_request_ = false;
+
+    return request_id;
+}
+
+// assign waiting requests to connections
+void HttpClient::Impl::dispatch(Host *host)
+{
+    while (host->requests_.empty() == false) {
+        // the least busy connection, a retried request only goes to
+        // a new one
+        bool retried = host->requests_.front()->retried_;
+        Connection *conn = nullptr;
+        for (size_t i = 0; i < host->connections_.size(); ++i) {
+            Connection *c = host->connections_[i];
+            if (c->connected_ && (!retried || !c->reused_) &&
+                (int)c->requests_.size() < max_pipeline_per_connection_ &&
+                (nullptr == conn ||
+                 c->requests_.size() < conn->requests_.size())) {
+                conn = c;
+                if (c->requests_.empty()) {
+                    break;
+                }
+            }
+        }
+
+        if (nullptr == conn) {
+            // make room for a new connection by an idle reused one
+            if (retried &&
+                (int)host->connections_.size() >= max_connections_per_host_) {
+                Connection *idle = nullptr;
+                for (size_t i = 0; i < host->connections_.size(); ++i) {
+                    Connection *c = host->connections_[i];
+                    if (c->connected_ && c->reused_ && c->requests_.empty()) {
+                        idle = c;
+                        break;
+                    }
+                }
+                if (idle != nullptr) {
+                    closeConnection(idle, ResultCode::CONNECTION_CLOSED);
+                    continue;
+                }
+            }
+
+            // connections being opened will take the waiting requests
+            if ((int)host->connections_.size() < max_connections_per_host_ &&
+                (int)host->requests_.size() >
+                    host->connecting_count_ * max_pipeline_per_connection_) {
+                if (openConnection(host)) {
+                    continue;
+                }
+                // no other connection will take them
+                if (host->connections_.empty()) {
+                    failWaitingRequests(host, ResultCode::CONNECT_FAILED);
+                }
+            }
+            return;
+        }
+
+        Request *req = host->requests_.front();
+        host->requests_.pop_front();
+        conn->requests_.push_back(req);
+        if (tcp_service_.sendMessage(conn->socket_id_,
+                req->data_.readBegin(), req->data_.readableBytes()) == false) {
+            // request is retried or failed in closeConnection
+            retryRequests(conn);
+            closeConnection(conn, ResultCode::CONNECTION_CLOSED);
+        }
+    }
+}
+
+bool HttpClient::Impl::openConnection(Host *host)
+{
+    bool complete = false;
+    SocketId socket_id = tcp_service_.asyncConnect(
+        host->addr_, &complete, connect_timeout_ms_);
+    if (-1 == socket_id) {
+        return false;
+    }
+
+    Connection *conn = new Connection(host, socket_id);
+    conn->protocol_.setBodyMaxSize(body_max_size_);
+    conn->connected_ = complete;
+    conn->idle_time_.setNow();
+    if (!complete) {
+        ++host->connecting_count_;
+    }
+    host->connections_.push_back(conn);
+    connections_[socket_id] = conn;
+
+    return true;
+}
+
+// in-flight requests of the connection are failed with result
+void HttpClient::Impl::closeConnection(Connection *conn, ResultCode result)
+{
+    Host *host = conn->host_;
+    host->connections_.erase(std::find(host->connections_.begin(),
+        host->connections_.end(), conn));
+    if (!conn->connected_) {
+        --host->connecting_count_;
+    }
+    connections_.erase(conn->socket_id_);
+    tcp_service_.closeSocket(conn->socket_id_);
+
+    std::deque<Request *> requests;
+    requests.swap(conn->requests_);
+    delete conn;
+
+    for (size_t i = 0; i < requests.size(); ++i) {
+        finishRequest(requests[i], result, nullptr);
+    }
+}
+
+// the server may close an idle connection at any time, the requests of
+// a reused connection closed before any byte of the response are queued
+// again to be sent once on a new connection, only the idempotent ones
+// (rfc 7230 6.3.1)
+void HttpClient::Impl::retryRequests(Connection *conn)
+{
+    if (!conn->reused_ || conn->response_started_) {
+        return;
+    }
+
+    Host *host = conn->host_;
+    std::deque<Request *> &requests = conn->requests_;
+    for (size_t i = requests.size(); i > 0; --i) {
+        Request *req = requests[i - 1];
+        if (req->idempotent_ && !req->retried_) {
+            req->retried_ = true;
+            host->requests_.push_front(req);
+            requests.erase(requests.begin() + (i - 1));
+        }
+    }
+}
+
+void HttpClient::Impl::finishRequest(Request *request, ResultCode result,
+                                     HttpResponse *response)
+{
+    if (request->timer_id_ != -1) {
+        io_service_->stopTimer(request->timer_id_);
+        timers_.erase(request->timer_id_);
+    }
+    requests_.erase(request->id_);
+
+    if (in_send_request_) {
+        request->result_ = result;
+        deferred_requests_.push_back(request);
+        if (-1 == deferred_timer_id_) {
+            deferred_timer_id_ = io_service_->startTimer(0,
+                BRICKRED_BIND_MEM_FUNC(&HttpClient::Impl::onDeferredFinish,
+                                       this), 1);
+        }
+        return;
+    }
+
+    UniquePtr<Request> req(request);
+    if (req->response_cb_) {
+        req->response_cb_(thiz_, req->id_, result, response);
+    }
+}
+
+void HttpClient::Impl::failWaitingRequests(Host *host, ResultCode result)
+{
+    // new requests sent in the callbacks are kept
+    std::deque<Request *> requests;
+    requests.swap(host->requests_);
+
+    for (size_t i = 0; i < requests.size(); ++i) {
+        finishRequest(requests[i], result, nullptr);
+    }
+}
+
+void HttpClient::Impl::onNewConnection(TcpService *service,
+    SocketId from_socket_id, SocketId socket_id)
+{
+    ConnectionMap::iterator iter = connections_.find(socket_id);
+    if (connections_.end() == iter) {
+        service->closeSocket(socket_id);
+        return;
+    }
+    Connection *conn = iter->second;
+    Host *host = conn->host_;
+
+    conn->connected_ = true;
+    --host->connecting_count_;
+    conn->idle_time_.setNow();
+
+    dispatch(host);
+}
+
+void HttpClient::Impl::onRecvMessage(TcpService *service,
+    SocketId socket_id, DynamicBuffer *buffer)
+{
+    ConnectionMap::iterator iter = connections_.find(socket_id);
+    if (connections_.end() == iter) {
+        service->closeSocket(socket_id);
+        return;
+    }
+    Connection *conn = iter->second;
+    Host *host = conn->host_;
+    if (buffer->readableBytes() > 0) {
+        conn->response_started_ = true;
+    }
+
+    for (;;) {
+        if (conn->requests_.empty()) {
+            // response without request
+            if (buffer->readableBytes() > 0) {
+                closeConnection(conn, ResultCode::PROTOCOL_ERROR);
+                dispatch(host);
+            }
+            return;
+        }
+
+        conn->protocol_.setHeadResponse(conn->requests_.front()->head_);
+        HttpProtocol::RetCode ret = conn->protocol_.recvMessage(buffer);
+        if (HttpProtocol::RetCode::WAITING_MORE_DATA == ret) {
+            return;
+        }
+        if (HttpProtocol::RetCode::ERROR == ret ||
+            conn->protocol_.retrieveResponse(&response_) == false) {
+            closeConnection(conn, ResultCode::PROTOCOL_ERROR);
+            dispatch(host);
+            return;
+        }
+
+        Request *req = conn->requests_.front();
+        conn->requests_.pop_front();
+        conn->idle_time_.setNow();
+        conn->reused_ = true;
+        conn->response_started_ = buffer->readableBytes() > 0;
+        bool keep_alive = response_.isConnectionKeepAlive();
+
+        // the callback may send requests, conn is still in the pool
+        // and may be closed in it by a failed send
+        finishRequest(req, ResultCode::OK, &response_);
+        if (connections_.find(socket_id) == connections_.end()) {
+            return;
+        }
+
+        if (!keep_alive) {
+            retryRequests(conn);
+            closeConnection(conn, ResultCode::CONNECTION_CLOSED);
+            dispatch(host);
+            return;
+        }
+        dispatch(host);
+        if (connections_.find(socket_id) == connections_.end()) {
+            return;
+        }
+    }
+}
+
+void HttpClient::Impl::onPeerClose(TcpService *service, SocketId socket_id)
+{
+    ConnectionMap::iterator iter = connections_.find(socket_id);
+    if (connections_.end() == iter) {
+        service->closeSocket(socket_id);
+        return;
+    }
+    Host *host = iter->second->host_;
+
+    retryRequests(iter->second);
+    closeConnection(iter->second, ResultCode::CONNECTION_CLOSED);
+    dispatch(host);
+}
+
+void HttpClient::Impl::onError(TcpService *service,
+                               SocketId socket_id, int error)
+{
+    ConnectionMap::iterator iter = connections_.find(socket_id);
+    if (connections_.end() == iter) {
+        service->closeSocket(socket_id);
+        return;
+    }
+    Connection *conn = iter->second;
+    Host *host = conn->host_;
+
+    if (conn->connected_) {
+        retryRequests(conn);
+        closeConnection(conn, ResultCode::CONNECTION_CLOSED);
+        dispatch(host);
+    } else {
+        // connect failed, the waiting requests are failed unless a
+        // connected one can take them, otherwise they would be retried
+        // with new connections forever
+        closeConnection(conn, ResultCode::CONNECT_FAILED);
+        bool has_connected = false;
+        for (size_t i = 0; i < host->connections_.size(); ++i) {
+            if (host->connections_[i]->connected_) {
+                has_connected = true;
+                break;
+            }
+        }
+        if (has_connected) {
+            dispatch(host);
+        } else {
+            failWaitingRequests(host, ResultCode::CONNECT_FAILED);
+        }
+    }
+}
+
+void HttpClient::Impl::onRequestTimeout(TimerId timer_id)
+{
+    TimerMap::iterator iter = timers_.find(timer_id);
+    if (timers_.end() == iter) {
+        return;
+    }
+    RequestId request_id = iter->second;
+    timers_.erase(iter);
+
+    RequestMap::iterator iter2 = requests_.find(request_id);
+    if (requests_.end() == iter2) {
+        return;
+    }
+    Request *req = iter2->second;
+    req->timer_id_ = -1;
+
+    // waiting for a connection
+    for (HostMap::iterator host_iter = hosts_.begin();
+         host_iter != hosts_.end(); ++host_iter) {
+        std::deque<Request *> &waiting = host_iter->second->requests_;
+        std::deque<Request *>::iterator req_iter =
+            std::find(waiting.begin(), waiting.end(), req);
+        if (req_iter != waiting.end()) {
+            waiting.erase(req_iter);
+            finishRequest(req, ResultCode::TIMEOUT, nullptr);
+            return;
+        }
+    }
+
+    // sent, the responses are in order, so the connection is dropped
+    // and the other requests on it are failed
+    for (ConnectionMap::iterator conn_iter = connections_.begin();
+         conn_iter != connections_.end(); ++conn_iter) {
+        Connection *conn = conn_iter->second;
+        std::deque<Request *>::iterator req_iter =
+            std::find(conn->requests_.begin(), conn->requests_.end(), req);
+        if (req_iter != conn->requests_.end()) {
+            Host *host = conn->host_;
+            conn->requests_.erase(req_iter);
+            closeConnection(conn, ResultCode::CONNECTION_CLOSED);
+            finishRequest(req, ResultCode::TIMEOUT, nullptr);
+            dispatch(host);
+            return;
+        }
+    }
+}
+
+void HttpClient::Impl::onIdleCheck(TimerId timer_id)
+{
+    if (idle_timeout_ms_ <= 0) {
+        return;
+    }
+
+    Timestamp now;
+    now.setNow();
+
+    std::vector<Connection *> expired;
+    for (ConnectionMap::iterator iter = connections_.begin();
+         iter != connections_.end(); ++iter) {
+        Connection *conn = iter->second;
+        if (conn->connected_ && conn->requests_.empty() &&
+            now.distanceMillisecond(conn->idle_time_) >= idle_timeout_ms_) {
+            expired.push_back(conn);
+        }
+    }
+    for (size_t i = 0; i < expired.size(); ++i) {
+        closeConnection(expired[i], ResultCode::CONNECTION_CLOSED);
+    }
+}
+
+void HttpClient::Impl::onDeferredFinish(TimerId timer_id)
+{
+    deferred_timer_id_ = -1;
+
+    // new requests finished in the callbacks are deferred again
+    std::vector<Request *> requests;
+    requests.swap(deferred_requests_);
+
+    for (size_t i = 0; i < requests.size(); ++i) {
+        UniquePtr<Request> req(requests[i]);
+        if (req->response_cb_) {
+            req->response_cb_(thiz_, req->id_, req->result_, nullptr);
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+HttpClient::HttpClient(IOService &io_service) :
+    pimpl_(new Impl(this, io_service))
+{
+    setMaxConnectionsPerHost();
+    setMaxPipelinePerConnection();
+    setConnectTimeout();
+    setIdleTimeout();
+    setBodyMaxSize();
+}
+
+HttpClient::~HttpClient()
+{
+}
+
+IOService *HttpClient::getIOService() const
+{
+    return pimpl_->getIOService();
+}
+
+HttpClient::RequestId HttpClient::sendRequest(const SocketAddress &addr,
+    const HttpRequest &request, const ResponseCallback &response_cb,
+    int timeout_ms)
+{
+    return pimpl_->sendRequest(addr, request, response_cb, timeout_ms);
+}
+
+size_t HttpClient::getConnectionCount() const
+{
+    return pimpl_->getConnectionCount();
+}
+
+size_t HttpClient::getPendingRequestCount() const
+{
+    return pimpl_->getPendingRequestCount();
+}
+
+void HttpClient::setMaxConnectionsPerHost(int count)
+{
+    pimpl_->setMaxConnectionsPerHost(count);
+}
+
+void HttpClient::setMaxPipelinePerConnection(int count)
+{
+    pimpl_->setMaxPipelinePerConnection(count);
+}
+
+void HttpClient::setConnectTimeout(int timeout_ms)
+{
+    pimpl_->setConnectTimeout(timeout_ms);
+}
+
+void HttpClient::setIdleTimeout(int timeout_ms)
+{
+    pimpl_->setIdleTimeout(timeout_ms);
+}
+
+void HttpClient::setBodyMaxSize(size_t size)
+{
+    pimpl_->setBodyMaxSize(size);
+}
+
+} // namespace brickred::protocol
@@ -0,0 +1,82 @@
+#ifndef BRICKRED_PROTOCOL_HTTP_CLIENT_H
+#define BRICKRED_PROTOCOL_HTTP_CLIENT_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <brickred/class_util.h>
+#include <brickred/function.h>
+#include <brickred/unique_ptr.h>
+
+namespace brickred { class IOService; }
+namespace brickred { class SocketAddress; }
+namespace brickred::protocol { class HttpRequest; }
+namespace brickred::protocol { class HttpResponse; }
+
+namespace brickred::protocol {
+
+// http/1.1 client with keep-alive connection pools per host (ip:port),
+// requests are queued per host and sent on an idle connection, or
+// pipelined on a busy one if allowed, a new connection is opened if
+// all are busy and the pool is not full, an idempotent request on a
+// reused connection closed by the server before the response is sent
+// once more on a new connection, all callbacks are called in the thread
+// of io service
+class HttpClient final {
+public:
+    using RequestId = int64_t;
+
+    enum class ResultCode {
+        OK = 0,
+        CONNECT_FAILED,
+        TIMEOUT,
+        CONNECTION_CLOSED,
+        PROTOCOL_ERROR
+    };
+
+    // response is nullptr if result is not OK, the body can be swapped out
+    using ResponseCallback = Function<void (HttpClient *client,
+                                            RequestId request_id,
+                                            ResultCode result,
+                                            HttpResponse *response)>;
+
+    explicit HttpClient(IOService &io_service);
+    ~HttpClient();
+
+    IOService *getIOService() const;
+
+    // the request is serialized before return, Host header is added if
+    // not set, timeout_ms covers queueing, connecting and the response,
+    // 0 means no limit, return -1 if failed, response_cb is never called
+    // before this function returns, a request failed at once (e.g.
+    // connect refused) is called back in the next loop of io service
+    RequestId sendRequest(const SocketAddress &addr,
+                          const HttpRequest &request,
+                          const ResponseCallback &response_cb,
+                          int timeout_ms = 0);
+
+    // open connections of all hosts
+    size_t getConnectionCount() const;
+    // requests waiting for a connection or the response
+    size_t getPendingRequestCount() const;
+
+    void setMaxConnectionsPerHost(int count = 8);
+    // requests sent on a connection before their responses,
+    // 1 means no pipelining
+    void setMaxPipelinePerConnection(int count = 1);
+    void setConnectTimeout(int timeout_ms = 3000);
+    // close the connection idle for timeout_ms, 0 means no limit, keep
+    // it below the keep-alive timeout of the server (60s of HttpServer)
+    void setIdleTimeout(int timeout_ms = 30000);
+    void setBodyMaxSize(size_t size = 1024 * 1024);
+
+private:
+    BRICKRED_NONCOPYABLE(HttpClient)
+
+    class Impl;
+    UniquePtr<Impl> pimpl_;
+};
+
+} // namespace brickred::protocol
+
+#endif
@@ -0,0 +1,212 @@
+#include <brickred/protocol/http_header_map.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace brickred::protocol {
+
+namespace {
+
+// fnv-1a of lower case name
+constexpr uint32_t caseInsensitiveHash(const char *str, size_t size)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < size; ++i) {
+        char c = str[i];
+        if (c >= 'A' && c <= 'Z') {
+            c += 'a' - 'A';
+        }
+        h = (h ^ (uint8_t)c) * 16777619u;
+    }
+
+    return h;
+}
+
+bool caseInsensitiveEqual(const std::string &lhs, const std::string &rhs)
+{
+    if (lhs.size() != rhs.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < lhs.size(); ++i) {
+        char l = lhs[i];
+        char r = rhs[i];
+        if (l >= 'A' && l <= 'Z') {
+            l += 'a' - 'A';
+        }
+        if (r >= 'A' && r <= 'Z') {
+            r += 'a' - 'A';
+        }
+        if (l != r) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+struct KnownHeaderEntry {
+    const char *name;
+    size_t size;
+    uint32_t hash;
+};
+
+#define BRICKRED_HTTP_KNOWN_HEADER(_name) \
+    { _name, sizeof(_name) - 1, caseInsensitiveHash(_name, sizeof(_name) - 1) }
+
+// same order as HttpHeaderMap::KnownHeader
+constexpr KnownHeaderEntry s_known_headers[] = {
+    BRICKRED_HTTP_KNOWN_HEADER("Content-Length"),
+    BRICKRED_HTTP_KNOWN_HEADER("Connection"),
+    BRICKRED_HTTP_KNOWN_HEADER("Transfer-Encoding"),
+    BRICKRED_HTTP_KNOWN_HEADER("Upgrade"),
+    BRICKRED_HTTP_KNOWN_HEADER("Sec-WebSocket-Key"),
+    BRICKRED_HTTP_KNOWN_HEADER("Host"),
+    BRICKRED_HTTP_KNOWN_HEADER("Date"),
+    BRICKRED_HTTP_KNOWN_HEADER("Content-Type"),
+};
+
+#undef BRICKRED_HTTP_KNOWN_HEADER
+
+static_assert(sizeof(s_known_headers) / sizeof(s_known_headers[0]) ==
+              (size_t)HttpHeaderMap::KnownHeader::MAX,
+              "known header table size mismatch");
+
+const std::string s_known_header_names[] = {
+    s_known_headers[0].name,
+    s_known_headers[1].name,
+    s_known_headers[2].name,
+    s_known_headers[3].name,
+    s_known_headers[4].name,
+    s_known_headers[5].name,
+    s_known_headers[6].name,
+    s_known_headers[7].name,
+};
+
+// return -1 if not a known header
+int findKnownHeader(const std::string &name, uint32_t hash)
+{
+    for (int i = 0; i < (int)HttpHeaderMap::KnownHeader::MAX; ++i) {
+        if (s_known_headers[i].hash == hash &&
+            caseInsensitiveEqual(name, s_known_header_names[i])) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+HttpHeaderMap::HttpHeaderMap()
+{
+    std::fill(known_headers_, known_headers_ + (int)KnownHeader::MAX, -1);
+}
+
+HttpHeaderMap::~HttpHeaderMap()
+{
+}
+
+void HttpHeaderMap::swap(HttpHeaderMap &other)
+{
+    headers_.swap(other.headers_);
+    std::swap(known_headers_, other.known_headers_);
+}
+
+void HttpHeaderMap::clear()
+{
+    headers_.clear();
+    std::fill(known_headers_, known_headers_ + (int)KnownHeader::MAX, -1);
+}
+
+int HttpHeaderMap::findIndex(const std::string &name, uint32_t hash,
+                             int known) const
+{
+    if (known >= 0) {
+        return known_headers_[known];
+    }
+
+    for (size_t i = 0; i < headers_.size(); ++i) {
+        if (headers_[i].hash == hash &&
+            caseInsensitiveEqual(headers_[i].first, name)) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+HttpHeaderMap::iterator HttpHeaderMap::find(const std::string &name)
+{
+    uint32_t hash = caseInsensitiveHash(name.data(), name.size());
+    int index = findIndex(name, hash, findKnownHeader(name, hash));
+
+    return (index < 0) ? headers_.end() : headers_.begin() + index;
+}
+
+HttpHeaderMap::const_iterator HttpHeaderMap::find(
+    const std::string &name) const
+{
+    uint32_t hash = caseInsensitiveHash(name.data(), name.size());
+    int index = findIndex(name, hash, findKnownHeader(name, hash));
+
+    return (index < 0) ? headers_.end() : headers_.begin() + index;
+}
+
+HttpHeaderMap::const_iterator HttpHeaderMap::find(KnownHeader name) const
+{
+    int index = known_headers_[(int)name];
+
+    return (index < 0) ? headers_.end() : headers_.begin() + index;
+}
+
+void HttpHeaderMap::set(const std::string &name, const std::string &value)
+{
+    uint32_t hash = caseInsensitiveHash(name.data(), name.size());
+    int known = findKnownHeader(name, hash);
+    int index = findIndex(name, hash, known);
+    if (index >= 0) {
+        headers_[index].second = value;
+        return;
+    }
+
+    // most messages have only a few headers
+    if (headers_.capacity() == 0) {
+        headers_.reserve(8);
+    }
+    headers_.emplace_back();
+    Header &header = headers_.back();
+    header.first = name;
+    header.second = value;
+    header.hash = hash;
+    if (known >= 0) {
+        known_headers_[known] = headers_.size() - 1;
+    }
+}
+
+void HttpHeaderMap::erase(const std::string &name)
+{
+    uint32_t hash = caseInsensitiveHash(name.data(), name.size());
+    int known = findKnownHeader(name, hash);
+    int index = findIndex(name, hash, known);
+    if (index < 0) {
+        return;
+    }
+
+    headers_.erase(headers_.begin() + index);
+    if (known >= 0) {
+        known_headers_[known] = -1;
+    }
+    for (int i = 0; i < (int)KnownHeader::MAX; ++i) {
+        if (known_headers_[i] > index) {
+            --known_headers_[i];
+        }
+    }
+}
+
+const std::string &HttpHeaderMap::KnownHeaderEnumToStr(KnownHeader known)
+{
+    return s_known_header_names[(int)known];
+}
+
+} // namespace brickred::protocol
@@ -0,0 +1,72 @@
+#ifndef BRICKRED_PROTOCOL_HTTP_HEADER_MAP_H
+#define BRICKRED_PROTOCOL_HTTP_HEADER_MAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace brickred::protocol {
+
+// insertion ordered headers with case insensitive unique names,
+// names are compared by precomputed hash first, and the well known
+// headers are indexed directly
+class HttpHeaderMap final {
+public:
+    // first is name, second is value, like std::map
+    struct Header {
+        std::string first;
+        std::string second;
+        uint32_t hash;
+    };
+
+    enum class KnownHeader {
+        CONTENT_LENGTH = 0,
+        CONNECTION,
+        TRANSFER_ENCODING,
+        UPGRADE,
+        SEC_WEBSOCKET_KEY,
+        HOST,
+        DATE,
+        CONTENT_TYPE,
+        MAX
+    };
+
+    using HeaderVector = std::vector<Header>;
+    using iterator = HeaderVector::iterator;
+    using const_iterator = HeaderVector::const_iterator;
+
+    HttpHeaderMap();
+    ~HttpHeaderMap();
+    void swap(HttpHeaderMap &other);
+    void clear();
+
+    iterator begin() { return headers_.begin(); }
+    iterator end() { return headers_.end(); }
+    const_iterator begin() const { return headers_.begin(); }
+    const_iterator end() const { return headers_.end(); }
+    size_t size() const { return headers_.size(); }
+    bool empty() const { return headers_.empty(); }
+
+    iterator find(const std::string &name);
+    const_iterator find(const std::string &name) const;
+    const_iterator find(KnownHeader name) const;
+    // replace the value if the name exists
+    void set(const std::string &name, const std::string &value);
+    void erase(const std::string &name);
+
+    static const std::string &KnownHeaderEnumToStr(KnownHeader known);
+
+private:
+    // return -1 if not found
+    int findIndex(const std::string &name, uint32_t hash, int known) const;
+
+private:
+    HeaderVector headers_;
+    // index in headers_ or -1
+    int known_headers_[(int)KnownHeader::MAX];
+};
+
+} // namespace brickred::protocol
+
+#endif
@@ -1,7 +1,9 @@
 #include <brickred/protocol/http_message.h>
 
+#include <cctype>
 #include <utility>
 
+#include <brickred/string_util.h>
 #include <brickred/timestamp.h>
 
 namespace brickred::protocol {
@@ -10,6 +12,7 @@ static const std::string s_cstr_empty_string;
 static const std::string s_cstr_http_1_1("HTTP/1.1");
 static const std::string s_cstr_http_1_0("HTTP/1.0");
 static const std::string s_cstr_unknown("UNKNOWN");
+static const std::string s_cstr_date("Date");
 
 HttpMessage::HttpMessage() :
     message_type_(MessageType::UNKNOWN),
@@ -39,22 +42,61 @@ const std::string &HttpMessage::getHeader(const std::string &key) const
     }
 }
 
+const std::string &HttpMessage::getHeader(KnownHeader key) const
+{
+    HeaderMap::const_iterator iter = headers_.find(key);
+    if (iter == headers_.end()) {
+        return s_cstr_empty_string;
+    } else {
+        return iter->second;
+    }
+}
+
 bool HttpMessage::hasHeader(const std::string &key) const
 {
     return headers_.find(key) != headers_.end();
 }
 
+bool HttpMessage::hasHeader(KnownHeader key) const
+{
+    return headers_.find(key) != headers_.end();
+}
+
 bool HttpMessage::headerEqual(const std::string &key,
                               const std::string &value) const
 {
     return string_util::caseInsensitiveEqual(getHeader(key), value);
 }
 
+static bool caseInsensitiveContain(const std::string &str,
+                                   const std::string &keyword)
+{
+    for (size_t i = 0; i + keyword.size() <= str.size(); ++i) {
+        size_t j = 0;
+        for (; j < keyword.size(); ++j) {
+            if (::tolower((unsigned char)str[i + j]) !=
+                    ::tolower((unsigned char)keyword[j])) {
+                break;
+            }
+        }
+        if (j == keyword.size()) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 bool HttpMessage::headerContain(const std::string &key,
                                 const std::string &value) const
 {
-    return string_util::toLower(getHeader(key)).find(
-               string_util::toLower(value)) != std::string::npos;
+    return caseInsensitiveContain(getHeader(key), value);
+}
+
+bool HttpMessage::headerContain(KnownHeader key,
+                                const std::string &value) const
+{
+    return caseInsensitiveContain(getHeader(key), value);
 }
 
 void HttpMessage::setVersion(Version version)
@@ -64,7 +106,7 @@ void HttpMessage::setVersion(Version version)
 
 void HttpMessage::setHeader(const std::string &key, const std::string &value)
 {
-    headers_[key] = value;
+    headers_.set(key, value);
 }
 
 void HttpMessage::removeHeader(const std::string &key)
@@ -84,7 +126,13 @@ void HttpMessage::setBody(const std::string &body)
 
 bool HttpMessage::isConnectionKeepAlive() const
 {
-    return headerEqual("Connection", "Keep-Alive");
+    const std::string &connection = getHeader(KnownHeader::CONNECTION);
+
+    // http/1.1 connection is persistent by default
+    if (Version::HTTP_1_1 == version_) {
+        return string_util::caseInsensitiveEqual(connection, "Close") == false;
+    }
+    return string_util::caseInsensitiveEqual(connection, "Keep-Alive");
 }
 
 void HttpMessage::setConnectionKeepAlive()
@@ -100,15 +148,22 @@ void HttpMessage::setConnectionClose()
 void HttpMessage::setDate(time_t now)
 {
     if (0 == now) {
-        Timestamp ts;
-        ts.setNow();
-        now = ts.getSecond();
+        now = Timestamp::now();
+    }
+
+    // the date string only changes once per second, each thread (so each
+    // io service) keeps the last one
+    static thread_local time_t s_date_second = 0;
+    static thread_local std::string s_date_string;
+    if (now != s_date_second) {
+        char date_string[256];
+        Timestamp::format(date_string, sizeof(date_string),
+                          "%a, %d %b %Y %H:%M:%S %Z", now);
+        s_date_second = now;
+        s_date_string = date_string;
     }
 
-    char date_string[256];
-    Timestamp::format(date_string, sizeof(date_string),
-                      "%a, %d %b %Y %H:%M:%S %Z", now);
-    setHeader("Date", date_string);
+    headers_.set(s_cstr_date, s_date_string);
 }
 
 HttpMessage::Version HttpMessage::VersionStrToEnum(
@@ -3,10 +3,9 @@
 
 #include <ctime>
 #include <cstddef>
-#include <map>
 #include <string>
 
-#include <brickred/string_util.h>
+#include <brickred/protocol/http_header_map.h>
 
 namespace brickred::protocol {
 
@@ -24,8 +23,8 @@ public:
         RESPONSE
     };
 
-    using HeaderMap = std::map<std::string, std::string,
-                               string_util::CaseInsensitiveLess>;
+    using HeaderMap = HttpHeaderMap;
+    using KnownHeader = HttpHeaderMap::KnownHeader;
 
     HttpMessage();
     virtual ~HttpMessage() = 0;
@@ -35,11 +34,14 @@ public:
     Version getVersion() const { return version_; }
     const HeaderMap &getHeaders() const { return headers_; }
     const std::string &getHeader(const std::string &key) const;
+    const std::string &getHeader(KnownHeader key) const;
     bool hasHeader(const std::string &key) const;
+    bool hasHeader(KnownHeader key) const;
     bool headerEqual(const std::string &key,
                      const std::string &value) const;
     bool headerContain(const std::string &key,
                        const std::string &value) const;
+    bool headerContain(KnownHeader key, const std::string &value) const;
     const std::string &getBody() const { return body_; }
 
     void setVersion(Version version);
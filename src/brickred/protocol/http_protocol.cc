@@ -1,5 +1,7 @@
 #include <brickred/protocol/http_protocol.h>
 
+#include <sys/uio.h>
+#include <algorithm>
 #include <cstddef>
 #include <cstdio>
 #include <cstdlib>
@@ -9,17 +11,160 @@
 
 #include <brickred/dynamic_buffer.h>
 #include <brickred/string_util.h>
+#include <brickred/timestamp.h>
 #include <brickred/protocol/http_message.h>
 #include <brickred/protocol/http_request.h>
 #include <brickred/protocol/http_response.h>
 
 namespace brickred::protocol {
 
+namespace {
+
+// precomputed status lines of http/1.1
+struct StatusLine {
+    int status_code;
+    const char *reason_phrase;
+    size_t reason_phrase_size;
+    const char *line;
+    size_t line_size;
+};
+
+#define BRICKRED_HTTP_STATUS_LINE(_status_code, _reason_phrase) \
+    { _status_code, _reason_phrase, sizeof(_reason_phrase) - 1, \
+      "HTTP/1.1 " #_status_code " " _reason_phrase "\r\n", \
+      sizeof("HTTP/1.1 " #_status_code " " _reason_phrase "\r\n") - 1 }
+
+// sorted by status code
+constexpr StatusLine s_status_lines[] = {
+    BRICKRED_HTTP_STATUS_LINE(100, "Continue"),
+    BRICKRED_HTTP_STATUS_LINE(101, "Switching Protocols"),
+    BRICKRED_HTTP_STATUS_LINE(200, "OK"),
+    BRICKRED_HTTP_STATUS_LINE(201, "Created"),
+    BRICKRED_HTTP_STATUS_LINE(202, "Accepted"),
+    BRICKRED_HTTP_STATUS_LINE(204, "No Content"),
+    BRICKRED_HTTP_STATUS_LINE(206, "Partial Content"),
+    BRICKRED_HTTP_STATUS_LINE(301, "Moved Permanently"),
+    BRICKRED_HTTP_STATUS_LINE(302, "Found"),
+    BRICKRED_HTTP_STATUS_LINE(303, "See Other"),
+    BRICKRED_HTTP_STATUS_LINE(304, "Not Modified"),
+    BRICKRED_HTTP_STATUS_LINE(307, "Temporary Redirect"),
+    BRICKRED_HTTP_STATUS_LINE(308, "Permanent Redirect"),
+    BRICKRED_HTTP_STATUS_LINE(400, "Bad Request"),
+    BRICKRED_HTTP_STATUS_LINE(401, "Unauthorized"),
+    BRICKRED_HTTP_STATUS_LINE(403, "Forbidden"),
+    BRICKRED_HTTP_STATUS_LINE(404, "Not Found"),
+    BRICKRED_HTTP_STATUS_LINE(405, "Method Not Allowed"),
+    BRICKRED_HTTP_STATUS_LINE(408, "Request Timeout"),
+    BRICKRED_HTTP_STATUS_LINE(411, "Length Required"),
+    BRICKRED_HTTP_STATUS_LINE(413, "Payload Too Large"),
+    BRICKRED_HTTP_STATUS_LINE(414, "URI Too Long"),
+    BRICKRED_HTTP_STATUS_LINE(429, "Too Many Requests"),
+    BRICKRED_HTTP_STATUS_LINE(431, "Request Header Fields Too Large"),
+    BRICKRED_HTTP_STATUS_LINE(500, "Internal Server Error"),
+    BRICKRED_HTTP_STATUS_LINE(501, "Not Implemented"),
+    BRICKRED_HTTP_STATUS_LINE(502, "Bad Gateway"),
+    BRICKRED_HTTP_STATUS_LINE(503, "Service Unavailable"),
+    BRICKRED_HTTP_STATUS_LINE(504, "Gateway Timeout"),
+};
+
+#undef BRICKRED_HTTP_STATUS_LINE
+
+// empty reason phrase uses the standard one
+const StatusLine *findStatusLine(int status_code,
+                                 const std::string &reason_phrase)
+{
+    const StatusLine *end = s_status_lines +
+        sizeof(s_status_lines) / sizeof(s_status_lines[0]);
+    const StatusLine *line = std::lower_bound(s_status_lines, end,
+        status_code, [](const StatusLine &line, int status_code) {
+            return line.status_code < status_code;
+        });
+    if (line == end || line->status_code != status_code) {
+        return nullptr;
+    }
+    if (reason_phrase.empty() == false &&
+        (reason_phrase.size() != line->reason_phrase_size ||
+         ::memcmp(reason_phrase.data(), line->reason_phrase,
+                  line->reason_phrase_size) != 0)) {
+        return nullptr;
+    }
+
+    return line;
+}
+
+// 64 bit integer in decimal or hex
+const size_t s_max_integer_size = 20;
+
+// the caller reserves enough space
+class BufferWriter {
+public:
+    explicit BufferWriter(char *buffer) : current_(buffer) {}
+    ~BufferWriter() {}
+
+    size_t size(const char *begin) const { return current_ - begin; }
+
+    void append(char c)
+    {
+        *current_++ = c;
+    }
+
+    void append(const char *str, size_t size)
+    {
+        ::memcpy(current_, str, size);
+        current_ += size;
+    }
+
+    void append(const std::string &str)
+    {
+        append(str.data(), str.size());
+    }
+
+    void appendDecimal(int64_t value)
+    {
+        uint64_t u = value;
+        if (value < 0) {
+            *current_++ = '-';
+            u = 0 - u;
+        }
+        char digits[s_max_integer_size];
+        size_t count = 0;
+        do {
+            digits[count++] = '0' + u % 10;
+            u /= 10;
+        } while (u != 0);
+        while (count > 0) {
+            *current_++ = digits[--count];
+        }
+    }
+
+    void appendHex(uint64_t value)
+    {
+        static const char s_hex_digits[] = "0123456789abcdef";
+        char digits[s_max_integer_size];
+        size_t count = 0;
+        do {
+            digits[count++] = s_hex_digits[value & 0xf];
+            value >>= 4;
+        } while (value != 0);
+        while (count > 0) {
+            *current_++ = digits[--count];
+        }
+    }
+
+private:
+    char *current_;
+};
+
+} // namespace
+
 class HttpProtocol::Impl {
 public:
     using Status = HttpProtocol::Status;
     using RetCode = HttpProtocol::RetCode;
     using OutputCallback = HttpProtocol::OutputCallback;
+    using OutputVCallback = HttpProtocol::OutputVCallback;
+    using BodyEvent = HttpProtocol::BodyEvent;
+    using BodyCallback = HttpProtocol::BodyCallback;
     using StatusHandler = int (HttpProtocol::Impl::*)(DynamicBuffer *);
 
     Impl();
@@ -29,32 +174,78 @@ public:
     Status getStatus() const { return status_; }
 
     void setOutputCallback(const OutputCallback &output_cb);
+    void setOutputVCallback(const OutputVCallback &outputv_cb);
+    void setBodyCallback(const BodyCallback &body_cb);
+    void setHeadResponse(bool head_response);
 
     RetCode recvMessage(DynamicBuffer *buffer);
     bool retrieveRequest(HttpRequest *request);
     bool retrieveResponse(HttpResponse *response);
     void sendMessage(const HttpMessage &message);
 
+    RetCode recvRequests(DynamicBuffer *buffer,
+                         std::vector<HttpRequest> *requests,
+                         size_t max_count);
+    void beginOutputBatch();
+    void endOutputBatch();
+
+    void sendMessageHeader(const HttpMessage &message);
+    void sendChunk(const char *buffer, size_t size);
+    void sendLastChunk();
+
     void setStartLineMaxSize(size_t size);
     void setHeaderMaxSize(size_t size);
     void setBodyMaxSize(size_t size);
+    void setHeaderTimeout(int64_t timeout_ms);
+    bool isHeaderTimeout(const Timestamp &now) const;
 
 public:
     int readStartLine(DynamicBuffer *buffer);
     int readHeader(DynamicBuffer *buffer);
     int readBody(DynamicBuffer *buffer);
 
+private:
+    bool isReadingHeader() const;
+    bool isResponseWithoutBody() const;
+    int readBodyStream(DynamicBuffer *buffer);
+    int readChunkStream(DynamicBuffer *buffer);
+    void output(const DynamicBuffer &buffer);
+
 private:
     static StatusHandler s_status_handler_[(int)Status::MAX];
 
 private:
     Status status_;
     OutputCallback output_cb_;
+    OutputVCallback outputv_cb_;
+    DynamicBuffer header_buffer_;
     HttpMessage *message_;
     DynamicBuffer *chunk_buffer_;
     size_t start_line_max_size_;
     size_t header_max_size_;
     size_t body_max_size_;
+    // bytes from readBegin() already scanned for the line terminator
+    size_t scan_offset_;
+    int64_t header_timeout_ms_;
+    // time of the first byte of the message
+    bool header_started_;
+    Timestamp header_start_time_;
+    bool output_batching_;
+    DynamicBuffer output_buffer_;
+
+    // streaming body mode
+    enum class ChunkStatus {
+        READING_SIZE_LINE = 0,
+        READING_DATA,
+        READING_DATA_CRLF
+    };
+    BodyCallback body_cb_;
+    bool head_response_;
+    bool body_started_;
+    bool body_chunked_;
+    ChunkStatus chunk_status_;
+    // remaining bytes of the body or current chunk
+    uint64_t body_remaining_;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -73,7 +264,16 @@ HttpProtocol::Impl::Impl() :
     chunk_buffer_(nullptr),
     start_line_max_size_(0),
     header_max_size_(0),
-    body_max_size_(0)
+    body_max_size_(0),
+    scan_offset_(0),
+    header_timeout_ms_(0),
+    header_started_(false),
+    output_batching_(false),
+    head_response_(false),
+    body_started_(false),
+    body_chunked_(false),
+    chunk_status_(ChunkStatus::READING_SIZE_LINE),
+    body_remaining_(0)
 {
 }
 
@@ -95,6 +295,12 @@ void HttpProtocol::Impl::reset()
     }
 
     status_ = Status::READING_START_LINE;
+    scan_offset_ = 0;
+    header_started_ = false;
+    body_started_ = false;
+    body_chunked_ = false;
+    chunk_status_ = ChunkStatus::READING_SIZE_LINE;
+    body_remaining_ = 0;
 }
 
 void HttpProtocol::Impl::setOutputCallback(const OutputCallback &output_cb)
@@ -102,9 +308,40 @@ void HttpProtocol::Impl::setOutputCallback(const OutputCallback &output_cb)
     output_cb_ = output_cb;
 }
 
+void HttpProtocol::Impl::setOutputVCallback(
+    const OutputVCallback &outputv_cb)
+{
+    outputv_cb_ = outputv_cb;
+}
+
+void HttpProtocol::Impl::setBodyCallback(const BodyCallback &body_cb)
+{
+    body_cb_ = body_cb;
+}
+
+void HttpProtocol::Impl::setHeadResponse(bool head_response)
+{
+    head_response_ = head_response;
+}
+
 HttpProtocol::Impl::RetCode HttpProtocol::Impl::recvMessage(
     DynamicBuffer *buffer)
 {
+    if (header_timeout_ms_ > 0 && isReadingHeader()) {
+        if (header_started_) {
+            // header is not completed in time
+            Timestamp now;
+            now.setNow();
+            if (isHeaderTimeout(now)) {
+                status_ = Status::PENDING_ERROR;
+                return RetCode::ERROR;
+            }
+        } else if (buffer->readableBytes() > 0) {
+            header_started_ = true;
+            header_start_time_.setNow();
+        }
+    }
+
     for (;;) {
         StatusHandler func = s_status_handler_[(int)status_];
         if (nullptr == func) {
@@ -124,23 +361,53 @@ HttpProtocol::Impl::RetCode HttpProtocol::Impl::recvMessage(
 
         if (Status::FINISHED == status_) {
             // finished
+            if (body_started_) {
+                body_cb_(BodyEvent::END, *message_, nullptr, 0);
+            }
             return RetCode::MESSAGE_READY;
         }
     }
 }
 
+bool HttpProtocol::Impl::isReadingHeader() const
+{
+    return Status::READING_START_LINE == status_ ||
+           Status::READING_HEADER == status_;
+}
+
+// 1xx, 204 and 304 responses and responses to HEAD never have a body
+bool HttpProtocol::Impl::isResponseWithoutBody() const
+{
+    if (message_->getMessageType() != HttpMessage::MessageType::RESPONSE) {
+        return false;
+    }
+    if (head_response_) {
+        return true;
+    }
+    int status_code =
+        static_cast<const HttpResponse *>(message_)->getStatusCode();
+
+    return (status_code >= 100 && status_code < 200) ||
+           204 == status_code || 304 == status_code;
+}
+
 int HttpProtocol::Impl::readStartLine(DynamicBuffer *buffer)
 {
-    // get a http line
-    const char *crlf = string_util::find(buffer->readBegin(),
-        buffer->readableBytes(), "\r\n");
+    // get a http line, resume from the last scan position
+    const char *crlf = string_util::find(buffer->readBegin() + scan_offset_,
+        buffer->readableBytes() - scan_offset_, "\r\n");
     if (nullptr == crlf) {
         // exceed max size
         if (buffer->readableBytes() > start_line_max_size_) {
             return -1;
         }
+        // the last byte may be the '\r' of a crlf
+        if (buffer->readableBytes() > 0) {
+            scan_offset_ = buffer->readableBytes() - 1;
+        }
         return 0;
     }
+    scan_offset_ = 0;
 
     size_t line_length = crlf - buffer->readBegin();
     // exceed max size
@@ -220,18 +487,31 @@ int HttpProtocol::Impl::readHeader(DynamicBuffer *buffer)
 
     if (::memcmp(buffer->readBegin(), "\r\n", 2) == 0) {
         buffer->read(2);
-        this->status_ = Status::FINISHED;
+        header_started_ = false;
+        if (body_cb_ && Status::READING_HEADER == this->status_) {
+            // streaming mode always reports the body events
+            this->status_ = Status::READING_BODY;
+        } else {
+            this->status_ = Status::FINISHED;
+        }
         return 1;
     }
 
-    const char *double_crlf = string_util::find(buffer->readBegin(),
-        buffer->readableBytes(), "\r\n\r\n");
+    // resume from the last scan position
+    const char *double_crlf = string_util::find(
+        buffer->readBegin() + scan_offset_,
+        buffer->readableBytes() - scan_offset_, "\r\n\r\n");
     if (nullptr == double_crlf) {
         if (buffer->readableBytes() > header_max_size_) {
             return -1;
         }
+        // the last 3 bytes may be the beginning of a double crlf
+        if (buffer->readableBytes() > 3) {
+            scan_offset_ = buffer->readableBytes() - 3;
+        }
         return 0;
     }
+    scan_offset_ = 0;
 
     size_t header_length = double_crlf - buffer->readBegin();
     // exceed max size
@@ -256,6 +536,7 @@ int HttpProtocol::Impl::readHeader(DynamicBuffer *buffer)
     }
 
     buffer->read(header_length + 4);
+    header_started_ = false;
     if (this->status_ == Status::READING_TRAILER_HEADER) {
         this->status_ = Status::FINISHED;
     } else {
@@ -266,9 +547,19 @@ int HttpProtocol::Impl::readHeader(DynamicBuffer *buffer)
 
 int HttpProtocol::Impl::readBody(DynamicBuffer *buffer)
 {
-    if (message_->hasHeader("Content-Length")) {
+    if (body_cb_) {
+        return readBodyStream(buffer);
+    }
+
+    if (isResponseWithoutBody()) {
+        this->status_ = Status::FINISHED;
+        return 1;
+    }
+
+    if (message_->hasHeader(HttpMessage::KnownHeader::CONTENT_LENGTH)) {
         // header content-length exists
-        int content_length = ::atoi(message_->getHeader("Content-Length").c_str());
+        int content_length = ::atoi(message_->getHeader(
+            HttpMessage::KnownHeader::CONTENT_LENGTH).c_str());
         if (content_length > 0) {
             // exceed max size
             if ((size_t)content_length > body_max_size_) {
@@ -291,18 +582,13 @@ int HttpProtocol::Impl::readBody(DynamicBuffer *buffer)
             return -1;
         }
 
-    } else if (message_->headerContain("Transfer-Encoding", "chunked")) {
+    } else if (message_->headerContain(
+            HttpMessage::KnownHeader::TRANSFER_ENCODING, "chunked")) {
         // header transfer-encoding == "chunked"
         if (nullptr == chunk_buffer_) {
             chunk_buffer_ = new DynamicBuffer();
         }
 
-        // exceed max size
-        if (chunk_buffer_->readableBytes() + buffer->readableBytes() >
-                body_max_size_) {
-            return -1;
-        }
-
         for (;;) {
             const char *buffer_start = buffer->readBegin();
             size_t buffer_size = buffer->readableBytes();
@@ -310,6 +596,10 @@ int HttpProtocol::Impl::readBody(DynamicBuffer *buffer)
             const char *crlf =
                 string_util::find(buffer_start, buffer_size, "\r\n");
             if (nullptr == crlf) {
+                // chunk head line exceed max size
+                if (buffer_size > body_max_size_) {
+                    return -1;
+                }
                 // wait for more data
                 return 0;
             }
@@ -319,7 +609,10 @@ int HttpProtocol::Impl::readBody(DynamicBuffer *buffer)
             if (::sscanf(chunk_head_line.c_str(), "%x", &chunk_size) != 1) {
                 return -1;
             }
-            if (chunk_size > body_max_size_) {
+            // exceed max size, the buffer may also hold the pipelined
+            // messages after this one, so only the chunks are counted
+            if (chunk_buffer_->readableBytes() + chunk_size >
+                    body_max_size_) {
                 return -1;
             }
 
@@ -357,11 +650,141 @@ int HttpProtocol::Impl::readBody(DynamicBuffer *buffer)
                 return 1;
             }
         }
+    } else if (message_->getMessageType() ==
+               HttpMessage::MessageType::REQUEST) {
+        // request without content-length and chunked has no body
+        this->status_ = Status::FINISHED;
+        return 1;
     } else {
         return -1;
     }
 }
 
+int HttpProtocol::Impl::readBodyStream(DynamicBuffer *buffer)
+{
+    if (!body_started_) {
+        if (isResponseWithoutBody()) {
+            body_remaining_ = 0;
+        } else if (message_->hasHeader(
+                       HttpMessage::KnownHeader::CONTENT_LENGTH)) {
+            const std::string &value = message_->getHeader(
+                HttpMessage::KnownHeader::CONTENT_LENGTH);
+            char *end = nullptr;
+            body_remaining_ = ::strtoull(value.c_str(), &end, 10);
+            if (value.empty() || *end != '\0' || value[0] == '-') {
+                return -1;
+            }
+        } else if (message_->headerContain(
+                       HttpMessage::KnownHeader::TRANSFER_ENCODING,
+                       "chunked")) {
+            body_chunked_ = true;
+        } else if (message_->getMessageType() !=
+                   HttpMessage::MessageType::REQUEST) {
+            // reading body until connection closed is not supported
+            return -1;
+        }
+
+        body_started_ = true;
+        body_cb_(BodyEvent::HEADER_COMPLETE, *message_, nullptr, 0);
+    }
+
+    if (body_chunked_) {
+        return readChunkStream(buffer);
+    }
+
+    if (body_remaining_ > 0) {
+        size_t size = std::min(body_remaining_,
+                               (uint64_t)buffer->readableBytes());
+        if (0 == size) {
+            return 0;
+        }
+        body_cb_(BodyEvent::DATA, *message_, buffer->readBegin(), size);
+        buffer->read(size);
+        body_remaining_ -= size;
+        if (body_remaining_ > 0) {
+            return 0;
+        }
+    }
+
+    this->status_ = Status::FINISHED;
+    return 1;
+}
+
+int HttpProtocol::Impl::readChunkStream(DynamicBuffer *buffer)
+{
+    for (;;) {
+        if (ChunkStatus::READING_SIZE_LINE == chunk_status_) {
+            const char *crlf = string_util::find(buffer->readBegin(),
+                buffer->readableBytes(), "\r\n");
+            if (nullptr == crlf) {
+                // chunk size and extensions
+                if (buffer->readableBytes() > start_line_max_size_) {
+                    return -1;
+                }
+                return 0;
+            }
+
+            // chunk-size [; chunk-ext]
+            uint64_t chunk_size = 0;
+            const char *p = buffer->readBegin();
+            if (p == crlf) {
+                return -1;
+            }
+            for (; p < crlf; ++p) {
+                int digit = 0;
+                if (*p >= '0' && *p <= '9') {
+                    digit = *p - '0';
+                } else if (*p >= 'a' && *p <= 'f') {
+                    digit = *p - 'a' + 10;
+                } else if (*p >= 'A' && *p <= 'F') {
+                    digit = *p - 'A' + 10;
+                } else {
+                    break;
+                }
+                if (chunk_size >> 60 != 0) {
+                    return -1;
+                }
+                chunk_size = (chunk_size << 4) | digit;
+            }
+            if (p < crlf && *p != ';' && *p != ' ' && *p != '\t') {
+                return -1;
+            }
+            buffer->read(crlf + 2 - buffer->readBegin());
+
+            if (0 == chunk_size) {
+                // read tailer header
+                this->status_ = Status::READING_TRAILER_HEADER;
+                return 1;
+            }
+            body_remaining_ = chunk_size;
+            chunk_status_ = ChunkStatus::READING_DATA;
+
+        } else if (ChunkStatus::READING_DATA == chunk_status_) {
+            size_t size = std::min(body_remaining_,
+                                   (uint64_t)buffer->readableBytes());
+            if (0 == size) {
+                return 0;
+            }
+            body_cb_(BodyEvent::DATA, *message_, buffer->readBegin(), size);
+            buffer->read(size);
+            body_remaining_ -= size;
+            if (0 == body_remaining_) {
+                chunk_status_ = ChunkStatus::READING_DATA_CRLF;
+            }
+
+        } else {
+            if (buffer->readableBytes() < 2) {
+                return 0;
+            }
+            if (::memcmp(buffer->readBegin(), "\r\n", 2) != 0) {
+                return -1;
+            }
+            buffer->read(2);
+            chunk_status_ = ChunkStatus::READING_SIZE_LINE;
+        }
+    }
+}
+
 bool HttpProtocol::Impl::retrieveRequest(HttpRequest *request)
 {
     if (status_ != Status::FINISHED) {
@@ -400,6 +823,20 @@ bool HttpProtocol::Impl::retrieveResponse(HttpResponse *response)
 
 void HttpProtocol::Impl::sendMessage(const HttpMessage &message)
 {
+    if (output_batching_) {
+        HttpProtocol::writeMessage(message, &output_buffer_);
+        return;
+    }
+
+    if (outputv_cb_) {
+        struct iovec buffers[2];
+        int count = HttpProtocol::writeMessageV(
+            message, &header_buffer_, buffers);
+        outputv_cb_(buffers, count);
+        header_buffer_.clear();
+        return;
+    }
+
     if (output_cb_) {
         DynamicBuffer buffer;
         HttpProtocol::writeMessage(message, &buffer);
@@ -407,6 +844,105 @@ void HttpProtocol::Impl::sendMessage(const HttpMessage &message)
     }
 }
 
+HttpProtocol::Impl::RetCode HttpProtocol::Impl::recvRequests(
+    DynamicBuffer *buffer, std::vector<HttpRequest> *requests,
+    size_t max_count)
+{
+    size_t count = 0;
+
+    while (count < max_count) {
+        RetCode ret = recvMessage(buffer);
+        if (RetCode::MESSAGE_READY == ret) {
+            requests->emplace_back();
+            if (retrieveRequest(&requests->back()) == false) {
+                requests->pop_back();
+                status_ = Status::PENDING_ERROR;
+                break;
+            }
+            ++count;
+        } else {
+            break;
+        }
+    }
+
+    // the error is returned by the next call if any request is appended,
+    // recvMessage() keeps returning ERROR in PENDING_ERROR status
+    if (0 == count && Status::PENDING_ERROR == status_) {
+        return RetCode::ERROR;
+    }
+
+    return count > 0 ? RetCode::MESSAGE_READY : RetCode::WAITING_MORE_DATA;
+}
+
+void HttpProtocol::Impl::output(const DynamicBuffer &buffer)
+{
+    if (output_cb_) {
+        output_cb_(buffer.readBegin(), buffer.readableBytes());
+    } else if (outputv_cb_) {
+        struct iovec iov;
+        iov.iov_base = const_cast<char *>(buffer.readBegin());
+        iov.iov_len = buffer.readableBytes();
+        outputv_cb_(&iov, 1);
+    }
+}
+
+void HttpProtocol::Impl::sendMessageHeader(const HttpMessage &message)
+{
+    if (output_batching_) {
+        HttpProtocol::writeMessageHeader(message, &output_buffer_);
+        return;
+    }
+
+    DynamicBuffer buffer;
+    HttpProtocol::writeMessageHeader(message, &buffer);
+    output(buffer);
+}
+
+void HttpProtocol::Impl::sendChunk(const char *buffer, size_t size)
+{
+    // empty chunk is the last chunk
+    if (0 == size) {
+        return;
+    }
+
+    if (output_batching_) {
+        HttpProtocol::writeChunk(buffer, size, &output_buffer_);
+        return;
+    }
+
+    DynamicBuffer chunk(size + 32);
+    HttpProtocol::writeChunk(buffer, size, &chunk);
+    output(chunk);
+}
+
+void HttpProtocol::Impl::sendLastChunk()
+{
+    if (output_batching_) {
+        HttpProtocol::writeLastChunk(&output_buffer_);
+        return;
+    }
+
+    DynamicBuffer chunk(32);
+    HttpProtocol::writeLastChunk(&chunk);
+    output(chunk);
+}
+
+void HttpProtocol::Impl::beginOutputBatch()
+{
+    output_batching_ = true;
+}
+
+void HttpProtocol::Impl::endOutputBatch()
+{
+    output_batching_ = false;
+
+    if (output_buffer_.readableBytes() == 0) {
+        return;
+    }
+    output(output_buffer_);
+    output_buffer_.clear();
+}
+
 void HttpProtocol::Impl::setStartLineMaxSize(size_t size)
 {
     // single crlf
@@ -433,6 +969,23 @@ void HttpProtocol::Impl::setBodyMaxSize(size_t size)
     body_max_size_ = size;
 }
 
+void HttpProtocol::Impl::setHeaderTimeout(int64_t timeout_ms)
+{
+    if (timeout_ms < 0) {
+        return;
+    }
+    header_timeout_ms_ = timeout_ms;
+}
+
+bool HttpProtocol::Impl::isHeaderTimeout(const Timestamp &now) const
+{
+    if (header_timeout_ms_ <= 0 || !header_started_ || !isReadingHeader()) {
+        return false;
+    }
+
+    return header_start_time_.distanceMillisecond(now) >= header_timeout_ms_;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 HttpProtocol::HttpProtocol() :
     pimpl_(new Impl())
@@ -440,6 +993,7 @@ HttpProtocol::HttpProtocol() :
     setStartLineMaxSize();
     setHeaderMaxSize();
     setBodyMaxSize();
+    setHeaderTimeout();
 }
 
 HttpProtocol::~HttpProtocol()
@@ -461,6 +1015,21 @@ void HttpProtocol::setOutputCallback(const OutputCallback &output_cb)
     pimpl_->setOutputCallback(output_cb);
 }
 
+void HttpProtocol::setOutputVCallback(const OutputVCallback &outputv_cb)
+{
+    pimpl_->setOutputVCallback(outputv_cb);
+}
+
+void HttpProtocol::setBodyCallback(const BodyCallback &body_cb)
+{
+    pimpl_->setBodyCallback(body_cb);
+}
+
+void HttpProtocol::setHeadResponse(bool head_response)
+{
+    pimpl_->setHeadResponse(head_response);
+}
+
 HttpProtocol::RetCode HttpProtocol::recvMessage(DynamicBuffer *buffer)
 {
     return pimpl_->recvMessage(buffer);
@@ -481,6 +1050,38 @@ void HttpProtocol::sendMessage(const HttpMessage &message)
     pimpl_->sendMessage(message);
 }
 
+HttpProtocol::RetCode HttpProtocol::recvRequests(
+    DynamicBuffer *buffer, std::vector<HttpRequest> *requests,
+    size_t max_count)
+{
+    return pimpl_->recvRequests(buffer, requests, max_count);
+}
+
+void HttpProtocol::beginOutputBatch()
+{
+    pimpl_->beginOutputBatch();
+}
+
+void HttpProtocol::endOutputBatch()
+{
+    pimpl_->endOutputBatch();
+}
+
+void HttpProtocol::sendMessageHeader(const HttpMessage &message)
+{
+    pimpl_->sendMessageHeader(message);
+}
+
+void HttpProtocol::sendChunk(const char *buffer, size_t size)
+{
+    pimpl_->sendChunk(buffer, size);
+}
+
+void HttpProtocol::sendLastChunk()
+{
+    pimpl_->sendLastChunk();
+}
+
 void HttpProtocol::setStartLineMaxSize(size_t size)
 {
     pimpl_->setStartLineMaxSize(size);
@@ -496,65 +1097,140 @@ void HttpProtocol::setBodyMaxSize(size_t size)
     pimpl_->setBodyMaxSize(size);
 }
 
+void HttpProtocol::setHeaderTimeout(int64_t timeout_ms)
+{
+    pimpl_->setHeaderTimeout(timeout_ms);
+}
+
+bool HttpProtocol::isHeaderTimeout(const Timestamp &now) const
+{
+    return pimpl_->isHeaderTimeout(now);
+}
+
 void HttpProtocol::writeMessage(const HttpMessage &message,
                                 DynamicBuffer *buffer)
 {
-    int count = 0;
+    writeMessageHeader(message, buffer);
+
+    // body
+    buffer->reserveWritableBytes(message.getBody().size());
+    ::memcpy(buffer->writeBegin(), message.getBody().data(),
+        message.getBody().size());
+    buffer->write(message.getBody().size());
+}
+
+void HttpProtocol::writeMessageHeader(const HttpMessage &message,
+                                      DynamicBuffer *buffer)
+{
+    const std::string &version =
+        HttpMessage::VersionEnumToStr(message.getVersion());
+    const HttpMessage::HeaderMap &headers = message.getHeaders();
+
+    // compute the size first to reserve the buffer once
+    size_t size = 2;
+    for (HttpMessage::HeaderMap::const_iterator iter = headers.begin();
+         iter != headers.end(); ++iter) {
+        size += iter->first.size() + 2 + iter->second.size() + 2;
+    }
+
+    const HttpRequest *request = nullptr;
+    const HttpResponse *response = nullptr;
+    const StatusLine *status_line = nullptr;
 
     // start line
     if (message.getMessageType() == HttpMessage::MessageType::REQUEST) {
-        const HttpRequest &request =
-            static_cast<const HttpRequest &>(message);
-
-        buffer->reserveWritableBytes(64 + request.getRequestUri().size());
-        count = ::snprintf(buffer->writeBegin(), buffer->writableBytes(),
-            "%s %s %s\r\n",
-            HttpRequest::MethodEnumToStr(request.getMethod()).c_str(),
-            request.getRequestUri().c_str(),
-            HttpMessage::VersionEnumToStr(request.getVersion()).c_str());
-        if (count > 0) {
-            buffer->write(count);
-        }
+        request = static_cast<const HttpRequest *>(&message);
+        size += HttpRequest::MethodEnumToStr(request->getMethod()).size() +
+                1 + request->getRequestUri().size() + 1 + version.size() + 2;
 
     } else if (message.getMessageType() ==
                HttpMessage::MessageType::RESPONSE) {
-        const HttpResponse &response =
-            static_cast<const HttpResponse &>(message);
-
-        buffer->reserveWritableBytes(64 + response.getReasonPhrase().size());
-        count = ::snprintf(buffer->writeBegin(), buffer->writableBytes(),
-            "%s %d %s\r\n",
-            HttpMessage::VersionEnumToStr(response.getVersion()).c_str(),
-            response.getStatusCode(),
-            response.getReasonPhrase().c_str());
-        if (count > 0) {
-            buffer->write(count);
+        response = static_cast<const HttpResponse *>(&message);
+        if (response->getVersion() == HttpMessage::Version::HTTP_1_1) {
+            status_line = findStatusLine(response->getStatusCode(),
+                                         response->getReasonPhrase());
+        }
+        if (status_line != nullptr) {
+            size += status_line->line_size;
+        } else {
+            size += version.size() + 1 + s_max_integer_size + 1 +
+                    response->getReasonPhrase().size() + 2;
         }
     } else {
         return;
     }
 
+    buffer->reserveWritableBytes(size);
+    BufferWriter writer(buffer->writeBegin());
+
+    if (request != nullptr) {
+        writer.append(HttpRequest::MethodEnumToStr(request->getMethod()));
+        writer.append(' ');
+        writer.append(request->getRequestUri());
+        writer.append(' ');
+        writer.append(version);
+        writer.append("\r\n", 2);
+    } else if (status_line != nullptr) {
+        writer.append(status_line->line, status_line->line_size);
+    } else {
+        writer.append(version);
+        writer.append(' ');
+        writer.appendDecimal(response->getStatusCode());
+        writer.append(' ');
+        writer.append(response->getReasonPhrase());
+        writer.append("\r\n", 2);
+    }
+
     // header
-    for (HttpMessage::HeaderMap::const_iterator iter =
-             message.getHeaders().begin();
-         iter != message.getHeaders().end(); ++iter) {
-        buffer->reserveWritableBytes(
-            32 + iter->first.size() + iter->second.size());
-        count = ::snprintf(buffer->writeBegin(), buffer->writableBytes(),
-            "%s: %s\r\n", iter->first.c_str(), iter->second.c_str());
-        if (count > 0) {
-            buffer->write(count);
-        }
+    for (HttpMessage::HeaderMap::const_iterator iter = headers.begin();
+         iter != headers.end(); ++iter) {
+        writer.append(iter->first);
+        writer.append(": ", 2);
+        writer.append(iter->second);
+        writer.append("\r\n", 2);
     }
-    buffer->reserveWritableBytes(2);
-    ::snprintf(buffer->writeBegin(), buffer->writableBytes(), "\r\n");
-    buffer->write(2);
+    writer.append("\r\n", 2);
 
-    // body
-    buffer->reserveWritableBytes(message.getBody().size());
-    ::memcpy(buffer->writeBegin(), message.getBody().data(),
-        message.getBody().size());
-    buffer->write(message.getBody().size());
+    buffer->write(writer.size(buffer->writeBegin()));
+}
+
+int HttpProtocol::writeMessageV(const HttpMessage &message,
+                                DynamicBuffer *header_buffer,
+                                struct iovec *buffers)
+{
+    size_t header_begin = header_buffer->readableBytes();
+    writeMessageHeader(message, header_buffer);
+
+    buffers[0].iov_base = (void *)(header_buffer->readBegin() + header_begin);
+    buffers[0].iov_len = header_buffer->readableBytes() - header_begin;
+    if (message.getBody().empty()) {
+        return 1;
+    }
+    buffers[1].iov_base = (void *)message.getBody().data();
+    buffers[1].iov_len = message.getBody().size();
+
+    return 2;
+}
+
+void HttpProtocol::writeChunk(const char *chunk, size_t size,
+                              DynamicBuffer *buffer)
+{
+    if (0 == size) {
+        return;
+    }
+
+    buffer->reserveWritableBytes(s_max_integer_size + 2 + size + 2);
+    BufferWriter writer(buffer->writeBegin());
+    writer.appendHex(size);
+    writer.append("\r\n", 2);
+    writer.append(chunk, size);
+    writer.append("\r\n", 2);
+    buffer->write(writer.size(buffer->writeBegin()));
+}
+
+void HttpProtocol::writeLastChunk(DynamicBuffer *buffer)
+{
+    buffer->writeBytes("0\r\n\r\n", 5);
 }
 
 } // namespace brickred::protocol
@@ -2,16 +2,21 @@
 #define BRICKRED_PROTOCOL_HTTP_PROTOCOL_H
 
 #include <cstddef>
+#include <cstdint>
+#include <vector>
 
 #include <brickred/class_util.h>
 #include <brickred/function.h>
 #include <brickred/unique_ptr.h>
 
 namespace brickred { class DynamicBuffer; }
+namespace brickred { class Timestamp; }
 namespace brickred::protocol { class HttpMessage; }
 namespace brickred::protocol { class HttpRequest; }
 namespace brickred::protocol { class HttpResponse; }
 
+struct iovec;
+
 namespace brickred::protocol {
 
 class HttpProtocol {
@@ -32,7 +37,19 @@ public:
         MESSAGE_READY = 1
     };
 
+    enum class BodyEvent {
+        HEADER_COMPLETE = 0,
+        DATA,
+        END
+    };
+
     using OutputCallback = Function<void (const char *, size_t)>;
+    using OutputVCallback = Function<void (const struct iovec *, int)>;
+    // message is the message being received without body,
+    // data and size are only used by DATA event
+    using BodyCallback = Function<void (BodyEvent event,
+                                        const HttpMessage &message,
+                                        const char *data, size_t size)>;
 
     HttpProtocol();
     ~HttpProtocol();
@@ -41,18 +58,66 @@ public:
     Status getStatus() const;
 
     void setOutputCallback(const OutputCallback &output_cb);
+    // if set, sendMessage() passes the header and the body as two
+    // buffers instead of copying them together (except in output batch),
+    // other output is passed as one buffer if output callback is not set
+    void setOutputVCallback(const OutputVCallback &outputv_cb);
+    // streaming body mode, body is passed to body_cb as it arrives
+    // instead of buffered in message (body max size is not applied),
+    // recvMessage() still returns MESSAGE_READY after END event
+    void setBodyCallback(const BodyCallback &body_cb);
+    // the response being received answers a HEAD request, its body is
+    // not read even if it has Content-Length, not cleared by reset()
+    void setHeadResponse(bool head_response);
 
     RetCode recvMessage(DynamicBuffer *buffer);
     bool retrieveRequest(HttpRequest *request);
     bool retrieveResponse(HttpResponse *response);
     void sendMessage(const HttpMessage &message);
 
+    // parse all complete (pipelined) requests in the buffer and append
+    // them to requests, at most max_count, returns MESSAGE_READY if
+    // any request is appended, an error after them is returned as ERROR
+    // by the next call
+    RetCode recvRequests(DynamicBuffer *buffer,
+                         std::vector<HttpRequest> *requests,
+                         size_t max_count = 64);
+    // messages sent between beginOutputBatch() and endOutputBatch() are
+    // passed to output (or outputv) callback in one call by
+    // endOutputBatch()
+    void beginOutputBatch();
+    void endOutputBatch();
+
+    // streaming chunked message, the message should have header
+    // Transfer-Encoding: chunked, its body is not sent
+    void sendMessageHeader(const HttpMessage &message);
+    void sendChunk(const char *buffer, size_t size);
+    void sendLastChunk();
+
     void setStartLineMaxSize(size_t size = 8 * 1024);
     void setHeaderMaxSize(size_t size = 32 * 1024);
     void setBodyMaxSize(size_t size = 1024 * 1024);
+    // the start line and headers must be received in timeout_ms
+    // from the first byte of the message, 0 means no limit,
+    // recvMessage() returns ERROR when it is exceeded, call
+    // isHeaderTimeout() in a timer to catch the peer which sends nothing
+    void setHeaderTimeout(int64_t timeout_ms = 0);
+    bool isHeaderTimeout(const Timestamp &now) const;
 
     static void writeMessage(const HttpMessage &message,
                              DynamicBuffer *buffer);
+    // start line and headers are appended to header_buffer, buffers[0]
+    // points to them and buffers[1] points to the body of message,
+    // return the buffer count (1 if no body)
+    static int writeMessageV(const HttpMessage &message,
+                             DynamicBuffer *header_buffer,
+                             struct iovec *buffers);
+    // start line and headers
+    static void writeMessageHeader(const HttpMessage &message,
+                                   DynamicBuffer *buffer);
+    static void writeChunk(const char *chunk, size_t size,
+                           DynamicBuffer *buffer);
+    static void writeLastChunk(DynamicBuffer *buffer);
 
 private:
     BRICKRED_NONCOPYABLE(HttpProtocol)
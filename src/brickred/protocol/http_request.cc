@@ -1,12 +1,24 @@
 #include <brickred/protocol/http_request.h>
 
+#include <cstring>
 #include <utility>
 
 namespace brickred::protocol {
 
-static const std::string s_cstr_get("GET");
-static const std::string s_cstr_post("POST");
-static const std::string s_cstr_unknown("UNKNOWN");
+static const std::string s_method_strs[] = {
+    "UNKNOWN",
+    "GET",
+    "POST",
+    "PUT",
+    "DELETE",
+    "HEAD",
+    "OPTIONS",
+    "PATCH",
+};
+
+static_assert(sizeof(s_method_strs) / sizeof(s_method_strs[0]) ==
+              (size_t)HttpRequest::Method::MAX,
+              "method string table size mismatch");
 
 HttpRequest::HttpRequest() :
     method_(Method::UNKNOWN)
@@ -38,25 +50,58 @@ void HttpRequest::setRequestUri(const std::string &request_uri)
 HttpRequest::Method HttpRequest::MethodStrToEnum(
     const std::string &method_str)
 {
-    if (method_str == s_cstr_get) {
-        return Method::GET;
-    } else if (method_str == s_cstr_post) {
-        return Method::POST;
-    } else {
+    return MethodStrToEnum(method_str.data(), method_str.size());
+}
+
+// dispatch on the length and the first byte, then one memcmp
+HttpRequest::Method HttpRequest::MethodStrToEnum(
+    const char *method_str, size_t size)
+{
+    Method method = Method::UNKNOWN;
+
+    switch (size) {
+    case 3:
+        if ('G' == method_str[0]) {
+            method = Method::GET;
+        } else if ('P' == method_str[0]) {
+            method = Method::PUT;
+        }
+        break;
+    case 4:
+        if ('P' == method_str[0]) {
+            method = Method::POST;
+        } else if ('H' == method_str[0]) {
+            method = Method::HEAD;
+        }
+        break;
+    case 5:
+        method = Method::PATCH;
+        break;
+    case 6:
+        method = Method::DELETE;
+        break;
+    case 7:
+        method = Method::OPTIONS;
+        break;
+    default:
         return Method::UNKNOWN;
     }
+
+    if (method != Method::UNKNOWN &&
+        ::memcmp(method_str, s_method_strs[(int)method].data(), size) == 0) {
+        return method;
+    }
+
+    return Method::UNKNOWN;
 }
 
 const std::string &HttpRequest::MethodEnumToStr(Method method_enum)
 {
-
-    if (Method::GET == method_enum) {
-        return s_cstr_get;
-    } else if (Method::POST == method_enum) {
-        return s_cstr_post;
-    } else {
-        return s_cstr_unknown;
+    if (method_enum <= Method::UNKNOWN || method_enum >= Method::MAX) {
+        return s_method_strs[0];
     }
+
+    return s_method_strs[(int)method_enum];
 }
 
 } // namespace brickred::protocol
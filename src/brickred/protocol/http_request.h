@@ -1,6 +1,7 @@
 #ifndef BRICKRED_PROTOCOL_HTTP_REQUEST_H
 #define BRICKRED_PROTOCOL_HTTP_REQUEST_H
 
+#include <cstddef>
 #include <string>
 
 #include <brickred/protocol/http_message.h>
@@ -12,7 +13,13 @@ public:
     enum class Method {
         UNKNOWN = 0,
         GET,
-        POST
+        POST,
+        PUT,
+        DELETE,
+        HEAD,
+        OPTIONS,
+        PATCH,
+        MAX
     };
 
     HttpRequest();
@@ -26,6 +33,7 @@ public:
     void setRequestUri(const std::string &request_uri);
 
     static Method MethodStrToEnum(const std::string &method_str);
+    static Method MethodStrToEnum(const char *method_str, size_t size);
     static const std::string &MethodEnumToStr(Method method_enum);
 
 private:
@@ -0,0 +1,330 @@
+#include <brickred/protocol/http_request_view.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include <brickred/string_util.h>
+
+namespace brickred::protocol {
+
+namespace {
+
+bool caseInsensitiveEqual(const char *lhs, size_t lhs_length,
+                          const char *rhs, size_t rhs_length)
+{
+    if (lhs_length != rhs_length) {
+        return false;
+    }
+    for (size_t i = 0; i < lhs_length; ++i) {
+        // only used for header names and tokens, ascii is enough
+        if ((lhs[i] | 0x20) != (rhs[i] | 0x20)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool caseInsensitiveContain(const char *str, size_t length,
+                            const char *keyword, size_t keyword_length)
+{
+    for (size_t i = 0; i + keyword_length <= length; ++i) {
+        if (caseInsensitiveEqual(str + i, keyword_length,
+                                 keyword, keyword_length)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+HttpRequestView::HttpRequestView() :
+    buffer_(nullptr),
+    header_max_size_(0)
+{
+    reset();
+    setHeaderMaxSize();
+}
+
+HttpRequestView::~HttpRequestView()
+{
+}
+
+void HttpRequestView::reset()
+{
+    buffer_ = nullptr;
+    method_ = HttpRequest::Method::UNKNOWN;
+    version_ = HttpMessage::Version::UNKNOWN;
+    method_str_ = Slice();
+    request_uri_ = Slice();
+    header_count_ = 0;
+    content_length_ = -1;
+    chunked_ = false;
+    keep_alive_ = false;
+    header_size_ = 0;
+    body_ = Slice();
+}
+
+void HttpRequestView::setHeaderMaxSize(size_t size)
+{
+    // double crlf
+    if (size < 4) {
+        return;
+    }
+    header_max_size_ = size;
+}
+
+HttpRequestView::Header HttpRequestView::getHeader(size_t index) const
+{
+    Header header;
+    if (index < header_count_) {
+        header.name = view(headers_[index][0]);
+        header.value = view(headers_[index][1]);
+    }
+
+    return header;
+}
+
+std::string_view HttpRequestView::getHeader(std::string_view name) const
+{
+    for (size_t i = 0; i < header_count_; ++i) {
+        if (caseInsensitiveEqual(buffer_ + headers_[i][0].offset,
+                                 headers_[i][0].length,
+                                 name.data(), name.size())) {
+            return view(headers_[i][1]);
+        }
+    }
+
+    return std::string_view();
+}
+
+bool HttpRequestView::hasHeader(std::string_view name) const
+{
+    for (size_t i = 0; i < header_count_; ++i) {
+        if (caseInsensitiveEqual(buffer_ + headers_[i][0].offset,
+                                 headers_[i][0].length,
+                                 name.data(), name.size())) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+HttpRequestView::RetCode HttpRequestView::parse(
+    const char *buffer, size_t size)
+{
+    reset();
+    buffer_ = buffer;
+
+    // the header block is at most header_max_size_ bytes
+    const char *end = buffer + std::min(size, header_max_size_);
+    const char *next = nullptr;
+
+    int ret = parseStartLine(end, &next);
+    if (ret > 0) {
+        ret = parseHeaders(next, end, &next);
+    }
+    if (ret < 0) {
+        return RetCode::ERROR;
+    } else if (0 == ret) {
+        // exceed max size
+        if (size >= header_max_size_) {
+            return RetCode::ERROR;
+        }
+        return RetCode::WAITING_MORE_DATA;
+    }
+    header_size_ = next - buffer;
+
+    // content-length with chunked can be framed differently by another
+    // parser on the way, reject it (rfc 7230 3.3.3)
+    if (chunked_ && content_length_ >= 0) {
+        return RetCode::ERROR;
+    }
+
+    if (content_length_ > 0) {
+        if (size - header_size_ < (uint64_t)content_length_) {
+            return RetCode::WAITING_MORE_DATA;
+        }
+        body_ = slice(next, content_length_);
+    }
+
+    return RetCode::MESSAGE_READY;
+}
+
+// return 1 if finished, 0 if need more data, -1 if error
+int HttpRequestView::parseStartLine(const char *end, const char **next)
+{
+    // method
+    const char *p = buffer_;
+    const char *method_end = p;
+    while (method_end < end && *method_end != ' ') {
+        if (*method_end < 'A' || *method_end > 'Z') {
+            return -1;
+        }
+        ++method_end;
+    }
+    if (method_end >= end) {
+        return 0;
+    }
+    if (method_end == p) {
+        return -1;
+    }
+    method_str_ = slice(p, method_end - p);
+    method_ = HttpRequest::MethodStrToEnum(p, method_end - p);
+    if (HttpRequest::Method::UNKNOWN == method_) {
+        return -1;
+    }
+
+    // request uri
+    p = method_end + 1;
+    const char *uri_end = string_util::findFirstOf(p, end - p, ' ', '\r');
+    if (nullptr == uri_end) {
+        return 0;
+    }
+    if (uri_end == p || *uri_end != ' ') {
+        return -1;
+    }
+    request_uri_ = slice(p, uri_end - p);
+
+    // version
+    p = uri_end + 1;
+    if (end - p < 10) {
+        size_t length = std::min((size_t)(end - p), (size_t)7);
+        return (::memcmp(p, "HTTP/1.", length) == 0) ? 0 : -1;
+    }
+    if (::memcmp(p, "HTTP/1.", 7) != 0 || p[8] != '\r' || p[9] != '\n') {
+        return -1;
+    }
+    if ('1' == p[7]) {
+        version_ = HttpMessage::Version::HTTP_1_1;
+        keep_alive_ = true;
+    } else if ('0' == p[7]) {
+        version_ = HttpMessage::Version::HTTP_1_0;
+        keep_alive_ = false;
+    } else {
+        return -1;
+    }
+
+    *next = p + 10;
+    return 1;
+}
+
+// return 1 if finished, 0 if need more data, -1 if error
+int HttpRequestView::parseHeaders(const char *begin, const char *end,
+                                  const char **next)
+{
+    const char *p = begin;
+
+    for (;;) {
+        if (end - p < 2) {
+            return 0;
+        }
+        // end of headers
+        if ('\r' == p[0]) {
+            if (p[1] != '\n') {
+                return -1;
+            }
+            *next = p + 2;
+            return 1;
+        }
+
+        // header name
+        const char *colon = string_util::findFirstOf(p, end - p, ':', '\r');
+        if (nullptr == colon) {
+            return 0;
+        }
+        if (colon == p || *colon != ':') {
+            return -1;
+        }
+        const char *name = p;
+        size_t name_length = colon - p;
+        if (' ' == name[name_length - 1] || '\t' == name[name_length - 1] ||
+            ::memchr(name, '\n', name_length) != nullptr) {
+            return -1;
+        }
+
+        // header value, bare lf may hide another header from a parser
+        // which ends the line at lf, so it is rejected
+        const char *value = colon + 1;
+        const char *cr =
+            string_util::findFirstOf(value, end - value, '\r', '\n');
+        if (nullptr == cr) {
+            return 0;
+        }
+        if (*cr != '\r') {
+            return -1;
+        }
+        if (end - cr < 2) {
+            return 0;
+        }
+        if (cr[1] != '\n') {
+            return -1;
+        }
+        const char *value_end = cr;
+        while (value < value_end && (' ' == *value || '\t' == *value)) {
+            ++value;
+        }
+        while (value_end > value &&
+               (' ' == value_end[-1] || '\t' == value_end[-1])) {
+            --value_end;
+        }
+
+        if (addHeader(name, name_length, value, value_end - value) == false) {
+            return -1;
+        }
+
+        p = cr + 2;
+    }
+}
+
+bool HttpRequestView::addHeader(const char *name, size_t name_length,
+                                const char *value, size_t value_length)
+{
+    if (header_count_ >= s_max_header_count) {
+        return false;
+    }
+    headers_[header_count_][0] = slice(name, name_length);
+    headers_[header_count_][1] = slice(value, value_length);
+    ++header_count_;
+
+    // headers the parser needs to know
+    if (caseInsensitiveEqual(name, name_length, "Content-Length", 14)) {
+        if (0 == value_length || value_length > 18) {
+            return false;
+        }
+        int64_t content_length = 0;
+        for (size_t i = 0; i < value_length; ++i) {
+            if (value[i] < '0' || value[i] > '9') {
+                return false;
+            }
+            content_length = content_length * 10 + (value[i] - '0');
+        }
+        // repeated content-length must be the same (rfc 7230 3.3.2)
+        if (content_length_ >= 0 && content_length_ != content_length) {
+            return false;
+        }
+        content_length_ = content_length;
+
+    } else if (caseInsensitiveEqual(name, name_length,
+                                    "Transfer-Encoding", 17)) {
+        if (caseInsensitiveContain(value, value_length, "chunked", 7)) {
+            chunked_ = true;
+        }
+
+    } else if (caseInsensitiveEqual(name, name_length, "Connection", 10)) {
+        if (caseInsensitiveContain(value, value_length, "close", 5)) {
+            keep_alive_ = false;
+        } else if (caseInsensitiveContain(value, value_length,
+                                          "keep-alive", 10)) {
+            keep_alive_ = true;
+        }
+    }
+
+    return true;
+}
+
+} // namespace brickred::protocol
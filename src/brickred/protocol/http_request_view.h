@@ -0,0 +1,110 @@
+#ifndef BRICKRED_PROTOCOL_HTTP_REQUEST_VIEW_H
+#define BRICKRED_PROTOCOL_HTTP_REQUEST_VIEW_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include <brickred/class_util.h>
+#include <brickred/protocol/http_message.h>
+#include <brickred/protocol/http_request.h>
+
+namespace brickred::protocol {
+
+// allocation free http request parser, the start line and headers are
+// kept in the caller's buffer and exposed as views, the views are valid
+// until the buffer is modified
+class HttpRequestView final {
+public:
+    enum class RetCode {
+        ERROR = -1,
+        WAITING_MORE_DATA = 0,
+        MESSAGE_READY = 1
+    };
+
+    struct Header {
+        std::string_view name;
+        std::string_view value;
+    };
+
+    HttpRequestView();
+    ~HttpRequestView();
+    void reset();
+
+    // parse the request in [buffer, buffer + size), MESSAGE_READY means
+    // the header block and the content-length body are all received,
+    // chunked body is not parsed, check isChunked() and use HttpProtocol,
+    // bare lf in headers, different content-length values and
+    // content-length with chunked return ERROR
+    RetCode parse(const char *buffer, size_t size);
+
+    HttpRequest::Method getMethod() const { return method_; }
+    HttpMessage::Version getVersion() const { return version_; }
+    std::string_view getMethodString() const { return view(method_str_); }
+    std::string_view getRequestUri() const { return view(request_uri_); }
+
+    size_t getHeaderCount() const { return header_count_; }
+    Header getHeader(size_t index) const;
+    // case insensitive, return empty view if not found
+    std::string_view getHeader(std::string_view name) const;
+    bool hasHeader(std::string_view name) const;
+
+    // -1 if no content-length header
+    int64_t getContentLength() const { return content_length_; }
+    bool isChunked() const { return chunked_; }
+    bool isConnectionKeepAlive() const { return keep_alive_; }
+    std::string_view getBody() const { return view(body_); }
+
+    // size of start line and headers
+    size_t getHeaderSize() const { return header_size_; }
+    // header size + body size, read it from the buffer after handling
+    size_t getMessageSize() const { return header_size_ + body_.length; }
+
+    // exceed size returns ERROR
+    void setHeaderMaxSize(size_t size = 32 * 1024);
+
+    static const size_t s_max_header_count = 64;
+
+private:
+    BRICKRED_NONCOPYABLE(HttpRequestView)
+
+    struct Slice {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    std::string_view view(const Slice &slice) const
+    {
+        return std::string_view(buffer_ + slice.offset, slice.length);
+    }
+
+    int parseStartLine(const char *end, const char **next);
+    int parseHeaders(const char *begin, const char *end,
+                     const char **next);
+    bool addHeader(const char *name, size_t name_length,
+                   const char *value, size_t value_length);
+    Slice slice(const char *begin, size_t length) const
+    {
+        Slice s = { (uint32_t)(begin - buffer_), (uint32_t)length };
+        return s;
+    }
+
+private:
+    const char *buffer_;
+    size_t header_max_size_;
+    HttpRequest::Method method_;
+    HttpMessage::Version version_;
+    Slice method_str_;
+    Slice request_uri_;
+    Slice headers_[s_max_header_count][2];
+    size_t header_count_;
+    int64_t content_length_;
+    bool chunked_;
+    bool keep_alive_;
+    size_t header_size_;
+    Slice body_;
+};
+
+} // namespace brickred::protocol
+
+#endif
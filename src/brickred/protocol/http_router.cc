@@ -0,0 +1,286 @@
+#include <brickred/protocol/http_router.h>
+
+#include <cstring>
+
+namespace brickred::protocol {
+
+std::string_view HttpRouter::Params::get(std::string_view name) const
+{
+    for (size_t i = 0; i < count_; ++i) {
+        if (params_[i].name == name) {
+            return params_[i].value;
+        }
+    }
+
+    return std::string_view();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+HttpRouter::Node::Node() :
+    param_child(-1),
+    prefix_child(-1)
+{
+}
+
+HttpRouter::HttpRouter()
+{
+    // root
+    newNode();
+}
+
+HttpRouter::~HttpRouter()
+{
+}
+
+int HttpRouter::newNode()
+{
+    nodes_.emplace_back();
+    return nodes_.size() - 1;
+}
+
+bool HttpRouter::checkPattern(std::string_view pattern)
+{
+    if (pattern.empty() || pattern[0] != '/') {
+        return false;
+    }
+
+    size_t param_count = 0;
+    for (size_t i = 1; i < pattern.size(); ++i) {
+        char c = pattern[i];
+        if (c != ':' && c != '*') {
+            continue;
+        }
+        // param and prefix take a whole segment
+        if (pattern[i - 1] != '/') {
+            return false;
+        }
+        if (++param_count > Params::s_max_param_count) {
+            return false;
+        }
+
+        size_t end = pattern.find('/', i);
+        if (std::string_view::npos == end) {
+            end = pattern.size();
+        } else if ('*' == c) {
+            // prefix must be the last segment
+            return false;
+        }
+        std::string_view name = pattern.substr(i + 1, end - i - 1);
+        if (':' == c && name.empty()) {
+            return false;
+        }
+        if (name.find_first_of(":*") != std::string_view::npos) {
+            return false;
+        }
+        i = end;
+    }
+
+    return true;
+}
+
+// return the node after part is consumed
+int HttpRouter::insertStatic(int node_index, std::string_view part)
+{
+    while (part.empty() == false) {
+        // nodes_ may be reallocated by newNode(), use index only
+        const std::string &indices = nodes_[node_index].indices;
+        const char *p = (const char *)::memchr(
+            indices.data(), part[0], indices.size());
+        if (nullptr == p) {
+            int child = newNode();
+            nodes_[child].prefix = part;
+            nodes_[node_index].indices.push_back(part[0]);
+            nodes_[node_index].children.push_back(child);
+            return child;
+        }
+
+        size_t i = p - indices.data();
+        int child = nodes_[node_index].children[i];
+        const std::string &prefix = nodes_[child].prefix;
+        size_t common = 0;
+        while (common < prefix.size() && common < part.size() &&
+               prefix[common] == part[common]) {
+            ++common;
+        }
+
+        if (common < prefix.size()) {
+            // split the child at the common prefix
+            int split = newNode();
+            Node &split_node = nodes_[split];
+            Node &child_node = nodes_[child];
+            split_node.prefix = child_node.prefix.substr(0, common);
+            child_node.prefix.erase(0, common);
+            split_node.indices.push_back(child_node.prefix[0]);
+            split_node.children.push_back(child);
+            nodes_[node_index].children[i] = split;
+            child = split;
+        }
+
+        node_index = child;
+        part.remove_prefix(common);
+    }
+
+    return node_index;
+}
+
+bool HttpRouter::addRoute(HttpRequest::Method method,
+                          std::string_view pattern, const Handler &handler)
+{
+    if (method <= HttpRequest::Method::UNKNOWN ||
+        method >= HttpRequest::Method::MAX) {
+        return false;
+    }
+    if (checkPattern(pattern) == false) {
+        return false;
+    }
+
+    int node_index = 0;
+    size_t pos = 0;
+
+    while (pos < pattern.size()) {
+        char c = pattern[pos];
+
+        if (':' == c || '*' == c) {
+            size_t end = (':' == c) ? pattern.find('/', pos) : pattern.size();
+            if (std::string_view::npos == end) {
+                end = pattern.size();
+            }
+            std::string_view name = pattern.substr(pos + 1, end - pos - 1);
+
+            int child = (':' == c) ? nodes_[node_index].param_child
+                                   : nodes_[node_index].prefix_child;
+            if (-1 == child) {
+                child = newNode();
+                nodes_[child].name = name;
+                if (':' == c) {
+                    nodes_[node_index].param_child = child;
+                } else {
+                    nodes_[node_index].prefix_child = child;
+                }
+            } else if (nodes_[child].name != name) {
+                // /users/:id and /users/:name can not be told apart
+                return false;
+            }
+            node_index = child;
+            pos = end;
+
+        } else {
+            size_t end = pattern.find_first_of(":*", pos);
+            if (std::string_view::npos == end) {
+                end = pattern.size();
+            }
+            node_index = insertStatic(node_index,
+                                      pattern.substr(pos, end - pos));
+            pos = end;
+        }
+    }
+
+    Handler &node_handler = nodes_[node_index].handlers[(int)method];
+    if (node_handler) {
+        return false;
+    }
+    node_handler = handler;
+
+    return true;
+}
+
+// the prefix of node has already been consumed
+bool HttpRouter::match(int node_index, HttpRequest::Method method,
+                       const char *path, size_t size,
+                       Params *params, const Handler **handler) const
+{
+    const Node &node = nodes_[node_index];
+
+    if (0 == size) {
+        if (node.handlers[(int)method]) {
+            *handler = &node.handlers[(int)method];
+            return true;
+        }
+    } else {
+        // static child, at most one starts with the byte
+        const char *p = (const char *)::memchr(
+            node.indices.data(), path[0], node.indices.size());
+        if (p != nullptr) {
+            int child = node.children[p - node.indices.data()];
+            const std::string &prefix = nodes_[child].prefix;
+            if (prefix.size() <= size &&
+                ::memcmp(prefix.data(), path, prefix.size()) == 0 &&
+                match(child, method, path + prefix.size(),
+                      size - prefix.size(), params, handler)) {
+                return true;
+            }
+        }
+
+        // param child takes one segment
+        if (node.param_child != -1) {
+            const char *slash = (const char *)::memchr(path, '/', size);
+            size_t segment_size = (nullptr == slash) ? size : slash - path;
+            if (segment_size > 0) {
+                size_t count = params->count_;
+                params->params_[count].name = nodes_[node.param_child].name;
+                params->params_[count].value =
+                    std::string_view(path, segment_size);
+                params->count_ = count + 1;
+                if (match(node.param_child, method, path + segment_size,
+                          size - segment_size, params, handler)) {
+                    return true;
+                }
+                params->count_ = count;
+            }
+        }
+    }
+
+    // prefix child takes the rest
+    if (node.prefix_child != -1) {
+        const Node &prefix_node = nodes_[node.prefix_child];
+        if (prefix_node.handlers[(int)method]) {
+            size_t count = params->count_;
+            params->params_[count].name = prefix_node.name;
+            params->params_[count].value = std::string_view(path, size);
+            params->count_ = count + 1;
+            *handler = &prefix_node.handlers[(int)method];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+const HttpRouter::Handler *HttpRouter::find(
+    HttpRequest::Method method, std::string_view path, Params *params) const
+{
+    if (method <= HttpRequest::Method::UNKNOWN ||
+        method >= HttpRequest::Method::MAX) {
+        return nullptr;
+    }
+
+    const Handler *handler = nullptr;
+    params->count_ = 0;
+    if (match(0, method, path.data(), path.size(), params, &handler)) {
+        return handler;
+    }
+    params->count_ = 0;
+
+    return nullptr;
+}
+
+bool HttpRouter::dispatch(const HttpRequest &request) const
+{
+    const std::string &request_uri = request.getRequestUri();
+    size_t path_size = request_uri.find('?');
+    if (std::string::npos == path_size) {
+        path_size = request_uri.size();
+    }
+
+    Params params;
+    const Handler *handler = find(request.getMethod(),
+        std::string_view(request_uri.data(), path_size), &params);
+    if (nullptr == handler) {
+        return false;
+    }
+    (*handler)(request, params);
+
+    return true;
+}
+
+} // namespace brickred::protocol
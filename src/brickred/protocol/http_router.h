@@ -0,0 +1,96 @@
+#ifndef BRICKRED_PROTOCOL_HTTP_ROUTER_H
+#define BRICKRED_PROTOCOL_HTTP_ROUTER_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <brickred/class_util.h>
+#include <brickred/function.h>
+#include <brickred/protocol/http_request.h>
+
+namespace brickred::protocol {
+
+// routes are compiled into a radix tree, a path is matched in
+// O(path length) without allocation
+//   static:  /users/list
+//   param:   /users/:id/profile   (one whole segment)
+//   prefix:  /static/*path        (the rest of the path, name is optional)
+// static segments take priority over params, params over prefixes
+class HttpRouter final {
+public:
+    class Params {
+    public:
+        struct Param {
+            std::string_view name;
+            std::string_view value;
+        };
+
+        Params() : count_(0) {}
+
+        size_t size() const { return count_; }
+        const Param &operator[](size_t index) const { return params_[index]; }
+        // return empty view if not found
+        std::string_view get(std::string_view name) const;
+
+        static const size_t s_max_param_count = 16;
+
+    private:
+        friend class HttpRouter;
+
+        Param params_[s_max_param_count];
+        size_t count_;
+    };
+
+    using Handler = Function<void (const HttpRequest &, const Params &)>;
+
+    HttpRouter();
+    ~HttpRouter();
+
+    // return false if the pattern is invalid or conflicts with
+    // a registered route
+    bool addRoute(HttpRequest::Method method, std::string_view pattern,
+                  const Handler &handler);
+
+    // path should not contain the query string,
+    // return nullptr if no route matches
+    const Handler *find(HttpRequest::Method method, std::string_view path,
+                        Params *params) const;
+
+    // query string of the request uri is ignored,
+    // return false if no route matches
+    bool dispatch(const HttpRequest &request) const;
+
+private:
+    BRICKRED_NONCOPYABLE(HttpRouter)
+
+    struct Node {
+        // static part, compressed
+        std::string prefix;
+        // first byte of each static child, for memchr
+        std::string indices;
+        std::vector<int> children;
+        int param_child;
+        int prefix_child;
+        // name of param or prefix node
+        std::string name;
+        Handler handlers[(int)HttpRequest::Method::MAX];
+
+        Node();
+    };
+
+    static bool checkPattern(std::string_view pattern);
+    int newNode();
+    int insertStatic(int node_index, std::string_view part);
+    bool match(int node_index, HttpRequest::Method method,
+               const char *path, size_t size,
+               Params *params, const Handler **handler) const;
+
+private:
+    std::vector<Node> nodes_;
+};
+
+} // namespace brickred::protocol
+
+#endif
@@ -0,0 +1,749 @@
+#include <brickred/protocol/http_server.h>
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include <brickred/dynamic_buffer.h>
+#include <brickred/io_service.h>
+#include <brickred/socket_address.h>
+#include <brickred/tcp_socket.h>
+#include <brickred/thread.h>
+#include <brickred/timestamp.h>
+#include <brickred/protocol/http_protocol.h>
+#include <brickred/protocol/http_request.h>
+#include <brickred/protocol/http_response.h>
+
+namespace brickred::protocol {
+
+namespace {
+
+const char s_http_400[] =
+    "HTTP/1.1 400 Bad Request\r\n"
+    "Connection: close\r\n"
+    "Content-Length: 0\r\n\r\n";
+const char s_http_408[] =
+    "HTTP/1.1 408 Request Timeout\r\n"
+    "Connection: close\r\n"
+    "Content-Length: 0\r\n\r\n";
+
+// timeouts are checked and quit flag is polled in this interval
+const int s_tick_ms = 100;
+
+} // namespace
+
+class HttpServer::Impl {
+public:
+    using ConnectionId = HttpServer::ConnectionId;
+    using RequestCallback = HttpServer::RequestCallback;
+    using RequestCancelCallback = HttpServer::RequestCancelCallback;
+
+    class Reactor;
+
+    class Connection : public TcpService::Context {
+    public:
+        Connection(Reactor *reactor, TcpService::SocketId socket_id);
+        ~Connection() override;
+
+        void onOutput(const char *buffer, size_t size);
+
+        Reactor *reactor_;
+        TcpService::SocketId socket_id_;
+        HttpProtocol protocol_;
+        // the front one is being handled if handling_ is true
+        std::deque<HttpRequest> requests_;
+        int request_count_;
+        bool handling_;
+        bool counted_;
+        bool processing_;
+        bool bad_request_;
+        bool close_after_response_;
+        bool closing_;
+        bool reading_body_;
+        Timestamp last_active_time_;
+        Timestamp body_start_time_;
+    };
+
+    class Reactor {
+    public:
+        Reactor(Impl *server, int index);
+        ~Reactor();
+
+        void run();
+        void processRequests(Connection *conn);
+        // connection may be closed and deleted after this
+        void flushOutput(Connection *conn);
+
+    private:
+        void onTick(IOService::TimerId timer_id);
+        void onNewConnection(TcpService *service,
+                             TcpService::SocketId from_socket_id,
+                             TcpService::SocketId socket_id);
+        void onRecvMessage(TcpService *service,
+                           TcpService::SocketId socket_id,
+                           DynamicBuffer *buffer);
+        void onPeerClose(TcpService *service,
+                         TcpService::SocketId socket_id);
+        void onError(TcpService *service,
+                     TcpService::SocketId socket_id, int error);
+        void closeAfterSend(TcpService::SocketId socket_id);
+        void cancelRequest(Connection *conn);
+        void closeConnection(TcpService::SocketId socket_id);
+
+    public:
+        using ConnectionMap =
+            std::unordered_map<TcpService::SocketId, Connection *>;
+
+        Impl *server_;
+        int index_;
+        IOService io_service_;
+        // destroyed after tcp_service_ which deletes the connections
+        ConnectionMap connections_;
+        TcpService tcp_service_;
+        Thread thread_;
+        std::vector<HttpRequest> recv_requests_;
+        std::vector<TcpService::SocketId> expired_;
+    };
+
+public:
+    explicit Impl(HttpServer *thiz);
+    ~Impl();
+
+    void setRequestCallback(const RequestCallback &request_cb);
+    void setRequestCancelCallback(
+        const RequestCancelCallback &request_cancel_cb);
+    void setReactorCount(int count);
+    void setKeepAliveMaxRequests(int count);
+    void setKeepAliveTimeout(int timeout_ms);
+    void setHeaderTimeout(int timeout_ms);
+    void setBodyTimeout(int timeout_ms);
+    void setMaxConcurrentRequests(int count);
+    void setMaxPipelinedRequests(int count);
+    void setHeaderMaxSize(size_t size);
+    void setBodyMaxSize(size_t size);
+
+    bool listen(const SocketAddress &addr);
+    bool getListenAddress(SocketAddress *addr) const;
+    void run();
+    void quit();
+
+    int getReactorCount() const;
+    IOService *getIOService(int reactor_index) const;
+
+    bool sendResponse(ConnectionId conn_id, const HttpResponse &response);
+
+private:
+    HttpServer *thiz_;
+    RequestCallback request_cb_;
+    RequestCancelCallback request_cancel_cb_;
+    int reactor_count_;
+    int keepalive_max_requests_;
+    int keepalive_timeout_ms_;
+    int header_timeout_ms_;
+    int body_timeout_ms_;
+    int max_concurrent_requests_;
+    int max_pipelined_requests_;
+    size_t header_max_size_;
+    size_t body_max_size_;
+
+    TcpSocket listen_socket_;
+    std::vector<Reactor *> reactors_;
+    std::atomic<int> concurrent_requests_;
+    std::atomic<bool> quit_;
+    HttpResponse service_unavailable_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+HttpServer::Impl::Connection::Connection(Reactor *reactor,
+                                         TcpService::SocketId socket_id) :
+    reactor_(reactor), socket_id_(socket_id),
+    request_count_(0), handling_(false), counted_(false),
+    processing_(false), bad_request_(false),
+    close_after_response_(false), closing_(false), reading_body_(false)
+{
+    const Impl *server = reactor_->server_;
+    protocol_.setOutputCallback(BRICKRED_BIND_MEM_FUNC(
+        &Connection::onOutput, this));
+    protocol_.setHeaderMaxSize(server->header_max_size_);
+    protocol_.setBodyMaxSize(server->body_max_size_);
+    protocol_.setHeaderTimeout(server->header_timeout_ms_);
+    last_active_time_.setNow();
+
+    reactor_->connections_[socket_id_] = this;
+}
+
+HttpServer::Impl::Connection::~Connection()
+{
+    if (handling_ && counted_) {
+        --reactor_->server_->concurrent_requests_;
+    }
+    reactor_->connections_.erase(socket_id_);
+}
+
+void HttpServer::Impl::Connection::onOutput(const char *buffer, size_t size)
+{
+    // close is deferred to flushOutput(), the connection can not be
+    // deleted in the output callback of its own protocol
+    reactor_->tcp_service_.sendMessage(socket_id_, buffer, size);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+HttpServer::Impl::Reactor::Reactor(Impl *server, int index) :
+    server_(server), index_(index), tcp_service_(io_service_)
+{
+    tcp_service_.setNewConnectionCallback(BRICKRED_BIND_MEM_FUNC(
+        &Reactor::onNewConnection, this));
+    tcp_service_.setRecvMessageCallback(BRICKRED_BIND_MEM_FUNC(
+        &Reactor::onRecvMessage, this));
+    tcp_service_.setPeerCloseCallback(BRICKRED_BIND_MEM_FUNC(
+        &Reactor::onPeerClose, this));
+    tcp_service_.setErrorCallback(BRICKRED_BIND_MEM_FUNC(
+        &Reactor::onError, this));
+}
+
+HttpServer::Impl::Reactor::~Reactor()
+{
+}
+
+void HttpServer::Impl::Reactor::run()
+{
+    IOService::TimerId timer_id = io_service_.startTimer(s_tick_ms,
+        BRICKRED_BIND_MEM_FUNC(&Reactor::onTick, this));
+    io_service_.loop();
+    io_service_.stopTimer(timer_id);
+}
+
+void HttpServer::Impl::Reactor::onTick(IOService::TimerId timer_id)
+{
+    if (server_->quit_) {
+        io_service_.quit();
+        return;
+    }
+
+    Timestamp now;
+    now.setNow();
+
+    // connections waiting for the response are not checked
+    expired_.clear();
+    for (ConnectionMap::iterator iter = connections_.begin();
+         iter != connections_.end(); ++iter) {
+        Connection *conn = iter->second;
+        if (conn->handling_ || conn->closing_) {
+            continue;
+        }
+
+        bool timeout = conn->protocol_.isHeaderTimeout(now) ||
+            (conn->reading_body_ && server_->body_timeout_ms_ > 0 &&
+             now.distanceMillisecond(conn->body_start_time_) >=
+                 server_->body_timeout_ms_);
+        if (timeout) {
+            conn->closing_ = true;
+            tcp_service_.sendMessage(conn->socket_id_,
+                                     s_http_408, sizeof(s_http_408) - 1);
+            expired_.push_back(conn->socket_id_);
+
+        } else if (server_->keepalive_timeout_ms_ > 0 &&
+                   conn->reading_body_ == false &&
+                   now.distanceMillisecond(conn->last_active_time_) >=
+                       server_->keepalive_timeout_ms_) {
+            conn->closing_ = true;
+            expired_.push_back(conn->socket_id_);
+        }
+    }
+
+    for (size_t i = 0; i < expired_.size(); ++i) {
+        closeAfterSend(expired_[i]);
+    }
+}
+
+void HttpServer::Impl::Reactor::onNewConnection(TcpService *service,
+    TcpService::SocketId from_socket_id, TcpService::SocketId socket_id)
+{
+    UniquePtr<Connection> conn(new Connection(this, socket_id));
+    if (service->setContext(socket_id, conn.get()) == false) {
+        service->closeSocket(socket_id);
+        return;
+    }
+    conn.release();
+}
+
+void HttpServer::Impl::Reactor::onRecvMessage(TcpService *service,
+    TcpService::SocketId socket_id, DynamicBuffer *buffer)
+{
+    Connection *conn = (Connection *)service->getContext(socket_id);
+    if (nullptr == conn) {
+        service->closeSocket(socket_id);
+        return;
+    }
+    if (conn->closing_ || conn->bad_request_) {
+        buffer->read(buffer->readableBytes());
+        return;
+    }
+    conn->last_active_time_.setNow();
+
+    // requests are moved to the deque whose references are stable,
+    // the request being handled is referenced by the request callback
+    HttpProtocol::RetCode ret = HttpProtocol::RetCode::MESSAGE_READY;
+    while (HttpProtocol::RetCode::MESSAGE_READY == ret) {
+        ret = conn->protocol_.recvRequests(buffer, &recv_requests_);
+        for (size_t i = 0; i < recv_requests_.size(); ++i) {
+            conn->requests_.emplace_back();
+            conn->requests_.back().swap(recv_requests_[i]);
+        }
+        recv_requests_.clear();
+
+        // a client pipelining too many requests is closed
+        if (server_->max_pipelined_requests_ > 0 &&
+            conn->requests_.size() >
+                (size_t)server_->max_pipelined_requests_) {
+            buffer->read(buffer->readableBytes());
+            cancelRequest(conn);
+            conn->requests_.clear();
+            conn->closing_ = true;
+            closeAfterSend(socket_id);
+            return;
+        }
+    }
+    if (HttpProtocol::RetCode::ERROR == ret) {
+        conn->bad_request_ = true;
+    }
+
+    HttpProtocol::Status status = conn->protocol_.getStatus();
+    if (HttpProtocol::Status::READING_BODY == status ||
+        HttpProtocol::Status::READING_TRAILER_HEADER == status) {
+        if (conn->reading_body_ == false) {
+            conn->reading_body_ = true;
+            conn->body_start_time_ = conn->last_active_time_;
+        }
+    } else {
+        conn->reading_body_ = false;
+    }
+
+    conn->protocol_.beginOutputBatch();
+    processRequests(conn);
+    flushOutput(conn);
+}
+
+void HttpServer::Impl::Reactor::processRequests(Connection *conn)
+{
+    conn->processing_ = true;
+
+    while (conn->handling_ == false && conn->closing_ == false &&
+           conn->requests_.empty() == false) {
+        const HttpRequest &request = conn->requests_.front();
+
+        ++conn->request_count_;
+        if (request.isConnectionKeepAlive() == false ||
+            (server_->keepalive_max_requests_ > 0 &&
+             conn->request_count_ >= server_->keepalive_max_requests_) ||
+            server_->quit_) {
+            conn->close_after_response_ = true;
+        }
+        conn->handling_ = true;
+        conn->counted_ = false;
+
+        ConnectionId conn_id = { index_, conn->socket_id_ };
+        if (server_->max_concurrent_requests_ > 0) {
+            if (++server_->concurrent_requests_ >
+                    server_->max_concurrent_requests_) {
+                --server_->concurrent_requests_;
+                server_->sendResponse(conn_id, server_->service_unavailable_);
+            } else {
+                conn->counted_ = true;
+            }
+        }
+        if (conn->handling_) {
+            server_->request_cb_(server_->thiz_, conn_id, request);
+        }
+
+        // responded later
+        if (conn->handling_) {
+            break;
+        }
+        conn->requests_.pop_front();
+    }
+
+    conn->processing_ = false;
+}
+
+void HttpServer::Impl::Reactor::flushOutput(Connection *conn)
+{
+    conn->protocol_.endOutputBatch();
+
+    if (conn->bad_request_ && conn->closing_ == false &&
+        conn->handling_ == false && conn->requests_.empty()) {
+        conn->closing_ = true;
+        tcp_service_.sendMessage(conn->socket_id_,
+                                 s_http_400, sizeof(s_http_400) - 1);
+    }
+    if (conn->closing_) {
+        closeAfterSend(conn->socket_id_);
+    }
+}
+
+void HttpServer::Impl::Reactor::closeAfterSend(TcpService::SocketId socket_id)
+{
+    // nothing to send, close after the pending output is sent
+    if (tcp_service_.sendMessageThenClose(socket_id, "", 0) == false) {
+        tcp_service_.closeSocket(socket_id);
+    }
+}
+
+void HttpServer::Impl::Reactor::cancelRequest(Connection *conn)
+{
+    if (conn->handling_ == false) {
+        return;
+    }
+
+    conn->handling_ = false;
+    if (conn->counted_) {
+        --server_->concurrent_requests_;
+        conn->counted_ = false;
+    }
+    if (server_->request_cancel_cb_) {
+        ConnectionId conn_id = { index_, conn->socket_id_ };
+        server_->request_cancel_cb_(server_->thiz_, conn_id);
+    }
+}
+
+void HttpServer::Impl::Reactor::closeConnection(
+    TcpService::SocketId socket_id)
+{
+    // the request being handled is cancelled before it is deleted
+    Connection *conn = (Connection *)tcp_service_.getContext(socket_id);
+    if (conn != nullptr) {
+        cancelRequest(conn);
+    }
+    tcp_service_.closeSocket(socket_id);
+}
+
+void HttpServer::Impl::Reactor::onPeerClose(TcpService *service,
+                                            TcpService::SocketId socket_id)
+{
+    closeConnection(socket_id);
+}
+
+void HttpServer::Impl::Reactor::onError(TcpService *service,
+    TcpService::SocketId socket_id, int error)
+{
+    closeConnection(socket_id);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+HttpServer::Impl::Impl(HttpServer *thiz) :
+    thiz_(thiz),
+    reactor_count_(0),
+    keepalive_max_requests_(0),
+    keepalive_timeout_ms_(0),
+    header_timeout_ms_(0),
+    body_timeout_ms_(0),
+    max_concurrent_requests_(0),
+    max_pipelined_requests_(0),
+    header_max_size_(0),
+    body_max_size_(0),
+    concurrent_requests_(0),
+    quit_(false)
+{
+    service_unavailable_.setVersion(HttpMessage::Version::HTTP_1_1);
+    service_unavailable_.setStatusCode(503);
+    service_unavailable_.setReasonPhrase("Service Unavailable");
+    service_unavailable_.setHeader("Content-Length", "0");
+}
+
+HttpServer::Impl::~Impl()
+{
+    for (size_t i = 0; i < reactors_.size(); ++i) {
+        delete reactors_[i];
+    }
+}
+
+void HttpServer::Impl::setRequestCallback(const RequestCallback &request_cb)
+{
+    request_cb_ = request_cb;
+}
+
+void HttpServer::Impl::setRequestCancelCallback(
+    const RequestCancelCallback &request_cancel_cb)
+{
+    request_cancel_cb_ = request_cancel_cb;
+}
+
+void HttpServer::Impl::setReactorCount(int count)
+{
+    if (count <= 0) {
+        return;
+    }
+    reactor_count_ = count;
+}
+
+void HttpServer::Impl::setKeepAliveMaxRequests(int count)
+{
+    keepalive_max_requests_ = count;
+}
+
+void HttpServer::Impl::setKeepAliveTimeout(int timeout_ms)
+{
+    keepalive_timeout_ms_ = timeout_ms;
+}
+
+void HttpServer::Impl::setHeaderTimeout(int timeout_ms)
+{
+    header_timeout_ms_ = timeout_ms;
+}
+
+void HttpServer::Impl::setBodyTimeout(int timeout_ms)
+{
+    body_timeout_ms_ = timeout_ms;
+}
+
+void HttpServer::Impl::setMaxConcurrentRequests(int count)
+{
+    max_concurrent_requests_ = count;
+}
+
+void HttpServer::Impl::setMaxPipelinedRequests(int count)
+{
+    max_pipelined_requests_ = count;
+}
+
+void HttpServer::Impl::setHeaderMaxSize(size_t size)
+{
+    header_max_size_ = size;
+}
+
+void HttpServer::Impl::setBodyMaxSize(size_t size)
+{
+    body_max_size_ = size;
+}
+
+bool HttpServer::Impl::listen(const SocketAddress &addr)
+{
+    if (reactors_.empty() == false) {
+        return false;
+    }
+    if (listen_socket_.passiveOpenNonblock(addr) == false) {
+        return false;
+    }
+
+    // every reactor accepts on a duplicate of the listen socket
+    for (int i = 0; i < reactor_count_; ++i) {
+        Reactor *reactor = new Reactor(this, i);
+        reactors_.push_back(reactor);
+        if (reactor->tcp_service_.shareListen(listen_socket_) < 0) {
+            return false;
+        }
+    }
+    quit_ = false;
+
+    return true;
+}
+
+bool HttpServer::Impl::getListenAddress(SocketAddress *addr) const
+{
+    return listen_socket_.getLocalAddress(addr);
+}
+
+void HttpServer::Impl::run()
+{
+    if (reactors_.empty()) {
+        return;
+    }
+
+    for (size_t i = 1; i < reactors_.size(); ++i) {
+        reactors_[i]->thread_.start(BRICKRED_BIND_MEM_FUNC(
+            &Reactor::run, reactors_[i]));
+    }
+    reactors_[0]->run();
+    for (size_t i = 1; i < reactors_.size(); ++i) {
+        reactors_[i]->thread_.join();
+    }
+}
+
+void HttpServer::Impl::quit()
+{
+    quit_ = true;
+}
+
+int HttpServer::Impl::getReactorCount() const
+{
+    return reactors_.size();
+}
+
+IOService *HttpServer::Impl::getIOService(int reactor_index) const
+{
+    if (reactor_index < 0 || reactor_index >= (int)reactors_.size()) {
+        return nullptr;
+    }
+
+    return &reactors_[reactor_index]->io_service_;
+}
+
+bool HttpServer::Impl::sendResponse(ConnectionId conn_id,
+                                    const HttpResponse &response)
+{
+    if (conn_id.reactor_index < 0 ||
+        conn_id.reactor_index >= (int)reactors_.size()) {
+        return false;
+    }
+    Reactor *reactor = reactors_[conn_id.reactor_index];
+    Connection *conn = (Connection *)
+        reactor->tcp_service_.getContext(conn_id.socket_id);
+    if (nullptr == conn || conn->handling_ == false) {
+        return false;
+    }
+
+    // responded in request callback
+    bool in_process = conn->processing_;
+    if (!in_process) {
+        conn->protocol_.beginOutputBatch();
+    }
+
+    conn->handling_ = false;
+    if (conn->counted_) {
+        --concurrent_requests_;
+        conn->counted_ = false;
+    }
+
+    const HttpResponse *message = &response;
+    HttpResponse close_response;
+    if (conn->close_after_response_) {
+        conn->closing_ = true;
+        if (response.headerContain(HttpMessage::KnownHeader::CONNECTION,
+                                   "close") == false) {
+            // once per connection, the copy is fine
+            close_response = response;
+            close_response.setHeader("Connection", "close");
+            message = &close_response;
+        }
+    }
+    // Content-Length of a HEAD response is not followed by a body
+    if (HttpRequest::Method::HEAD == conn->requests_.front().getMethod()) {
+        conn->protocol_.sendMessageHeader(*message);
+    } else {
+        conn->protocol_.sendMessage(*message);
+    }
+    conn->last_active_time_.setNow();
+
+    if (!in_process) {
+        conn->requests_.pop_front();
+        reactor->processRequests(conn);
+        reactor->flushOutput(conn);
+    }
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+HttpServer::HttpServer() :
+    pimpl_(new Impl(this))
+{
+    setReactorCount();
+    setKeepAliveMaxRequests();
+    setKeepAliveTimeout();
+    setHeaderTimeout();
+    setBodyTimeout();
+    setMaxConcurrentRequests();
+    setMaxPipelinedRequests();
+    setHeaderMaxSize();
+    setBodyMaxSize();
+}
+
+HttpServer::~HttpServer()
+{
+}
+
+void HttpServer::setRequestCallback(const RequestCallback &request_cb)
+{
+    pimpl_->setRequestCallback(request_cb);
+}
+
+void HttpServer::setRequestCancelCallback(
+    const RequestCancelCallback &request_cancel_cb)
+{
+    pimpl_->setRequestCancelCallback(request_cancel_cb);
+}
+
+void HttpServer::setReactorCount(int count)
+{
+    pimpl_->setReactorCount(count);
+}
+
+void HttpServer::setKeepAliveMaxRequests(int count)
+{
+    pimpl_->setKeepAliveMaxRequests(count);
+}
+
+void HttpServer::setKeepAliveTimeout(int timeout_ms)
+{
+    pimpl_->setKeepAliveTimeout(timeout_ms);
+}
+
+void HttpServer::setHeaderTimeout(int timeout_ms)
+{
+    pimpl_->setHeaderTimeout(timeout_ms);
+}
+
+void HttpServer::setBodyTimeout(int timeout_ms)
+{
+    pimpl_->setBodyTimeout(timeout_ms);
+}
+
+void HttpServer::setMaxConcurrentRequests(int count)
+{
+    pimpl_->setMaxConcurrentRequests(count);
+}
+
+void HttpServer::setMaxPipelinedRequests(int count)
+{
+    pimpl_->setMaxPipelinedRequests(count);
+}
+
+void HttpServer::setHeaderMaxSize(size_t size)
+{
+    pimpl_->setHeaderMaxSize(size);
+}
+
+void HttpServer::setBodyMaxSize(size_t size)
+{
+    pimpl_->setBodyMaxSize(size);
+}
+
+bool HttpServer::listen(const SocketAddress &addr)
+{
+    return pimpl_->listen(addr);
+}
+
+bool HttpServer::getListenAddress(SocketAddress *addr) const
+{
+    return pimpl_->getListenAddress(addr);
+}
+
+void HttpServer::run()
+{
+    pimpl_->run();
+}
+
+void HttpServer::quit()
+{
+    pimpl_->quit();
+}
+
+int HttpServer::getReactorCount() const
+{
+    return pimpl_->getReactorCount();
+}
+
+IOService *HttpServer::getIOService(int reactor_index) const
+{
+    return pimpl_->getIOService(reactor_index);
+}
+
+bool HttpServer::sendResponse(ConnectionId conn_id,
+                              const HttpResponse &response)
+{
+    return pimpl_->sendResponse(conn_id, response);
+}
+
+} // namespace brickred::protocol
@@ -0,0 +1,94 @@
+#ifndef BRICKRED_PROTOCOL_HTTP_SERVER_H
+#define BRICKRED_PROTOCOL_HTTP_SERVER_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <brickred/class_util.h>
+#include <brickred/function.h>
+#include <brickred/tcp_service.h>
+#include <brickred/unique_ptr.h>
+
+namespace brickred { class IOService; }
+namespace brickred { class SocketAddress; }
+namespace brickred::protocol { class HttpRequest; }
+namespace brickred::protocol { class HttpResponse; }
+
+namespace brickred::protocol {
+
+// http/1.1 server on TcpService and HttpProtocol, each reactor runs
+// an IOService in its own thread and accepts on the shared listen socket,
+// requests of a connection are passed to request callback one by one
+// in order, the next one is passed after the response is sent
+class HttpServer final {
+public:
+    struct ConnectionId {
+        int reactor_index;
+        TcpService::SocketId socket_id;
+    };
+
+    // call sendResponse() in the callback or later in the reactor thread
+    // of the connection, request is valid until the response is sent or
+    // the request is cancelled
+    using RequestCallback = Function<void (HttpServer *server,
+                                           ConnectionId conn_id,
+                                           const HttpRequest &request)>;
+    // the connection is closed before the response of the request being
+    // handled is sent, request is invalid from now on and sendResponse()
+    // returns false
+    using RequestCancelCallback = Function<void (HttpServer *server,
+                                                 ConnectionId conn_id)>;
+
+    HttpServer();
+    ~HttpServer();
+
+    void setRequestCallback(const RequestCallback &request_cb);
+    void setRequestCancelCallback(
+        const RequestCancelCallback &request_cancel_cb);
+
+    // settings below must be set before listen()
+    void setReactorCount(int count = 1);
+    // close the connection after count requests, 0 means no limit
+    void setKeepAliveMaxRequests(int count = 0);
+    // close the connection idle for timeout_ms between requests
+    void setKeepAliveTimeout(int timeout_ms = 60000);
+    // start line and headers must be received in timeout_ms
+    void setHeaderTimeout(int timeout_ms = 10000);
+    // body must be received in timeout_ms after headers
+    void setBodyTimeout(int timeout_ms = 60000);
+    // requests passed to request callback but not responded in all
+    // reactors, exceeded requests are responded 503, 0 means no limit
+    void setMaxConcurrentRequests(int count = 0);
+    // requests received on a connection and not responded yet, the
+    // connection is closed when exceeded, 0 means no limit
+    void setMaxPipelinedRequests(int count = 64);
+    void setHeaderMaxSize(size_t size = 32 * 1024);
+    void setBodyMaxSize(size_t size = 1024 * 1024);
+
+    bool listen(const SocketAddress &addr);
+    bool getListenAddress(SocketAddress *addr) const;
+    // reactor 0 runs in the caller thread, return after quit()
+    void run();
+    // thread safe
+    void quit();
+
+    int getReactorCount() const;
+    IOService *getIOService(int reactor_index) const;
+
+    // must be called in the reactor thread of the connection,
+    // the response is sent with Connection: close if the connection
+    // is going to be closed, the body is not sent for a HEAD request,
+    // return false if the connection is closed or has no request being
+    // handled
+    bool sendResponse(ConnectionId conn_id, const HttpResponse &response);
+
+private:
+    BRICKRED_NONCOPYABLE(HttpServer)
+
+    class Impl;
+    UniquePtr<Impl> pimpl_;
+};
+
+} // namespace brickred::protocol
+
+#endif
@@ -0,0 +1,634 @@
+#include <brickred/protocol/web_socket_deflate.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef BRICKRED_BUILD_ZLIB
+#include <zlib.h>
+#endif
+
+#include <brickred/dynamic_buffer.h>
+#include <brickred/string_util.h>
+
+namespace brickred::protocol {
+
+namespace {
+
+// compress buffer grown by a large message is released after it
+const size_t s_buffer_keep_size = 64 * 1024;
+// zlib does not support 8 bits window of raw deflate
+const int s_min_window_bits = 9;
+const int s_max_window_bits = 15;
+
+// name and value of extension parameter, value is empty if not given
+using ExtensionParam = std::pair<std::string, std::string>;
+
+struct Extension {
+    std::string name;
+    std::vector<ExtensionParam> params;
+};
+
+// Sec-WebSocket-Extensions: ext1; p1; p2=v, ext2
+void parseExtensions(const std::string &value,
+                     std::vector<Extension> *extensions)
+{
+    std::vector<std::string> items;
+    string_util::split(value.c_str(), ",", &items);
+
+    for (size_t i = 0; i < items.size(); ++i) {
+        std::vector<std::string> tokens;
+        string_util::split(items[i].c_str(), ";", &tokens);
+        if (tokens.empty()) {
+            continue;
+        }
+
+        Extension extension;
+        extension.name = string_util::trim(tokens[0]);
+        for (size_t j = 1; j < tokens.size(); ++j) {
+            std::string token = string_util::trim(tokens[j]);
+            size_t pos = token.find('=');
+            if (std::string::npos == pos) {
+                extension.params.push_back(ExtensionParam(token, ""));
+            } else {
+                std::string param_value =
+                    string_util::trim(token.substr(pos + 1), " \t\"");
+                extension.params.push_back(ExtensionParam(
+                    string_util::trim(token.substr(0, pos)), param_value));
+            }
+        }
+        extensions->push_back(extension);
+    }
+}
+
+// return -1 if invalid
+int parseWindowBits(const std::string &value)
+{
+    if (value.size() < 1 || value.size() > 2 ||
+        value.find_first_not_of("0123456789") != std::string::npos ||
+        ('0' == value[0])) {
+        return -1;
+    }
+    int bits = ::atoi(value.c_str());
+    if (bits < 8 || bits > s_max_window_bits) {
+        return -1;
+    }
+
+    return bits;
+}
+
+} // namespace
+
+class WebSocketDeflate::Impl {
+public:
+    Impl();
+    ~Impl();
+
+    void setMaxWindowBits(int bits);
+    void setNoContextTakeover(bool no_context_takeover);
+    void setMemLevel(int level);
+
+    std::string buildOffer() const;
+    bool acceptOffer(const std::string &extensions, std::string *response);
+    bool acceptResponse(const std::string &extensions);
+    bool isActive() const { return active_; }
+
+    bool compress(const char *in, size_t size,
+                  const char **out, size_t *out_size, bool finish);
+    bool decompress(const char *in, size_t size,
+                    DynamicBuffer *out, size_t max_size);
+    bool decompressPiece(const char *in, size_t size, size_t *consumed,
+                         DynamicBuffer *out, size_t max_size,
+                         bool finish, bool *done);
+
+private:
+    bool acceptOfferParams(const Extension &offer, std::string *response);
+
+private:
+    int max_window_bits_;
+    bool no_context_takeover_;
+    int mem_level_;
+
+    // negotiated
+    bool active_;
+    int deflate_window_bits_;
+    int inflate_window_bits_;
+    bool deflate_no_context_takeover_;
+    bool inflate_no_context_takeover_;
+
+#ifdef BRICKRED_BUILD_ZLIB
+    z_stream deflate_stream_;
+    z_stream inflate_stream_;
+#endif
+    bool deflate_inited_;
+    bool inflate_inited_;
+    DynamicBuffer compress_buffer_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+WebSocketDeflate::Impl::Impl() :
+    max_window_bits_(s_max_window_bits),
+    no_context_takeover_(false),
+    mem_level_(8),
+    active_(false),
+    deflate_window_bits_(s_max_window_bits),
+    inflate_window_bits_(s_max_window_bits),
+    deflate_no_context_takeover_(false),
+    inflate_no_context_takeover_(false),
+    deflate_inited_(false),
+    inflate_inited_(false)
+{
+}
+
+WebSocketDeflate::Impl::~Impl()
+{
+#ifdef BRICKRED_BUILD_ZLIB
+    if (deflate_inited_) {
+        ::deflateEnd(&deflate_stream_);
+    }
+    if (inflate_inited_) {
+        ::inflateEnd(&inflate_stream_);
+    }
+#endif
+}
+
+void WebSocketDeflate::Impl::setMaxWindowBits(int bits)
+{
+    if (bits < s_min_window_bits || bits > s_max_window_bits) {
+        return;
+    }
+    max_window_bits_ = bits;
+}
+
+void WebSocketDeflate::Impl::setNoContextTakeover(bool no_context_takeover)
+{
+    no_context_takeover_ = no_context_takeover;
+}
+
+void WebSocketDeflate::Impl::setMemLevel(int level)
+{
+    if (level < 1 || level > 9) {
+        return;
+    }
+    mem_level_ = level;
+}
+
+std::string WebSocketDeflate::Impl::buildOffer() const
+{
+    std::string offer = "permessage-deflate";
+
+    // this side does not keep the context, the server may rely on it
+    if (no_context_takeover_) {
+        offer += "; client_no_context_takeover";
+    }
+    if (max_window_bits_ < s_max_window_bits) {
+        offer += "; server_max_window_bits=" +
+            string_util::toString(max_window_bits_);
+        offer += "; client_max_window_bits=" +
+            string_util::toString(max_window_bits_);
+    } else {
+        offer += "; client_max_window_bits";
+    }
+
+    return offer;
+}
+
+bool WebSocketDeflate::Impl::acceptOfferParams(const Extension &offer,
+                                               std::string *response)
+{
+    bool server_no_context_takeover = false;
+    bool client_no_context_takeover = false;
+    int server_max_window_bits = s_max_window_bits;
+    int client_max_window_bits = -1;
+    std::vector<std::string> seen;
+
+    for (size_t i = 0; i < offer.params.size(); ++i) {
+        const std::string &name = offer.params[i].first;
+        const std::string &value = offer.params[i].second;
+
+        // each parameter appears at most once
+        if (std::find(seen.begin(), seen.end(), name) != seen.end()) {
+            return false;
+        }
+        seen.push_back(name);
+
+        if ("server_no_context_takeover" == name) {
+            if (value.empty() == false) {
+                return false;
+            }
+            server_no_context_takeover = true;
+        } else if ("client_no_context_takeover" == name) {
+            if (value.empty() == false) {
+                return false;
+            }
+            client_no_context_takeover = true;
+        } else if ("server_max_window_bits" == name) {
+            server_max_window_bits = parseWindowBits(value);
+            if (server_max_window_bits < s_min_window_bits) {
+                return false;
+            }
+        } else if ("client_max_window_bits" == name) {
+            if (value.empty()) {
+                client_max_window_bits = s_max_window_bits;
+            } else {
+                client_max_window_bits = parseWindowBits(value);
+                if (-1 == client_max_window_bits) {
+                    return false;
+                }
+            }
+        } else {
+            return false;
+        }
+    }
+
+    deflate_window_bits_ = std::min(max_window_bits_, server_max_window_bits);
+    deflate_no_context_takeover_ =
+        server_no_context_takeover || no_context_takeover_;
+    inflate_no_context_takeover_ = client_no_context_takeover;
+    inflate_window_bits_ = s_max_window_bits;
+
+    *response = "permessage-deflate";
+    if (deflate_no_context_takeover_) {
+        *response += "; server_no_context_takeover";
+    }
+    if (inflate_no_context_takeover_) {
+        *response += "; client_no_context_takeover";
+    }
+    if (deflate_window_bits_ < s_max_window_bits) {
+        *response += "; server_max_window_bits=" +
+            string_util::toString(deflate_window_bits_);
+    }
+    // the client can only be limited if it supports the parameter
+    if (client_max_window_bits != -1) {
+        inflate_window_bits_ = std::max(s_min_window_bits,
+            std::min(max_window_bits_, client_max_window_bits));
+        if (inflate_window_bits_ < s_max_window_bits) {
+            *response += "; client_max_window_bits=" +
+                string_util::toString(inflate_window_bits_);
+        }
+    }
+
+    return true;
+}
+
+bool WebSocketDeflate::Impl::acceptOffer(const std::string &extensions,
+                                         std::string *response)
+{
+    if (WebSocketDeflate::isSupported() == false) {
+        return false;
+    }
+
+    std::vector<Extension> offers;
+    parseExtensions(extensions, &offers);
+
+    for (size_t i = 0; i < offers.size(); ++i) {
+        if (offers[i].name != "permessage-deflate") {
+            continue;
+        }
+        if (acceptOfferParams(offers[i], response)) {
+            active_ = true;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool WebSocketDeflate::Impl::acceptResponse(const std::string &extensions)
+{
+    if (WebSocketDeflate::isSupported() == false) {
+        return false;
+    }
+
+    std::vector<Extension> responses;
+    parseExtensions(extensions, &responses);
+    if (responses.size() != 1 ||
+        responses[0].name != "permessage-deflate") {
+        return false;
+    }
+
+    deflate_window_bits_ = max_window_bits_;
+    inflate_window_bits_ = s_max_window_bits;
+    deflate_no_context_takeover_ = no_context_takeover_;
+    inflate_no_context_takeover_ = false;
+    std::vector<std::string> seen;
+
+    const std::vector<ExtensionParam> &params = responses[0].params;
+    for (size_t i = 0; i < params.size(); ++i) {
+        const std::string &name = params[i].first;
+        const std::string &value = params[i].second;
+
+        if (std::find(seen.begin(), seen.end(), name) != seen.end()) {
+            return false;
+        }
+        seen.push_back(name);
+
+        if ("server_no_context_takeover" == name) {
+            if (value.empty() == false) {
+                return false;
+            }
+            inflate_no_context_takeover_ = true;
+        } else if ("client_no_context_takeover" == name) {
+            if (value.empty() == false) {
+                return false;
+            }
+            deflate_no_context_takeover_ = true;
+        } else if ("server_max_window_bits" == name) {
+            int bits = parseWindowBits(value);
+            if (-1 == bits || bits > max_window_bits_) {
+                return false;
+            }
+            // a larger window decodes a smaller one
+            inflate_window_bits_ = std::max(s_min_window_bits, bits);
+        } else if ("client_max_window_bits" == name) {
+            int bits = parseWindowBits(value);
+            if (bits < s_min_window_bits) {
+                return false;
+            }
+            deflate_window_bits_ = std::min(deflate_window_bits_, bits);
+        } else {
+            return false;
+        }
+    }
+
+    active_ = true;
+    return true;
+}
+
+#ifdef BRICKRED_BUILD_ZLIB
+bool WebSocketDeflate::Impl::compress(const char *in, size_t size,
+                                      const char **out, size_t *out_size,
+                                      bool finish)
+{
+    if (!active_) {
+        return false;
+    }
+    if (!deflate_inited_) {
+        ::memset(&deflate_stream_, 0, sizeof(deflate_stream_));
+        if (::deflateInit2(&deflate_stream_, Z_DEFAULT_COMPRESSION,
+                           Z_DEFLATED, -deflate_window_bits_, mem_level_,
+                           Z_DEFAULT_STRATEGY) != Z_OK) {
+            return false;
+        }
+        deflate_inited_ = true;
+    }
+
+    compress_buffer_.clear();
+    if (compress_buffer_.capacity() > s_buffer_keep_size) {
+        DynamicBuffer empty_buffer;
+        compress_buffer_.swap(empty_buffer);
+    }
+
+    deflate_stream_.next_in = (Bytef *)in;
+    deflate_stream_.avail_in = size;
+    for (;;) {
+        size_t reserve_size = ::deflateBound(&deflate_stream_, size) + 16;
+        compress_buffer_.reserveWritableBytes(reserve_size);
+        deflate_stream_.next_out = (Bytef *)compress_buffer_.writeBegin();
+        deflate_stream_.avail_out = compress_buffer_.writableBytes();
+
+        int ret = ::deflate(&deflate_stream_, Z_SYNC_FLUSH);
+        if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            return false;
+        }
+        compress_buffer_.write(compress_buffer_.writableBytes() -
+                               deflate_stream_.avail_out);
+        // all flushed
+        if (deflate_stream_.avail_out != 0) {
+            break;
+        }
+    }
+
+    *out = compress_buffer_.readBegin();
+    *out_size = compress_buffer_.readableBytes();
+    if (!finish) {
+        return true;
+    }
+
+    // remove the empty block 0x00 0x00 0xff 0xff of sync flush
+    if (compress_buffer_.readableBytes() >= 4) {
+        *out_size -= 4;
+    } else if (compress_buffer_.readableBytes() == 0) {
+        // nothing left after the sync flush of the last piece,
+        // the message ends with an empty stored block (rfc 7692 7.2.3.6)
+        compress_buffer_.reserveWritableBytes(1);
+        *compress_buffer_.writeBegin() = '\0';
+        compress_buffer_.write(1);
+        *out = compress_buffer_.readBegin();
+        *out_size = 1;
+    } else {
+        return false;
+    }
+
+    if (deflate_no_context_takeover_) {
+        ::deflateReset(&deflate_stream_);
+    }
+
+    return true;
+}
+
+bool WebSocketDeflate::Impl::decompress(const char *in, size_t size,
+                                        DynamicBuffer *out, size_t max_size)
+{
+    // one more byte to tell a message of max_size from a larger one
+    size_t consumed = 0;
+    bool done = false;
+    size_t out_start = out->readableBytes();
+    if (decompressPiece(in, size, &consumed, out, max_size + 1,
+                        true, &done) == false) {
+        return false;
+    }
+
+    return done && out->readableBytes() - out_start <= max_size;
+}
+
+bool WebSocketDeflate::Impl::decompressPiece(const char *in, size_t size,
+                                             size_t *consumed,
+                                             DynamicBuffer *out,
+                                             size_t max_size,
+                                             bool finish, bool *done)
+{
+    static const char s_tail[] = { 0x00, 0x00, (char)0xff, (char)0xff };
+
+    if (!active_) {
+        return false;
+    }
+    if (!inflate_inited_) {
+        ::memset(&inflate_stream_, 0, sizeof(inflate_stream_));
+        if (::inflateInit2(&inflate_stream_, -inflate_window_bits_) != Z_OK) {
+            return false;
+        }
+        inflate_inited_ = true;
+    }
+
+    size_t out_start = out->readableBytes();
+    inflate_stream_.next_in = (Bytef *)in;
+    inflate_stream_.avail_in = size;
+    *done = false;
+
+    for (;;) {
+        size_t room = max_size - (out->readableBytes() - out_start);
+        // more output may be pending
+        if (0 == room) {
+            *consumed = size - inflate_stream_.avail_in;
+            return true;
+        }
+        out->reserveWritableBytes(
+            std::min(room, std::max(size * 2, (size_t)4096)));
+        inflate_stream_.next_out = (Bytef *)out->writeBegin();
+        inflate_stream_.avail_out = std::min(room, out->writableBytes());
+        size_t avail_out = inflate_stream_.avail_out;
+
+        int ret = ::inflate(&inflate_stream_, Z_SYNC_FLUSH);
+        if (ret != Z_OK && ret != Z_BUF_ERROR && ret != Z_STREAM_END) {
+            return false;
+        }
+        out->write(avail_out - inflate_stream_.avail_out);
+
+        // the peer ended the stream with a final block
+        if (Z_STREAM_END == ret) {
+            ::inflateReset(&inflate_stream_);
+            *consumed = size;
+            *done = true;
+            return true;
+        }
+        // output space left means all input is inflated
+        if (inflate_stream_.avail_out > 0) {
+            if (inflate_stream_.avail_in > 0) {
+                return false;
+            }
+            break;
+        }
+    }
+
+    *consumed = size;
+    *done = true;
+
+    // the tail is appended to the last piece of a message, it is an
+    // empty stored block and outputs nothing
+    if (finish) {
+        char buffer[1];
+        inflate_stream_.next_in = (Bytef *)s_tail;
+        inflate_stream_.avail_in = sizeof(s_tail);
+        inflate_stream_.next_out = (Bytef *)buffer;
+        inflate_stream_.avail_out = sizeof(buffer);
+        int ret = ::inflate(&inflate_stream_, Z_SYNC_FLUSH);
+        if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            return false;
+        }
+        if (inflate_stream_.avail_in > 0 ||
+            inflate_stream_.avail_out != sizeof(buffer)) {
+            return false;
+        }
+        if (inflate_no_context_takeover_) {
+            ::inflateReset(&inflate_stream_);
+        }
+    }
+
+    return true;
+}
+#else
+bool WebSocketDeflate::Impl::compress(const char *in, size_t size,
+                                      const char **out, size_t *out_size,
+                                      bool finish)
+{
+    return false;
+}
+
+bool WebSocketDeflate::Impl::decompress(const char *in, size_t size,
+                                        DynamicBuffer *out, size_t max_size)
+{
+    return false;
+}
+
+bool WebSocketDeflate::Impl::decompressPiece(const char *in, size_t size,
+                                             size_t *consumed,
+                                             DynamicBuffer *out,
+                                             size_t max_size,
+                                             bool finish, bool *done)
+{
+    return false;
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+WebSocketDeflate::WebSocketDeflate() :
+    pimpl_(new Impl())
+{
+}
+
+WebSocketDeflate::~WebSocketDeflate()
+{
+}
+
+bool WebSocketDeflate::isSupported()
+{
+#ifdef BRICKRED_BUILD_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
+void WebSocketDeflate::setMaxWindowBits(int bits)
+{
+    pimpl_->setMaxWindowBits(bits);
+}
+
+void WebSocketDeflate::setNoContextTakeover(bool no_context_takeover)
+{
+    pimpl_->setNoContextTakeover(no_context_takeover);
+}
+
+void WebSocketDeflate::setMemLevel(int level)
+{
+    pimpl_->setMemLevel(level);
+}
+
+std::string WebSocketDeflate::buildOffer() const
+{
+    return pimpl_->buildOffer();
+}
+
+bool WebSocketDeflate::acceptOffer(const std::string &extensions,
+                                   std::string *response)
+{
+    return pimpl_->acceptOffer(extensions, response);
+}
+
+bool WebSocketDeflate::acceptResponse(const std::string &extensions)
+{
+    return pimpl_->acceptResponse(extensions);
+}
+
+bool WebSocketDeflate::isActive() const
+{
+    return pimpl_->isActive();
+}
+
+bool WebSocketDeflate::compress(const char *in, size_t size,
+                                const char **out, size_t *out_size,
+                                bool finish)
+{
+    return pimpl_->compress(in, size, out, out_size, finish);
+}
+
+bool WebSocketDeflate::decompress(const char *in, size_t size,
+                                  DynamicBuffer *out, size_t max_size)
+{
+    return pimpl_->decompress(in, size, out, max_size);
+}
+
+bool WebSocketDeflate::decompressPiece(const char *in, size_t size,
+                                       size_t *consumed,
+                                       DynamicBuffer *out, size_t max_size,
+                                       bool finish, bool *done)
+{
+    return pimpl_->decompressPiece(in, size, consumed, out, max_size,
+                                   finish, done);
+}
+
+} // namespace brickred::protocol
@@ -0,0 +1,70 @@
+#ifndef BRICKRED_PROTOCOL_WEB_SOCKET_DEFLATE_H
+#define BRICKRED_PROTOCOL_WEB_SOCKET_DEFLATE_H
+
+#include <cstddef>
+#include <string>
+
+#include <brickred/class_util.h>
+#include <brickred/unique_ptr.h>
+
+namespace brickred { class DynamicBuffer; }
+
+namespace brickred::protocol {
+
+// permessage-deflate extension (rfc 7692) of one connection,
+// zlib streams are created on first use, memory of the compressor is
+// (1 << (window_bits + 2)) + (1 << (mem_level + 9)) bytes,
+// the decompressor is (1 << window_bits) bytes plus about 7KB
+class WebSocketDeflate final {
+public:
+    WebSocketDeflate();
+    ~WebSocketDeflate();
+
+    // false if the library is built without zlib
+    static bool isSupported();
+
+    // window bits (9~15) of this side, also requested for the peer
+    void setMaxWindowBits(int bits);
+    // reset the compressor of this side after each message
+    void setNoContextTakeover(bool no_context_takeover);
+    // zlib memLevel (1~9) of the compressor
+    void setMemLevel(int level);
+
+    // Sec-WebSocket-Extensions value offered by a client
+    std::string buildOffer() const;
+    // server accepts the first valid offer, return false if none,
+    // response is the Sec-WebSocket-Extensions value to reply
+    bool acceptOffer(const std::string &extensions, std::string *response);
+    // client accepts the response of the server, return false if
+    // it is invalid, the connection should fail
+    bool acceptResponse(const std::string &extensions);
+    bool isActive() const;
+
+    // compressed payload without the trailing 0x00 0x00 0xff 0xff,
+    // out is valid until the next call, a message can be compressed in
+    // pieces and finish is set on the last piece, an empty last piece
+    // is the single byte 0x00
+    bool compress(const char *in, size_t size,
+                  const char **out, size_t *out_size, bool finish = true);
+    // append decompressed payload to out, fail if the appended size
+    // exceeds max_size
+    bool decompress(const char *in, size_t size,
+                    DynamicBuffer *out, size_t max_size);
+    // append at most max_size bytes of a message piece to out, consumed
+    // is the bytes of in used, done is false if more output is pending
+    // and the rest of in must be passed again, finish is set if in ends
+    // the message
+    bool decompressPiece(const char *in, size_t size, size_t *consumed,
+                         DynamicBuffer *out, size_t max_size,
+                         bool finish, bool *done);
+
+private:
+    BRICKRED_NONCOPYABLE(WebSocketDeflate)
+
+    class Impl;
+    UniquePtr<Impl> pimpl_;
+};
+
+} // namespace brickred::protocol
+
+#endif
@@ -0,0 +1,204 @@
+#include <brickred/protocol/web_socket_mask.h>
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BRICKRED_WEB_SOCKET_MASK_X86
+#include <immintrin.h>
+#endif
+
+namespace brickred::protocol::web_socket_mask {
+
+namespace {
+
+// key holds the 4 mask bytes in memory order, key byte 0 masks dst[0],
+// every implementation handles whole blocks and leaves the tail to a
+// narrower one, block sizes are multiples of 4 so the key stays aligned
+using MaskFunc = void (*)(char *dst, const char *src, size_t size,
+                          uint32_t key);
+
+void maskByte(char *dst, const char *src, size_t size, uint32_t key)
+{
+    const uint8_t *k = (const uint8_t *)&key;
+    for (size_t i = 0; i < size; ++i) {
+        dst[i] = src[i] ^ k[i & 0x03];
+    }
+}
+
+void maskWord(char *dst, const char *src, size_t size, uint32_t key)
+{
+    uint64_t key64 = ((uint64_t)key << 32) | key;
+    size_t i = 0;
+
+    for (; size - i >= 8; i += 8) {
+        uint64_t v;
+        ::memcpy(&v, src + i, 8);
+        v ^= key64;
+        ::memcpy(dst + i, &v, 8);
+    }
+    maskByte(dst + i, src + i, size - i, key);
+}
+
+#ifdef __SSE2__
+void maskSse2(char *dst, const char *src, size_t size, uint32_t key)
+{
+    __m128i k = _mm_set1_epi32((int)key);
+    size_t i = 0;
+
+    for (; size - i >= 64; i += 64) {
+        __m128i v0 = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i v1 = _mm_loadu_si128((const __m128i *)(src + i + 16));
+        __m128i v2 = _mm_loadu_si128((const __m128i *)(src + i + 32));
+        __m128i v3 = _mm_loadu_si128((const __m128i *)(src + i + 48));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_xor_si128(v0, k));
+        _mm_storeu_si128((__m128i *)(dst + i + 16), _mm_xor_si128(v1, k));
+        _mm_storeu_si128((__m128i *)(dst + i + 32), _mm_xor_si128(v2, k));
+        _mm_storeu_si128((__m128i *)(dst + i + 48), _mm_xor_si128(v3, k));
+    }
+    for (; size - i >= 16; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_xor_si128(v, k));
+    }
+    maskWord(dst + i, src + i, size - i, key);
+}
+#endif
+
+#ifdef BRICKRED_WEB_SOCKET_MASK_X86
+__attribute__((target("avx2")))
+void maskAvx2(char *dst, const char *src, size_t size, uint32_t key)
+{
+    __m256i k = _mm256_set1_epi32((int)key);
+    size_t i = 0;
+
+    for (; size - i >= 128; i += 128) {
+        __m256i v0 = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i v1 = _mm256_loadu_si256((const __m256i *)(src + i + 32));
+        __m256i v2 = _mm256_loadu_si256((const __m256i *)(src + i + 64));
+        __m256i v3 = _mm256_loadu_si256((const __m256i *)(src + i + 96));
+        _mm256_storeu_si256((__m256i *)(dst + i),
+                            _mm256_xor_si256(v0, k));
+        _mm256_storeu_si256((__m256i *)(dst + i + 32),
+                            _mm256_xor_si256(v1, k));
+        _mm256_storeu_si256((__m256i *)(dst + i + 64),
+                            _mm256_xor_si256(v2, k));
+        _mm256_storeu_si256((__m256i *)(dst + i + 96),
+                            _mm256_xor_si256(v3, k));
+    }
+    for (; size - i >= 32; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_xor_si256(v, k));
+    }
+    maskWord(dst + i, src + i, size - i, key);
+}
+#endif
+
+bool isSupported(Impl impl)
+{
+    switch (impl) {
+    case Impl::BYTE:
+    case Impl::WORD:
+        return true;
+#ifdef __SSE2__
+    case Impl::SSE2:
+        return true;
+#endif
+#ifdef BRICKRED_WEB_SOCKET_MASK_X86
+    case Impl::AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+MaskFunc getMaskFunc(Impl impl)
+{
+    switch (impl) {
+    case Impl::BYTE:
+        return maskByte;
+    case Impl::WORD:
+        return maskWord;
+#ifdef __SSE2__
+    case Impl::SSE2:
+        return maskSse2;
+#endif
+#ifdef BRICKRED_WEB_SOCKET_MASK_X86
+    case Impl::AVX2:
+        return maskAvx2;
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+Impl selectImpl()
+{
+    if (isSupported(Impl::AVX2)) {
+        return Impl::AVX2;
+    }
+    if (isSupported(Impl::SSE2)) {
+        return Impl::SSE2;
+    }
+    return Impl::WORD;
+}
+
+uint32_t rotateKey(const uint8_t *mask_key, size_t key_offset)
+{
+    uint8_t k[4];
+    for (size_t i = 0; i < 4; ++i) {
+        k[i] = mask_key[(key_offset + i) & 0x03];
+    }
+
+    uint32_t key;
+    ::memcpy(&key, k, 4);
+    return key;
+}
+
+} // namespace
+
+void mask(char *dst, const char *src, size_t size,
+          const uint8_t *mask_key, size_t key_offset)
+{
+    static const MaskFunc s_mask_func = getMaskFunc(getImpl());
+
+    s_mask_func(dst, src, size, rotateKey(mask_key, key_offset));
+}
+
+Impl getImpl()
+{
+    static const Impl s_impl = selectImpl();
+
+    return s_impl;
+}
+
+const char *getImplName(Impl impl)
+{
+    static const char *s_impl_names[] = {
+        "auto", "byte", "word", "sse2", "avx2"
+    };
+    static_assert(sizeof(s_impl_names) / sizeof(s_impl_names[0]) ==
+                  (size_t)Impl::MAX);
+
+    if (impl < Impl::AUTO || impl >= Impl::MAX) {
+        return "unknown";
+    }
+    return s_impl_names[(int)impl];
+}
+
+bool maskWith(Impl impl, char *dst, const char *src, size_t size,
+              const uint8_t *mask_key, size_t key_offset)
+{
+    if (Impl::AUTO == impl) {
+        impl = getImpl();
+    }
+    if (isSupported(impl) == false) {
+        return false;
+    }
+
+    getMaskFunc(impl)(dst, src, size, rotateKey(mask_key, key_offset));
+
+    return true;
+}
+
+} // namespace brickred::protocol::web_socket_mask
@@ -0,0 +1,32 @@
+#ifndef BRICKRED_PROTOCOL_WEB_SOCKET_MASK_H
+#define BRICKRED_PROTOCOL_WEB_SOCKET_MASK_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace brickred::protocol::web_socket_mask {
+
+enum class Impl {
+    AUTO = 0,
+    BYTE,
+    WORD,
+    SSE2,
+    AVX2,
+    MAX
+};
+
+// dst[i] = src[i] ^ mask_key[(key_offset + i) & 3], dst can be src,
+// key_offset continues the key of a payload masked in pieces
+void mask(char *dst, const char *src, size_t size,
+          const uint8_t *mask_key, size_t key_offset = 0);
+
+// the implementation used by mask(), picked by the cpu at startup
+Impl getImpl();
+const char *getImplName(Impl impl);
+// return false if the cpu does not support impl
+bool maskWith(Impl impl, char *dst, const char *src, size_t size,
+              const uint8_t *mask_key, size_t key_offset = 0);
+
+} // namespace brickred::protocol::web_socket_mask
+
+#endif
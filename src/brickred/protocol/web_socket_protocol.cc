@@ -1,30 +1,160 @@
 #include <brickred/protocol/web_socket_protocol.h>
 
+#include <sys/uio.h>
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <cstring>
-#include <map>
+#include <new>
 #include <vector>
 
 #include <brickred/dynamic_buffer.h>
 #include <brickred/random.h>
 #include <brickred/socket_address.h>
 #include <brickred/string_util.h>
+#include <brickred/tcp_service.h>
 #include <brickred/codec/base64.h>
 #include <brickred/codec/sha1.h>
+#include <brickred/codec/utf8.h>
+#include <brickred/protocol/http_header_map.h>
 #include <brickred/protocol/http_message.h>
 #include <brickred/protocol/http_protocol.h>
 #include <brickred/protocol/http_request.h>
 #include <brickred/protocol/http_response.h>
+#include <brickred/protocol/web_socket_deflate.h>
+#include <brickred/protocol/web_socket_mask.h>
 
 namespace brickred::protocol {
 
+namespace {
+
+// output buffer grown by a large frame is released after the frame
+const size_t s_output_buffer_keep_size = 64 * 1024;
+// buffers start small enough for a control frame, most connections
+// are idle after the handshake
+const size_t s_buffer_init_size = 128;
+
+// header is 2 ~ 10 bytes without mask key, return the header size
+size_t writeFrameHeader(uint8_t *header, int opcode, size_t size, bool mask)
+{
+    size_t header_size = 2;
+
+    // FIN = 1, RSV1~RSV3 = 0
+    header[0] = 0x80 | opcode;
+    // mask flag
+    header[1] = (mask) ? 0x80 : 0x0;
+
+    // payload length
+    if (size < 126) {
+        header[1] |= size;
+    } else if (size <= 65535) {
+        header[1] |= 126;
+        header[2] = size >> 8;
+        header[3] = size;
+        header_size += 2;
+    } else {
+        header[1] |= 127;
+        for (int i = 0; i < 8; ++i) {
+            header[2 + i] = (uint64_t)size >> (56 - i * 8);
+        }
+        header_size += 8;
+    }
+
+    return header_size;
+}
+
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+// the frame bytes follow the block in one allocation
+struct WebSocketProtocol::Frame::Block {
+    std::atomic<int> ref_count_;
+    size_t size_;
+
+    char *getData() { return (char *)(this + 1); }
+
+    static Block *create(size_t size)
+    {
+        void *p = ::operator new(sizeof(Block) + size);
+        Block *block = new (p) Block();
+        block->ref_count_.store(1, std::memory_order_relaxed);
+        block->size_ = size;
+        return block;
+    }
+
+    void retain()
+    {
+        ref_count_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void release()
+    {
+        if (ref_count_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            this->~Block();
+            ::operator delete((void *)this);
+        }
+    }
+
+    // release callback of zero copy send, buffer is the frame data
+    static void onBufferRelease(TcpService *service,
+                                TcpService::SocketId socket_id,
+                                const char *buffer)
+    {
+        ((Block *)buffer - 1)->release();
+    }
+};
+
+WebSocketProtocol::Frame::Frame() :
+    block_(nullptr)
+{
+}
+
+WebSocketProtocol::Frame::Frame(const Frame &copy) :
+    block_(copy.block_)
+{
+    if (block_ != nullptr) {
+        block_->retain();
+    }
+}
+
+WebSocketProtocol::Frame::~Frame()
+{
+    if (block_ != nullptr) {
+        block_->release();
+    }
+}
+
+WebSocketProtocol::Frame &WebSocketProtocol::Frame::operator=(
+    const Frame &rhs)
+{
+    if (rhs.block_ != nullptr) {
+        rhs.block_->retain();
+    }
+    if (block_ != nullptr) {
+        block_->release();
+    }
+    block_ = rhs.block_;
+
+    return *this;
+}
+
+const char *WebSocketProtocol::Frame::getData() const
+{
+    return (block_ != nullptr) ? block_->getData() : nullptr;
+}
+
+size_t WebSocketProtocol::Frame::getSize() const
+{
+    return (block_ != nullptr) ? block_->size_ : 0;
+}
+
 class WebSocketProtocol::Impl {
 public:
     using Status = WebSocketProtocol::Status;
     using RetCode = WebSocketProtocol::RetCode;
     using OutputCallback = WebSocketProtocol::OutputCallback;
-    using HeaderMap = std::map<std::string, std::string,
-                               string_util::CaseInsensitiveLess>;
+    using OutputVCallback = WebSocketProtocol::OutputVCallback;
+    using HeaderMap = HttpHeaderMap;
     using StatusHandler = int (WebSocketProtocol::Impl::*)(DynamicBuffer *);
 
     Impl();
@@ -33,6 +163,7 @@ public:
     Status getStatus() const { return status_; }
 
     void setOutputCallback(const OutputCallback &output_cb);
+    void setOutputVCallback(const OutputVCallback &outputv_cb);
     void setHandshakeHeader(const std::string &key, const std::string &value);
 
     bool startAsClient(const SocketAddress &peer_addr,
@@ -41,23 +172,40 @@ public:
     bool startAsServer();
 
     RetCode recvMessage(DynamicBuffer *buffer);
-    bool retrieveMessage(DynamicBuffer *message);
-    void sendMessage(const char *buffer, size_t size);
+    bool retrieveMessage(DynamicBuffer *message, int *opcode);
+    bool retrieveFragment(DynamicBuffer *fragment, int *opcode, bool *fin);
+    void sendMessage(int opcode, const char *buffer, size_t size);
+    bool sendFragment(int opcode, const char *buffer, size_t size,
+                      bool fin);
     void sendCloseFrame();
     void sendPingFrame();
+    bool sendEncodedFrame(const Frame &frame);
 
     void setMessageMaxSize(size_t size);
+    void setStreamingEnabled(bool enabled);
+
+    void setDeflateEnabled(bool enabled);
+    void setDeflateMaxWindowBits(int bits);
+    void setDeflateNoContextTakeover(bool no_context_takeover);
+    void setDeflateMemLevel(int level);
+    void setDeflateThreshold(size_t size);
+    bool isDeflateActive() const;
 
 private:
     bool checkHandshakeRequestValid(const HttpRequest &request) const;
     void sendHandshakeErrorResponse();
     void sendHandshakeSuccessResponse(const HttpRequest &request);
     bool checkHandshakeResponseValid(
-        const HttpResponse &response, const std::string &sec_key) const;
+        const HttpResponse &response, const std::string &sec_key);
+    WebSocketDeflate *createDeflate() const;
 
     int readHandshakeRequest(DynamicBuffer *buffer);
     int readHandshakeResponse(DynamicBuffer *buffer);
     int readFrame(DynamicBuffer *buffer);
+    int readFramePayload(DynamicBuffer *buffer);
+    int updateMessageOpCode(int opcode, bool fin);
+    bool sendFrame(int opcode, const char *buffer, size_t size,
+                   bool fin = true);
     void sendPongFrame();
 
 private:
@@ -66,16 +214,46 @@ private:
 private:
     Status status_;
     OutputCallback output_cb_;
+    OutputVCallback outputv_cb_;
     Random *random_generator_;
-    HttpProtocol http_protocol_;
+    // released after the handshake
+    UniquePtr<HttpProtocol> http_protocol_;
     HeaderMap handshake_headers_;
     DynamicBuffer control_message_;
     DynamicBuffer message_;
+    DynamicBuffer output_buffer_;
     bool is_client_;
     bool close_frame_sent_;
     int last_op_code_;
     RetCode ret_code_;
     size_t message_size_max_;
+    int message_op_code_;
+    bool fragment_sending_;
+    int fragment_send_op_code_;
+    codec::utf8::Validator utf8_validator_;
+
+    // streaming receive, payload of the current frame is read in pieces
+    bool streaming_enabled_;
+    uint64_t frame_left_bytes_;
+    uint8_t frame_mask_key_[4];
+    bool frame_masked_;
+    size_t frame_mask_offset_;
+    bool frame_fin_;
+    int fragment_op_code_;
+    bool fragment_fin_;
+    bool fragment_ready_;
+    bool inflate_pending_;
+
+    // permessage-deflate
+    bool deflate_enabled_;
+    int deflate_max_window_bits_;
+    bool deflate_no_context_takeover_;
+    int deflate_mem_level_;
+    size_t deflate_threshold_;
+    UniquePtr<WebSocketDeflate> deflate_;
+    bool message_compressed_;
+    bool message_send_compressed_;
+    DynamicBuffer inflate_buffer_;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -93,10 +271,35 @@ WebSocketProtocol::Impl::s_status_handler_[] = {
 WebSocketProtocol::Impl::Impl() :
     status_(Status::DETACHED),
     random_generator_(nullptr),
+    http_protocol_(new HttpProtocol()),
+    control_message_(s_buffer_init_size),
+    message_(s_buffer_init_size),
+    output_buffer_(s_buffer_init_size),
     is_client_(false), close_frame_sent_(false), last_op_code_(-1),
     ret_code_(RetCode::ERROR),
-    message_size_max_(0)
+    message_size_max_(0),
+    message_op_code_(-1),
+    fragment_sending_(false),
+    fragment_send_op_code_(-1),
+    streaming_enabled_(false),
+    frame_left_bytes_(0),
+    frame_masked_(false),
+    frame_mask_offset_(0),
+    frame_fin_(false),
+    fragment_op_code_(-1),
+    fragment_fin_(false),
+    fragment_ready_(false),
+    inflate_pending_(false),
+    deflate_enabled_(false),
+    deflate_max_window_bits_(0),
+    deflate_no_context_takeover_(false),
+    deflate_mem_level_(0),
+    deflate_threshold_(0),
+    message_compressed_(false),
+    message_send_compressed_(false),
+    inflate_buffer_(s_buffer_init_size)
 {
+    ::memset(frame_mask_key_, 0, sizeof(frame_mask_key_));
 }
 
 WebSocketProtocol::Impl::~Impl()
@@ -106,14 +309,22 @@ WebSocketProtocol::Impl::~Impl()
 void WebSocketProtocol::Impl::setOutputCallback(
     const OutputCallback &output_cb)
 {
-    http_protocol_.setOutputCallback(output_cb);
+    if (http_protocol_) {
+        http_protocol_->setOutputCallback(output_cb);
+    }
     output_cb_ = output_cb;
 }
 
+void WebSocketProtocol::Impl::setOutputVCallback(
+    const OutputVCallback &outputv_cb)
+{
+    outputv_cb_ = outputv_cb;
+}
+
 void WebSocketProtocol::Impl::setHandshakeHeader(const std::string &key,
                                                  const std::string &value)
 {
-    handshake_headers_[key] = value;
+    handshake_headers_.set(key, value);
 }
 
 bool WebSocketProtocol::Impl::startAsClient(
@@ -147,6 +358,14 @@ bool WebSocketProtocol::Impl::startAsClient(
         setHandshakeHeader("Sec-WebSocket-Key",
                            codec::base64Encode(&key[0], key.size()));
     }
+    // offer permessage-deflate if extensions are not provided
+    if (deflate_enabled_ && WebSocketDeflate::isSupported() &&
+        handshake_headers_.find("Sec-WebSocket-Extensions") ==
+            handshake_headers_.end()) {
+        deflate_.reset(createDeflate());
+        request.setHeader("Sec-WebSocket-Extensions",
+                          deflate_->buildOffer());
+    }
     // set header 'Host' if not provided
     if (handshake_headers_.find("Host") ==
         handshake_headers_.end()) {
@@ -161,7 +380,7 @@ bool WebSocketProtocol::Impl::startAsClient(
         request.setHeader(iter->first, iter->second);
     }
 
-    http_protocol_.sendMessage(request);
+    http_protocol_->sendMessage(request);
 
     return true;
 }
@@ -261,6 +480,21 @@ void WebSocketProtocol::Impl::sendHandshakeSuccessResponse(
         codec::base64Encode(codec::sha1Binary(sec_key +
             "258EAFA5-E914-47DA-95CA-C5AB0DC85B11")));
 
+    // accept permessage-deflate if extensions are not provided
+    if (deflate_enabled_ &&
+        request.hasHeader("Sec-WebSocket-Extensions") &&
+        handshake_headers_.find("Sec-WebSocket-Extensions") ==
+            handshake_headers_.end()) {
+        UniquePtr<WebSocketDeflate> deflate(createDeflate());
+        std::string extensions;
+        if (deflate->acceptOffer(
+                request.getHeader("Sec-WebSocket-Extensions"),
+                &extensions)) {
+            response.setHeader("Sec-WebSocket-Extensions", extensions);
+            deflate_.reset(deflate.release());
+        }
+    }
+
     // set handshake headers
     for (HeaderMap::const_iterator iter = handshake_headers_.begin();
          iter != handshake_headers_.end(); ++iter) {
@@ -272,18 +506,18 @@ void WebSocketProtocol::Impl::sendHandshakeSuccessResponse(
         response.setDate();
     }
 
-    http_protocol_.sendMessage(response);
+    http_protocol_->sendMessage(response);
 }
 
 int WebSocketProtocol::Impl::readHandshakeRequest(DynamicBuffer *buffer)
 {
-    HttpProtocol::RetCode ret = http_protocol_.recvMessage(buffer);
+    HttpProtocol::RetCode ret = http_protocol_->recvMessage(buffer);
     if (HttpProtocol::RetCode::WAITING_MORE_DATA == ret) {
         return 0;
 
     } else if (HttpProtocol::RetCode::MESSAGE_READY == ret) {
         HttpRequest request;
-        if (http_protocol_.retrieveRequest(&request) == false) {
+        if (http_protocol_->retrieveRequest(&request) == false) {
             sendHandshakeErrorResponse();
             return -1;
         }
@@ -294,6 +528,7 @@ int WebSocketProtocol::Impl::readHandshakeRequest(DynamicBuffer *buffer)
         }
 
         sendHandshakeSuccessResponse(request);
+        http_protocol_.reset();
 
         status_ = Status::CONNECTED;
         ret_code_ = RetCode::CONNECTION_ESTABLISHED;
@@ -306,7 +541,7 @@ int WebSocketProtocol::Impl::readHandshakeRequest(DynamicBuffer *buffer)
 }
 
 bool WebSocketProtocol::Impl::checkHandshakeResponseValid(
-    const HttpResponse &response, const std::string &sec_key) const
+    const HttpResponse &response, const std::string &sec_key)
 {
     // check status code
     if (response.getStatusCode() != 101) {
@@ -330,25 +565,49 @@ bool WebSocketProtocol::Impl::checkHandshakeResponseValid(
         return false;
     }
 
+    // check header 'Sec-WebSocket-Extensions' if permessage-deflate
+    // is offered, the server can only accept it or decline
+    if (deflate_ && response.hasHeader("Sec-WebSocket-Extensions")) {
+        if (deflate_->acceptResponse(
+                response.getHeader("Sec-WebSocket-Extensions")) == false) {
+            return false;
+        }
+    }
+
     return true;
 }
 
+WebSocketDeflate *WebSocketProtocol::Impl::createDeflate() const
+{
+    WebSocketDeflate *deflate = new WebSocketDeflate();
+    deflate->setMaxWindowBits(deflate_max_window_bits_);
+    deflate->setNoContextTakeover(deflate_no_context_takeover_);
+    deflate->setMemLevel(deflate_mem_level_);
+
+    return deflate;
+}
+
 int WebSocketProtocol::Impl::readHandshakeResponse(DynamicBuffer *buffer)
 {
-    HttpProtocol::RetCode ret = http_protocol_.recvMessage(buffer);
+    HttpProtocol::RetCode ret = http_protocol_->recvMessage(buffer);
     if (HttpProtocol::RetCode::WAITING_MORE_DATA == ret) {
         return 0;
 
     } else if (HttpProtocol::RetCode::MESSAGE_READY == ret) {
         HttpResponse response;
-        if (http_protocol_.retrieveResponse(&response) == false) {
+        if (http_protocol_->retrieveResponse(&response) == false) {
             return -1;
         }
 
-        if (checkHandshakeResponseValid(response,
-                handshake_headers_["Sec-WebSocket-Key"]) == false) {
+        // the key is always set by startAsClient()
+        HeaderMap::const_iterator sec_key = handshake_headers_.find(
+            HeaderMap::KnownHeader::SEC_WEBSOCKET_KEY);
+        if (sec_key == handshake_headers_.end() ||
+            checkHandshakeResponseValid(response,
+                                        sec_key->second) == false) {
             return -1;
         }
+        http_protocol_.reset();
 
         status_ = Status::CONNECTED;
         ret_code_ = RetCode::CONNECTION_ESTABLISHED;
@@ -361,20 +620,32 @@ int WebSocketProtocol::Impl::readHandshakeResponse(DynamicBuffer *buffer)
 
 int WebSocketProtocol::Impl::readFrame(DynamicBuffer *buffer)
 {
+    // in the middle of a streamed frame
+    if (frame_left_bytes_ > 0 || inflate_pending_) {
+        return readFramePayload(buffer);
+    }
+
     if (buffer->readableBytes() < 2) {
         return 0;
     }
 
     const uint8_t *b = (uint8_t *)buffer->readBegin();
 
-    // check RSV1, RSV2, RSV3
-    if ((b[0] & 0x70) != 0) {
+    // check RSV2, RSV3
+    if ((b[0] & 0x30) != 0) {
         return -1;
     }
     bool fin = b[0] & 0x80;
+    bool rsv1 = b[0] & 0x40;
     int opcode = b[0] & 0x0f;
     bool is_control = opcode >= 0x8;
 
+    // RSV1 is the compressed flag of permessage-deflate, only in the
+    // first frame of a data message
+    if (rsv1 && (isDeflateActive() == false || is_control || 0x0 == opcode)) {
+        return -1;
+    }
+
     // control frames MUST NOT be fragmented
     if (is_control && fin == false) {
         return -1;
@@ -425,8 +696,8 @@ int WebSocketProtocol::Impl::readFrame(DynamicBuffer *buffer)
         left_bytes -= 8;
     }
 
-    // exceed max size
-    if (is_control == false &&
+    // exceed max size, a streamed frame is read in pieces
+    if (is_control == false && streaming_enabled_ == false &&
         message_.readableBytes() + payload_length > message_size_max_) {
         return -1;
     }
@@ -456,6 +727,28 @@ int WebSocketProtocol::Impl::readFrame(DynamicBuffer *buffer)
         }
     }
 
+    // data frame of streaming mode, payload is returned as it arrives
+    if (streaming_enabled_ && is_control == false) {
+        fragment_op_code_ = updateMessageOpCode(opcode, fin);
+        if (-1 == fragment_op_code_) {
+            return -1;
+        }
+        if (opcode != 0x0) {
+            message_compressed_ = rsv1;
+        }
+        frame_left_bytes_ = payload_length;
+        frame_masked_ = mask;
+        if (mask) {
+            ::memcpy(frame_mask_key_, mask_key, 4);
+        }
+        frame_mask_offset_ = 0;
+        frame_fin_ = fin;
+
+        buffer->read(p - b);
+
+        return readFramePayload(buffer);
+    }
+
     // get payload
     DynamicBuffer *message = nullptr;
     if (is_control) {
@@ -468,14 +761,13 @@ int WebSocketProtocol::Impl::readFrame(DynamicBuffer *buffer)
         if (left_bytes < payload_length) {
             return 0;
         }
-        // copy payload
+        // copy payload, unmasking is done during the copy
         message->reserveWritableBytes(payload_length);
-        ::memcpy(message->writeBegin(), p, payload_length);
-        // do masking
         if (mask) {
-            for (size_t i = 0; i < payload_length; ++i) {
-                *(message->writeBegin() + i) ^= mask_key[i & 0x03];
-            }
+            web_socket_mask::mask(message->writeBegin(), (const char *)p,
+                                  payload_length, mask_key);
+        } else {
+            ::memcpy(message->writeBegin(), p, payload_length);
         }
         message->write(payload_length);
         // move forward
@@ -485,43 +777,52 @@ int WebSocketProtocol::Impl::readFrame(DynamicBuffer *buffer)
 
     buffer->read(p - b);
 
+    if (0x1 == opcode || 0x2 == opcode) {
+        message_compressed_ = rsv1;
+    }
+
     // process frame
+    opcode = updateMessageOpCode(opcode, fin);
+    if (-1 == opcode) {
+        return -1;
+    }
+    // text is validated frame by frame right after unmasking,
+    // compressed text is validated after inflating
+    if (0x1 == opcode && !message_compressed_ &&
+        utf8_validator_.update(message_.readBegin() +
+                message_.readableBytes() - payload_length,
+            payload_length) == false) {
+        return -1;
+    }
     // -- not fin
     if (!fin) {
-        if (opcode != 0x0) {
-            // opcode must in first frag
-            if (last_op_code_ != -1) {
-                return -1;
-            }
-            last_op_code_ = opcode;
-        } else {
-            // 0x0 should in follow frag
-            if (last_op_code_ == -1) {
-                return -1;
-            }
-        }
         return 1;
     }
 
-    // -- fin
-    if (0x0 == opcode) {
-        // 0x0 should in follow frag
-        if (last_op_code_ == -1) {
-            return -1;
-        }
-        opcode = last_op_code_;
-        last_op_code_ = -1;
-    } else {
-        // opcode must in first frag
-        if (is_control == false) {
-            if (last_op_code_ != -1) {
+    if (0x1 == opcode || 0x2 == opcode) {
+        // data frame
+        if (message_compressed_) {
+            // message max size is applied to the decompressed size
+            if (deflate_->decompress(message_.readBegin(),
+                    message_.readableBytes(), &inflate_buffer_,
+                    message_size_max_) == false) {
                 return -1;
             }
+            message_.swap(inflate_buffer_);
+            inflate_buffer_.clear();
+            if (inflate_buffer_.capacity() > s_output_buffer_keep_size) {
+                DynamicBuffer empty_buffer(s_buffer_init_size);
+                inflate_buffer_.swap(empty_buffer);
+            }
+            message_compressed_ = false;
+            if (0x1 == opcode && codec::utf8::validate(
+                    message_.readBegin(), message_.readableBytes()) == false) {
+                return -1;
+            }
+        } else if (0x1 == opcode && utf8_validator_.finish() == false) {
+            return -1;
         }
-    }
-
-    if (0x1 == opcode || 0x2 == opcode) {
-        // data frame
+        message_op_code_ = opcode;
         status_ = Status::FINISHED;
         return 1;
 
@@ -551,21 +852,141 @@ int WebSocketProtocol::Impl::readFrame(DynamicBuffer *buffer)
     }
 }
 
-bool WebSocketProtocol::Impl::retrieveMessage(DynamicBuffer *message)
+int WebSocketProtocol::Impl::readFramePayload(DynamicBuffer *buffer)
+{
+    // compressed payload is read into the inflate buffer, no more is
+    // read until the inflated output of it is all returned
+    DynamicBuffer *payload =
+        message_compressed_ ? &inflate_buffer_ : &message_;
+    if (!inflate_pending_) {
+        // a piece is limited by message max size
+        size_t size = std::min((uint64_t)buffer->readableBytes(),
+                               frame_left_bytes_);
+        size = std::min(size, message_size_max_);
+        if (0 == size && frame_left_bytes_ > 0) {
+            return 0;
+        }
+
+        payload->reserveWritableBytes(size);
+        if (frame_masked_) {
+            web_socket_mask::mask(payload->writeBegin(), buffer->readBegin(),
+                                  size, frame_mask_key_, frame_mask_offset_);
+        } else {
+            ::memcpy(payload->writeBegin(), buffer->readBegin(), size);
+        }
+        payload->write(size);
+        buffer->read(size);
+        frame_left_bytes_ -= size;
+        frame_mask_offset_ += size;
+    }
+
+    bool fin = frame_fin_ && 0 == frame_left_bytes_;
+    if (message_compressed_) {
+        size_t consumed = 0;
+        bool done = false;
+        if (deflate_->decompressPiece(inflate_buffer_.readBegin(),
+                inflate_buffer_.readableBytes(), &consumed, &message_,
+                message_size_max_, fin, &done) == false) {
+            return -1;
+        }
+        inflate_buffer_.read(consumed);
+        inflate_pending_ = !done;
+        if (inflate_pending_) {
+            fin = false;
+        } else if (fin) {
+            message_compressed_ = false;
+        }
+    }
+
+    if (0x1 == fragment_op_code_) {
+        if (utf8_validator_.update(message_.readBegin(),
+                                   message_.readableBytes()) == false ||
+            (fin && utf8_validator_.finish() == false)) {
+            return -1;
+        }
+    }
+
+    // empty pieces are only returned to finish a message
+    if (message_.readableBytes() == 0 && !fin) {
+        return 1;
+    }
+
+    fragment_fin_ = fin;
+    fragment_ready_ = true;
+    status_ = Status::FINISHED;
+    ret_code_ = RetCode::FRAGMENT_READY;
+    return 2;
+}
+
+// check the order of frames, return the opcode of the message the
+// frame belongs to, -1 if the order is wrong
+int WebSocketProtocol::Impl::updateMessageOpCode(int opcode, bool fin)
 {
-    if (status_ != Status::FINISHED) {
+    // control frames can be injected in the middle of a message
+    if (opcode >= 0x8) {
+        return opcode;
+    }
+
+    if (0x0 == opcode) {
+        // 0x0 should in follow frag
+        if (last_op_code_ == -1) {
+            return -1;
+        }
+        opcode = last_op_code_;
+        if (fin) {
+            last_op_code_ = -1;
+        }
+    } else {
+        // opcode must in first frag
+        if (last_op_code_ != -1) {
+            return -1;
+        }
+        if (!fin) {
+            last_op_code_ = opcode;
+        }
+    }
+
+    return opcode;
+}
+
+bool WebSocketProtocol::Impl::retrieveMessage(DynamicBuffer *message,
+                                              int *opcode)
+{
+    if (status_ != Status::FINISHED || fragment_ready_) {
         return false;
     }
 
     message->swap(message_);
     message_.clear();
+    if (opcode != nullptr) {
+        *opcode = message_op_code_;
+    }
+
+    status_ = Status::CONNECTED;
+
+    return true;
+}
+
+bool WebSocketProtocol::Impl::retrieveFragment(DynamicBuffer *fragment,
+                                               int *opcode, bool *fin)
+{
+    if (status_ != Status::FINISHED || !fragment_ready_) {
+        return false;
+    }
+
+    fragment->swap(message_);
+    message_.clear();
+    *opcode = fragment_op_code_;
+    *fin = fragment_fin_;
 
+    fragment_ready_ = false;
     status_ = Status::CONNECTED;
 
     return true;
 }
 
-void WebSocketProtocol::Impl::sendMessage(const char *buffer, size_t size)
+void WebSocketProtocol::Impl::sendMessage(int opcode,
+                                          const char *buffer, size_t size)
 {
     if (status_ != Status::CONNECTED) {
         return;
@@ -573,58 +994,143 @@ void WebSocketProtocol::Impl::sendMessage(const char *buffer, size_t size)
     if (close_frame_sent_) {
         return;
     }
+    // frames of another message can not be interleaved
+    if (fragment_sending_) {
+        return;
+    }
 
-    DynamicBuffer message;
+    sendFrame(opcode, buffer, size);
+}
 
-    message.reserveWritableBytes(2);
-    // FIN = 1, RSV1~RSV3 = 0, opcode = 0x2
-    message.writeBegin()[0] = 0x82;
-    message.write(1);
+bool WebSocketProtocol::Impl::sendFragment(int opcode,
+                                           const char *buffer, size_t size,
+                                           bool fin)
+{
+    if (status_ != Status::CONNECTED) {
+        return false;
+    }
+    if (close_frame_sent_) {
+        return false;
+    }
+    // opcode of the message is decided by the first frame
+    if (fragment_sending_ && opcode != fragment_send_op_code_) {
+        return false;
+    }
 
-    // mask flag
-    message.writeBegin()[0] = (is_client_) ? 0x80 : 0x0;
+    // data frame first, continuation frame then
+    if (sendFrame(fragment_sending_ ? 0x0 : opcode,
+                  buffer, size, fin) == false) {
+        return false;
+    }
+    fragment_sending_ = !fin;
+    fragment_send_op_code_ = opcode;
 
-    // payload length
-    if (size < 126) {
-        message.writeBegin()[0] |= size;
-        message.write(1);
-    } else if (size <= 65535) {
-        message.writeBegin()[0] |= 126;
-        message.write(1);
-        message.writeInt16(size);
-    } else {
-        message.writeBegin()[0] |= 127;
-        message.write(1);
-        message.writeInt64(size);
+    return true;
+}
+
+bool WebSocketProtocol::Impl::sendFrame(int opcode,
+                                        const char *buffer, size_t size,
+                                        bool fin)
+{
+    // data message large enough is compressed, the first frame
+    // decides for the whole message
+    bool compressed = false;
+    if (opcode < 0x8 && isDeflateActive()) {
+        if (opcode != 0x0) {
+            message_send_compressed_ = size >= deflate_threshold_;
+        }
+        const char *compressed_buffer = nullptr;
+        size_t compressed_size = 0;
+        if (message_send_compressed_) {
+            if (deflate_->compress(buffer, size, &compressed_buffer,
+                                   &compressed_size, fin)) {
+                buffer = compressed_buffer;
+                size = compressed_size;
+                compressed = true;
+            } else if (0x0 == opcode) {
+                // the peer is inflating the message, plain data
+                // can not follow
+                return false;
+            } else {
+                message_send_compressed_ = false;
+            }
+        }
+    }
+
+    // header is 2 ~ 14 bytes, built on the stack
+    uint8_t header[14];
+    size_t header_size = writeFrameHeader(header, opcode, size, is_client_);
+    if (!fin) {
+        // FIN
+        header[0] &= 0x7f;
+    }
+    if (compressed && opcode != 0x0) {
+        // RSV1
+        header[0] |= 0x40;
     }
 
-    // mask key
-    uint8_t mask_key_buf[4] = {};
     const uint8_t *mask_key = nullptr;
     if (is_client_) {
-        message.reserveWritableBytes(4);
+        // mask key
+        mask_key = header + header_size;
         for (size_t i = 0; i < 4; ++i) {
-            mask_key_buf[i] = random_generator_->nextInt(256);
-            message.writeBegin()[i] = mask_key_buf[i];
+            header[header_size++] = random_generator_->nextInt(256);
         }
-        message.write(4);
-        mask_key = (uint8_t *)mask_key_buf;
+    } else if (outputv_cb_) {
+        struct iovec buffers[2];
+        buffers[0].iov_base = header;
+        buffers[0].iov_len = header_size;
+        buffers[1].iov_base = const_cast<char *>(buffer);
+        buffers[1].iov_len = size;
+        outputv_cb_(buffers, size > 0 ? 2 : 1);
+        return true;
     }
 
-    // payload
-    message.reserveWritableBytes(size);
-    ::memcpy(message.writeBegin(), buffer, size);
-    // do masking
+    if (!output_cb_) {
+        return true;
+    }
+
+    // the payload is masked during the copy
+    output_buffer_.reserveWritableBytes(header_size + size);
+    char *p = output_buffer_.writeBegin();
+    ::memcpy(p, header, header_size);
     if (mask_key != nullptr) {
-        for (size_t i = 0; i < size; ++i) {
-            message.writeBegin()[i] ^= mask_key[i & 0x03];
-        }
+        web_socket_mask::mask(p + header_size, buffer, size, mask_key);
+    } else {
+        ::memcpy(p + header_size, buffer, size);
     }
-    message.write(size);
+    output_buffer_.write(header_size + size);
 
-    if (output_cb_) {
-        output_cb_(message.readBegin(), message.readableBytes());
+    output_cb_(output_buffer_.readBegin(), output_buffer_.readableBytes());
+
+    output_buffer_.clear();
+    if (output_buffer_.capacity() > s_output_buffer_keep_size) {
+        DynamicBuffer empty_buffer(s_buffer_init_size);
+        output_buffer_.swap(empty_buffer);
     }
+
+    return true;
+}
+
+bool WebSocketProtocol::Impl::sendEncodedFrame(const Frame &frame)
+{
+    if (status_ != Status::CONNECTED) {
+        return false;
+    }
+    if (close_frame_sent_ || fragment_sending_) {
+        return false;
+    }
+    // encoded frame is not masked
+    if (is_client_) {
+        return false;
+    }
+    if (frame.empty() || !output_cb_) {
+        return false;
+    }
+
+    output_cb_(frame.getData(), frame.getSize());
+
+    return true;
 }
 
 void WebSocketProtocol::Impl::sendCloseFrame()
@@ -682,35 +1188,9 @@ void WebSocketProtocol::Impl::sendPongFrame()
         return;
     }
 
-    if (output_cb_) {
-        if (is_client_) {
-            size_t payload_length = control_message_.readableBytes();
-            // FIN = 1, RSV1~RSV3 = 0, opcode = 0xa
-            uint8_t client_frame[256];
-            client_frame[0] = 0x8a;
-            client_frame[1] = payload_length;
-            client_frame[1] |= 0x80;
-            for (int i = 0; i < 4; ++i) {
-                client_frame[i + 2] = random_generator_->nextInt(256);
-            }
-            ::memcpy(client_frame + 6, control_message_.readBegin(),
-                payload_length);
-            // do masking
-            for (size_t i = 0; i < payload_length; ++i) {
-                client_frame[6 + i] ^= client_frame[2 + (i & 0x03)];
-            }
-            output_cb_((const char *)client_frame, payload_length + 6);
-        } else {
-            size_t payload_length = control_message_.readableBytes();
-            // FIN = 1, RSV1~RSV3 = 0, opcode = 0xa
-            uint8_t server_frame[128];
-            server_frame[0] = 0x8a;
-            server_frame[1] = payload_length;
-            ::memcpy(server_frame + 2, control_message_.readBegin(),
-                payload_length);
-            output_cb_((const char *)server_frame, payload_length + 2);
-        }
-    }
+    // pong frame echoes the payload of ping frame
+    sendFrame(0xa, control_message_.readBegin(),
+              control_message_.readableBytes());
 }
 
 void WebSocketProtocol::Impl::setMessageMaxSize(size_t size)
@@ -721,11 +1201,59 @@ void WebSocketProtocol::Impl::setMessageMaxSize(size_t size)
     message_size_max_ = size;
 }
 
+void WebSocketProtocol::Impl::setStreamingEnabled(bool enabled)
+{
+    streaming_enabled_ = enabled;
+}
+
+void WebSocketProtocol::Impl::setDeflateEnabled(bool enabled)
+{
+    deflate_enabled_ = enabled;
+}
+
+void WebSocketProtocol::Impl::setDeflateMaxWindowBits(int bits)
+{
+    if (bits < 9 || bits > 15) {
+        return;
+    }
+    deflate_max_window_bits_ = bits;
+}
+
+void WebSocketProtocol::Impl::setDeflateNoContextTakeover(
+    bool no_context_takeover)
+{
+    deflate_no_context_takeover_ = no_context_takeover;
+}
+
+void WebSocketProtocol::Impl::setDeflateMemLevel(int level)
+{
+    if (level < 1 || level > 9) {
+        return;
+    }
+    deflate_mem_level_ = level;
+}
+
+void WebSocketProtocol::Impl::setDeflateThreshold(size_t size)
+{
+    deflate_threshold_ = size;
+}
+
+bool WebSocketProtocol::Impl::isDeflateActive() const
+{
+    return deflate_ && deflate_->isActive();
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 WebSocketProtocol::WebSocketProtocol() :
     pimpl_(new Impl())
 {
     setMessageMaxSize();
+    setStreamingEnabled();
+    setDeflateEnabled();
+    setDeflateMaxWindowBits();
+    setDeflateNoContextTakeover();
+    setDeflateMemLevel();
+    setDeflateThreshold();
 }
 
 WebSocketProtocol::~WebSocketProtocol()
@@ -742,6 +1270,11 @@ void WebSocketProtocol::setOutputCallback(const OutputCallback &output_cb)
     pimpl_->setOutputCallback(output_cb);
 }
 
+void WebSocketProtocol::setOutputVCallback(const OutputVCallback &outputv_cb)
+{
+    pimpl_->setOutputVCallback(outputv_cb);
+}
+
 void WebSocketProtocol::setHandshakeHeader(const std::string &key,
                                            const std::string &value)
 {
@@ -768,12 +1301,40 @@ WebSocketProtocol::RetCode WebSocketProtocol::recvMessage(
 
 bool WebSocketProtocol::retrieveMessage(DynamicBuffer *message)
 {
-    return pimpl_->retrieveMessage(message);
+    return pimpl_->retrieveMessage(message, nullptr);
+}
+
+bool WebSocketProtocol::retrieveMessage(DynamicBuffer *message, int *opcode)
+{
+    return pimpl_->retrieveMessage(message, opcode);
+}
+
+bool WebSocketProtocol::retrieveFragment(DynamicBuffer *fragment,
+                                         int *opcode, bool *fin)
+{
+    return pimpl_->retrieveFragment(fragment, opcode, fin);
 }
 
 void WebSocketProtocol::sendMessage(const char *buffer, size_t size)
 {
-    pimpl_->sendMessage(buffer, size);
+    pimpl_->sendMessage(0x2, buffer, size);
+}
+
+void WebSocketProtocol::sendTextMessage(const char *buffer, size_t size)
+{
+    pimpl_->sendMessage(0x1, buffer, size);
+}
+
+bool WebSocketProtocol::sendFragment(const char *buffer, size_t size,
+                                     bool fin)
+{
+    return pimpl_->sendFragment(0x2, buffer, size, fin);
+}
+
+bool WebSocketProtocol::sendTextFragment(const char *buffer, size_t size,
+                                         bool fin)
+{
+    return pimpl_->sendFragment(0x1, buffer, size, fin);
 }
 
 void WebSocketProtocol::sendCloseFrame()
@@ -786,9 +1347,87 @@ void WebSocketProtocol::sendPingFrame()
     pimpl_->sendPingFrame();
 }
 
+bool WebSocketProtocol::sendEncodedFrame(const Frame &frame)
+{
+    return pimpl_->sendEncodedFrame(frame);
+}
+
 void WebSocketProtocol::setMessageMaxSize(size_t size)
 {
     pimpl_->setMessageMaxSize(size);
 }
 
+void WebSocketProtocol::setStreamingEnabled(bool enabled)
+{
+    pimpl_->setStreamingEnabled(enabled);
+}
+
+void WebSocketProtocol::setDeflateEnabled(bool enabled)
+{
+    pimpl_->setDeflateEnabled(enabled);
+}
+
+void WebSocketProtocol::setDeflateMaxWindowBits(int bits)
+{
+    pimpl_->setDeflateMaxWindowBits(bits);
+}
+
+void WebSocketProtocol::setDeflateNoContextTakeover(bool no_context_takeover)
+{
+    pimpl_->setDeflateNoContextTakeover(no_context_takeover);
+}
+
+void WebSocketProtocol::setDeflateMemLevel(int level)
+{
+    pimpl_->setDeflateMemLevel(level);
+}
+
+void WebSocketProtocol::setDeflateThreshold(size_t size)
+{
+    pimpl_->setDeflateThreshold(size);
+}
+
+bool WebSocketProtocol::isDeflateActive() const
+{
+    return pimpl_->isDeflateActive();
+}
+
+WebSocketProtocol::Frame WebSocketProtocol::encodeFrame(
+    const char *buffer, size_t size)
+{
+    uint8_t header[10];
+    size_t header_size = writeFrameHeader(header, 0x2, size, false);
+
+    Frame frame;
+    frame.block_ = Frame::Block::create(header_size + size);
+    char *p = frame.block_->getData();
+    ::memcpy(p, header, header_size);
+    ::memcpy(p + header_size, buffer, size);
+
+    return frame;
+}
+
+size_t WebSocketProtocol::broadcastFrame(TcpService *service,
+    const int64_t *socket_ids, size_t count, const Frame &frame)
+{
+    if (frame.empty()) {
+        return 0;
+    }
+
+    size_t sent_count = 0;
+    for (size_t i = 0; i < count; ++i) {
+        // released by the callback, which is always called once and
+        // not before kernel is done with the frame even if the socket
+        // is closed in flight
+        frame.block_->retain();
+        if (service->sendMessageZeroCopy(socket_ids[i],
+                frame.getData(), frame.getSize(),
+                BRICKRED_BIND_FREE_FUNC(&Frame::Block::onBufferRelease))) {
+            ++sent_count;
+        }
+    }
+
+    return sent_count;
+}
+
 } // namespace brickred::protocol
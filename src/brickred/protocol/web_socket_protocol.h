@@ -2,15 +2,19 @@
 #define BRICKRED_PROTOCOL_WEB_SOCKET_PROTOCOL_H
 
 #include <cstddef>
+#include <cstdint>
 #include <string>
 
 #include <brickred/class_util.h>
 #include <brickred/function.h>
 #include <brickred/unique_ptr.h>
 
+struct iovec;
+
 namespace brickred { class DynamicBuffer; }
 namespace brickred { class Random; }
 namespace brickred { class SocketAddress; }
+namespace brickred { class TcpService; }
 
 namespace brickred::protocol {
 
@@ -35,9 +39,32 @@ public:
         PEER_CLOSED,
         PING_FRAME,
         PONG_FRAME,
+        FRAGMENT_READY,
+    };
+
+    // an encoded server frame, immutable and shared by copies,
+    // the reference count is atomic so copies can be sent from
+    // different threads
+    class Frame final {
+    public:
+        Frame();
+        Frame(const Frame &copy);
+        ~Frame();
+        Frame &operator=(const Frame &rhs);
+
+        const char *getData() const;
+        size_t getSize() const;
+        bool empty() const { return nullptr == block_; }
+
+    private:
+        friend class WebSocketProtocol;
+        struct Block;
+
+        Block *block_;
     };
 
     using OutputCallback = Function<void (const char *, size_t)>;
+    using OutputVCallback = Function<void (const struct iovec *, int)>;
 
     WebSocketProtocol();
     ~WebSocketProtocol();
@@ -45,6 +72,10 @@ public:
     Status getStatus() const;
 
     void setOutputCallback(const OutputCallback &output_cb);
+    // if set, sendMessage() of a server passes the frame header and the
+    // payload as two buffers instead of copying them together,
+    // frames of a client are always masked into one buffer
+    void setOutputVCallback(const OutputVCallback &outputv_cb);
     void setHandshakeHeader(const std::string &key, const std::string &value);
 
     // send a handshake to the server
@@ -56,11 +87,61 @@ public:
 
     RetCode recvMessage(DynamicBuffer *buffer);
     bool retrieveMessage(DynamicBuffer *message);
+    // opcode is the opcode of the message (0x1 text, 0x2 binary),
+    // text messages are valid utf-8, otherwise recvMessage() fails
+    bool retrieveMessage(DynamicBuffer *message, int *opcode);
+    // get a piece of a data message in streaming mode, opcode is the
+    // opcode of the message, fin is true on the last piece of the
+    // message, a piece of text can end in the middle of a character
+    bool retrieveFragment(DynamicBuffer *fragment, int *opcode, bool *fin);
     void sendMessage(const char *buffer, size_t size);
+    // buffer must be valid utf-8, it is not checked
+    void sendTextMessage(const char *buffer, size_t size);
+    // send a binary message in frames, fin is set on the last frame,
+    // sendMessage() is ignored until the message is finished,
+    // return false if the frame is not sent, the connection should be
+    // closed if a frame of a compressed message fails to compress
+    bool sendFragment(const char *buffer, size_t size, bool fin);
+    // text version of sendFragment(), a message can not mix both
+    bool sendTextFragment(const char *buffer, size_t size, bool fin);
     void sendCloseFrame();
     void sendPingFrame();
+    // send a frame from encodeFrame(), only a server can send it,
+    // return false if the frame is not sent
+    bool sendEncodedFrame(const Frame &frame);
 
     void setMessageMaxSize(size_t size = 1024 * 1024);
+    // if enabled, data messages are not reassembled, recvMessage()
+    // returns FRAGMENT_READY as soon as any payload arrives and
+    // message max size limits a piece instead of the whole message
+    void setStreamingEnabled(bool enabled = false);
+
+    // permessage-deflate (rfc 7692) is offered by a client and accepted
+    // by a server if enabled, the library must be built with zlib
+    // (config.sh --with-zlib), it is never negotiated otherwise
+    void setDeflateEnabled(bool enabled = false);
+    // window bits (9~15) of this side's compressor, also requested for
+    // the peer, compressor memory is (1 << (bits + 2)) +
+    // (1 << (mem_level + 9)) bytes per connection
+    void setDeflateMaxWindowBits(int bits = 15);
+    // reset this side's compressor after each message
+    void setDeflateNoContextTakeover(bool no_context_takeover = false);
+    // zlib memLevel (1~9) of this side's compressor
+    void setDeflateMemLevel(int level = 8);
+    // messages smaller than size are sent uncompressed
+    void setDeflateThreshold(size_t size = 64);
+    // negotiated in the handshake
+    bool isDeflateActive() const;
+
+    // encode a binary message once into a server (not masked) frame
+    static Frame encodeFrame(const char *buffer, size_t size);
+    // send the frame to every socket without copying it per socket,
+    // sockets must be connected web socket peers which have not sent
+    // close frame, the frame is sent by zero copy if it reaches the zero
+    // copy threshold of the service, return the count of sockets sent
+    static size_t broadcastFrame(TcpService *service,
+                                 const int64_t *socket_ids, size_t count,
+                                 const Frame &frame);
 
 private:
     BRICKRED_NONCOPYABLE(WebSocketProtocol)
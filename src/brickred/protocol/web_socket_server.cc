@@ -0,0 +1,753 @@
+#include <brickred/protocol/web_socket_server.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include <brickred/dynamic_buffer.h>
+#include <brickred/io_service.h>
+#include <brickred/socket_address.h>
+
+namespace brickred::protocol {
+
+namespace {
+
+// slots of the timing wheel, a deadline further than a round is
+// relinked when its slot is reached
+const int s_wheel_size = 256;
+const int s_tick_min_ms = 10;
+// output is rarely blocked, the send buffer grows when it is used
+const size_t s_send_buffer_init_size = 128;
+// message buffer is swapped into the protocol of the connection,
+// a grown one is not handed on to idle connections
+const size_t s_message_keep_size = 1024;
+
+} // namespace
+
+class WebSocketServer::Impl {
+public:
+    using SocketId = WebSocketServer::SocketId;
+    using Error = WebSocketServer::Error;
+    using OpenCallback = WebSocketServer::OpenCallback;
+    using MessageCallback = WebSocketServer::MessageCallback;
+    using ErrorCallback = WebSocketServer::ErrorCallback;
+    using CloseCallback = WebSocketServer::CloseCallback;
+
+    class Connection;
+
+    // intrusive node of the timing wheel, a slot is a circular list
+    // with a sentinel node
+    struct WheelNode {
+        WheelNode *prev_;
+        WheelNode *next_;
+        Connection *conn_;
+
+        WheelNode() : prev_(this), next_(this), conn_(nullptr) {}
+
+        bool linked() const { return next_ != this; }
+        void unlink()
+        {
+            prev_->next_ = next_;
+            next_->prev_ = prev_;
+            prev_ = this;
+            next_ = this;
+        }
+        void linkBefore(WheelNode *node)
+        {
+            prev_ = node->prev_;
+            next_ = node;
+            node->prev_->next_ = this;
+            node->prev_ = this;
+        }
+    };
+
+    enum class State {
+        HANDSHAKING,
+        OPEN,
+        CLOSING,
+        CLOSED
+    };
+
+    class Connection : public TcpService::Context {
+    public:
+        Connection(Impl *server, SocketId socket_id);
+        ~Connection() override;
+
+        void onOutput(const char *buffer, size_t size);
+        void onOutputV(const struct iovec *buffers, int count);
+
+        Impl *server_;
+        SocketId socket_id_;
+        WebSocketProtocol protocol_;
+        State state_;
+        // ticks of the server
+        int64_t state_tick_;
+        int64_t last_recv_tick_;
+        int64_t ping_tick_;
+        int64_t deadline_tick_;
+        bool ping_sent_;
+        WheelNode wheel_node_;
+    };
+
+public:
+    Impl(WebSocketServer *thiz, IOService &io_service);
+    ~Impl();
+
+    IOService *getIOService() const;
+    TcpService *getTcpService();
+
+    void setOpenCallback(const OpenCallback &open_cb);
+    void setMessageCallback(const MessageCallback &message_cb);
+    void setErrorCallback(const ErrorCallback &error_cb);
+    void setCloseCallback(const CloseCallback &close_cb);
+
+    void setHandshakeTimeout(int timeout_ms);
+    void setPingInterval(int interval_ms);
+    void setPingTimeout(int timeout_ms);
+    void setCloseTimeout(int timeout_ms);
+    void setMessageMaxSize(size_t size);
+    void setDeflateEnabled(bool enabled);
+
+    SocketId listen(const SocketAddress &addr);
+
+    size_t getConnectionCount() const;
+    bool isOpen(SocketId socket_id) const;
+
+    bool sendMessage(SocketId socket_id, int opcode,
+                     const char *buffer, size_t size);
+    size_t broadcastFrame(const SocketId *socket_ids, size_t count,
+                          const WebSocketProtocol::Frame &frame);
+    void close(SocketId socket_id);
+
+private:
+    void onTick(IOService::TimerId timer_id);
+    void onNewConnection(TcpService *service,
+                         SocketId from_socket_id, SocketId socket_id);
+    void onRecvMessage(TcpService *service,
+                       SocketId socket_id, DynamicBuffer *buffer);
+    void onPeerClose(TcpService *service, SocketId socket_id);
+    void onError(TcpService *service, SocketId socket_id, int error);
+
+    Connection *getOpenConnection(SocketId socket_id) const;
+    int64_t toTicks(int ms) const;
+    // deadline tick of the connection by its state, -1 if none
+    int64_t getDeadline(const Connection *conn) const;
+    // link the connection to the slot of its deadline
+    void schedule(Connection *conn);
+    void checkTimeout(Connection *conn);
+    // callbacks may be called, the socket is left to the caller
+    void finish(Connection *conn);
+    void fail(Connection *conn, Error error);
+    void closeAfterSend(SocketId socket_id);
+
+private:
+    WebSocketServer *thiz_;
+    IOService *io_service_;
+    OpenCallback open_cb_;
+    MessageCallback message_cb_;
+    ErrorCallback error_cb_;
+    CloseCallback close_cb_;
+    int handshake_timeout_ms_;
+    int ping_interval_ms_;
+    int ping_timeout_ms_;
+    int close_timeout_ms_;
+    size_t message_max_size_;
+    bool deflate_enabled_;
+
+    size_t connection_count_;
+    int tick_ms_;
+    int64_t tick_count_;
+    IOService::TimerId tick_timer_id_;
+    WheelNode wheel_[s_wheel_size];
+    DynamicBuffer message_;
+    std::vector<SocketId> broadcast_ids_;
+    // destroyed first, it deletes the connections
+    TcpService tcp_service_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+WebSocketServer::Impl::Connection::Connection(Impl *server,
+                                              SocketId socket_id) :
+    server_(server), socket_id_(socket_id),
+    state_(State::HANDSHAKING),
+    state_tick_(server->tick_count_),
+    last_recv_tick_(server->tick_count_),
+    ping_tick_(0), deadline_tick_(0), ping_sent_(false)
+{
+    wheel_node_.conn_ = this;
+
+    protocol_.setOutputCallback(BRICKRED_BIND_MEM_FUNC(
+        &Connection::onOutput, this));
+    protocol_.setOutputVCallback(BRICKRED_BIND_MEM_FUNC(
+        &Connection::onOutputV, this));
+    protocol_.setMessageMaxSize(server->message_max_size_);
+    protocol_.setDeflateEnabled(server->deflate_enabled_);
+
+    ++server_->connection_count_;
+}
+
+WebSocketServer::Impl::Connection::~Connection()
+{
+    wheel_node_.unlink();
+    --server_->connection_count_;
+}
+
+void WebSocketServer::Impl::Connection::onOutput(const char *buffer,
+                                                 size_t size)
+{
+    server_->tcp_service_.sendMessage(socket_id_, buffer, size);
+}
+
+void WebSocketServer::Impl::Connection::onOutputV(
+    const struct iovec *buffers, int count)
+{
+    server_->tcp_service_.sendMessage(socket_id_, buffers, count);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+WebSocketServer::Impl::Impl(WebSocketServer *thiz, IOService &io_service) :
+    thiz_(thiz), io_service_(&io_service),
+    handshake_timeout_ms_(0), ping_interval_ms_(0),
+    ping_timeout_ms_(0), close_timeout_ms_(0),
+    message_max_size_(0), deflate_enabled_(false),
+    connection_count_(0), tick_ms_(0), tick_count_(0),
+    tick_timer_id_(-1),
+    tcp_service_(io_service)
+{
+    tcp_service_.setNewConnectionCallback(BRICKRED_BIND_MEM_FUNC(
+        &Impl::onNewConnection, this));
+    tcp_service_.setRecvMessageCallback(BRICKRED_BIND_MEM_FUNC(
+        &Impl::onRecvMessage, this));
+    tcp_service_.setPeerCloseCallback(BRICKRED_BIND_MEM_FUNC(
+        &Impl::onPeerClose, this));
+    tcp_service_.setErrorCallback(BRICKRED_BIND_MEM_FUNC(
+        &Impl::onError, this));
+    tcp_service_.setSendBufferInitSize(s_send_buffer_init_size);
+}
+
+WebSocketServer::Impl::~Impl()
+{
+    if (tick_timer_id_ >= 0) {
+        io_service_->stopTimer(tick_timer_id_);
+    }
+}
+
+IOService *WebSocketServer::Impl::getIOService() const
+{
+    return io_service_;
+}
+
+TcpService *WebSocketServer::Impl::getTcpService()
+{
+    return &tcp_service_;
+}
+
+void WebSocketServer::Impl::setOpenCallback(const OpenCallback &open_cb)
+{
+    open_cb_ = open_cb;
+}
+
+void WebSocketServer::Impl::setMessageCallback(
+    const MessageCallback &message_cb)
+{
+    message_cb_ = message_cb;
+}
+
+void WebSocketServer::Impl::setErrorCallback(const ErrorCallback &error_cb)
+{
+    error_cb_ = error_cb;
+}
+
+void WebSocketServer::Impl::setCloseCallback(const CloseCallback &close_cb)
+{
+    close_cb_ = close_cb;
+}
+
+void WebSocketServer::Impl::setHandshakeTimeout(int timeout_ms)
+{
+    handshake_timeout_ms_ = std::max(timeout_ms, 0);
+}
+
+void WebSocketServer::Impl::setPingInterval(int interval_ms)
+{
+    ping_interval_ms_ = std::max(interval_ms, 0);
+}
+
+void WebSocketServer::Impl::setPingTimeout(int timeout_ms)
+{
+    ping_timeout_ms_ = std::max(timeout_ms, 0);
+}
+
+void WebSocketServer::Impl::setCloseTimeout(int timeout_ms)
+{
+    close_timeout_ms_ = std::max(timeout_ms, 0);
+}
+
+void WebSocketServer::Impl::setMessageMaxSize(size_t size)
+{
+    message_max_size_ = size;
+}
+
+void WebSocketServer::Impl::setDeflateEnabled(bool enabled)
+{
+    deflate_enabled_ = enabled;
+}
+
+WebSocketServer::Impl::SocketId WebSocketServer::Impl::listen(
+    const SocketAddress &addr)
+{
+    SocketId socket_id = tcp_service_.listen(addr);
+    if (socket_id < 0) {
+        return -1;
+    }
+
+    // the tick is fixed by the timeouts at the first listen
+    if (tick_timer_id_ < 0) {
+        int shortest = 0;
+        const int timeouts[] = {
+            handshake_timeout_ms_, ping_interval_ms_,
+            ping_timeout_ms_, close_timeout_ms_
+        };
+        for (size_t i = 0; i < sizeof(timeouts) / sizeof(timeouts[0]);
+             ++i) {
+            if (timeouts[i] > 0 &&
+                (0 == shortest || timeouts[i] < shortest)) {
+                shortest = timeouts[i];
+            }
+        }
+        if (shortest > 0) {
+            tick_ms_ = std::max(shortest / 8, s_tick_min_ms);
+            tick_timer_id_ = io_service_->startTimer(tick_ms_,
+                BRICKRED_BIND_MEM_FUNC(&Impl::onTick, this));
+        }
+    }
+
+    return socket_id;
+}
+
+size_t WebSocketServer::Impl::getConnectionCount() const
+{
+    return connection_count_;
+}
+
+bool WebSocketServer::Impl::isOpen(SocketId socket_id) const
+{
+    return getOpenConnection(socket_id) != nullptr;
+}
+
+bool WebSocketServer::Impl::sendMessage(SocketId socket_id, int opcode,
+                                        const char *buffer, size_t size)
+{
+    Connection *conn = getOpenConnection(socket_id);
+    if (nullptr == conn) {
+        return false;
+    }
+
+    if (0x1 == opcode) {
+        conn->protocol_.sendTextMessage(buffer, size);
+    } else {
+        conn->protocol_.sendMessage(buffer, size);
+    }
+
+    return true;
+}
+
+size_t WebSocketServer::Impl::broadcastFrame(
+    const SocketId *socket_ids, size_t count,
+    const WebSocketProtocol::Frame &frame)
+{
+    broadcast_ids_.clear();
+    for (size_t i = 0; i < count; ++i) {
+        if (getOpenConnection(socket_ids[i]) != nullptr) {
+            broadcast_ids_.push_back(socket_ids[i]);
+        }
+    }
+    if (broadcast_ids_.empty()) {
+        return 0;
+    }
+
+    return WebSocketProtocol::broadcastFrame(&tcp_service_,
+        &broadcast_ids_[0], broadcast_ids_.size(), frame);
+}
+
+void WebSocketServer::Impl::close(SocketId socket_id)
+{
+    Connection *conn = (Connection *)tcp_service_.getContext(socket_id);
+    if (nullptr == conn) {
+        return;
+    }
+
+    if (State::OPEN == conn->state_) {
+        conn->protocol_.sendCloseFrame();
+        conn->state_ = State::CLOSING;
+        conn->state_tick_ = tick_count_;
+        schedule(conn);
+
+    } else if (State::HANDSHAKING == conn->state_) {
+        // never opened, no callback is needed
+        conn->state_ = State::CLOSED;
+        conn->wheel_node_.unlink();
+        closeAfterSend(socket_id);
+    }
+}
+
+WebSocketServer::Impl::Connection *
+WebSocketServer::Impl::getOpenConnection(SocketId socket_id) const
+{
+    Connection *conn = (Connection *)tcp_service_.getContext(socket_id);
+    if (nullptr == conn || conn->state_ != State::OPEN) {
+        return nullptr;
+    }
+
+    return conn;
+}
+
+int64_t WebSocketServer::Impl::toTicks(int ms) const
+{
+    return (ms + tick_ms_ - 1) / tick_ms_;
+}
+
+int64_t WebSocketServer::Impl::getDeadline(const Connection *conn) const
+{
+    if (State::HANDSHAKING == conn->state_) {
+        if (handshake_timeout_ms_ > 0) {
+            return conn->state_tick_ + toTicks(handshake_timeout_ms_);
+        }
+    } else if (State::OPEN == conn->state_) {
+        if (conn->ping_sent_) {
+            if (ping_timeout_ms_ > 0) {
+                return conn->ping_tick_ + toTicks(ping_timeout_ms_);
+            }
+        } else if (ping_interval_ms_ > 0) {
+            return conn->last_recv_tick_ + toTicks(ping_interval_ms_);
+        }
+    } else if (State::CLOSING == conn->state_) {
+        if (close_timeout_ms_ > 0) {
+            return conn->state_tick_ + toTicks(close_timeout_ms_);
+        }
+    }
+
+    return -1;
+}
+
+void WebSocketServer::Impl::schedule(Connection *conn)
+{
+    conn->wheel_node_.unlink();
+    if (tick_ms_ <= 0) {
+        return;
+    }
+
+    int64_t deadline = getDeadline(conn);
+    if (deadline < 0) {
+        return;
+    }
+
+    conn->deadline_tick_ = std::max(deadline, tick_count_ + 1);
+    conn->wheel_node_.linkBefore(
+        &wheel_[conn->deadline_tick_ % s_wheel_size]);
+}
+
+void WebSocketServer::Impl::onTick(IOService::TimerId timer_id)
+{
+    ++tick_count_;
+
+    WheelNode *slot = &wheel_[tick_count_ % s_wheel_size];
+    if (slot->linked() == false) {
+        return;
+    }
+
+    // move the slot out, connections are unlinked one by one so
+    // callbacks can close any connection safely
+    WheelNode expired;
+    expired.linkBefore(slot);
+    slot->unlink();
+
+    while (expired.linked()) {
+        Connection *conn = expired.next_->conn_;
+        conn->wheel_node_.unlink();
+        if (conn->deadline_tick_ > tick_count_) {
+            // later round of the wheel
+            conn->wheel_node_.linkBefore(slot);
+            continue;
+        }
+        checkTimeout(conn);
+    }
+}
+
+void WebSocketServer::Impl::checkTimeout(Connection *conn)
+{
+    // recv only updates the ticks, the real deadline may be later
+    int64_t deadline = getDeadline(conn);
+    if (deadline < 0) {
+        return;
+    }
+    if (deadline > tick_count_) {
+        schedule(conn);
+        return;
+    }
+
+    SocketId socket_id = conn->socket_id_;
+
+    if (State::HANDSHAKING == conn->state_) {
+        fail(conn, Error::HANDSHAKE_TIMEOUT);
+        tcp_service_.closeSocket(socket_id);
+
+    } else if (State::OPEN == conn->state_) {
+        if (conn->ping_sent_) {
+            fail(conn, Error::PING_TIMEOUT);
+            tcp_service_.closeSocket(socket_id);
+        } else {
+            conn->protocol_.sendPingFrame();
+            conn->ping_sent_ = true;
+            conn->ping_tick_ = tick_count_;
+            schedule(conn);
+        }
+
+    } else if (State::CLOSING == conn->state_) {
+        fail(conn, Error::CLOSE_TIMEOUT);
+        tcp_service_.closeSocket(socket_id);
+    }
+}
+
+void WebSocketServer::Impl::finish(Connection *conn)
+{
+    State state = conn->state_;
+    conn->state_ = State::CLOSED;
+    conn->wheel_node_.unlink();
+
+    if ((State::OPEN == state || State::CLOSING == state) && close_cb_) {
+        close_cb_(thiz_, conn->socket_id_);
+    }
+}
+
+void WebSocketServer::Impl::fail(Connection *conn, Error error)
+{
+    State state = conn->state_;
+    conn->state_ = State::CLOSED;
+    conn->wheel_node_.unlink();
+
+    if (error_cb_) {
+        error_cb_(thiz_, conn->socket_id_, error);
+    }
+    if ((State::OPEN == state || State::CLOSING == state) && close_cb_) {
+        close_cb_(thiz_, conn->socket_id_);
+    }
+}
+
+void WebSocketServer::Impl::closeAfterSend(SocketId socket_id)
+{
+    // nothing to send, close after the pending output is sent
+    if (tcp_service_.sendMessageThenClose(socket_id, "", 0) == false) {
+        tcp_service_.closeSocket(socket_id);
+    }
+}
+
+void WebSocketServer::Impl::onNewConnection(TcpService *service,
+    SocketId from_socket_id, SocketId socket_id)
+{
+    UniquePtr<Connection> conn(new Connection(this, socket_id));
+    if (conn->protocol_.startAsServer() == false ||
+        service->setContext(socket_id, conn.get()) == false) {
+        service->closeSocket(socket_id);
+        return;
+    }
+    schedule(conn.release());
+}
+
+void WebSocketServer::Impl::onRecvMessage(TcpService *service,
+    SocketId socket_id, DynamicBuffer *buffer)
+{
+    Connection *conn = (Connection *)service->getContext(socket_id);
+    if (nullptr == conn) {
+        service->closeSocket(socket_id);
+        return;
+    }
+    if (State::CLOSED == conn->state_) {
+        buffer->read(buffer->readableBytes());
+        return;
+    }
+
+    // any frame answers the ping
+    conn->last_recv_tick_ = tick_count_;
+    conn->ping_sent_ = false;
+
+    // pings and pongs are replied by the protocol
+    for (;;) {
+        WebSocketProtocol::RetCode ret = conn->protocol_.recvMessage(buffer);
+        if (WebSocketProtocol::RetCode::WAITING_MORE_DATA == ret) {
+            break;
+
+        } else if (WebSocketProtocol::RetCode::CONNECTION_ESTABLISHED ==
+                   ret) {
+            conn->state_ = State::OPEN;
+            conn->state_tick_ = tick_count_;
+            schedule(conn);
+            if (open_cb_) {
+                open_cb_(thiz_, socket_id);
+            }
+
+        } else if (WebSocketProtocol::RetCode::MESSAGE_READY == ret) {
+            int opcode = 0;
+            if (conn->protocol_.retrieveMessage(&message_, &opcode) &&
+                message_cb_) {
+                message_cb_(thiz_, socket_id, opcode, &message_);
+            }
+            message_.clear();
+            if (message_.capacity() > s_message_keep_size) {
+                DynamicBuffer empty_buffer(s_message_keep_size);
+                message_.swap(empty_buffer);
+            }
+
+        } else if (WebSocketProtocol::RetCode::PEER_CLOSED == ret) {
+            // close frame is replied by the protocol
+            finish(conn);
+            break;
+
+        } else if (WebSocketProtocol::RetCode::ERROR == ret) {
+            fail(conn, State::HANDSHAKING == conn->state_ ?
+                 Error::HANDSHAKE_FAILED : Error::PROTOCOL_ERROR);
+            break;
+        }
+    }
+
+    if (State::CLOSED == conn->state_) {
+        buffer->read(buffer->readableBytes());
+        closeAfterSend(socket_id);
+    }
+}
+
+void WebSocketServer::Impl::onPeerClose(TcpService *service,
+                                        SocketId socket_id)
+{
+    Connection *conn = (Connection *)service->getContext(socket_id);
+    if (conn != nullptr && conn->state_ != State::CLOSED) {
+        finish(conn);
+    }
+    service->closeSocket(socket_id);
+}
+
+void WebSocketServer::Impl::onError(TcpService *service,
+                                    SocketId socket_id, int error)
+{
+    Connection *conn = (Connection *)service->getContext(socket_id);
+    if (conn != nullptr && conn->state_ != State::CLOSED) {
+        fail(conn, Error::SOCKET_ERROR);
+    }
+    service->closeSocket(socket_id);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+WebSocketServer::WebSocketServer(IOService &io_service) :
+    pimpl_(new Impl(this, io_service))
+{
+    setHandshakeTimeout();
+    setPingInterval();
+    setPingTimeout();
+    setCloseTimeout();
+    setMessageMaxSize();
+    setDeflateEnabled();
+}
+
+WebSocketServer::~WebSocketServer()
+{
+}
+
+IOService *WebSocketServer::getIOService() const
+{
+    return pimpl_->getIOService();
+}
+
+TcpService *WebSocketServer::getTcpService()
+{
+    return pimpl_->getTcpService();
+}
+
+void WebSocketServer::setOpenCallback(const OpenCallback &open_cb)
+{
+    pimpl_->setOpenCallback(open_cb);
+}
+
+void WebSocketServer::setMessageCallback(const MessageCallback &message_cb)
+{
+    pimpl_->setMessageCallback(message_cb);
+}
+
+void WebSocketServer::setErrorCallback(const ErrorCallback &error_cb)
+{
+    pimpl_->setErrorCallback(error_cb);
+}
+
+void WebSocketServer::setCloseCallback(const CloseCallback &close_cb)
+{
+    pimpl_->setCloseCallback(close_cb);
+}
+
+void WebSocketServer::setHandshakeTimeout(int timeout_ms)
+{
+    pimpl_->setHandshakeTimeout(timeout_ms);
+}
+
+void WebSocketServer::setPingInterval(int interval_ms)
+{
+    pimpl_->setPingInterval(interval_ms);
+}
+
+void WebSocketServer::setPingTimeout(int timeout_ms)
+{
+    pimpl_->setPingTimeout(timeout_ms);
+}
+
+void WebSocketServer::setCloseTimeout(int timeout_ms)
+{
+    pimpl_->setCloseTimeout(timeout_ms);
+}
+
+void WebSocketServer::setMessageMaxSize(size_t size)
+{
+    pimpl_->setMessageMaxSize(size);
+}
+
+void WebSocketServer::setDeflateEnabled(bool enabled)
+{
+    pimpl_->setDeflateEnabled(enabled);
+}
+
+WebSocketServer::SocketId WebSocketServer::listen(const SocketAddress &addr)
+{
+    return pimpl_->listen(addr);
+}
+
+size_t WebSocketServer::getConnectionCount() const
+{
+    return pimpl_->getConnectionCount();
+}
+
+bool WebSocketServer::isOpen(SocketId socket_id) const
+{
+    return pimpl_->isOpen(socket_id);
+}
+
+bool WebSocketServer::sendMessage(SocketId socket_id,
+                                  const char *buffer, size_t size)
+{
+    return pimpl_->sendMessage(socket_id, 0x2, buffer, size);
+}
+
+bool WebSocketServer::sendTextMessage(SocketId socket_id,
+                                      const char *buffer, size_t size)
+{
+    return pimpl_->sendMessage(socket_id, 0x1, buffer, size);
+}
+
+size_t WebSocketServer::broadcastFrame(const SocketId *socket_ids,
+    size_t count, const WebSocketProtocol::Frame &frame)
+{
+    return pimpl_->broadcastFrame(socket_ids, count, frame);
+}
+
+void WebSocketServer::close(SocketId socket_id)
+{
+    pimpl_->close(socket_id);
+}
+
+} // namespace brickred::protocol
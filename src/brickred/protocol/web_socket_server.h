@@ -0,0 +1,104 @@
+#ifndef BRICKRED_PROTOCOL_WEB_SOCKET_SERVER_H
+#define BRICKRED_PROTOCOL_WEB_SOCKET_SERVER_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <brickred/class_util.h>
+#include <brickred/function.h>
+#include <brickred/tcp_service.h>
+#include <brickred/unique_ptr.h>
+#include <brickred/protocol/web_socket_protocol.h>
+
+namespace brickred { class DynamicBuffer; }
+namespace brickred { class IOService; }
+namespace brickred { class SocketAddress; }
+
+namespace brickred::protocol {
+
+// web socket server on TcpService and WebSocketProtocol, handshake,
+// keepalive ping and close handshake timeouts of all connections are
+// checked by one timing wheel driven by a single coarse timer
+class WebSocketServer final {
+public:
+    using SocketId = TcpService::SocketId;
+
+    enum class Error {
+        HANDSHAKE_FAILED,
+        HANDSHAKE_TIMEOUT,
+        PROTOCOL_ERROR,
+        PING_TIMEOUT,
+        CLOSE_TIMEOUT,
+        SOCKET_ERROR,
+        MAX
+    };
+
+    // handshake is done
+    using OpenCallback = Function<void (WebSocketServer *, SocketId)>;
+    // opcode is 0x1 for text and 0x2 for binary
+    using MessageCallback =
+        Function<void (WebSocketServer *, SocketId, int, DynamicBuffer *)>;
+    // the connection is going to be closed after error callback,
+    // close callback is still called if it is opened
+    using ErrorCallback =
+        Function<void (WebSocketServer *, SocketId, Error)>;
+    // called once for every opened connection, no more callback of
+    // the connection is called after it
+    using CloseCallback = Function<void (WebSocketServer *, SocketId)>;
+
+    explicit WebSocketServer(IOService &io_service);
+    ~WebSocketServer();
+
+    IOService *getIOService() const;
+    // the callbacks of the service must not be changed
+    TcpService *getTcpService();
+
+    void setOpenCallback(const OpenCallback &open_cb);
+    void setMessageCallback(const MessageCallback &message_cb);
+    void setErrorCallback(const ErrorCallback &error_cb);
+    void setCloseCallback(const CloseCallback &close_cb);
+
+    // settings below must be set before listen(), timeouts are checked
+    // in a tick of 1/8 of the shortest one (at least 10ms) and may be
+    // exceeded by up to a tick, 0 means no timeout
+    void setHandshakeTimeout(int timeout_ms = 10000);
+    // ping the connection idle for interval_ms
+    void setPingInterval(int interval_ms = 30000);
+    // any frame must be received in timeout_ms after the ping
+    void setPingTimeout(int timeout_ms = 10000);
+    // peer close frame must be received in timeout_ms after close()
+    void setCloseTimeout(int timeout_ms = 5000);
+    void setMessageMaxSize(size_t size = 1024 * 1024);
+    // permessage-deflate, see WebSocketProtocol::setDeflateEnabled()
+    void setDeflateEnabled(bool enabled = false);
+
+    // can be called more than once to listen on several addresses
+    SocketId listen(const SocketAddress &addr);
+
+    size_t getConnectionCount() const;
+    bool isOpen(SocketId socket_id) const;
+
+    // return false if the connection is not open
+    bool sendMessage(SocketId socket_id, const char *buffer, size_t size);
+    // buffer must be valid utf-8, it is not checked
+    bool sendTextMessage(SocketId socket_id,
+                         const char *buffer, size_t size);
+    // send a frame to every open connection in socket_ids,
+    // return the count of connections sent
+    size_t broadcastFrame(const SocketId *socket_ids, size_t count,
+                          const WebSocketProtocol::Frame &frame);
+    // start the close handshake, the connection is closed when the peer
+    // replies or close timeout, a connection not open is closed at once,
+    // callbacks are never called in this function
+    void close(SocketId socket_id);
+
+private:
+    BRICKRED_NONCOPYABLE(WebSocketServer)
+
+    class Impl;
+    UniquePtr<Impl> pimpl_;
+};
+
+} // namespace brickred::protocol
+
+#endif
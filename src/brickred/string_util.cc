@@ -6,6 +6,10 @@
 #include <cctype>
 #include <algorithm>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 namespace brickred::string_util {
 
 void split(const char *str, const char *sep,
@@ -207,6 +211,33 @@ const char *find(const char *str, size_t str_len, const char *keyword)
     }
 }
 
+const char *findFirstOf(const char *str, size_t str_len, char c1, char c2)
+{
+    const char *p = str;
+    const char *end = str + str_len;
+
+#ifdef __SSE2__
+    __m128i v1 = _mm_set1_epi8(c1);
+    __m128i v2 = _mm_set1_epi8(c2);
+    for (; end - p >= 16; p += 16) {
+        __m128i data = _mm_loadu_si128((const __m128i *)p);
+        int mask = _mm_movemask_epi8(_mm_or_si128(
+            _mm_cmpeq_epi8(data, v1), _mm_cmpeq_epi8(data, v2)));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+#endif
+
+    for (; p < end; ++p) {
+        if (*p == c1 || *p == c2) {
+            return p;
+        }
+    }
+
+    return nullptr;
+}
+
 bool caseInsensitiveEqual(const std::string &lhs, const std::string &rhs)
 {
     if (lhs.size() != rhs.size()) {
@@ -30,6 +30,8 @@ std::string toString(unsigned long ul);
 std::string toString(unsigned long long ull);
 
 const char *find(const char *str, size_t str_len, const char *keyword);
+// find the first c1 or c2, return nullptr if not found
+const char *findFirstOf(const char *str, size_t str_len, char c1, char c2);
 bool caseInsensitiveEqual(const std::string &lhs, const std::string &rhs);
 
 struct Hash {
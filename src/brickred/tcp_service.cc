@@ -1,9 +1,13 @@
 #include <brickred/tcp_service.h>
 
+#include <poll.h>
+#include <sys/uio.h>
 #include <cerrno>
+#include <climits>
 #include <cstdint>
 #include <cstring>
 #include <algorithm>
+#include <deque>
 #include <unordered_map>
 
 #include <brickred/dynamic_buffer.h>
@@ -12,11 +16,17 @@
 #include <brickred/io_service.h>
 #include <brickred/socket_address.h>
 #include <brickred/tcp_socket.h>
+#include <brickred/timestamp.h>
 
 namespace brickred {
 
 namespace {
 
+// time waiting for the zero copy completions when service is destroyed
+static const int ZERO_COPY_WAIT_TIMEOUT_MSEC = 1000;
+// interval polling the zero copy completions of a hung up socket
+static const int ZERO_COPY_POLL_INTERVAL_MSEC = 10;
+
 class SocketIdAllocator {
 public:
     SocketIdAllocator() : value_(0) {}
@@ -47,7 +57,26 @@ public:
         PENDING_ERROR,
     };
 
+    enum class ZeroCopyStatus {
+        NONE,
+        ENABLED,
+        DISABLED,
+    };
+
     using SendCompleteCallback = TcpService::SendCompleteCallback;
+    using BufferReleaseCallback = TcpService::BufferReleaseCallback;
+
+    // buffer queued after write buffer, sent in order
+    struct SendSegment {
+        const char *buffer;
+        size_t size;
+        size_t sent;
+        bool zero_copy;
+        bool has_seq;
+        uint32_t last_seq;
+        BufferReleaseCallback release_cb;
+    };
+    using SendSegmentQueue = std::deque<SendSegment>;
 
     explicit TcpConnection(TcpSocket *socket,
                            size_t read_buffer_init_size,
@@ -65,6 +94,23 @@ public:
     void setStatus(Status status) { status_ = status; }
     void setError(int error_code);
 
+    SendSegmentQueue &getPendingSegments() { return pending_segments_; }
+    SendSegmentQueue &getInflightSegments() { return inflight_segments_; }
+    size_t getPendingCopyBytes() const { return pending_copy_bytes_; }
+    void addPendingCopyBytes(size_t size) { pending_copy_bytes_ += size; }
+    void subPendingCopyBytes(size_t size) { pending_copy_bytes_ -= size; }
+    ZeroCopyStatus getZeroCopyStatus() const { return zero_copy_status_; }
+    void setZeroCopyStatus(ZeroCopyStatus status)
+    {
+        zero_copy_status_ = status;
+    }
+    uint32_t nextZeroCopySeq() { return zero_copy_seq_++; }
+    const Timestamp &getLingerDeadline() const { return linger_deadline_; }
+    void setLingerDeadline(const Timestamp &deadline)
+    {
+        linger_deadline_ = deadline;
+    }
+
     const SendCompleteCallback &getSendCompleteCallback() const {
         return send_complete_cb_;
     }
@@ -83,6 +129,12 @@ private:
     DynamicBuffer read_buffer_;
     DynamicBuffer write_buffer_;
     SendCompleteCallback send_complete_cb_;
+    SendSegmentQueue pending_segments_;
+    SendSegmentQueue inflight_segments_;
+    size_t pending_copy_bytes_;
+    ZeroCopyStatus zero_copy_status_;
+    uint32_t zero_copy_seq_;
+    Timestamp linger_deadline_;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -95,7 +147,10 @@ TcpConnection::TcpConnection(TcpSocket *socket,
     status_(Status::NONE),
     error_code_(0),
     read_buffer_(read_buffer_init_size, read_buffer_expand_size),
-    write_buffer_(write_buffer_init_size, write_buffer_expand_size)
+    write_buffer_(write_buffer_init_size, write_buffer_expand_size),
+    pending_copy_bytes_(0),
+    zero_copy_status_(ZeroCopyStatus::NONE),
+    zero_copy_seq_(0)
 {
 }
 
@@ -105,6 +160,13 @@ void TcpConnection::setError(int error_code)
     error_code_ = error_code;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+void releaseCopiedBuffer(TcpService *service,
+                         TcpService::SocketId socket_id, const char *buffer)
+{
+    delete[] buffer;
+}
+
 } // namespace
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -117,6 +179,9 @@ public:
     using PeerCloseCallback = TcpService::PeerCloseCallback;
     using ErrorCallback = TcpService::ErrorCallback;
     using SendCompleteCallback = TcpService::SendCompleteCallback;
+    using BufferReleaseCallback = TcpService::BufferReleaseCallback;
+    using SendSegment = TcpConnection::SendSegment;
+    using SendSegmentQueue = TcpConnection::SendSegmentQueue;
     using TimerId = IOService::TimerId;
     using TimerCallback = IOService::TimerCallback;
     using TcpSocketMap = std::unordered_map<SocketId, TcpSocket *>;
@@ -143,8 +208,15 @@ public:
 
     bool sendMessage(SocketId socket_id, const char *buffer, size_t size,
                      const SendCompleteCallback &send_complete_cb);
+    bool sendMessage(SocketId socket_id,
+                     const struct iovec *buffers, int count,
+                     const SendCompleteCallback &send_complete_cb);
     bool sendMessageThenClose(SocketId socket_id,
                               const char *buffer, size_t size);
+    bool sendMessageZeroCopy(SocketId socket_id,
+                             const char *buffer, size_t size,
+                             const BufferReleaseCallback &release_cb,
+                             const SendCompleteCallback &send_complete_cb);
     void broadcastMessage(const char *buffer, size_t size);
     void closeSocket(SocketId socket_id);
 
@@ -163,6 +235,8 @@ public:
     void setSendBufferExpandSize(size_t size);
     void setSendBufferMaxSize(size_t size);
     void setAcceptPauseTimeWhenExceedOpenFileLimit(int ms);
+    void setZeroCopyThreshold(size_t size);
+    void setZeroCopyLingerTime(int ms);
 
 private:
     SocketId buildListenSocket(UniquePtr<TcpSocket> &socket);
@@ -181,6 +255,9 @@ private:
     void onSocketRead(IODevice *io_device);
     void onSocketWrite(IODevice *io_device);
     void onSocketError(IODevice *io_device);
+    void onLingerSocketError(IODevice *io_device);
+    void onLingerSocketPoll(TimerId timer_id);
+    void onLingerSocketTimeout(TimerId timer_id);
 
     bool sendMessage(TcpConnection *connection,
                      const char *buffer, size_t size,
@@ -188,6 +265,25 @@ private:
     void onSendMessageError(TimerId timer_id);
     void sendCompleteCloseCallback(TcpService *service, SocketId socket_id);
 
+    bool queueCopySegment(TcpConnection *connection,
+                          const char *buffer, size_t size,
+                          const SendCompleteCallback &send_complete_cb);
+    bool prepareZeroCopy(TcpConnection *connection);
+    bool sendPendingSegments(TcpConnection *connection,
+                             SendSegmentQueue *released);
+    bool recvZeroCopyCompletion(TcpConnection *connection,
+                                SendSegmentQueue *released);
+    void releaseSegments(SocketId socket_id, SendSegmentQueue *released);
+    void releaseUnsentSegments(TcpConnection *connection,
+                               SendSegmentQueue *released);
+    void lingerConnection(TcpConnection *connection);
+    void closeLingerConnection(SocketId socket_id, bool reset);
+    void resetZeroCopySocket(TcpConnection *connection,
+                             SendSegmentQueue *released);
+    void waitZeroCopyCompletion(TcpConnection *connection,
+                                const Timestamp &deadline,
+                                SendSegmentQueue *released);
+
 private:
     TcpService *thiz_;
     IOService *io_service_;
@@ -195,6 +291,8 @@ private:
     SocketIdAllocator socket_id_allocator_;
     TcpSocketMap sockets_;
     TcpConnectionMap connections_;
+    // closed connections waiting for the zero copy completions
+    TcpConnectionMap linger_connections_;
     ContextMap contexts_;
     SocketId_TimerId_Map socket_to_timer_map_;
     TimerId_SocketId_Map timer_to_socket_map_;
@@ -211,6 +309,8 @@ private:
     size_t conn_write_buffer_expand_size_;
     size_t conn_write_buffer_max_size_;
     int accept_pause_time_when_exceed_open_file_limit_;
+    size_t zero_copy_threshold_;
+    int zero_copy_linger_time_;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -220,7 +320,8 @@ TcpService::Impl::Impl(TcpService *thiz, IOService &io_service) :
     conn_read_buffer_max_size_(0),
     conn_write_buffer_init_size_(0), conn_write_buffer_expand_size_(0),
     conn_write_buffer_max_size_(0),
-    accept_pause_time_when_exceed_open_file_limit_(0)
+    accept_pause_time_when_exceed_open_file_limit_(0),
+    zero_copy_threshold_(0), zero_copy_linger_time_(0)
 {
 }
 
@@ -228,8 +329,35 @@ TcpService::Impl::~Impl()
 {
     for (TcpConnectionMap::iterator iter = connections_.begin();
          iter != connections_.end(); ++iter) {
-        delete iter->second;
+        TcpConnection *connection = iter->second;
+        SendSegmentQueue released;
+        releaseUnsentSegments(connection, &released);
+        if (connection->getInflightSegments().empty()) {
+            delete connection;
+        } else {
+            sockets_.erase(iter->first);
+            lingerConnection(connection);
+            linger_connections_.insert(
+                std::make_pair(iter->first, connection));
+        }
+        releaseSegments(iter->first, &released);
     }
+
+    // the buffers in flight can not be released before the completions
+    Timestamp deadline;
+    deadline.setNow();
+    deadline += ZERO_COPY_WAIT_TIMEOUT_MSEC;
+    for (TcpConnectionMap::iterator iter = linger_connections_.begin();
+         iter != linger_connections_.end(); ++iter) {
+        TcpConnection *connection = iter->second;
+        SendSegmentQueue released;
+        removeSocketTimer(iter->first);
+        waitZeroCopyCompletion(connection, deadline, &released);
+        delete connection->getSocket();
+        delete connection;
+        releaseSegments(iter->first, &released);
+    }
+
     for (TcpSocketMap::iterator iter = sockets_.begin();
          iter != sockets_.end(); ++iter) {
         delete iter->second;
@@ -610,39 +738,56 @@ void TcpService::Impl::onSocketRead(IODevice *io_device)
 void TcpService::Impl::onSocketWrite(IODevice *io_device)
 {
     TcpSocket *socket = static_cast<TcpSocket *>(io_device);
+    SocketId socket_id = socket->getId();
 
-    TcpConnectionMap::iterator iter = connections_.find(socket->getId());
+    TcpConnectionMap::iterator iter = connections_.find(socket_id);
     if (connections_.end() == iter) {
         BRICKRED_INTERNAL_LOG_ERROR(
             "socket(%lx) not found in connection map",
-            socket->getId());
+            socket_id);
         return;
     }
     TcpConnection *connection = iter->second;
     DynamicBuffer &write_buffer = connection->getWriteBuffer();
 
-    int write_size = socket->send(write_buffer.readBegin(),
-                                  write_buffer.readableBytes());
-    if (write_size < 0) {
-        if (errno != EAGAIN) {
-            connection->setError(errno);
-            if (error_cb_) {
-                error_cb_(thiz_, socket->getId(), connection->getErrorCode());
+    if (write_buffer.readableBytes() > 0) {
+        int write_size = socket->send(write_buffer.readBegin(),
+                                      write_buffer.readableBytes());
+        if (write_size < 0) {
+            if (errno != EAGAIN) {
+                connection->setError(errno);
+                if (error_cb_) {
+                    error_cb_(thiz_, socket_id, connection->getErrorCode());
+                }
             }
             return;
         }
-    } else {
         write_buffer.read(write_size);
-        if (write_buffer.readableBytes() == 0) {
-            socket->setWriteCallback(NullFunction());
-            SendCompleteCallback send_complete_cb =
-                connection->getSendCompleteCallback();
-            connection->setSendCompleteCallback(NullFunction());
-            if (send_complete_cb) {
-                send_complete_cb(thiz_, socket->getId());
-            }
+        if (write_buffer.readableBytes() > 0) {
+            return;
         }
     }
+
+    // write buffer is empty, go on with the pending segments
+    SendSegmentQueue released;
+    if (sendPendingSegments(connection, &released) == false) {
+        if (error_cb_) {
+            error_cb_(thiz_, socket_id, connection->getErrorCode());
+        }
+        releaseSegments(socket_id, &released);
+        return;
+    }
+
+    if (connection->getPendingSegments().empty()) {
+        socket->setWriteCallback(NullFunction());
+        SendCompleteCallback send_complete_cb =
+            connection->getSendCompleteCallback();
+        connection->setSendCompleteCallback(NullFunction());
+        if (send_complete_cb) {
+            send_complete_cb(thiz_, socket_id);
+        }
+    }
+    releaseSegments(socket_id, &released);
 }
 
 void TcpService::Impl::onSocketError(IODevice *io_device)
@@ -657,15 +802,103 @@ void TcpService::Impl::onSocketError(IODevice *io_device)
         return;
     }
     TcpConnection *connection = iter->second;
+    SocketId socket_id = socket->getId();
+
+    // zero copy completions are reported by the error queue
+    SendSegmentQueue released;
+    bool has_completion = false;
+    if (connection->getInflightSegments().empty() == false) {
+        has_completion = recvZeroCopyCompletion(connection, &released);
+    }
 
     int socket_error = socket->getSocketError();
+    if (0 == socket_error && has_completion) {
+        releaseSegments(socket_id, &released);
+        return;
+    }
     if (0 == socket_error) {
         socket_error = errno;
     }
     connection->setError(socket_error);
     if (error_cb_) {
-        error_cb_(thiz_, socket->getId(), connection->getErrorCode());
+        error_cb_(thiz_, socket_id, connection->getErrorCode());
+    }
+    releaseSegments(socket_id, &released);
+}
+
+void TcpService::Impl::onLingerSocketError(IODevice *io_device)
+{
+    SocketId socket_id = io_device->getId();
+
+    TcpConnectionMap::iterator iter = linger_connections_.find(socket_id);
+    if (linger_connections_.end() == iter) {
+        BRICKRED_INTERNAL_LOG_ERROR(
+            "socket(%lx) not found in linger connection map",
+            socket_id);
+        return;
     }
+    TcpConnection *connection = iter->second;
+
+    SendSegmentQueue released;
+    if (recvZeroCopyCompletion(connection, &released) == false) {
+        // hang up is reported on every wait after peer closes, so the
+        // socket is not watched any more and the completions are polled
+        io_device->detachIOService();
+        removeSocketTimer(socket_id);
+        addSocketTimer(socket_id, ZERO_COPY_POLL_INTERVAL_MSEC,
+            BRICKRED_BIND_MEM_FUNC(
+                &TcpService::Impl::onLingerSocketPoll, this));
+    } else if (connection->getInflightSegments().empty()) {
+        closeLingerConnection(socket_id, false);
+    }
+    releaseSegments(socket_id, &released);
+}
+
+void TcpService::Impl::onLingerSocketPoll(TimerId timer_id)
+{
+    TimerId_SocketId_Map::iterator iter =
+        timer_to_socket_map_.find(timer_id);
+    if (timer_to_socket_map_.end() == iter) {
+        return;
+    }
+    SocketId socket_id = iter->second;
+    timer_to_socket_map_.erase(iter);
+    socket_to_timer_map_.erase(socket_id);
+
+    TcpConnectionMap::iterator iter2 = linger_connections_.find(socket_id);
+    if (linger_connections_.end() == iter2) {
+        return;
+    }
+    TcpConnection *connection = iter2->second;
+
+    SendSegmentQueue released;
+    recvZeroCopyCompletion(connection, &released);
+    Timestamp now;
+    now.setNow();
+    if (connection->getInflightSegments().empty()) {
+        closeLingerConnection(socket_id, false);
+    } else if (connection->getLingerDeadline() < now) {
+        closeLingerConnection(socket_id, true);
+    } else {
+        addSocketTimer(socket_id, ZERO_COPY_POLL_INTERVAL_MSEC,
+            BRICKRED_BIND_MEM_FUNC(
+                &TcpService::Impl::onLingerSocketPoll, this));
+    }
+    releaseSegments(socket_id, &released);
+}
+
+void TcpService::Impl::onLingerSocketTimeout(TimerId timer_id)
+{
+    TimerId_SocketId_Map::iterator iter =
+        timer_to_socket_map_.find(timer_id);
+    if (timer_to_socket_map_.end() == iter) {
+        return;
+    }
+    SocketId socket_id = iter->second;
+    timer_to_socket_map_.erase(iter);
+    socket_to_timer_map_.erase(socket_id);
+
+    closeLingerConnection(socket_id, true);
 }
 
 TcpService::Impl::SocketId TcpService::Impl::listen(const SocketAddress &addr)
@@ -795,6 +1028,94 @@ bool TcpService::Impl::sendMessage(SocketId socket_id,
     return sendMessage(connection, buffer, size, send_complete_cb);
 }
 
+bool TcpService::Impl::sendMessage(SocketId socket_id,
+    const struct iovec *buffers, int count,
+    const SendCompleteCallback &send_complete_cb)
+{
+    TcpConnectionMap::iterator iter = connections_.find(socket_id);
+    if (connections_.end() == iter) {
+        return false;
+    }
+    TcpConnection *connection = iter->second;
+
+    if (connection->getStatus() != TcpConnection::Status::CONNECTED) {
+        return false;
+    }
+
+    TcpSocket *socket = connection->getSocket();
+    DynamicBuffer &write_buffer = connection->getWriteBuffer();
+
+    // data is queued, append the buffers one by one
+    if (connection->getPendingSegments().empty() == false ||
+        write_buffer.readableBytes() > 0 || count > IOV_MAX) {
+        for (int i = 0; i < count; ++i) {
+            if (sendMessage(connection,
+                    (const char *)buffers[i].iov_base, buffers[i].iov_len,
+                    (i == count - 1) ? send_complete_cb : NullFunction())
+                        == false) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // send directly
+    size_t total_size = 0;
+    for (int i = 0; i < count; ++i) {
+        total_size += buffers[i].iov_len;
+    }
+    int write_size = socket->sendv(buffers, count);
+    if (write_size < 0) {
+        if (errno != EAGAIN) {
+            connection->setError(errno);
+            addSocketTimer(socket->getId(), 0, BRICKRED_BIND_MEM_FUNC(
+                &TcpService::Impl::onSendMessageError, this));
+            return false;
+        } else {
+            write_size = 0;
+        }
+    }
+
+    size_t remain_size = total_size - write_size;
+    if (0 == remain_size) {
+        if (send_complete_cb) {
+            send_complete_cb(thiz_, socket->getId());
+        }
+        return true;
+    }
+
+    // check buffer overflow
+    if (conn_write_buffer_max_size_ > 0 &&
+        remain_size > conn_write_buffer_max_size_) {
+        connection->setError(ENOBUFS);
+        addSocketTimer(socket->getId(), 0, BRICKRED_BIND_MEM_FUNC(
+            &TcpService::Impl::onSendMessageError, this));
+        return false;
+    }
+
+    // write the rest to write buffer
+    write_buffer.reserveWritableBytes(remain_size);
+    size_t skip_size = write_size;
+    for (int i = 0; i < count; ++i) {
+        size_t size = buffers[i].iov_len;
+        if (skip_size >= size) {
+            skip_size -= size;
+            continue;
+        }
+        ::memcpy(write_buffer.writeBegin(),
+            (const char *)buffers[i].iov_base + skip_size, size - skip_size);
+        write_buffer.write(size - skip_size);
+        skip_size = 0;
+    }
+    // set send complete callback
+    connection->setSendCompleteCallback(send_complete_cb);
+    // set writeable callback
+    socket->setWriteCallback(BRICKRED_BIND_MEM_FUNC(
+        &TcpService::Impl::onSocketWrite, this));
+
+    return true;
+}
+
 void TcpService::Impl::broadcastMessage(const char *buffer, size_t size)
 {
     for (TcpConnectionMap::iterator iter = connections_.begin();
@@ -812,6 +1133,11 @@ bool TcpService::Impl::sendMessage(TcpConnection *connection,
         return false;
     }
 
+    // keep the order with the pending segments
+    if (connection->getPendingSegments().empty() == false) {
+        return queueCopySegment(connection, buffer, size, send_complete_cb);
+    }
+
     TcpSocket *socket = connection->getSocket();
     DynamicBuffer &write_buffer = connection->getWriteBuffer();
 
@@ -922,20 +1248,350 @@ bool TcpService::Impl::sendMessageThenClose(SocketId socket_id,
                        &TcpService::Impl::sendCompleteCloseCallback, this));
 }
 
+bool TcpService::Impl::sendMessageZeroCopy(SocketId socket_id,
+    const char *buffer, size_t size,
+    const BufferReleaseCallback &release_cb,
+    const SendCompleteCallback &send_complete_cb)
+{
+    TcpConnectionMap::iterator iter = connections_.find(socket_id);
+    if (connections_.end() == iter) {
+        release_cb(thiz_, socket_id, buffer);
+        return false;
+    }
+    TcpConnection *connection = iter->second;
+
+    // small buffer is cheaper to copy
+    if (0 == zero_copy_threshold_ || size < zero_copy_threshold_ ||
+        connection->getStatus() != TcpConnection::Status::CONNECTED ||
+        prepareZeroCopy(connection) == false) {
+        bool ret = sendMessage(connection, buffer, size, send_complete_cb);
+        release_cb(thiz_, socket_id, buffer);
+        return ret;
+    }
+
+    TcpSocket *socket = connection->getSocket();
+    SendSegmentQueue &pending = connection->getPendingSegments();
+
+    SendSegment segment;
+    segment.buffer = buffer;
+    segment.size = size;
+    segment.sent = 0;
+    segment.zero_copy = true;
+    segment.has_seq = false;
+    segment.last_seq = 0;
+    segment.release_cb = release_cb;
+    pending.push_back(segment);
+    connection->setSendCompleteCallback(send_complete_cb);
+
+    // already waiting for writable
+    if (connection->getWriteBuffer().readableBytes() > 0 ||
+        pending.size() > 1) {
+        return true;
+    }
+
+    // send directly
+    SendSegmentQueue released;
+    if (sendPendingSegments(connection, &released) == false) {
+        addSocketTimer(socket_id, 0, BRICKRED_BIND_MEM_FUNC(
+            &TcpService::Impl::onSendMessageError, this));
+        releaseSegments(socket_id, &released);
+        return false;
+    }
+
+    if (pending.empty()) {
+        connection->setSendCompleteCallback(NullFunction());
+        if (send_complete_cb) {
+            send_complete_cb(thiz_, socket_id);
+        }
+    } else {
+        socket->setWriteCallback(BRICKRED_BIND_MEM_FUNC(
+            &TcpService::Impl::onSocketWrite, this));
+    }
+    releaseSegments(socket_id, &released);
+
+    return true;
+}
+
+bool TcpService::Impl::queueCopySegment(TcpConnection *connection,
+    const char *buffer, size_t size,
+    const SendCompleteCallback &send_complete_cb)
+{
+    TcpSocket *socket = connection->getSocket();
+
+    // check buffer overflow
+    if (conn_write_buffer_max_size_ > 0 &&
+        size + connection->getWriteBuffer().readableBytes() +
+            connection->getPendingCopyBytes() >
+                conn_write_buffer_max_size_) {
+        connection->setError(ENOBUFS);
+        addSocketTimer(socket->getId(), 0, BRICKRED_BIND_MEM_FUNC(
+            &TcpService::Impl::onSendMessageError, this));
+        return false;
+    }
+
+    char *copied = new char[size];
+    ::memcpy(copied, buffer, size);
+
+    SendSegment segment;
+    segment.buffer = copied;
+    segment.size = size;
+    segment.sent = 0;
+    segment.zero_copy = false;
+    segment.has_seq = false;
+    segment.last_seq = 0;
+    segment.release_cb = BRICKRED_BIND_FREE_FUNC(&releaseCopiedBuffer);
+    connection->getPendingSegments().push_back(segment);
+    connection->addPendingCopyBytes(size);
+    // set send complete callback
+    connection->setSendCompleteCallback(send_complete_cb);
+
+    return true;
+}
+
+bool TcpService::Impl::prepareZeroCopy(TcpConnection *connection)
+{
+    if (TcpConnection::ZeroCopyStatus::NONE ==
+            connection->getZeroCopyStatus()) {
+        if (connection->getSocket()->setZeroCopy()) {
+            connection->setZeroCopyStatus(
+                TcpConnection::ZeroCopyStatus::ENABLED);
+        } else {
+            connection->setZeroCopyStatus(
+                TcpConnection::ZeroCopyStatus::DISABLED);
+        }
+    }
+
+    return TcpConnection::ZeroCopyStatus::ENABLED ==
+           connection->getZeroCopyStatus();
+}
+
+bool TcpService::Impl::sendPendingSegments(TcpConnection *connection,
+    SendSegmentQueue *released)
+{
+    TcpSocket *socket = connection->getSocket();
+    SendSegmentQueue &pending = connection->getPendingSegments();
+
+    while (pending.empty() == false) {
+        SendSegment &segment = pending.front();
+        const char *buffer = segment.buffer + segment.sent;
+        size_t size = segment.size - segment.sent;
+
+        int write_size = -1;
+        if (segment.zero_copy &&
+            TcpConnection::ZeroCopyStatus::ENABLED ==
+                connection->getZeroCopyStatus()) {
+            write_size = socket->sendZeroCopy(buffer, size);
+            if (write_size > 0) {
+                segment.has_seq = true;
+                segment.last_seq = connection->nextZeroCopySeq();
+            } else if (write_size < 0 && ENOBUFS == errno) {
+                // notification memory is used up, send by copy
+                write_size = socket->send(buffer, size);
+            }
+        } else {
+            write_size = socket->send(buffer, size);
+        }
+
+        if (write_size < 0) {
+            if (EAGAIN == errno) {
+                return true;
+            }
+            connection->setError(errno);
+            return false;
+        }
+
+        segment.sent += write_size;
+        if (segment.sent < segment.size) {
+            return true;
+        }
+
+        if (segment.has_seq) {
+            // wait for the completion notification
+            connection->getInflightSegments().push_back(segment);
+        } else {
+            if (segment.zero_copy == false) {
+                connection->subPendingCopyBytes(segment.size);
+            }
+            released->push_back(segment);
+        }
+        pending.pop_front();
+    }
+
+    return true;
+}
+
+bool TcpService::Impl::recvZeroCopyCompletion(TcpConnection *connection,
+    SendSegmentQueue *released)
+{
+    TcpSocket *socket = connection->getSocket();
+    SendSegmentQueue &inflight = connection->getInflightSegments();
+    bool has_completion = false;
+
+    for (;;) {
+        uint32_t lo = 0;
+        uint32_t hi = 0;
+        bool copied = false;
+        if (socket->recvZeroCopyCompletion(&lo, &hi, &copied) != 1) {
+            break;
+        }
+        has_completion = true;
+
+        // kernel did copy (e.g. loopback), plain send is cheaper
+        if (copied) {
+            connection->setZeroCopyStatus(
+                TcpConnection::ZeroCopyStatus::DISABLED);
+        }
+
+        // completions of tcp socket are in order
+        while (inflight.empty() == false &&
+               (int32_t)(hi - inflight.front().last_seq) >= 0) {
+            released->push_back(inflight.front());
+            inflight.pop_front();
+        }
+    }
+
+    return has_completion;
+}
+
+void TcpService::Impl::releaseSegments(SocketId socket_id,
+    SendSegmentQueue *released)
+{
+    for (size_t i = 0; i < released->size(); ++i) {
+        const SendSegment &segment = (*released)[i];
+        segment.release_cb(thiz_, socket_id, segment.buffer);
+    }
+    released->clear();
+}
+
+void TcpService::Impl::releaseUnsentSegments(TcpConnection *connection,
+    SendSegmentQueue *released)
+{
+    // a partly sent zero copy segment is already referenced by kernel
+    SendSegmentQueue &inflight = connection->getInflightSegments();
+    SendSegmentQueue &pending = connection->getPendingSegments();
+    for (size_t i = 0; i < pending.size(); ++i) {
+        if (pending[i].has_seq) {
+            inflight.push_back(pending[i]);
+        } else {
+            released->push_back(pending[i]);
+        }
+    }
+    pending.clear();
+}
+
+void TcpService::Impl::lingerConnection(TcpConnection *connection)
+{
+    // kernel still sends the data queued after close() and reads the
+    // buffers in flight until their completions arrive, so the socket
+    // is kept open to receive the completions
+    TcpSocket *socket = connection->getSocket();
+    socket->setReadCallback(NullFunction());
+    socket->setWriteCallback(NullFunction());
+    socket->setErrorCallback(BRICKRED_BIND_MEM_FUNC(
+        &TcpService::Impl::onLingerSocketError, this));
+    socket->shutdownWrite();
+}
+
+void TcpService::Impl::closeLingerConnection(SocketId socket_id, bool reset)
+{
+    TcpConnectionMap::iterator iter = linger_connections_.find(socket_id);
+    if (linger_connections_.end() == iter) {
+        return;
+    }
+    TcpConnection *connection = iter->second;
+    linger_connections_.erase(iter);
+    removeSocketTimer(socket_id);
+
+    SendSegmentQueue released;
+    recvZeroCopyCompletion(connection, &released);
+    if (reset && connection->getInflightSegments().empty() == false) {
+        resetZeroCopySocket(connection, &released);
+    }
+    delete connection->getSocket();
+    delete connection;
+    releaseSegments(socket_id, &released);
+}
+
+void TcpService::Impl::resetZeroCopySocket(TcpConnection *connection,
+    SendSegmentQueue *released)
+{
+    // reset the connection on close, kernel drops the data in flight
+    // instead of reading the buffers any more
+    TcpSocket *socket = connection->getSocket();
+    SendSegmentQueue &inflight = connection->getInflightSegments();
+    socket->setLinger(true, 0);
+    socket->close();
+    released->insert(released->end(), inflight.begin(), inflight.end());
+    inflight.clear();
+}
+
+void TcpService::Impl::waitZeroCopyCompletion(TcpConnection *connection,
+    const Timestamp &deadline, SendSegmentQueue *released)
+{
+    TcpSocket *socket = connection->getSocket();
+    SendSegmentQueue &inflight = connection->getInflightSegments();
+
+    for (;;) {
+        recvZeroCopyCompletion(connection, released);
+        if (inflight.empty()) {
+            return;
+        }
+
+        Timestamp now;
+        now.setNow();
+        if (deadline < now) {
+            break;
+        }
+        struct pollfd pfd;
+        pfd.fd = socket->getDescriptor();
+        pfd.events = 0;
+        if (::poll(&pfd, 1, (int)deadline.distanceMillisecond(now)) == -1 &&
+            errno != EINTR) {
+            break;
+        }
+    }
+
+    resetZeroCopySocket(connection, released);
+}
+
 void TcpService::Impl::closeSocket(SocketId socket_id)
 {
     removeSocketTimer(socket_id);
+    SendSegmentQueue released;
+    bool linger = false;
     {
         TcpConnectionMap::iterator iter = connections_.find(socket_id);
         if (iter != connections_.end()) {
-            delete iter->second;
+            TcpConnection *connection = iter->second;
             connections_.erase(iter);
+            releaseUnsentSegments(connection, &released);
+            if (connection->getInflightSegments().empty()) {
+                delete connection;
+            } else {
+                // the buffers in flight are released by reset if the
+                // completions do not arrive before the deadline
+                Timestamp deadline;
+                deadline.setNow();
+                deadline += zero_copy_linger_time_;
+                connection->setLingerDeadline(deadline);
+                lingerConnection(connection);
+                linger_connections_.insert(
+                    std::make_pair(socket_id, connection));
+                addSocketTimer(socket_id, zero_copy_linger_time_,
+                    BRICKRED_BIND_MEM_FUNC(
+                        &TcpService::Impl::onLingerSocketTimeout, this));
+                linger = true;
+            }
         }
     }
     {
         TcpSocketMap::iterator iter = sockets_.find(socket_id);
         if (iter != sockets_.end()) {
-            delete iter->second;
+            // the socket of linger connection is deleted after the
+            // completions arrive
+            if (!linger) {
+                delete iter->second;
+            }
             sockets_.erase(iter);
         }
     }
@@ -946,6 +1602,7 @@ void TcpService::Impl::closeSocket(SocketId socket_id)
             contexts_.erase(iter);
         }
     }
+    releaseSegments(socket_id, &released);
 }
 
 TcpService::Impl::Context *TcpService::Impl::getContext(
@@ -1063,6 +1720,16 @@ void TcpService::Impl::setAcceptPauseTimeWhenExceedOpenFileLimit(int ms)
     accept_pause_time_when_exceed_open_file_limit_ = ms;
 }
 
+void TcpService::Impl::setZeroCopyThreshold(size_t size)
+{
+    zero_copy_threshold_ = size;
+}
+
+void TcpService::Impl::setZeroCopyLingerTime(int ms)
+{
+    zero_copy_linger_time_ = ms;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 TcpService::Context::~Context()
 {
@@ -1079,6 +1746,8 @@ TcpService::TcpService(IOService &io_service) :
     setSendBufferExpandSize();
     setSendBufferMaxSize();
     setAcceptPauseTimeWhenExceedOpenFileLimit();
+    setZeroCopyThreshold();
+    setZeroCopyLingerTime();
 }
 
 TcpService::~TcpService()
@@ -1132,12 +1801,28 @@ bool TcpService::sendMessage(SocketId socket_id, const char *buffer,
     return pimpl_->sendMessage(socket_id, buffer, size, send_complete_cb);
 }
 
+bool TcpService::sendMessage(SocketId socket_id,
+    const struct iovec *buffers, int count,
+    const SendCompleteCallback &send_complete_cb)
+{
+    return pimpl_->sendMessage(socket_id, buffers, count, send_complete_cb);
+}
+
 bool TcpService::sendMessageThenClose(SocketId socket_id,
     const char *buffer, size_t size)
 {
     return pimpl_->sendMessageThenClose(socket_id, buffer, size);
 }
 
+bool TcpService::sendMessageZeroCopy(SocketId socket_id,
+    const char *buffer, size_t size,
+    const BufferReleaseCallback &release_cb,
+    const SendCompleteCallback &send_complete_cb)
+{
+    return pimpl_->sendMessageZeroCopy(socket_id, buffer, size,
+                                       release_cb, send_complete_cb);
+}
+
 void TcpService::broadcastMessage(const char *buffer, size_t size)
 {
     return pimpl_->broadcastMessage(buffer, size);
@@ -1217,4 +1902,14 @@ void TcpService::setAcceptPauseTimeWhenExceedOpenFileLimit(int ms)
     pimpl_->setAcceptPauseTimeWhenExceedOpenFileLimit(ms);
 }
 
+void TcpService::setZeroCopyThreshold(size_t size)
+{
+    pimpl_->setZeroCopyThreshold(size);
+}
+
+void TcpService::setZeroCopyLingerTime(int ms)
+{
+    pimpl_->setZeroCopyLingerTime(ms);
+}
+
 } // namespace brickred
@@ -13,6 +13,8 @@ namespace brickred { class IOService; }
 namespace brickred { class SocketAddress; }
 namespace brickred { class TcpSocket; }
 
+struct iovec;
+
 namespace brickred {
 
 class TcpService final {
@@ -37,8 +39,12 @@ public:
         Function<void (TcpService *, SocketId, int)>;
     using SendCompleteCallback =
         Function<void (TcpService *, SocketId)>;
+    using BufferReleaseCallback =
+        Function<void (TcpService *, SocketId, const char *)>;
 
     explicit TcpService(IOService &io_service);
+    // blocks for up to 1 second if zero copy buffers are still in flight,
+    // the connections are reset and the buffers released after that
     ~TcpService();
 
     IOService *getIOService() const;
@@ -56,8 +62,21 @@ public:
 
     bool sendMessage(SocketId socket_id, const char *buffer, size_t size,
         const SendCompleteCallback &send_complete_cb = NullFunction());
+    // the buffers are sent in one system call if possible
+    bool sendMessage(SocketId socket_id,
+        const struct iovec *buffers, int count,
+        const SendCompleteCallback &send_complete_cb = NullFunction());
     bool sendMessageThenClose(SocketId socket_id,
                               const char *buffer, size_t size);
+    // the buffer is sent by MSG_ZEROCOPY if its size reach zero copy
+    // threshold, and must be kept unchanged until release_cb is called,
+    // otherwise it is copied and released before this function return,
+    // release_cb is always called exactly once, the buffer in flight is
+    // released after kernel is done with it even if the socket is closed
+    bool sendMessageZeroCopy(SocketId socket_id,
+        const char *buffer, size_t size,
+        const BufferReleaseCallback &release_cb,
+        const SendCompleteCallback &send_complete_cb = NullFunction());
     void broadcastMessage(const char *buffer, size_t size);
     void closeSocket(SocketId socket_id);
 
@@ -76,6 +95,11 @@ public:
     void setSendBufferExpandSize(size_t size = 1024);
     void setSendBufferMaxSize(size_t size = 0);
     void setAcceptPauseTimeWhenExceedOpenFileLimit(int ms = 0);
+    // 0 means zero copy send is disabled
+    void setZeroCopyThreshold(size_t size = 0);
+    // a closed socket waits at most this time for the zero copy
+    // completions, then it is reset and the buffers in flight are released
+    void setZeroCopyLingerTime(int ms = 10000);
 
 private:
     BRICKRED_NONCOPYABLE(TcpService)
@@ -5,7 +5,9 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <linux/errqueue.h>
 #include <cerrno>
+#include <cstring>
 
 namespace brickred {
 
@@ -156,6 +158,72 @@ int TcpSocket::send(const char *buffer, size_t size)
     return ::send(fd_, buffer, size, MSG_NOSIGNAL);
 }
 
+int TcpSocket::sendv(const struct iovec *buffers, int count)
+{
+    struct msghdr msg;
+    ::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = const_cast<struct iovec *>(buffers);
+    msg.msg_iovlen = count;
+
+    return ::sendmsg(fd_, &msg, MSG_NOSIGNAL);
+}
+
+int TcpSocket::sendZeroCopy(const char *buffer, size_t size)
+{
+#ifdef MSG_ZEROCOPY
+    return ::send(fd_, buffer, size, MSG_NOSIGNAL | MSG_ZEROCOPY);
+#else
+    errno = EOPNOTSUPP;
+    return -1;
+#endif
+}
+
+int TcpSocket::recvZeroCopyCompletion(uint32_t *lo, uint32_t *hi,
+                                      bool *copied)
+{
+#ifdef SO_EE_ORIGIN_ZEROCOPY
+    char control[128];
+    struct msghdr msg;
+    ::memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    if (::recvmsg(fd_, &msg, MSG_ERRQUEUE) == -1) {
+        if (EAGAIN == errno) {
+            return 0;
+        }
+        return -1;
+    }
+
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+         cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+        if (!((SOL_IP == cm->cmsg_level && IP_RECVERR == cm->cmsg_type) ||
+              (SOL_IPV6 == cm->cmsg_level &&
+               IPV6_RECVERR == cm->cmsg_type))) {
+            continue;
+        }
+
+        struct sock_extended_err serr;
+        ::memcpy(&serr, CMSG_DATA(cm), sizeof(serr));
+        if (serr.ee_errno != 0 ||
+            serr.ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+            continue;
+        }
+
+        *lo = serr.ee_info;
+        *hi = serr.ee_data;
+        *copied = (serr.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0;
+        return 1;
+    }
+
+    errno = ENOMSG;
+    return -1;
+#else
+    errno = EOPNOTSUPP;
+    return -1;
+#endif
+}
+
 bool TcpSocket::shutdownRead()
 {
     if (::shutdown(fd_, SHUT_RD) != 0) {
@@ -214,6 +282,33 @@ bool TcpSocket::setTcpNoDelay()
     return true;
 }
 
+bool TcpSocket::setZeroCopy()
+{
+#ifdef SO_ZEROCOPY
+    int opt = 1;
+    if (::setsockopt(fd_, SOL_SOCKET, SO_ZEROCOPY, &opt, sizeof(opt)) != 0) {
+        return false;
+    }
+
+    return true;
+#else
+    errno = EOPNOTSUPP;
+    return false;
+#endif
+}
+
+bool TcpSocket::setLinger(bool on, int second)
+{
+    struct linger opt;
+    opt.l_onoff = on ? 1 : 0;
+    opt.l_linger = second;
+    if (::setsockopt(fd_, SOL_SOCKET, SO_LINGER, &opt, sizeof(opt)) != 0) {
+        return false;
+    }
+
+    return true;
+}
+
 bool TcpSocket::activeOpen(const SocketAddress &remote_addr)
 {
     if (open(remote_addr.getProtocol()) == false) {
@@ -2,11 +2,14 @@
 #define BRICKRED_TCP_SOCKET_H
 
 #include <cstddef>
+#include <cstdint>
 
 #include <brickred/class_util.h>
 #include <brickred/io_device.h>
 #include <brickred/socket_address.h>
 
+struct iovec;
+
 namespace brickred {
 
 class TcpSocket final : public IODevice {
@@ -27,6 +30,14 @@ public:
     int readableBytes() const;
     int recv(char *buffer, size_t size);
     int send(const char *buffer, size_t size);
+    int sendv(const struct iovec *buffers, int count);
+    // need setZeroCopy() first, buffer must be kept unchanged until
+    // the completion is read by recvZeroCopyCompletion()
+    int sendZeroCopy(const char *buffer, size_t size);
+    // read one completion notification [lo, hi] from error queue,
+    // copied is true if kernel fell back to copy the data,
+    // return 1 on success, 0 on queue empty, -1 on error
+    int recvZeroCopyCompletion(uint32_t *lo, uint32_t *hi, bool *copied);
 
     bool shutdownRead();
     bool shutdownWrite();
@@ -36,6 +47,10 @@ public:
     int getSocketError();
     bool setReuseAddr();
     bool setTcpNoDelay();
+    bool setZeroCopy();
+    // linger with 0 second makes close() reset the connection and
+    // drop the data not sent
+    bool setLinger(bool on, int second = 0);
 
     // -*- builder methods -*-
     // open()
@@ -23,6 +23,12 @@ void Timestamp::setNow()
     nanosecond_ = tv.tv_nsec;
 }
 
+void Timestamp::setTime(time_t second, int64_t nanosecond)
+{
+    second_ = second;
+    nanosecond_ = nanosecond;
+}
+
 Timestamp &Timestamp::operator+=(int64_t millisecond)
 {
     second_ += millisecond / 1000;
@@ -12,9 +12,11 @@ public:
     ~Timestamp();
 
     void setNow();
+    void setTime(time_t second, int64_t nanosecond);
 
     time_t getSecond() const { return second_; }
     int64_t getMilliSecond() const { return nanosecond_ / 1000000; }
+    int64_t getNanoSecond() const { return nanosecond_; }
 
     Timestamp &operator+=(int64_t millisecond);
     bool operator<(const Timestamp &other) const;
@@ -0,0 +1,933 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <brickred/command_line_option.h>
+#include <brickred/dynamic_buffer.h>
+#include <brickred/rank_set.h>
+#include <brickred/string_util.h>
+#include <brickred/timer_heap.h>
+#include <brickred/timestamp.h>
+#include <brickred/codec/base64.h>
+#include <brickred/codec/md5.h>
+#include <brickred/codec/mt19937.h>
+#include <brickred/codec/sha1.h>
+#include <brickred/codec/sha256.h>
+#include <brickred/codec/url.h>
+#include <brickred/codec/utf8.h>
+
+#include "test/test_util.h"
+
+using namespace brickred;
+
+///////////////////////////////////////////////////////////////////////////////
+// count allocations of the whole program, bench_core is single threaded
+static int64_t s_alloc_count = 0;
+
+void *operator new(size_t size)
+{
+    ++s_alloc_count;
+    void *p = ::malloc(size == 0 ? 1 : size);
+    if (nullptr == p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    ::free(p);
+}
+
+void operator delete(void *p, size_t size) noexcept
+{
+    ::free(p);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+class BenchState {
+public:
+    explicit BenchState(int64_t iterations) :
+        iterations_(iterations), paused_(false),
+        elapsed_ns_(0), alloc_count_(0)
+    {
+        start_ns_ = test::nowNanoseconds();
+        start_alloc_count_ = s_alloc_count;
+    }
+
+    int64_t getIterations() const { return iterations_; }
+
+    // exclude setup code from the result
+    void pauseTiming()
+    {
+        if (paused_) {
+            return;
+        }
+        elapsed_ns_ += test::nowNanoseconds() - start_ns_;
+        alloc_count_ += s_alloc_count - start_alloc_count_;
+        paused_ = true;
+    }
+
+    void resumeTiming()
+    {
+        if (!paused_) {
+            return;
+        }
+        start_ns_ = test::nowNanoseconds();
+        start_alloc_count_ = s_alloc_count;
+        paused_ = false;
+    }
+
+    int64_t getElapsedNanoseconds() const { return elapsed_ns_; }
+    int64_t getAllocCount() const { return alloc_count_; }
+
+private:
+    int64_t iterations_;
+    bool paused_;
+    int64_t start_ns_;
+    int64_t start_alloc_count_;
+    int64_t elapsed_ns_;
+    int64_t alloc_count_;
+};
+
+using BenchFunc = void (*)(BenchState &);
+
+struct BenchEntry {
+    const char *name;
+    BenchFunc func;
+    // 0 means calibrated by the harness
+    int64_t fixed_iterations;
+    // for throughput, 0 means not reported
+    int64_t bytes_per_op;
+};
+
+// keep the compiler from optimizing the result away
+template <typename T>
+static void doNotOptimize(const T &value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+static void fillRandomBytes(std::string *buffer, size_t size,
+                            uint32_t seed = 5489)
+{
+    codec::Mt19937 random(seed);
+    buffer->resize(size);
+    for (size_t i = 0; i < size; ++i) {
+        (*buffer)[i] = (char)random.nextInt(256);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static void benchDynamicBufferWriteRead64(BenchState &state)
+{
+    DynamicBuffer buffer;
+    char data[64] = {0};
+    for (int64_t i = 0; i < state.getIterations(); ++i) {
+        buffer.writeBytes(data, sizeof(data));
+        buffer.readBytes(data, sizeof(data));
+    }
+    doNotOptimize(data);
+}
+
+static void benchDynamicBufferWriteReadInt32(BenchState &state)
+{
+    DynamicBuffer buffer;
+    uint32_t v = 0;
+    for (int64_t i = 0; i < state.getIterations(); ++i) {
+        buffer.writeInt32((uint32_t)i);
+        buffer.readInt32(v);
+    }
+    doNotOptimize(v);
+}
+
+static void benchDynamicBufferPeekInt64(BenchState &state)
+{
+    DynamicBuffer buffer;
+    for (int i = 0; i < 64; ++i) {
+        buffer.writeInt64((uint64_t)i);
+    }
+    uint64_t v = 0;
+    uint64_t sum = 0;
+    for (int64_t i = 0; i < state.getIterations(); ++i) {
+        buffer.peekInt64(v, (i & 63) * 8);
+        sum += v;
+    }
+    doNotOptimize(sum);
+}
+
+static void benchDynamicBufferReserve4k(BenchState &state)
+{
+    DynamicBuffer buffer;
+    for (int64_t i = 0; i < state.getIterations(); ++i) {
+        buffer.reserveWritableBytes(4096);
+        buffer.write(4096);
+        buffer.read(buffer.readableBytes());
+    }
+    doNotOptimize(buffer);
+}
+
+// grow from the default size to 1MB by 512 bytes chunks
+static void benchDynamicBufferGrow1m(BenchState &state)
+{
+    char data[512] = {0};
+    for (int64_t i = 0; i < state.getIterations(); ++i) {
+        DynamicBuffer buffer;
+        for (int j = 0; j < 2048; ++j) {
+            buffer.writeBytes(data, sizeof(data));
+        }
+        doNotOptimize(buffer);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static void onTimer(TimerHeap::TimerId timer_id)
+{
+}
+
+// add and remove a timer with 10k timers in the heap
+static void benchTimerHeapAddRemove(BenchState &state)
+{
+    state.pauseTiming();
+    TimerHeap timer_heap;
+    Timestamp now;
+    now.setNow();
+    codec::Mt19937 random(5489);
+    for (int i = 0; i < 10000; ++i) {
+        timer_heap.addTimer(now, random.nextInt(1000000),
+                            BRICKRED_BIND_FREE_FUNC(&onTimer));
+    }
+    state.resumeTiming();
+
+    for (int64_t i = 0; i < state.getIterations(); ++i) {
+        TimerHeap::TimerId timer_id = timer_heap.addTimer(
+            now, (i * 7919) % 1000000, BRICKRED_BIND_FREE_FUNC(&onTimer));
+        timer_heap.removeTimer(timer_id);
+    }
+}
+
+// expire timers added once, per op is one timer
+static void benchTimerHeapExpire(BenchState &state)
+{
+    state.pauseTiming();
+    TimerHeap timer_heap;
+    Timestamp now;
+    now.setNow();
+    codec::Mt19937 random(5489);
+    for (int64_t i = 0; i < state.getIterations(); ++i) {
+        timer_heap.addTimer(now, random.nextInt(1000),
+                            BRICKRED_BIND_FREE_FUNC(&onTimer), 1);
+    }
+    state.resumeTiming();
+
+    timer_heap.checkTimeout(now + 1000);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+using BenchRankSet = RankSet<int64_t>;
+
+static const int64_t s_rank_set_size = 1000000;
+
+// keys are even numbers in random order
+static const std::vector<int64_t> &getRankSetKeys()
+{
+    static std::vector<int64_t> s_keys;
+    if (s_keys.empty()) {
+        codec::Mt19937 random(5489);
+        s_keys.resize(s_rank_set_size);
+        for (int64_t i = 0; i < s_rank_set_size; ++i) {
+            s_keys[i] = i * 2;
+        }
+        for (int64_t i = s_rank_set_size - 1; i > 0; --i) {
+            std::swap(s_keys[i], s_keys[random.nextInt(i + 1)]);
+        }
+    }
+    return s_keys;
+}
+
+static const BenchRankSet &getRankSet()
+{
+    static BenchRankSet s_rank_set;
+    if (s_rank_set.empty()) {
+        const std::vector<int64_t> &keys = getRankSetKeys();
+        for (size_t i = 0; i < keys.size(); ++i) {
+            s_rank_set.insert(keys[i]);
+        }
+    }
+    return s_rank_set;
+}
+
+// build a 1e6 elements set from empty
+static void benchRankSetInsert(BenchState &state)
+{
+    state.pauseTiming();
+    const std::vector<int64_t> &keys = getRankSetKeys();
+    BenchRankSet rank_set;
+    state.resumeTiming();
+
+    for (int64_t i = 0; i < state.getIterations(); ++i) {
+        rank_set.insert(keys[i % s_rank_set_size]);
+    }
+
+    state.pauseTiming();
+}
+
+// erase all elements of a 1e6 elements set
+static void benchRankSetErase(BenchState &state)
+{
+    state.pauseTiming();
+    const std::vector<int64_t> &keys = getRankSetKeys();
+    BenchRankSet rank_set(getRankSet());
+    state.resumeTiming();
+
+    for (int64_t i = 0; i < state.getIterations(); ++i) {
+        rank_set.erase(keys[i % s_rank_set_size]);
+    }
+
+    state.pauseTiming();
+}
+
+static void benchRankSetRank(BenchState &state)
+{
+    state.pauseTiming();
+    const std::vector<int64_t> &keys = getRankSetKeys();
+    const BenchRankSet &rank_set = getRankSet();
+    state.resumeTiming();
+
+    size_t sum = 0;
+    for (int64_t i = 0; i < state.getIterations(); ++i) {
+        sum += rank_set.rank(keys[i % s_rank_set_size]);
+    }
+    doNotOptimize(sum);
+}
+
+static void benchRankSetSelect(BenchState &state)
+{
+    state.pauseTiming();
+    const std::vector<int64_t> &keys = getRankSetKeys();
+    const BenchRankSet &rank_set = getRankSet();
+    state.resumeTiming();
+
+    int64_t sum = 0;
+    for (int64_t i = 0; i < state.getIterations(); ++i) {
+        sum += *rank_set.select(keys[i % s_rank_set_size] / 2);
+    }
+    doNotOptimize(sum);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static const size_t s_codec_data_size = 64 * 1024;
+
+static const std::string &getCodecData()
+{
+    static std::string s_data;
+    if (s_data.empty()) {
+        fillRandomBytes(&s_data, s_codec_data_size);
+    }
+    return s_data;
+}
+
+template <typename Hasher, size_t HashSize>
+static void benchHash(BenchState &state)
+{
+    const std::string &data = getCodecData();
+    Hasher hasher;
+    char hash[HashSize];
+    for (int64_t i = 0; i < state.getIterations(); ++i) {
+        hasher.reset();
+        hasher.update(data.c_str(), data.size());
+        hasher.digest(hash);
+    }
+    doNotOptimize(hash);
+}
+
+// nothing is measured if the cpu does not support impl
+template <typename Hasher, size_t HashSize, typename Hasher::Impl Impl>
+static void benchHashWith(BenchState &state)
+{
+    const std::string &data = getCodecData();
+    Hasher hasher;
+    char hash[HashSize];
+    if (hasher.setImpl(Impl) == false) {
+        return;
+    }
+    for (int64_t i = 0; i < state.getIterations(); ++i) {
+        hasher.reset();
+        hasher.update(data.c_str(), data.size());
+        hasher.digest(hash);
+    }
+    doNotOptimize(hash);
+}
+
+// the codec data as buffers of Size bytes hashed by one md5BatchWith()
+template <codec::Md5BatchImpl Impl, size_t Size>
+static void benchMd5BatchWith(BenchState &state)
+{
+    static const size_t s_count = s_codec_data_size / Size;
+    const std::string &data = getCodecData();
+    const char *buffers[s_count];
+    size_t sizes[s_count];
+    char hashes[s_count][16];
+    for (size_t i = 0; i < s_count; ++i) {
+        buffers[i] = data.c_str() + i * Size;
+        sizes[i] = Size;
+    }
+    for (int64_t i = 0; i < state.getIterations(); ++i) {
+        if (codec::md5BatchWith(Impl, buffers, sizes, s_count,
+                                hashes) == false) {
+            return;
+        }
+        doNotOptimize(hashes);
+    }
+}
+
+static void benchBase64Encode(BenchState &state)
+{
+    const std::string &data = getCodecData();
+    std::vector<char> out(data.size() * 2);
+    for (int64_t i = 0; i < state.getIterations(); ++i) {
+        int ret = codec::base64Encode(data.c_str(), data.size(),
+                                      &out[0], out.size());
+        doNotOptimize(ret);
+    }
+}
+
+static void benchBase64Decode(BenchState &state)
+{
+    state.pauseTiming();
+    std::string encoded = codec::base64Encode(getCodecData());
+    std::vector<char> out(encoded.size());
+    state.resumeTiming();
+
+    for (int64_t i = 0; i < state.getIterations(); ++i) {
+        int ret = codec::base64Decode(encoded.c_str(), encoded.size(),
+                                      &out[0], out.size());
+        doNotOptimize(ret);
+    }
+}
+
+// nothing is measured if the cpu does not support impl
+template <codec::Base64Impl Impl, size_t Size>
+static void benchBase64EncodeWith(BenchState &state)
+{
+    const std::string &data = getCodecData();
+    std::vector<char> out(Size * 2);
+    int ret = 0;
+    for (int64_t i = 0; i < state.getIterations(); ++i) {
+        if (codec::base64EncodeWith(Impl, false, data.c_str(), Size,
+                                    &out[0], out.size(), &ret) == false) {
+            return;
+        }
+        doNotOptimize(ret);
+    }
+}
+
+template <codec::Base64Impl Impl, size_t Size>
+static void benchBase64DecodeWith(BenchState &state)
+{
+    state.pauseTiming();
+    std::string encoded = codec::base64Encode(getCodecData().c_str(), Size);
+    std::vector<char> out(encoded.size());
+    state.resumeTiming();
+
+    int ret = 0;
+    for (int64_t i = 0; i < state.getIterations(); ++i) {
+        if (codec::base64DecodeWith(Impl, false,
+                encoded.c_str(), encoded.size(),
+                &out[0], out.size(), &ret) == false) {
+            return;
+        }
+        doNotOptimize(ret);
+    }
+}
+
+// url data is mostly unreserved characters
+static const std::string &getUrlData()
+{
+    static std::string s_data;
+    if (s_data.empty()) {
+        codec::Mt19937 random(5489);
+        static const char chars[] =
+            "abcdefghijklmnopqrstuvwxyz0123456789-_./ &=?";
+        s_data.resize(s_codec_data_size);
+        for (size_t i = 0; i < s_data.size(); ++i) {
+            s_data[i] = chars[random.nextInt(sizeof(chars) - 1)];
+        }
+    }
+    return s_data;
+}
+
+static void benchUrlEncode(BenchState &state)
+{
+    const std::string &data = getUrlData();
+    std::vector<char> out(data.size() * 3);
+    for (int64_t i = 0; i < state.getIterations(); ++i) {
+        int ret = codec::urlEncode(data.c_str(), data.size(),
+                                   &out[0], out.size());
+        doNotOptimize(ret);
+    }
+}
+
+static void benchUrlDecode(BenchState &state)
+{
+    state.pauseTiming();
+    std::string encoded = codec::urlEncode(getUrlData());
+    std::vector<char> out(encoded.size());
+    state.resumeTiming();
+
+    for (int64_t i = 0; i < state.getIterations(); ++i) {
+        int ret = codec::urlDecode(encoded.c_str(), encoded.size(),
+                                   &out[0], out.size());
+        doNotOptimize(ret);
+    }
+}
+
+// query strings and cookie values, about 1 in 64 chars is reserved
+static const std::string &getUrlSparseData()
+{
+    static std::string s_data;
+    if (s_data.empty()) {
+        codec::Mt19937 random(5489);
+        static const char chars[] =
+            "abcdefghijklmnopqrstuvwxyz0123456789-_.~";
+        static const char reserved_chars[] = "/ &=?%";
+        s_data.resize(s_codec_data_size);
+        for (size_t i = 0; i < s_data.size(); ++i) {
+            s_data[i] = (random.nextInt(64) == 0)
+                ? reserved_chars[random.nextInt(sizeof(reserved_chars) - 1)]
+                : chars[random.nextInt(sizeof(chars) - 1)];
+        }
+    }
+    return s_data;
+}
+
+// nothing is measured if the cpu does not support impl
+template <codec::UrlImpl Impl, bool Sparse>
+static void benchUrlEncodeWith(BenchState &state)
+{
+    const std::string &data = Sparse ? getUrlSparseData() : getUrlData();
+    std::vector<char> out(data.size() * 3);
+    int ret = 0;
+    for (int64_t i = 0; i < state.getIterations(); ++i) {
+        if (codec::urlEncodeWith(Impl, data.c_str(), data.size(),
+                                 &out[0], out.size(), &ret) == false) {
+            return;
+        }
+        doNotOptimize(ret);
+    }
+}
+
+template <codec::UrlImpl Impl, bool Sparse>
+static void benchUrlDecodeWith(BenchState &state)
+{
+    state.pauseTiming();
+    std::string encoded = codec::urlEncode(
+        Sparse ? getUrlSparseData() : getUrlData());
+    std::vector<char> out(encoded.size());
+    state.resumeTiming();
+
+    int ret = 0;
+    for (int64_t i = 0; i < state.getIterations(); ++i) {
+        if (codec::urlDecodeWith(Impl, encoded.c_str(), encoded.size(),
+                                 &out[0], out.size(), &ret) == false) {
+            return;
+        }
+        doNotOptimize(ret);
+    }
+}
+
+// utf-8 text of ascii and 2 ~ 4 byte characters in 1:1 bytes
+static const std::string &getUtf8Data()
+{
+    static std::string s_data;
+    if (s_data.empty()) {
+        static const char *chars[] = {
+            "a", "b", "c", "d", "e", "f", "g", "h", "i",
+            "\xc3\xa9", "\xe4\xbd\xa0", "\xf0\x9f\x98\x80"
+        };
+        codec::Mt19937 random(5489);
+        while (s_data.size() < s_codec_data_size - 4) {
+            s_data += chars[random.nextInt(sizeof(chars) / sizeof(chars[0]))];
+        }
+        s_data.resize(s_codec_data_size, 'a');
+    }
+    return s_data;
+}
+
+template <codec::utf8::Impl Impl, bool Ascii>
+static void benchUtf8Validate(BenchState &state)
+{
+    const std::string &data = Ascii ? getUrlData() : getUtf8Data();
+    bool valid = false;
+    for (int64_t i = 0; i < state.getIterations(); ++i) {
+        codec::utf8::validateWith(Impl, data.c_str(), data.size(), &valid);
+        doNotOptimize(valid);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static void benchStringUtilSplit(BenchState &state)
+{
+    const char *line =
+        "GET,/index.html,HTTP/1.1,host,localhost,accept,*/*,"
+        "connection,keep-alive,user-agent,bench,cache-control,no-cache";
+    std::vector<std::string> result;
+    for (int64_t i = 0; i < state.getIterations(); ++i) {
+        result.clear();
+        string_util::split(line, ",", &result);
+    }
+    doNotOptimize(result);
+}
+
+// keyword at the end of 4k text
+static void benchStringUtilFind(BenchState &state)
+{
+    state.pauseTiming();
+    std::string text(4096 - 4, 'a');
+    text.append("\r\n\r\n");
+    state.resumeTiming();
+
+    for (int64_t i = 0; i < state.getIterations(); ++i) {
+        const char *p = string_util::find(text.c_str(), text.size(),
+                                          "\r\n\r\n");
+        doNotOptimize(p);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static const BenchEntry s_bench_entries[] = {
+    { "dynamic_buffer/write_read_64",
+      &benchDynamicBufferWriteRead64, 0, 64 },
+    { "dynamic_buffer/write_read_int32",
+      &benchDynamicBufferWriteReadInt32, 0, 4 },
+    { "dynamic_buffer/peek_int64",
+      &benchDynamicBufferPeekInt64, 0, 8 },
+    { "dynamic_buffer/reserve_4k",
+      &benchDynamicBufferReserve4k, 0, 0 },
+    { "dynamic_buffer/grow_1m",
+      &benchDynamicBufferGrow1m, 0, 1024 * 1024 },
+    { "timer_heap/add_remove_10k",
+      &benchTimerHeapAddRemove, 0, 0 },
+    { "timer_heap/expire",
+      &benchTimerHeapExpire, 100000, 0 },
+    { "rank_set/insert_1m",
+      &benchRankSetInsert, s_rank_set_size, 0 },
+    { "rank_set/erase_1m",
+      &benchRankSetErase, s_rank_set_size, 0 },
+    { "rank_set/rank_1m",
+      &benchRankSetRank, 0, 0 },
+    { "rank_set/select_1m",
+      &benchRankSetSelect, 0, 0 },
+    { "codec/md5_64k",
+      &benchHash<codec::Md5, 16>, 0, s_codec_data_size },
+    { "codec/md5_batch_256_scalar",
+      &benchMd5BatchWith<codec::Md5BatchImpl::SCALAR, 256>,
+      0, s_codec_data_size },
+    { "codec/md5_batch_256_sse2",
+      &benchMd5BatchWith<codec::Md5BatchImpl::SSE2, 256>,
+      0, s_codec_data_size },
+    { "codec/md5_batch_256_avx2",
+      &benchMd5BatchWith<codec::Md5BatchImpl::AVX2, 256>,
+      0, s_codec_data_size },
+    { "codec/md5_batch_1k_scalar",
+      &benchMd5BatchWith<codec::Md5BatchImpl::SCALAR, 1024>,
+      0, s_codec_data_size },
+    { "codec/md5_batch_1k_sse2",
+      &benchMd5BatchWith<codec::Md5BatchImpl::SSE2, 1024>,
+      0, s_codec_data_size },
+    { "codec/md5_batch_1k_avx2",
+      &benchMd5BatchWith<codec::Md5BatchImpl::AVX2, 1024>,
+      0, s_codec_data_size },
+    { "codec/sha1_64k",
+      &benchHash<codec::Sha1, 20>, 0, s_codec_data_size },
+    { "codec/sha1_64k_scalar",
+      &benchHashWith<codec::Sha1, 20, codec::Sha1::Impl::SCALAR>,
+      0, s_codec_data_size },
+    { "codec/sha1_64k_sha_ni",
+      &benchHashWith<codec::Sha1, 20, codec::Sha1::Impl::SHA_NI>,
+      0, s_codec_data_size },
+    { "codec/sha256_64k",
+      &benchHash<codec::Sha256, 32>, 0, s_codec_data_size },
+    { "codec/sha256_64k_scalar",
+      &benchHashWith<codec::Sha256, 32, codec::Sha256::Impl::SCALAR>,
+      0, s_codec_data_size },
+    { "codec/sha256_64k_sha_ni",
+      &benchHashWith<codec::Sha256, 32, codec::Sha256::Impl::SHA_NI>,
+      0, s_codec_data_size },
+    { "codec/base64_encode_64k",
+      &benchBase64Encode, 0, s_codec_data_size },
+    { "codec/base64_decode_64k",
+      &benchBase64Decode, 0, s_codec_data_size },
+    { "codec/base64_encode_64_scalar",
+      &benchBase64EncodeWith<codec::Base64Impl::SCALAR, 64>,
+      0, 64 },
+    { "codec/base64_encode_64_sse41",
+      &benchBase64EncodeWith<codec::Base64Impl::SSE41, 64>,
+      0, 64 },
+    { "codec/base64_encode_64_avx2",
+      &benchBase64EncodeWith<codec::Base64Impl::AVX2, 64>,
+      0, 64 },
+    { "codec/base64_encode_1k_scalar",
+      &benchBase64EncodeWith<codec::Base64Impl::SCALAR, 1024>,
+      0, 1024 },
+    { "codec/base64_encode_1k_sse41",
+      &benchBase64EncodeWith<codec::Base64Impl::SSE41, 1024>,
+      0, 1024 },
+    { "codec/base64_encode_1k_avx2",
+      &benchBase64EncodeWith<codec::Base64Impl::AVX2, 1024>,
+      0, 1024 },
+    { "codec/base64_encode_64k_scalar",
+      &benchBase64EncodeWith<codec::Base64Impl::SCALAR, s_codec_data_size>,
+      0, s_codec_data_size },
+    { "codec/base64_encode_64k_sse41",
+      &benchBase64EncodeWith<codec::Base64Impl::SSE41, s_codec_data_size>,
+      0, s_codec_data_size },
+    { "codec/base64_encode_64k_avx2",
+      &benchBase64EncodeWith<codec::Base64Impl::AVX2, s_codec_data_size>,
+      0, s_codec_data_size },
+    { "codec/base64_decode_64_scalar",
+      &benchBase64DecodeWith<codec::Base64Impl::SCALAR, 64>,
+      0, 64 },
+    { "codec/base64_decode_64_sse41",
+      &benchBase64DecodeWith<codec::Base64Impl::SSE41, 64>,
+      0, 64 },
+    { "codec/base64_decode_64_avx2",
+      &benchBase64DecodeWith<codec::Base64Impl::AVX2, 64>,
+      0, 64 },
+    { "codec/base64_decode_1k_scalar",
+      &benchBase64DecodeWith<codec::Base64Impl::SCALAR, 1024>,
+      0, 1024 },
+    { "codec/base64_decode_1k_sse41",
+      &benchBase64DecodeWith<codec::Base64Impl::SSE41, 1024>,
+      0, 1024 },
+    { "codec/base64_decode_1k_avx2",
+      &benchBase64DecodeWith<codec::Base64Impl::AVX2, 1024>,
+      0, 1024 },
+    { "codec/base64_decode_64k_scalar",
+      &benchBase64DecodeWith<codec::Base64Impl::SCALAR, s_codec_data_size>,
+      0, s_codec_data_size },
+    { "codec/base64_decode_64k_sse41",
+      &benchBase64DecodeWith<codec::Base64Impl::SSE41, s_codec_data_size>,
+      0, s_codec_data_size },
+    { "codec/base64_decode_64k_avx2",
+      &benchBase64DecodeWith<codec::Base64Impl::AVX2, s_codec_data_size>,
+      0, s_codec_data_size },
+    { "codec/url_encode_64k",
+      &benchUrlEncode, 0, s_codec_data_size },
+    { "codec/url_decode_64k",
+      &benchUrlDecode, 0, s_codec_data_size },
+    { "codec/url_encode_64k_scalar",
+      &benchUrlEncodeWith<codec::UrlImpl::SCALAR, false>,
+      0, s_codec_data_size },
+    { "codec/url_encode_64k_ssse3",
+      &benchUrlEncodeWith<codec::UrlImpl::SSSE3, false>,
+      0, s_codec_data_size },
+    { "codec/url_encode_64k_avx2",
+      &benchUrlEncodeWith<codec::UrlImpl::AVX2, false>,
+      0, s_codec_data_size },
+    { "codec/url_encode_sparse_64k_scalar",
+      &benchUrlEncodeWith<codec::UrlImpl::SCALAR, true>,
+      0, s_codec_data_size },
+    { "codec/url_encode_sparse_64k_ssse3",
+      &benchUrlEncodeWith<codec::UrlImpl::SSSE3, true>,
+      0, s_codec_data_size },
+    { "codec/url_encode_sparse_64k_avx2",
+      &benchUrlEncodeWith<codec::UrlImpl::AVX2, true>,
+      0, s_codec_data_size },
+    { "codec/url_decode_64k_scalar",
+      &benchUrlDecodeWith<codec::UrlImpl::SCALAR, false>,
+      0, s_codec_data_size },
+    { "codec/url_decode_64k_ssse3",
+      &benchUrlDecodeWith<codec::UrlImpl::SSSE3, false>,
+      0, s_codec_data_size },
+    { "codec/url_decode_64k_avx2",
+      &benchUrlDecodeWith<codec::UrlImpl::AVX2, false>,
+      0, s_codec_data_size },
+    { "codec/url_decode_sparse_64k_scalar",
+      &benchUrlDecodeWith<codec::UrlImpl::SCALAR, true>,
+      0, s_codec_data_size },
+    { "codec/url_decode_sparse_64k_ssse3",
+      &benchUrlDecodeWith<codec::UrlImpl::SSSE3, true>,
+      0, s_codec_data_size },
+    { "codec/url_decode_sparse_64k_avx2",
+      &benchUrlDecodeWith<codec::UrlImpl::AVX2, true>,
+      0, s_codec_data_size },
+    { "codec/utf8_ascii_64k_scalar",
+      &benchUtf8Validate<codec::utf8::Impl::SCALAR, true>,
+      0, s_codec_data_size },
+    { "codec/utf8_ascii_64k_ssse3",
+      &benchUtf8Validate<codec::utf8::Impl::SSSE3, true>,
+      0, s_codec_data_size },
+    { "codec/utf8_ascii_64k_avx2",
+      &benchUtf8Validate<codec::utf8::Impl::AVX2, true>,
+      0, s_codec_data_size },
+    { "codec/utf8_mixed_64k_scalar",
+      &benchUtf8Validate<codec::utf8::Impl::SCALAR, false>,
+      0, s_codec_data_size },
+    { "codec/utf8_mixed_64k_ssse3",
+      &benchUtf8Validate<codec::utf8::Impl::SSSE3, false>,
+      0, s_codec_data_size },
+    { "codec/utf8_mixed_64k_avx2",
+      &benchUtf8Validate<codec::utf8::Impl::AVX2, false>,
+      0, s_codec_data_size },
+    { "string_util/split_16",
+      &benchStringUtilSplit, 0, 0 },
+    { "string_util/find_4k",
+      &benchStringUtilFind, 0, 4096 },
+};
+
+struct BenchResult {
+    int64_t iterations;
+    std::vector<double> ns_per_op;
+    std::vector<double> allocs_per_op;
+};
+
+static double median(std::vector<double> values)
+{
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t middle = values.size() / 2;
+    if (values.size() % 2 == 0) {
+        return (values[middle - 1] + values[middle]) / 2;
+    }
+    return values[middle];
+}
+
+// median absolute deviation
+static double medianAbsoluteDeviation(const std::vector<double> &values)
+{
+    double m = median(values);
+    std::vector<double> deviations(values.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+        deviations[i] = values[i] > m ? values[i] - m : m - values[i];
+    }
+    return median(deviations);
+}
+
+static void runBench(const BenchEntry &entry, int repetitions,
+                     int64_t min_time_ns, BenchResult *result)
+{
+    // warmup, lazy initialized data is also built here
+    int64_t iterations = entry.fixed_iterations > 0 ?
+                         entry.fixed_iterations : 1;
+    {
+        BenchState state(iterations);
+        entry.func(state);
+    }
+
+    // calibrate the iterations of one repetition
+    for (;;) {
+        BenchState state(iterations);
+        entry.func(state);
+        state.pauseTiming();
+        if (entry.fixed_iterations > 0) {
+            break;
+        }
+        int64_t elapsed_ns = state.getElapsedNanoseconds();
+        if (elapsed_ns >= min_time_ns) {
+            break;
+        }
+        int64_t next = elapsed_ns > 0 ?
+            (int64_t)((double)iterations * min_time_ns / elapsed_ns * 1.2) :
+            iterations * 100;
+        iterations = std::min(std::max(next, iterations + 1),
+                              iterations * 100);
+    }
+
+    result->iterations = iterations;
+    for (int i = 0; i < repetitions; ++i) {
+        BenchState state(iterations);
+        entry.func(state);
+        state.pauseTiming();
+        result->ns_per_op.push_back(
+            (double)state.getElapsedNanoseconds() / iterations);
+        result->allocs_per_op.push_back(
+            (double)state.getAllocCount() / iterations);
+    }
+}
+
+static void printUsage(const char *progname)
+{
+    ::fprintf(stderr, "usage: %s\n"
+              "[-f <name_filter>]\n"
+              "[-r <repetitions>]\n"
+              "[-t <min_time_ms>]\n",
+              progname);
+}
+
+int main(int argc, char *argv[])
+{
+    std::string filter;
+    int repetitions = 9;
+    int min_time_ms = 100;
+
+    CommandLineOption options;
+    options.addOption("f", CommandLineOption::ParameterType::REQUIRED);
+    options.addOption("r", CommandLineOption::ParameterType::REQUIRED);
+    options.addOption("t", CommandLineOption::ParameterType::REQUIRED);
+
+    if (options.parse(argc, argv) == false ||
+        options.getLeftArguments().empty() == false) {
+        printUsage(argv[0]);
+        return -1;
+    }
+    if (options.hasOption("f")) {
+        filter = options.getParameter("f");
+    }
+    if (options.hasOption("r")) {
+        repetitions = ::atoi(options.getParameter("r").c_str());
+    }
+    if (options.hasOption("t")) {
+        min_time_ms = ::atoi(options.getParameter("t").c_str());
+    }
+    if (repetitions <= 0 || min_time_ms <= 0) {
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    ::printf("{\n  \"repetitions\": %d,\n  \"min_time_ms\": %d,\n"
+             "  \"benchmarks\": [", repetitions, min_time_ms);
+
+    bool first = true;
+    for (size_t i = 0;
+         i < sizeof(s_bench_entries) / sizeof(s_bench_entries[0]); ++i) {
+        const BenchEntry &entry = s_bench_entries[i];
+        if (filter.empty() == false &&
+            ::strstr(entry.name, filter.c_str()) == nullptr) {
+            continue;
+        }
+
+        BenchResult result;
+        runBench(entry, repetitions, min_time_ms * 1000000LL, &result);
+
+        double ns_per_op = median(result.ns_per_op);
+        double ns_per_op_mad = medianAbsoluteDeviation(result.ns_per_op);
+        double ns_per_op_min = *std::min_element(result.ns_per_op.begin(),
+                                                 result.ns_per_op.end());
+        double allocs_per_op = median(result.allocs_per_op);
+
+        ::printf("%s\n    {\"name\": \"%s\", \"iterations\": %ld, "
+                 "\"ns_per_op\": %.3f, \"ns_per_op_mad\": %.3f, "
+                 "\"ns_per_op_min\": %.3f, \"allocs_per_op\": %.4f",
+                 first ? "" : ",", entry.name, result.iterations,
+                 ns_per_op, ns_per_op_mad, ns_per_op_min, allocs_per_op);
+        if (entry.bytes_per_op > 0 && ns_per_op > 0) {
+            ::printf(", \"mb_per_second\": %.2f",
+                     entry.bytes_per_op / ns_per_op * 1000.0);
+        }
+        ::printf("}");
+        ::fflush(stdout);
+        first = false;
+    }
+
+    ::printf("\n  ]\n}\n");
+
+    return 0;
+}
@@ -0,0 +1,315 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+
+#include <brickred/command_line_option.h>
+#include <brickred/dynamic_buffer.h>
+#include <brickred/protocol/http_protocol.h>
+#include <brickred/protocol/http_request.h>
+#include <brickred/protocol/http_request_view.h>
+#include <brickred/protocol/http_response.h>
+#include <brickred/protocol/http_router.h>
+
+#include "test/test_util.h"
+
+using namespace brickred;
+using namespace brickred::protocol;
+
+///////////////////////////////////////////////////////////////////////////////
+// count allocations of the whole program, bench_http is single threaded
+static int64_t s_alloc_count = 0;
+
+void *operator new(size_t size)
+{
+    ++s_alloc_count;
+    void *p = ::malloc(size == 0 ? 1 : size);
+    if (nullptr == p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    ::free(p);
+}
+
+void operator delete(void *p, size_t size) noexcept
+{
+    ::free(p);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static const char s_request_wrk[] =
+    "GET /plaintext HTTP/1.1\r\n"
+    "Host: localhost:8080\r\n"
+    "\r\n";
+
+static const char s_request_browser[] =
+    "GET /index.html?user=brickred&page=1 HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "Connection: keep-alive\r\n"
+    "Cache-Control: max-age=0\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 "
+    "(KHTML, like Gecko) Chrome/120.0.0.0 Safari/537.36\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,"
+    "image/avif,image/webp,*/*;q=0.8\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Accept-Language: en-US,en;q=0.9\r\n"
+    "Cookie: session=0123456789abcdef0123456789abcdef; theme=dark\r\n"
+    "\r\n";
+
+static const char s_request_post[] =
+    "POST /api/v1/update HTTP/1.1\r\n"
+    "Host: api.example.com\r\n"
+    "Content-Type: application/json\r\n"
+    "Content-Length: 32\r\n"
+    "\r\n"
+    "{\"id\":12345,\"value\":\"brickred\"}\n";
+
+struct BenchResult {
+    double ns_per_request;
+    double allocs_per_request;
+};
+
+static void doNotOptimize(const void *p)
+{
+    asm volatile("" : : "g"(p) : "memory");
+}
+
+static BenchResult benchHttpProtocol(const char *request, size_t size,
+                                     int64_t iterations)
+{
+    DynamicBuffer buffer(64 * 1024);
+    HttpProtocol protocol;
+    HttpRequest http_request;
+
+    int64_t alloc_count = s_alloc_count;
+    int64_t start = test::nowNanoseconds();
+    for (int64_t i = 0; i < iterations; ++i) {
+        buffer.reserveWritableBytes(size);
+        ::memcpy(buffer.writeBegin(), request, size);
+        buffer.write(size);
+
+        if (protocol.recvMessage(&buffer) !=
+                HttpProtocol::RetCode::MESSAGE_READY ||
+            protocol.retrieveRequest(&http_request) == false) {
+            ::fprintf(stderr, "HttpProtocol parse failed\n");
+            ::exit(-1);
+        }
+        doNotOptimize(&http_request);
+    }
+    int64_t end = test::nowNanoseconds();
+
+    BenchResult result;
+    result.ns_per_request = (double)(end - start) / iterations;
+    result.allocs_per_request =
+        (double)(s_alloc_count - alloc_count) / iterations;
+    return result;
+}
+
+static BenchResult benchHttpRequestView(const char *request, size_t size,
+                                        int64_t iterations)
+{
+    DynamicBuffer buffer(64 * 1024);
+    HttpRequestView view;
+
+    int64_t alloc_count = s_alloc_count;
+    int64_t start = test::nowNanoseconds();
+    for (int64_t i = 0; i < iterations; ++i) {
+        buffer.reserveWritableBytes(size);
+        ::memcpy(buffer.writeBegin(), request, size);
+        buffer.write(size);
+
+        if (view.parse(buffer.readBegin(), buffer.readableBytes()) !=
+                HttpRequestView::RetCode::MESSAGE_READY) {
+            ::fprintf(stderr, "HttpRequestView parse failed\n");
+            ::exit(-1);
+        }
+        doNotOptimize(view.getRequestUri().data());
+        buffer.read(view.getMessageSize());
+    }
+    int64_t end = test::nowNanoseconds();
+
+    BenchResult result;
+    result.ns_per_request = (double)(end - start) / iterations;
+    result.allocs_per_request =
+        (double)(s_alloc_count - alloc_count) / iterations;
+    return result;
+}
+
+static BenchResult benchWriteMessage(int64_t iterations)
+{
+    HttpResponse response;
+    response.setVersion(HttpMessage::Version::HTTP_1_1);
+    response.setStatusCode(200);
+    response.setReasonPhrase("OK");
+    response.setHeader("Server", "brickred");
+    response.setHeader("Content-Type", "text/plain");
+    response.setHeader("Content-Length", "13");
+    response.setBody("Hello, World!");
+    DynamicBuffer buffer(64 * 1024);
+
+    int64_t alloc_count = s_alloc_count;
+    int64_t start = test::nowNanoseconds();
+    for (int64_t i = 0; i < iterations; ++i) {
+        response.setDate();
+        HttpProtocol::writeMessage(response, &buffer);
+        doNotOptimize(buffer.readBegin());
+        buffer.clear();
+    }
+    int64_t end = test::nowNanoseconds();
+
+    BenchResult result;
+    result.ns_per_request = (double)(end - start) / iterations;
+    result.allocs_per_request =
+        (double)(s_alloc_count - alloc_count) / iterations;
+    return result;
+}
+
+static int64_t s_route_count = 0;
+
+static void onRoute(const HttpRequest &, const HttpRouter::Params &params)
+{
+    s_route_count += params.size() + 1;
+}
+
+// 250 resources, 4 routes each
+static void buildRouter(HttpRouter *router)
+{
+    HttpRouter::Handler handler = BRICKRED_BIND_FREE_FUNC(&onRoute);
+
+    for (int i = 0; i < 250; ++i) {
+        char resource[64];
+        ::snprintf(resource, sizeof(resource), "/api/v1/resource%03d", i);
+        std::string base = resource;
+
+        if (router->addRoute(HttpRequest::Method::GET, base, handler) ==
+                false ||
+            router->addRoute(HttpRequest::Method::GET,
+                             base + "/:id", handler) == false ||
+            router->addRoute(HttpRequest::Method::PUT,
+                             base + "/:id", handler) == false ||
+            router->addRoute(HttpRequest::Method::GET,
+                             base + "/:id/items/:item", handler) == false) {
+            ::fprintf(stderr, "HttpRouter add route failed\n");
+            ::exit(-1);
+        }
+    }
+}
+
+static BenchResult benchRouter(const HttpRouter &router,
+                               const HttpRequest &request,
+                               int64_t iterations)
+{
+    int64_t alloc_count = s_alloc_count;
+    int64_t start = test::nowNanoseconds();
+    for (int64_t i = 0; i < iterations; ++i) {
+        if (router.dispatch(request) == false) {
+            ::fprintf(stderr, "HttpRouter dispatch failed\n");
+            ::exit(-1);
+        }
+    }
+    int64_t end = test::nowNanoseconds();
+    doNotOptimize(&s_route_count);
+
+    BenchResult result;
+    result.ns_per_request = (double)(end - start) / iterations;
+    result.allocs_per_request =
+        (double)(s_alloc_count - alloc_count) / iterations;
+    return result;
+}
+
+static void printUsage(const char *progname)
+{
+    ::fprintf(stderr, "usage: %s [-n iterations]\n", progname);
+}
+
+int main(int argc, char *argv[])
+{
+    int64_t iterations = 1000000;
+
+    CommandLineOption options;
+    options.addOption("n", CommandLineOption::ParameterType::REQUIRED);
+
+    if (options.parse(argc, argv) == false ||
+        options.getLeftArguments().empty() == false) {
+        printUsage(argv[0]);
+        return -1;
+    }
+    if (options.hasOption("n")) {
+        iterations = ::atoll(options.getParameter("n").c_str());
+    }
+    if (iterations <= 0) {
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    struct {
+        const char *name;
+        const char *request;
+        size_t size;
+    } requests[] = {
+        { "wrk", s_request_wrk, sizeof(s_request_wrk) - 1 },
+        { "browser", s_request_browser, sizeof(s_request_browser) - 1 },
+        { "post", s_request_post, sizeof(s_request_post) - 1 },
+    };
+
+    ::printf("%-10s %-16s %12s %14s %12s\n",
+             "request", "parser", "ns/req", "requests/s", "allocs/req");
+    for (size_t i = 0; i < sizeof(requests) / sizeof(requests[0]); ++i) {
+        BenchResult results[2] = {
+            benchHttpProtocol(requests[i].request, requests[i].size,
+                              iterations),
+            benchHttpRequestView(requests[i].request, requests[i].size,
+                                 iterations),
+        };
+        const char *parsers[2] = { "HttpProtocol", "HttpRequestView" };
+
+        for (int j = 0; j < 2; ++j) {
+            ::printf("%-10s %-16s %12.1f %14.0f %12.2f\n",
+                     requests[i].name, parsers[j],
+                     results[j].ns_per_request,
+                     1e9 / results[j].ns_per_request,
+                     results[j].allocs_per_request);
+        }
+    }
+
+    BenchResult result = benchWriteMessage(iterations);
+    ::printf("%-10s %-16s %12.1f %14.0f %12.2f\n",
+             "response", "writeMessage", result.ns_per_request,
+             1e9 / result.ns_per_request, result.allocs_per_request);
+
+
+    HttpRouter router;
+    buildRouter(&router);
+    struct {
+        const char *name;
+        HttpRequest::Method method;
+        const char *uri;
+    } routes[] = {
+        { "static", HttpRequest::Method::GET,
+          "/api/v1/resource123" },
+        { "param", HttpRequest::Method::PUT,
+          "/api/v1/resource200/12345" },
+        { "params", HttpRequest::Method::GET,
+          "/api/v1/resource249/12345/items/678?detail=1" },
+    };
+
+    ::printf("\n%-10s %-16s %12s %14s %12s\n",
+             "route", "1000 routes", "ns/req", "requests/s", "allocs/req");
+    for (size_t i = 0; i < sizeof(routes) / sizeof(routes[0]); ++i) {
+        HttpRequest request;
+        request.setMethod(routes[i].method);
+        request.setRequestUri(routes[i].uri);
+        result = benchRouter(router, request, iterations);
+        ::printf("%-10s %-16s %12.1f %14.0f %12.2f\n",
+                 routes[i].name, "HttpRouter", result.ns_per_request,
+                 1e9 / result.ns_per_request, result.allocs_per_request);
+    }
+
+    return 0;
+}
@@ -0,0 +1,449 @@
+#include <sys/resource.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <unordered_map>
+
+#include <brickred/command_line_option.h>
+#include <brickred/dynamic_buffer.h>
+#include <brickred/io_service.h>
+#include <brickred/socket_address.h>
+#include <brickred/tcp_service.h>
+#include <brickred/thread.h>
+#include <brickred/unique_ptr.h>
+#include <brickred/protocol/http_request.h>
+#include <brickred/protocol/http_response.h>
+#include <brickred/protocol/http_server.h>
+
+#include "test/test_util.h"
+
+using namespace brickred;
+using namespace brickred::protocol;
+
+struct BenchConfig {
+    int thread_count;
+    int conn_count;
+    int pipeline;
+    int reactor_count;
+    int warmup_ms;
+    int duration_ms;
+    SocketAddress addr;
+};
+
+static const char s_request[] =
+    "GET /plaintext HTTP/1.1\r\n"
+    "Host: localhost\r\n"
+    "Accept: text/plain\r\n"
+    "\r\n";
+
+// return the size of the first complete response, 0 if incomplete,
+// -1 if it is not a response
+static int64_t parseResponseSize(const char *buffer, size_t size)
+{
+    const char *header_end =
+        (const char *)::memmem(buffer, size, "\r\n\r\n", 4);
+    if (nullptr == header_end) {
+        return 0;
+    }
+    if (size < 5 || ::memcmp(buffer, "HTTP/", 5) != 0) {
+        return -1;
+    }
+
+    static const char s_content_length[] = "\r\ncontent-length:";
+    const size_t s_content_length_size = sizeof(s_content_length) - 1;
+    int64_t body_size = 0;
+    for (const char *p = buffer; p + s_content_length_size <= header_end;
+         ++p) {
+        if (::strncasecmp(p, s_content_length,
+                          s_content_length_size) == 0) {
+            body_size = ::atoll(p + s_content_length_size);
+            break;
+        }
+    }
+
+    int64_t message_size = header_end + 4 - buffer + body_size;
+    return ((int64_t)size < message_size) ? 0 : message_size;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+class BenchServer {
+public:
+    BenchServer()
+    {
+        response_.setVersion(HttpMessage::Version::HTTP_1_1);
+        response_.setStatusCode(200);
+        response_.setReasonPhrase("OK");
+        response_.setHeader("Server", "brickred");
+        response_.setHeader("Content-Type", "text/plain");
+        response_.setHeader("Content-Length", "13");
+        response_.setBody("Hello, World!");
+
+        server_.setRequestCallback(BRICKRED_BIND_MEM_FUNC(
+            &BenchServer::onRequest, this));
+    }
+
+    ~BenchServer()
+    {
+    }
+
+    bool listen(const BenchConfig &config, SocketAddress *addr)
+    {
+        server_.setReactorCount(config.reactor_count);
+        if (server_.listen(config.addr) == false) {
+            return false;
+        }
+        return server_.getListenAddress(addr);
+    }
+
+    void run()
+    {
+        server_.run();
+    }
+
+    void stop()
+    {
+        server_.quit();
+    }
+
+private:
+    void onRequest(HttpServer *server, HttpServer::ConnectionId conn_id,
+                   const HttpRequest &request)
+    {
+        // the response is shared by the reactors, only read
+        server->sendResponse(conn_id, response_);
+    }
+
+private:
+    BRICKRED_NONCOPYABLE(BenchServer)
+
+    HttpServer server_;
+    HttpResponse response_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+class BenchClient {
+public:
+    BenchClient() :
+        tcp_service_(io_service_), measuring_(false),
+        request_count_(0), byte_count_(0), error_count_(0)
+    {
+        tcp_service_.setNewConnectionCallback(BRICKRED_BIND_MEM_FUNC(
+            &BenchClient::onNewConnection, this));
+        tcp_service_.setRecvMessageCallback(BRICKRED_BIND_MEM_FUNC(
+            &BenchClient::onRecvMessage, this));
+        tcp_service_.setPeerCloseCallback(BRICKRED_BIND_MEM_FUNC(
+            &BenchClient::onPeerClose, this));
+        tcp_service_.setErrorCallback(BRICKRED_BIND_MEM_FUNC(
+            &BenchClient::onError, this));
+    }
+
+    ~BenchClient()
+    {
+    }
+
+    void init(const BenchConfig &config)
+    {
+        config_ = config;
+    }
+
+    void run()
+    {
+        for (int i = 0; i < config_.conn_count; ++i) {
+            bool complete = false;
+            TcpService::SocketId socket_id = tcp_service_.asyncConnect(
+                config_.addr, &complete, 5000);
+            if (-1 == socket_id) {
+                ++error_count_;
+                continue;
+            }
+            if (complete) {
+                onConnected(socket_id);
+            }
+        }
+
+        io_service_.startTimer(config_.warmup_ms,
+            BRICKRED_BIND_MEM_FUNC(&BenchClient::onWarmupEnd, this), 1);
+        io_service_.startTimer(config_.warmup_ms + config_.duration_ms,
+            BRICKRED_BIND_MEM_FUNC(&BenchClient::onMeasureEnd, this), 1);
+        io_service_.loop();
+    }
+
+    const test::LatencyHistogram &getHistogram() const { return histogram_; }
+    int64_t getRequestCount() const { return request_count_; }
+    int64_t getByteCount() const { return byte_count_; }
+    int64_t getErrorCount() const { return error_count_; }
+
+private:
+    void onConnected(TcpService::SocketId socket_id)
+    {
+        for (int i = 0; i < config_.pipeline; ++i) {
+            sendRequest(socket_id);
+        }
+    }
+
+    void sendRequest(TcpService::SocketId socket_id)
+    {
+        send_times_[socket_id].push_back(test::nowNanoseconds());
+        if (tcp_service_.sendMessage(socket_id,
+                s_request, sizeof(s_request) - 1) == false) {
+            ++error_count_;
+            closeSocket(socket_id);
+        }
+    }
+
+    void closeSocket(TcpService::SocketId socket_id)
+    {
+        tcp_service_.closeSocket(socket_id);
+        send_times_.erase(socket_id);
+    }
+
+    void onWarmupEnd(int64_t timer_id)
+    {
+        measuring_ = true;
+    }
+
+    void onMeasureEnd(int64_t timer_id)
+    {
+        measuring_ = false;
+        io_service_.quit();
+    }
+
+    void onNewConnection(TcpService *service,
+                         TcpService::SocketId from_socket_id,
+                         TcpService::SocketId socket_id)
+    {
+        onConnected(socket_id);
+    }
+
+    void onRecvMessage(TcpService *service,
+                       TcpService::SocketId socket_id,
+                       DynamicBuffer *buffer)
+    {
+        std::deque<int64_t> &send_times = send_times_[socket_id];
+
+        for (;;) {
+            int64_t size = parseResponseSize(buffer->readBegin(),
+                                             buffer->readableBytes());
+            if (size < 0 || (size > 0 && send_times.empty())) {
+                ++error_count_;
+                closeSocket(socket_id);
+                return;
+            } else if (0 == size) {
+                break;
+            }
+            buffer->read(size);
+
+            if (measuring_) {
+                histogram_.record(
+                    test::nowNanoseconds() - send_times.front());
+                ++request_count_;
+                byte_count_ += size;
+            }
+            send_times.pop_front();
+            sendRequest(socket_id);
+        }
+    }
+
+    void onPeerClose(TcpService *service,
+                     TcpService::SocketId socket_id)
+    {
+        if (measuring_) {
+            ++error_count_;
+        }
+        closeSocket(socket_id);
+    }
+
+    void onError(TcpService *service,
+                 TcpService::SocketId socket_id,
+                 int error)
+    {
+        if (measuring_) {
+            ++error_count_;
+        }
+        closeSocket(socket_id);
+    }
+
+private:
+    BRICKRED_NONCOPYABLE(BenchClient)
+
+    IOService io_service_;
+    TcpService tcp_service_;
+    BenchConfig config_;
+    bool measuring_;
+    std::unordered_map<TcpService::SocketId, std::deque<int64_t>>
+        send_times_;
+
+    test::LatencyHistogram histogram_;
+    int64_t request_count_;
+    int64_t byte_count_;
+    int64_t error_count_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+static double getCpuTime()
+{
+    struct rusage usage;
+    ::getrusage(RUSAGE_SELF, &usage);
+
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1000000.0 +
+           usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1000000.0;
+}
+
+static void printUsage(const char *progname)
+{
+    ::fprintf(stderr, "usage: %s [<ip> <port>]\n"
+              "[-s] (serve only, for external load generators)\n"
+              "[-r <server_reactor_count>]\n"
+              "[-l <client_thread_count>]\n"
+              "[-n <conn_count_per_thread>]\n"
+              "[-p <pipeline>]\n"
+              "[-w <warmup_ms>]\n"
+              "[-t <duration_ms>]\n"
+              "without <ip> <port>, an in-process server "
+              "listens on loopback\n",
+              progname);
+}
+
+int main(int argc, char *argv[])
+{
+    BenchConfig config;
+    config.thread_count = 1;
+    config.conn_count = 64;
+    config.pipeline = 1;
+    config.reactor_count = 1;
+    config.warmup_ms = 1000;
+    config.duration_ms = 5000;
+
+    CommandLineOption options;
+    options.addOption("s");
+    options.addOption("r", CommandLineOption::ParameterType::REQUIRED);
+    options.addOption("l", CommandLineOption::ParameterType::REQUIRED);
+    options.addOption("n", CommandLineOption::ParameterType::REQUIRED);
+    options.addOption("p", CommandLineOption::ParameterType::REQUIRED);
+    options.addOption("w", CommandLineOption::ParameterType::REQUIRED);
+    options.addOption("t", CommandLineOption::ParameterType::REQUIRED);
+
+    if (options.parse(argc, argv) == false) {
+        printUsage(argv[0]);
+        return -1;
+    }
+    if (options.hasOption("r")) {
+        config.reactor_count = ::atoi(options.getParameter("r").c_str());
+    }
+    if (options.hasOption("l")) {
+        config.thread_count = ::atoi(options.getParameter("l").c_str());
+    }
+    if (options.hasOption("n")) {
+        config.conn_count = ::atoi(options.getParameter("n").c_str());
+    }
+    if (options.hasOption("p")) {
+        config.pipeline = ::atoi(options.getParameter("p").c_str());
+    }
+    if (options.hasOption("w")) {
+        config.warmup_ms = ::atoi(options.getParameter("w").c_str());
+    }
+    if (options.hasOption("t")) {
+        config.duration_ms = ::atoi(options.getParameter("t").c_str());
+    }
+    if (config.reactor_count <= 0 || config.thread_count <= 0 ||
+        config.conn_count <= 0 || config.pipeline <= 0 ||
+        config.duration_ms <= 0) {
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    bool serve_only = options.hasOption("s");
+    bool has_addr = options.getLeftArguments().size() == 2;
+    if (has_addr) {
+        config.addr.setAddress(options.getLeftArguments()[0],
+            ::atoi(options.getLeftArguments()[1].c_str()));
+    } else if (options.getLeftArguments().empty() && !serve_only) {
+        config.addr.setAddress("127.0.0.1", 0);
+    } else {
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    // start in-process server
+    UniquePtr<BenchServer> server;
+    Thread server_thread;
+    if (serve_only || !has_addr) {
+        server.reset(new BenchServer());
+        if (server->listen(config, &config.addr) == false) {
+            ::fprintf(stderr, "socket listen failed: %s\n",
+                      ::strerror(errno));
+            return -1;
+        }
+        if (serve_only) {
+            server->run();
+            return 0;
+        }
+        server_thread.start(BRICKRED_BIND_MEM_FUNC(
+            &BenchServer::run, server.get()));
+    }
+
+    UniquePtr<Thread[]> threads(new Thread[config.thread_count]);
+    UniquePtr<BenchClient[]> clients(new BenchClient[config.thread_count]);
+
+    for (int i = 0; i < config.thread_count; ++i) {
+        clients[i].init(config);
+    }
+    for (int i = 0; i < config.thread_count; ++i) {
+        threads[i].start(BRICKRED_BIND_MEM_FUNC(
+            &BenchClient::run, &clients[i]));
+    }
+
+    this_thread::sleepFor(config.warmup_ms);
+    double cpu_start = getCpuTime();
+    this_thread::sleepFor(config.duration_ms);
+    double cpu_end = getCpuTime();
+
+    for (int i = 0; i < config.thread_count; ++i) {
+        threads[i].join();
+    }
+    if (server.get() != nullptr) {
+        server->stop();
+        server_thread.join();
+    }
+
+    test::LatencyHistogram histogram;
+    int64_t request_count = 0;
+    int64_t byte_count = 0;
+    int64_t error_count = 0;
+    for (int i = 0; i < config.thread_count; ++i) {
+        histogram.merge(clients[i].getHistogram());
+        request_count += clients[i].getRequestCount();
+        byte_count += clients[i].getByteCount();
+        error_count += clients[i].getErrorCount();
+    }
+
+    double seconds = config.duration_ms / 1000.0;
+    double cpu_time = cpu_end - cpu_start;
+
+    ::printf("reactors: %d  client threads: %d  connections: %d  "
+             "pipeline: %d\n",
+             server.get() != nullptr ? config.reactor_count : 0,
+             config.thread_count, config.thread_count * config.conn_count,
+             config.pipeline);
+    ::printf("duration: %.3fs  errors: %ld\n", seconds, error_count);
+    ::printf("requests: %ld  (%.0f/s)\n",
+             request_count, request_count / seconds);
+    ::printf("transfer: %.2f MB/s\n", byte_count / seconds / 1000000.0);
+    ::printf("latency(us): min %.1f  p50 %.1f  p99 %.1f  p999 %.1f  "
+             "max %.1f  mean %.1f\n",
+             histogram.getMin() / 1000.0,
+             histogram.getPercentile(50) / 1000.0,
+             histogram.getPercentile(99) / 1000.0,
+             histogram.getPercentile(99.9) / 1000.0,
+             histogram.getMax() / 1000.0,
+             histogram.getMean() / 1000.0);
+    ::printf("cpu: %.3fs (%.1f%%)  per request: %.3fus\n",
+             cpu_time, cpu_time / seconds * 100.0,
+             request_count > 0 ? cpu_time / request_count * 1000000.0 : 0);
+
+    return 0;
+}
@@ -0,0 +1,573 @@
+#include <sys/resource.h>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+
+#include <brickred/command_line_option.h>
+#include <brickred/dynamic_buffer.h>
+#include <brickred/io_service.h>
+#include <brickred/socket_address.h>
+#include <brickred/tcp_service.h>
+#include <brickred/thread.h>
+#include <brickred/unique_ptr.h>
+
+#include "test/test_util.h"
+
+using namespace brickred;
+
+// message layout: [uint32 size][int64 send time in ns][padding]
+static const size_t s_message_header_size = 12;
+
+enum class Scenario {
+    ECHO,
+    BROADCAST,
+    REQRESP,
+    CHURN,
+};
+
+struct BenchConfig {
+    Scenario scenario;
+    int thread_count;
+    int conn_count;
+    size_t message_size;
+    int pipeline;
+    int warmup_ms;
+    int duration_ms;
+    SocketAddress addr;
+};
+
+static void writeMessageHeader(char *buffer, size_t size, int64_t time)
+{
+    uint32_t message_size = size;
+    ::memcpy(buffer, &message_size, 4);
+    ::memcpy(buffer + 4, &time, 8);
+}
+
+static bool readMessageHeader(const DynamicBuffer *buffer,
+                              size_t *size, int64_t *time)
+{
+    if (buffer->readableBytes() < s_message_header_size) {
+        return false;
+    }
+    uint32_t message_size = 0;
+    ::memcpy(&message_size, buffer->readBegin(), 4);
+    if (buffer->readableBytes() < message_size) {
+        return false;
+    }
+    ::memcpy(time, buffer->readBegin() + 4, 8);
+    *size = message_size;
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+class BenchServer {
+public:
+    BenchServer() :
+        tcp_service_(io_service_), stop_(false)
+    {
+        tcp_service_.setRecvMessageCallback(BRICKRED_BIND_MEM_FUNC(
+            &BenchServer::onRecvMessage, this));
+        tcp_service_.setPeerCloseCallback(BRICKRED_BIND_MEM_FUNC(
+            &BenchServer::onPeerClose, this));
+        tcp_service_.setErrorCallback(BRICKRED_BIND_MEM_FUNC(
+            &BenchServer::onError, this));
+    }
+
+    ~BenchServer()
+    {
+    }
+
+    bool listen(const BenchConfig &config, SocketAddress *addr)
+    {
+        config_ = config;
+
+        TcpService::SocketId socket_id = tcp_service_.listen(config.addr);
+        if (socket_id < 0) {
+            return false;
+        }
+        return tcp_service_.getLocalAddress(socket_id, addr);
+    }
+
+    void run()
+    {
+        io_service_.startTimer(100,
+            BRICKRED_BIND_MEM_FUNC(&BenchServer::onCheckStop, this));
+        io_service_.loop();
+    }
+
+    void stop()
+    {
+        stop_ = true;
+    }
+
+private:
+    void onCheckStop(int64_t timer_id)
+    {
+        if (stop_) {
+            io_service_.quit();
+        }
+    }
+
+    void onRecvMessage(TcpService *service,
+                       TcpService::SocketId socket_id,
+                       DynamicBuffer *buffer)
+    {
+        if (Scenario::ECHO == config_.scenario ||
+            Scenario::REQRESP == config_.scenario) {
+            // echo back
+            if (service->sendMessage(socket_id, buffer->readBegin(),
+                                     buffer->readableBytes()) == false) {
+                service->closeSocket(socket_id);
+                return;
+            }
+            buffer->read(buffer->readableBytes());
+            return;
+        }
+
+        size_t size = 0;
+        int64_t time = 0;
+        while (readMessageHeader(buffer, &size, &time)) {
+            if (Scenario::BROADCAST == config_.scenario) {
+                service->broadcastMessage(buffer->readBegin(), size);
+                buffer->read(size);
+            } else {
+                // server closes first to keep time wait out of the client
+                service->sendMessageThenClose(socket_id,
+                                              buffer->readBegin(), size);
+                return;
+            }
+        }
+    }
+
+    void onPeerClose(TcpService *service,
+                     TcpService::SocketId socket_id)
+    {
+        service->closeSocket(socket_id);
+    }
+
+    void onError(TcpService *service,
+                 TcpService::SocketId socket_id,
+                 int error)
+    {
+        service->closeSocket(socket_id);
+    }
+
+private:
+    BRICKRED_NONCOPYABLE(BenchServer)
+
+    IOService io_service_;
+    TcpService tcp_service_;
+    BenchConfig config_;
+    std::atomic<bool> stop_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+class BenchClient {
+public:
+    BenchClient() :
+        tcp_service_(io_service_),
+        id_(0), measuring_(false), publisher_socket_id_(-1),
+        connect_count_(0), message_count_(0), byte_count_(0),
+        error_count_(0)
+    {
+        tcp_service_.setNewConnectionCallback(BRICKRED_BIND_MEM_FUNC(
+            &BenchClient::onNewConnection, this));
+        tcp_service_.setRecvMessageCallback(BRICKRED_BIND_MEM_FUNC(
+            &BenchClient::onRecvMessage, this));
+        tcp_service_.setPeerCloseCallback(BRICKRED_BIND_MEM_FUNC(
+            &BenchClient::onPeerClose, this));
+        tcp_service_.setErrorCallback(BRICKRED_BIND_MEM_FUNC(
+            &BenchClient::onError, this));
+    }
+
+    ~BenchClient()
+    {
+    }
+
+    void init(int id, const BenchConfig &config)
+    {
+        id_ = id;
+        config_ = config;
+        message_.assign(config.message_size, 'x');
+    }
+
+    void run()
+    {
+        for (int i = 0; i < config_.conn_count; ++i) {
+            connect();
+        }
+
+        io_service_.startTimer(config_.warmup_ms,
+            BRICKRED_BIND_MEM_FUNC(&BenchClient::onWarmupEnd, this), 1);
+        io_service_.startTimer(config_.warmup_ms + config_.duration_ms,
+            BRICKRED_BIND_MEM_FUNC(&BenchClient::onMeasureEnd, this), 1);
+        io_service_.loop();
+    }
+
+    const test::LatencyHistogram &getHistogram() const { return histogram_; }
+    int64_t getConnectCount() const { return connect_count_; }
+    int64_t getMessageCount() const { return message_count_; }
+    int64_t getByteCount() const { return byte_count_; }
+    int64_t getErrorCount() const { return error_count_; }
+
+private:
+    void connect()
+    {
+        int64_t start_time = test::nowNanoseconds();
+        bool complete = false;
+        TcpService::SocketId socket_id = tcp_service_.asyncConnect(
+            config_.addr, &complete, 5000);
+        if (-1 == socket_id) {
+            ++error_count_;
+            return;
+        }
+        connect_start_times_[socket_id] = start_time;
+        if (complete) {
+            onConnected(socket_id);
+        }
+    }
+
+    void onConnected(TcpService::SocketId socket_id)
+    {
+        if (measuring_) {
+            ++connect_count_;
+        }
+
+        if (Scenario::BROADCAST == config_.scenario) {
+            // the first connection of the first thread publishes
+            if (id_ != 0 || publisher_socket_id_ != -1) {
+                return;
+            }
+            publisher_socket_id_ = socket_id;
+        }
+
+        int count = config_.pipeline;
+        if (Scenario::REQRESP == config_.scenario ||
+            Scenario::CHURN == config_.scenario) {
+            count = 1;
+        }
+        for (int i = 0; i < count; ++i) {
+            sendMessage(socket_id);
+        }
+    }
+
+    void sendMessage(TcpService::SocketId socket_id)
+    {
+        int64_t time = test::nowNanoseconds();
+        if (Scenario::CHURN == config_.scenario) {
+            // latency covers the whole connection cycle
+            time = connect_start_times_[socket_id];
+        }
+        writeMessageHeader(&message_[0], message_.size(), time);
+
+        if (tcp_service_.sendMessage(socket_id,
+                message_.c_str(), message_.size()) == false) {
+            ++error_count_;
+            closeSocket(socket_id);
+        }
+    }
+
+    void closeSocket(TcpService::SocketId socket_id)
+    {
+        tcp_service_.closeSocket(socket_id);
+        connect_start_times_.erase(socket_id);
+
+        if (Scenario::CHURN == config_.scenario) {
+            connect();
+        }
+    }
+
+    void onWarmupEnd(int64_t timer_id)
+    {
+        measuring_ = true;
+    }
+
+    void onMeasureEnd(int64_t timer_id)
+    {
+        measuring_ = false;
+        io_service_.quit();
+    }
+
+    void onNewConnection(TcpService *service,
+                         TcpService::SocketId from_socket_id,
+                         TcpService::SocketId socket_id)
+    {
+        onConnected(socket_id);
+    }
+
+    void onRecvMessage(TcpService *service,
+                       TcpService::SocketId socket_id,
+                       DynamicBuffer *buffer)
+    {
+        size_t size = 0;
+        int64_t time = 0;
+        while (readMessageHeader(buffer, &size, &time)) {
+            buffer->read(size);
+            if (measuring_) {
+                histogram_.record(test::nowNanoseconds() - time);
+                ++message_count_;
+                byte_count_ += size;
+            }
+
+            if (Scenario::CHURN == config_.scenario) {
+                closeSocket(socket_id);
+                return;
+            } else if (Scenario::BROADCAST == config_.scenario) {
+                if (socket_id == publisher_socket_id_) {
+                    sendMessage(socket_id);
+                }
+            } else {
+                sendMessage(socket_id);
+            }
+        }
+    }
+
+    void onPeerClose(TcpService *service,
+                     TcpService::SocketId socket_id)
+    {
+        if (Scenario::CHURN != config_.scenario && measuring_) {
+            ++error_count_;
+        }
+        closeSocket(socket_id);
+    }
+
+    void onError(TcpService *service,
+                 TcpService::SocketId socket_id,
+                 int error)
+    {
+        if (measuring_) {
+            ++error_count_;
+        }
+        closeSocket(socket_id);
+    }
+
+private:
+    BRICKRED_NONCOPYABLE(BenchClient)
+
+    IOService io_service_;
+    TcpService tcp_service_;
+    int id_;
+    BenchConfig config_;
+    std::string message_;
+    bool measuring_;
+    TcpService::SocketId publisher_socket_id_;
+    std::unordered_map<TcpService::SocketId, int64_t> connect_start_times_;
+
+    test::LatencyHistogram histogram_;
+    int64_t connect_count_;
+    int64_t message_count_;
+    int64_t byte_count_;
+    int64_t error_count_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+static double getCpuTime()
+{
+    struct rusage usage;
+    ::getrusage(RUSAGE_SELF, &usage);
+
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1000000.0 +
+           usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1000000.0;
+}
+
+// in kB, read from /proc/self/status
+static int64_t getMemoryStatus(const char *name)
+{
+    FILE *fp = ::fopen("/proc/self/status", "r");
+    if (nullptr == fp) {
+        return -1;
+    }
+
+    int64_t value = -1;
+    size_t name_size = ::strlen(name);
+    char line[256];
+    while (::fgets(line, sizeof(line), fp) != nullptr) {
+        if (::strncmp(line, name, name_size) == 0 &&
+            ':' == line[name_size]) {
+            value = ::atoll(line + name_size + 1);
+            break;
+        }
+    }
+    ::fclose(fp);
+
+    return value;
+}
+
+static void printUsage(const char *progname)
+{
+    ::fprintf(stderr, "usage: %s [<ip> <port>]\n"
+              "[-s <echo|broadcast|reqresp|churn>]\n"
+              "[-l <thread_count>]\n"
+              "[-n <conn_count_per_thread>]\n"
+              "[-m <message_size>]\n"
+              "[-p <pipeline>]\n"
+              "[-w <warmup_ms>]\n"
+              "[-t <duration_ms>]\n"
+              "without <ip> <port>, an in-process server "
+              "listens on loopback\n",
+              progname);
+}
+
+int main(int argc, char *argv[])
+{
+    BenchConfig config;
+    config.scenario = Scenario::ECHO;
+    config.thread_count = 1;
+    config.conn_count = 10;
+    config.message_size = 64;
+    config.pipeline = 16;
+    config.warmup_ms = 1000;
+    config.duration_ms = 5000;
+
+    CommandLineOption options;
+    options.addOption("s", CommandLineOption::ParameterType::REQUIRED);
+    options.addOption("l", CommandLineOption::ParameterType::REQUIRED);
+    options.addOption("n", CommandLineOption::ParameterType::REQUIRED);
+    options.addOption("m", CommandLineOption::ParameterType::REQUIRED);
+    options.addOption("p", CommandLineOption::ParameterType::REQUIRED);
+    options.addOption("w", CommandLineOption::ParameterType::REQUIRED);
+    options.addOption("t", CommandLineOption::ParameterType::REQUIRED);
+
+    if (options.parse(argc, argv) == false) {
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    std::string scenario_name = "echo";
+    if (options.hasOption("s")) {
+        scenario_name = options.getParameter("s");
+    }
+    if (scenario_name == "echo") {
+        config.scenario = Scenario::ECHO;
+    } else if (scenario_name == "broadcast") {
+        config.scenario = Scenario::BROADCAST;
+    } else if (scenario_name == "reqresp") {
+        config.scenario = Scenario::REQRESP;
+    } else if (scenario_name == "churn") {
+        config.scenario = Scenario::CHURN;
+    } else {
+        printUsage(argv[0]);
+        return -1;
+    }
+    if (options.hasOption("l")) {
+        config.thread_count = ::atoi(options.getParameter("l").c_str());
+    }
+    if (options.hasOption("n")) {
+        config.conn_count = ::atoi(options.getParameter("n").c_str());
+    }
+    if (options.hasOption("m")) {
+        config.message_size = ::atoi(options.getParameter("m").c_str());
+    }
+    if (options.hasOption("p")) {
+        config.pipeline = ::atoi(options.getParameter("p").c_str());
+    }
+    if (options.hasOption("w")) {
+        config.warmup_ms = ::atoi(options.getParameter("w").c_str());
+    }
+    if (options.hasOption("t")) {
+        config.duration_ms = ::atoi(options.getParameter("t").c_str());
+    }
+    if (config.message_size < s_message_header_size) {
+        config.message_size = s_message_header_size;
+    }
+    if (config.thread_count <= 0 || config.conn_count <= 0 ||
+        config.pipeline <= 0 || config.duration_ms <= 0) {
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    // start in-process server
+    UniquePtr<BenchServer> server;
+    Thread server_thread;
+    if (options.getLeftArguments().size() == 2) {
+        config.addr.setAddress(options.getLeftArguments()[0],
+            ::atoi(options.getLeftArguments()[1].c_str()));
+    } else if (options.getLeftArguments().empty()) {
+        config.addr.setAddress("127.0.0.1", 0);
+        server.reset(new BenchServer());
+        if (server->listen(config, &config.addr) == false) {
+            ::fprintf(stderr, "socket listen failed: %s\n",
+                      ::strerror(errno));
+            return -1;
+        }
+        server_thread.start(BRICKRED_BIND_MEM_FUNC(
+            &BenchServer::run, server.get()));
+    } else {
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    UniquePtr<Thread[]> threads(new Thread[config.thread_count]);
+    UniquePtr<BenchClient[]> clients(new BenchClient[config.thread_count]);
+
+    for (int i = 0; i < config.thread_count; ++i) {
+        clients[i].init(i, config);
+    }
+    for (int i = 0; i < config.thread_count; ++i) {
+        threads[i].start(BRICKRED_BIND_MEM_FUNC(
+            &BenchClient::run, &clients[i]));
+    }
+
+    this_thread::sleepFor(config.warmup_ms);
+    double cpu_start = getCpuTime();
+    this_thread::sleepFor(config.duration_ms);
+    double cpu_end = getCpuTime();
+
+    for (int i = 0; i < config.thread_count; ++i) {
+        threads[i].join();
+    }
+    if (server.get() != nullptr) {
+        server->stop();
+        server_thread.join();
+    }
+
+    test::LatencyHistogram histogram;
+    int64_t connect_count = 0;
+    int64_t message_count = 0;
+    int64_t byte_count = 0;
+    int64_t error_count = 0;
+    for (int i = 0; i < config.thread_count; ++i) {
+        histogram.merge(clients[i].getHistogram());
+        connect_count += clients[i].getConnectCount();
+        message_count += clients[i].getMessageCount();
+        byte_count += clients[i].getByteCount();
+        error_count += clients[i].getErrorCount();
+    }
+
+    double seconds = config.duration_ms / 1000.0;
+    double cpu_time = cpu_end - cpu_start;
+
+    ::printf("scenario: %s  threads: %d  connections: %d  "
+             "message size: %zu  pipeline: %d\n",
+             scenario_name.c_str(), config.thread_count,
+             config.thread_count * config.conn_count,
+             config.message_size, config.pipeline);
+    ::printf("duration: %.3fs  errors: %ld\n", seconds, error_count);
+    ::printf("accepts: %ld  (%.0f/s)\n",
+             connect_count, connect_count / seconds);
+    ::printf("messages: %ld  (%.0f/s)\n",
+             message_count, message_count / seconds);
+    ::printf("bytes: %ld  (%.2f MB/s)\n",
+             byte_count, byte_count / seconds / 1000000.0);
+    ::printf("latency(us): min %.1f  p50 %.1f  p99 %.1f  p999 %.1f  "
+             "max %.1f  mean %.1f\n",
+             histogram.getMin() / 1000.0,
+             histogram.getPercentile(50) / 1000.0,
+             histogram.getPercentile(99) / 1000.0,
+             histogram.getPercentile(99.9) / 1000.0,
+             histogram.getMax() / 1000.0,
+             histogram.getMean() / 1000.0);
+    ::printf("cpu: %.3fs (%.1f%%)  per message: %.3fus\n",
+             cpu_time, cpu_time / seconds * 100.0,
+             message_count > 0 ? cpu_time / message_count * 1000000.0 : 0);
+    ::printf("rss: %ld kB  peak: %ld kB\n",
+             getMemoryStatus("VmRSS"), getMemoryStatus("VmHWM"));
+
+    return 0;
+}
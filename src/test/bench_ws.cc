@@ -0,0 +1,654 @@
+#include <sys/uio.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <brickred/command_line_option.h>
+#include <brickred/dynamic_buffer.h>
+#include <brickred/io_service.h>
+#include <brickred/random.h>
+#include <brickred/socket_address.h>
+#include <brickred/tcp_service.h>
+#include <brickred/codec/utf8.h>
+#include <brickred/protocol/web_socket_deflate.h>
+#include <brickred/protocol/web_socket_mask.h>
+#include <brickred/protocol/web_socket_protocol.h>
+
+#include "test/test_util.h"
+
+using namespace brickred;
+using namespace brickred::protocol;
+
+///////////////////////////////////////////////////////////////////////////////
+// count allocations of the whole program, bench_ws is single threaded
+static int64_t s_alloc_count = 0;
+
+void *operator new(size_t size)
+{
+    ++s_alloc_count;
+    void *p = ::malloc(size == 0 ? 1 : size);
+    if (nullptr == p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    ::free(p);
+}
+
+void operator delete(void *p, size_t size) noexcept
+{
+    ::free(p);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static const uint8_t s_mask_key[4] = { 0x37, 0xfa, 0x21, 0x3d };
+
+static void doNotOptimize(const void *p)
+{
+    asm volatile("" : : "g"(p) : "memory");
+}
+
+// output of one side is the input of the other side
+class Pipe {
+public:
+    void write(const char *buffer, size_t size)
+    {
+        buffer_.reserveWritableBytes(size);
+        ::memcpy(buffer_.writeBegin(), buffer, size);
+        buffer_.write(size);
+    }
+
+    void writev(const struct iovec *buffers, int count)
+    {
+        for (int i = 0; i < count; ++i) {
+            write((const char *)buffers[i].iov_base, buffers[i].iov_len);
+        }
+    }
+
+    DynamicBuffer *getBuffer() { return &buffer_; }
+
+private:
+    DynamicBuffer buffer_;
+};
+
+static bool connect(WebSocketProtocol *client, Pipe *client_output,
+                    WebSocketProtocol *server, Pipe *server_output,
+                    Random *random)
+{
+    client->setOutputCallback(BRICKRED_BIND_MEM_FUNC(&Pipe::write,
+                                                     client_output));
+    server->setOutputCallback(BRICKRED_BIND_MEM_FUNC(&Pipe::write,
+                                                     server_output));
+
+    return client->startAsClient(SocketAddress("127.0.0.1", 80),
+                                 *random) &&
+        server->startAsServer() &&
+        server->recvMessage(client_output->getBuffer()) ==
+            WebSocketProtocol::RetCode::CONNECTION_ESTABLISHED &&
+        client->recvMessage(server_output->getBuffer()) ==
+            WebSocketProtocol::RetCode::CONNECTION_ESTABLISHED;
+}
+
+// moves at most size bytes of the input to buffer
+static void feed(Pipe *input, DynamicBuffer *buffer, size_t size)
+{
+    DynamicBuffer *from = input->getBuffer();
+    size = std::min(size, from->readableBytes());
+    buffer->reserveWritableBytes(size);
+    ::memcpy(buffer->writeBegin(), from->readBegin(), size);
+    buffer->write(size);
+    from->read(size);
+}
+
+static double benchMask(web_socket_mask::Impl impl,
+                        size_t size, int64_t total_bytes)
+{
+    std::vector<char> src(size);
+    std::vector<char> dst(size);
+    int64_t iterations = total_bytes / size + 1;
+
+    int64_t start = test::nowNanoseconds();
+    for (int64_t i = 0; i < iterations; ++i) {
+        web_socket_mask::maskWith(impl, &dst[0], &src[0], size, s_mask_key);
+        doNotOptimize(&dst[0]);
+    }
+    int64_t end = test::nowNanoseconds();
+
+    return (double)size * iterations / (end - start);
+}
+
+// a server receives masked frames of the size, returns GB/s,
+// text frames are half multibyte characters which are validated
+static double benchRecvFrame(size_t size, bool text, int64_t total_bytes)
+{
+    Random random;
+    Pipe client_output;
+    Pipe server_output;
+    WebSocketProtocol client;
+    WebSocketProtocol server;
+    client.setMessageMaxSize(2 * 1024 * 1024);
+    server.setMessageMaxSize(2 * 1024 * 1024);
+    if (connect(&client, &client_output, &server, &server_output,
+                &random) == false) {
+        ::fprintf(stderr, "web socket handshake failed\n");
+        ::exit(-1);
+    }
+
+    // one frame encoded by the client
+    std::string message(size, 'x');
+    if (text) {
+        for (size_t i = 0; i + 5 <= size; i += 5) {
+            message.replace(i, 3, "\xe4\xbd\xa0");
+        }
+        client.sendTextMessage(message.data(), message.size());
+    } else {
+        client.sendMessage(message.data(), message.size());
+    }
+    DynamicBuffer *output = client_output.getBuffer();
+    std::string frame(output->readBegin(), output->readableBytes());
+
+    DynamicBuffer buffer;
+    DynamicBuffer received;
+    int64_t iterations = total_bytes / size + 1;
+
+    int64_t start = test::nowNanoseconds();
+    for (int64_t i = 0; i < iterations; ++i) {
+        buffer.reserveWritableBytes(frame.size());
+        ::memcpy(buffer.writeBegin(), frame.data(), frame.size());
+        buffer.write(frame.size());
+
+        if (server.recvMessage(&buffer) !=
+                WebSocketProtocol::RetCode::MESSAGE_READY ||
+            server.retrieveMessage(&received) == false) {
+            ::fprintf(stderr, "web socket frame parse failed\n");
+            ::exit(-1);
+        }
+        doNotOptimize(received.readBegin());
+    }
+    int64_t end = test::nowNanoseconds();
+
+    return (double)size * iterations / (end - start);
+}
+
+// counts the output without copying it
+class NullOutput {
+public:
+    NullOutput() : bytes_(0) {}
+
+    void write(const char *buffer, size_t size)
+    {
+        bytes_ += size;
+    }
+
+    void writev(const struct iovec *buffers, int count)
+    {
+        for (int i = 0; i < count; ++i) {
+            bytes_ += buffers[i].iov_len;
+        }
+    }
+
+    int64_t bytes_;
+};
+
+struct SendResult {
+    double ns_per_frame;
+    double allocs_per_frame;
+};
+
+static SendResult benchSendMessage(bool is_client, bool use_outputv,
+                                   size_t size, int64_t total_bytes)
+{
+    Random random;
+    Pipe client_output;
+    Pipe server_output;
+    WebSocketProtocol client;
+    WebSocketProtocol server;
+    if (connect(&client, &client_output, &server, &server_output,
+                &random) == false) {
+        ::fprintf(stderr, "web socket handshake failed\n");
+        ::exit(-1);
+    }
+
+    NullOutput output;
+    WebSocketProtocol *protocol = is_client ? &client : &server;
+    protocol->setOutputCallback(BRICKRED_BIND_MEM_FUNC(
+        &NullOutput::write, &output));
+    if (use_outputv) {
+        protocol->setOutputVCallback(BRICKRED_BIND_MEM_FUNC(
+            &NullOutput::writev, &output));
+    }
+
+    std::string message(size, 'x');
+    int64_t iterations = total_bytes / size + 1;
+    // warm up the output buffer
+    protocol->sendMessage(message.data(), message.size());
+
+    int64_t alloc_count = s_alloc_count;
+    int64_t start = test::nowNanoseconds();
+    for (int64_t i = 0; i < iterations; ++i) {
+        protocol->sendMessage(message.data(), message.size());
+    }
+    int64_t end = test::nowNanoseconds();
+    doNotOptimize(&output);
+
+    SendResult result;
+    result.ns_per_frame = (double)(end - start) / iterations;
+    result.allocs_per_frame =
+        (double)(s_alloc_count - alloc_count) / iterations;
+    return result;
+}
+
+struct DeflateResult {
+    double ratio;
+    double ns_per_message;
+};
+
+// a server sends json-like messages of about size bytes to a client,
+// ratio is wire bytes / payload bytes
+static DeflateResult benchDeflate(bool enabled, bool no_context_takeover,
+                                  size_t size, int count)
+{
+    Random random;
+    Pipe client_output;
+    Pipe server_output;
+    WebSocketProtocol client;
+    WebSocketProtocol server;
+    client.setDeflateEnabled(enabled);
+    server.setDeflateEnabled(enabled);
+    server.setDeflateNoContextTakeover(no_context_takeover);
+    if (connect(&client, &client_output, &server, &server_output,
+                &random) == false) {
+        ::fprintf(stderr, "web socket handshake failed\n");
+        ::exit(-1);
+    }
+
+    std::vector<std::string> messages(64);
+    for (size_t i = 0; i < messages.size(); ++i) {
+        std::string &message = messages[i];
+        while (message.size() < size) {
+            char item[128];
+            ::snprintf(item, sizeof(item),
+                "{\"id\":%d,\"name\":\"player%d\",\"x\":%d,\"y\":%d,"
+                "\"hp\":%d,\"state\":\"%s\"},",
+                random.nextInt(100000), random.nextInt(1000),
+                random.nextInt(4096), random.nextInt(4096),
+                random.nextInt(100),
+                random.nextInt(2) ? "moving" : "idle");
+            message += item;
+        }
+        message.resize(size);
+    }
+
+    DynamicBuffer *wire = server_output.getBuffer();
+    DynamicBuffer received;
+    int64_t payload_bytes = 0;
+    int64_t wire_bytes = 0;
+
+    int64_t start = test::nowNanoseconds();
+    for (int i = 0; i < count; ++i) {
+        const std::string &message = messages[i % messages.size()];
+        server.sendMessage(message.data(), message.size());
+        payload_bytes += message.size();
+        wire_bytes += wire->readableBytes();
+
+        if (client.recvMessage(wire) !=
+                WebSocketProtocol::RetCode::MESSAGE_READY ||
+            client.retrieveMessage(&received) == false) {
+            ::fprintf(stderr, "web socket frame parse failed\n");
+            ::exit(-1);
+        }
+        doNotOptimize(received.readBegin());
+    }
+    int64_t end = test::nowNanoseconds();
+
+    DeflateResult result;
+    result.ratio = (double)wire_bytes / payload_bytes;
+    result.ns_per_message = (double)(end - start) / count;
+    return result;
+}
+
+struct StreamResult {
+    double gbps;
+    size_t peak_bytes;
+};
+
+// a client sends a message of total_bytes in 64KB fragments, a server in
+// streaming mode receives it in 64KB reads, peak_bytes is the largest
+// capacity of the buffers in between
+static StreamResult benchStreaming(int64_t total_bytes)
+{
+    Random random;
+    Pipe client_output;
+    Pipe server_output;
+    WebSocketProtocol client;
+    WebSocketProtocol server;
+    server.setStreamingEnabled(true);
+    if (connect(&client, &client_output, &server, &server_output,
+                &random) == false) {
+        ::fprintf(stderr, "web socket handshake failed\n");
+        ::exit(-1);
+    }
+
+    const size_t fragment_size = 64 * 1024;
+    std::string data(fragment_size, 's');
+    DynamicBuffer buffer;
+    DynamicBuffer fragment;
+    size_t peak_bytes = 0;
+    int64_t received_bytes = 0;
+
+    int64_t start = test::nowNanoseconds();
+    for (int64_t sent = 0; sent < total_bytes; sent += fragment_size) {
+        client.sendFragment(data.data(), data.size(),
+                            sent + (int64_t)fragment_size >= total_bytes);
+        while (client_output.getBuffer()->readableBytes() > 0) {
+            feed(&client_output, &buffer, fragment_size);
+            while (server.recvMessage(&buffer) ==
+                   WebSocketProtocol::RetCode::FRAGMENT_READY) {
+                int opcode = 0;
+                bool fin = false;
+                server.retrieveFragment(&fragment, &opcode, &fin);
+                received_bytes += fragment.readableBytes();
+                doNotOptimize(fragment.readBegin());
+            }
+        }
+        peak_bytes = std::max(peak_bytes,
+            client_output.getBuffer()->capacity() + buffer.capacity() +
+            fragment.capacity());
+    }
+    int64_t end = test::nowNanoseconds();
+
+    if (received_bytes < total_bytes) {
+        ::fprintf(stderr, "web socket streaming bench failed\n");
+        ::exit(-1);
+    }
+
+    StreamResult result;
+    result.gbps = (double)received_bytes / (end - start);
+    result.peak_bytes = peak_bytes;
+    return result;
+}
+
+// peers are the accepted sockets of connections made by the service
+// itself, the connecting sides discard what they receive
+class BroadcastBench {
+public:
+    class PeerSender {
+    public:
+        PeerSender(TcpService *service, TcpService::SocketId socket_id) :
+            service_(service), socket_id_(socket_id) {}
+
+        void write(const char *buffer, size_t size)
+        {
+            service_->sendMessage(socket_id_, buffer, size);
+        }
+
+    private:
+        TcpService *service_;
+        TcpService::SocketId socket_id_;
+    };
+
+    BroadcastBench() : service_(io_service_), listen_id_(-1)
+    {
+        service_.setNewConnectionCallback(BRICKRED_BIND_MEM_FUNC(
+            &BroadcastBench::onNewConnection, this));
+        service_.setRecvMessageCallback(BRICKRED_BIND_MEM_FUNC(
+            &BroadcastBench::onRecvMessage, this));
+    }
+
+    ~BroadcastBench()
+    {
+        for (size_t i = 0; i < senders_.size(); ++i) {
+            delete senders_[i];
+        }
+        for (size_t i = 0; i < protocols_.size(); ++i) {
+            delete protocols_[i];
+        }
+    }
+
+    bool open(size_t peer_count)
+    {
+        listen_id_ = service_.listen(SocketAddress("127.0.0.1", 0));
+        SocketAddress addr;
+        if (-1 == listen_id_ ||
+            service_.getLocalAddress(listen_id_, &addr) == false) {
+            return false;
+        }
+        // in batches under the listen backlog
+        while (peers_.size() < peer_count) {
+            peer_count_ = std::min(peer_count, peers_.size() + 64);
+            for (size_t i = peers_.size(); i < peer_count_; ++i) {
+                if (service_.connect(addr) == -1) {
+                    return false;
+                }
+            }
+            io_service_.loop();
+        }
+
+        // server side protocols connected through pipes
+        Random random;
+        Pipe client_output;
+        Pipe server_output;
+        for (size_t i = 0; i < peers_.size(); ++i) {
+            WebSocketProtocol client;
+            protocols_.push_back(new WebSocketProtocol());
+            if (connect(&client, &client_output, protocols_.back(),
+                        &server_output, &random) == false) {
+                return false;
+            }
+            senders_.push_back(new PeerSender(&service_, peers_[i]));
+            protocols_.back()->setOutputCallback(BRICKRED_BIND_MEM_FUNC(
+                &PeerSender::write, senders_.back()));
+        }
+
+        return true;
+    }
+
+    // returns ns per broadcast
+    double bench(bool encode_once, size_t size, int rounds)
+    {
+        std::string message(size, 'z');
+        int64_t elapsed = 0;
+
+        for (int i = 0; i < rounds; ++i) {
+            int64_t start = test::nowNanoseconds();
+            if (encode_once) {
+                WebSocketProtocol::Frame frame =
+                    WebSocketProtocol::encodeFrame(message.data(),
+                                                   message.size());
+                WebSocketProtocol::broadcastFrame(&service_,
+                    &peers_[0], peers_.size(), frame);
+            } else {
+                for (size_t j = 0; j < protocols_.size(); ++j) {
+                    protocols_[j]->sendMessage(message.data(),
+                                               message.size());
+                }
+            }
+            elapsed += test::nowNanoseconds() - start;
+
+            // drain the peers
+            io_service_.startTimer(1, BRICKRED_BIND_MEM_FUNC(
+                &BroadcastBench::onDrainTimer, this), 1);
+            io_service_.loop();
+        }
+
+        return (double)elapsed / rounds;
+    }
+
+    void onNewConnection(TcpService *service,
+                         TcpService::SocketId from_socket_id,
+                         TcpService::SocketId socket_id)
+    {
+        if (from_socket_id != listen_id_) {
+            return;
+        }
+        peers_.push_back(socket_id);
+        if (peers_.size() >= peer_count_) {
+            io_service_.quit();
+        }
+    }
+
+    void onRecvMessage(TcpService *service,
+                       TcpService::SocketId socket_id,
+                       DynamicBuffer *buffer)
+    {
+        buffer->read(buffer->readableBytes());
+    }
+
+    void onDrainTimer(IOService::TimerId timer_id)
+    {
+        io_service_.quit();
+    }
+
+private:
+    IOService io_service_;
+    TcpService service_;
+    TcpService::SocketId listen_id_;
+    size_t peer_count_;
+    std::vector<TcpService::SocketId> peers_;
+    std::vector<WebSocketProtocol *> protocols_;
+    std::vector<PeerSender *> senders_;
+};
+
+static void printUsage(const char *progname)
+{
+    ::fprintf(stderr, "usage: %s [-m megabytes_per_case]\n", progname);
+}
+
+int main(int argc, char *argv[])
+{
+    int64_t total_bytes = 1024LL * 1024 * 1024;
+
+    CommandLineOption options;
+    options.addOption("m", CommandLineOption::ParameterType::REQUIRED);
+
+    if (options.parse(argc, argv) == false ||
+        options.getLeftArguments().empty() == false) {
+        printUsage(argv[0]);
+        return -1;
+    }
+    if (options.hasOption("m")) {
+        total_bytes = ::atoll(options.getParameter("m").c_str()) *
+            1024 * 1024;
+    }
+    if (total_bytes <= 0) {
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    ::printf("mask implementation: %s\n", web_socket_mask::getImplName(
+        web_socket_mask::getImpl()));
+    ::printf("utf8 implementation: %s\n\n", codec::utf8::getImplName(
+        codec::utf8::getImpl()));
+
+    size_t sizes[] = { 64, 4096, 1024 * 1024 };
+    const char *size_names[] = { "64B", "4KB", "1MB" };
+
+    ::printf("%-8s %-12s %10s\n", "frame", "mask", "GB/s");
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        for (int impl = (int)web_socket_mask::Impl::BYTE;
+             impl < (int)web_socket_mask::Impl::MAX; ++impl) {
+            std::vector<char> probe(1);
+            if (web_socket_mask::maskWith((web_socket_mask::Impl)impl,
+                    &probe[0], &probe[0], 1, s_mask_key) == false) {
+                continue;
+            }
+            ::printf("%-8s %-12s %10.2f\n", size_names[i],
+                     web_socket_mask::getImplName(
+                         (web_socket_mask::Impl)impl),
+                     benchMask((web_socket_mask::Impl)impl,
+                               sizes[i], total_bytes));
+        }
+        ::printf("%-8s %-12s %10.2f\n", size_names[i], "recvMessage",
+                 benchRecvFrame(sizes[i], false, total_bytes));
+        ::printf("%-8s %-12s %10.2f\n", size_names[i], "recv text",
+                 benchRecvFrame(sizes[i], true, total_bytes));
+    }
+
+    struct {
+        const char *name;
+        bool is_client;
+        bool use_outputv;
+    } senders[] = {
+        { "server", false, false },
+        { "server iovec", false, true },
+        { "client", true, false },
+    };
+
+    ::printf("\n%-8s %-12s %10s %14s %12s\n",
+             "frame", "sendMessage", "ns/frame", "frames/s", "allocs/frame");
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        for (size_t j = 0; j < sizeof(senders) / sizeof(senders[0]); ++j) {
+            SendResult result = benchSendMessage(senders[j].is_client,
+                senders[j].use_outputv, sizes[i], total_bytes);
+            ::printf("%-8s %-12s %10.1f %14.0f %12.2f\n",
+                     size_names[i], senders[j].name, result.ns_per_frame,
+                     1e9 / result.ns_per_frame, result.allocs_per_frame);
+        }
+    }
+
+    const size_t peer_count = 256;
+    BroadcastBench broadcast;
+    if (broadcast.open(peer_count) == false) {
+        ::fprintf(stderr, "broadcast peers open failed\n");
+        return -1;
+    }
+    ::printf("\n%-8s %-20s %14s %12s\n", "frame", "broadcast 256 peers",
+             "us/broadcast", "ns/peer");
+    for (size_t i = 0; i < 2; ++i) {
+        for (int encode_once = 0; encode_once < 2; ++encode_once) {
+            double ns = broadcast.bench(encode_once, sizes[i], 200);
+            ::printf("%-8s %-20s %14.1f %12.1f\n", size_names[i],
+                     encode_once ? "broadcastFrame" : "per-peer send",
+                     ns / 1000, ns / peer_count);
+        }
+    }
+
+
+    StreamResult stream = benchStreaming(total_bytes / 4);
+    ::printf("\n%-24s %10s %14s\n", "streaming receive", "GB/s",
+             "peak buffers");
+    ::printf("%-24s %10.2f %12zuKB\n", "64KB fragments",
+             stream.gbps, stream.peak_bytes / 1024);
+
+    if (WebSocketDeflate::isSupported() == false) {
+        ::printf("\npermessage-deflate: not built with zlib\n");
+        return 0;
+    }
+    struct {
+        const char *name;
+        bool enabled;
+        bool no_context_takeover;
+    } deflates[] = {
+        { "off", false, false },
+        { "takeover", true, false },
+        { "no takeover", true, true },
+    };
+    size_t json_sizes[] = { 128, 1024, 16384 };
+    const char *json_size_names[] = { "128B", "1KB", "16KB" };
+
+    ::printf("\n%-8s %-12s %10s %12s\n",
+             "json", "deflate", "wire/raw", "ns/message");
+    for (size_t i = 0; i < sizeof(json_sizes) / sizeof(json_sizes[0]);
+         ++i) {
+        for (size_t j = 0; j < sizeof(deflates) / sizeof(deflates[0]);
+             ++j) {
+            DeflateResult result = benchDeflate(deflates[j].enabled,
+                deflates[j].no_context_takeover, json_sizes[i],
+                (int)std::min<int64_t>(total_bytes / json_sizes[i] / 16,
+                                       100000) + 1);
+            ::printf("%-8s %-12s %10.3f %12.1f\n", json_size_names[i],
+                     deflates[j].name, result.ratio,
+                     result.ns_per_message);
+        }
+    }
+
+    return 0;
+}
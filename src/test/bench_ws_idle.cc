@@ -0,0 +1,395 @@
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <brickred/command_line_option.h>
+#include <brickred/dynamic_buffer.h>
+#include <brickred/io_service.h>
+#include <brickred/socket_address.h>
+#include <brickred/tcp_service.h>
+#include <brickred/protocol/web_socket_server.h>
+
+#include "test/test_util.h"
+
+using namespace brickred;
+using namespace brickred::protocol;
+
+static const char s_handshake_request[] =
+    "GET / HTTP/1.1\r\n"
+    "Host: 127.0.0.1\r\n"
+    "Upgrade: websocket\r\n"
+    "Connection: Upgrade\r\n"
+    "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+    "Sec-WebSocket-Version: 13\r\n\r\n";
+// masked empty pong
+static const char s_pong_frame[] = { '\x8a', '\x80', 0, 0, 0, 0 };
+// connections of a listen port, under the ephemeral port range
+static const int s_conns_per_port = 25000;
+// handshakes in flight of a client process
+static const int s_handshake_window = 64;
+// file descriptors kept for other use in each process
+static const int s_reserved_fds = 32;
+
+static double getCpuTime()
+{
+    struct rusage usage;
+    ::getrusage(RUSAGE_SELF, &usage);
+
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1000000.0 +
+           usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1000000.0;
+}
+
+// in kB, read from /proc/self/status
+static int64_t getMemoryStatus(const char *name)
+{
+    FILE *fp = ::fopen("/proc/self/status", "r");
+    if (nullptr == fp) {
+        return -1;
+    }
+
+    int64_t value = -1;
+    size_t name_size = ::strlen(name);
+    char line[256];
+    while (::fgets(line, sizeof(line), fp) != nullptr) {
+        if (::strncmp(line, name, name_size) == 0 &&
+            ':' == line[name_size]) {
+            value = ::atoll(line + name_size + 1);
+            break;
+        }
+    }
+    ::fclose(fp);
+
+    return value;
+}
+
+static int getOpenFileLimit()
+{
+    struct rlimit limit;
+    if (::getrlimit(RLIMIT_NOFILE, &limit) != 0) {
+        return 1024;
+    }
+    if (limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        ::setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    return (int)std::min(limit.rlim_cur, (rlim_t)(1 << 30));
+}
+
+// client process with raw sockets, answers every ping with a pong,
+// killed by the server process
+static void runClient(const std::vector<SocketAddress> &addrs,
+                      int first, int count)
+{
+    int epoll_fd = ::epoll_create1(0);
+    if (-1 == epoll_fd) {
+        ::_exit(1);
+    }
+
+    // handshakes in flight are kept under the listen backlog
+    std::vector<char> responded;
+    int opened = 0;
+    int pending = 0;
+    std::vector<struct epoll_event> events(1024);
+    char buffer[4096];
+
+    for (;;) {
+        while (opened < count && pending < s_handshake_window) {
+            const SocketAddress &addr =
+                addrs[(first + opened) / s_conns_per_port];
+            int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+            if (-1 == fd) {
+                ::fprintf(stderr, "socket failed: %s\n", ::strerror(errno));
+                ::_exit(1);
+            }
+            if (::connect(fd,
+                    (const struct sockaddr *)addr.getNativeAddress(),
+                    addr.getNativeAddressSize()) != 0 ||
+                ::send(fd, s_handshake_request,
+                       sizeof(s_handshake_request) - 1, 0) < 0) {
+                ::fprintf(stderr, "connect failed: %s\n",
+                          ::strerror(errno));
+                ::_exit(1);
+            }
+
+            struct epoll_event event;
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+            if ((int)responded.size() <= fd) {
+                responded.resize(fd + 1, 0);
+            }
+            responded[fd] = 0;
+            ++opened;
+            ++pending;
+        }
+
+        // the handshake response is text, 0x89 only starts a ping frame
+        int n = ::epoll_wait(epoll_fd, &events[0], events.size(), -1);
+        for (int i = 0; i < n; ++i) {
+            int fd = events[i].data.fd;
+            ssize_t size = ::recv(fd, buffer, sizeof(buffer), 0);
+            if (size <= 0) {
+                ::epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+                ::close(fd);
+                continue;
+            }
+            if (0 == responded[fd]) {
+                responded[fd] = 1;
+                --pending;
+            }
+            for (ssize_t j = 0; j < size; ++j) {
+                if ('\x89' == buffer[j]) {
+                    ::send(fd, s_pong_frame, sizeof(s_pong_frame), 0);
+                }
+            }
+        }
+    }
+}
+
+class IdleBench {
+public:
+    IdleBench(int conn_count, int ping_interval_ms) :
+        server_(io_service_),
+        conn_count_(conn_count),
+        opened_(0), closed_(0), errors_(0), messages_(0)
+    {
+        server_.setPingInterval(ping_interval_ms);
+        server_.setPingTimeout(ping_interval_ms);
+        server_.setOpenCallback(BRICKRED_BIND_MEM_FUNC(
+            &IdleBench::onOpen, this));
+        server_.setMessageCallback(BRICKRED_BIND_MEM_FUNC(
+            &IdleBench::onMessage, this));
+        server_.setErrorCallback(BRICKRED_BIND_MEM_FUNC(
+            &IdleBench::onError, this));
+        server_.setCloseCallback(BRICKRED_BIND_MEM_FUNC(
+            &IdleBench::onClose, this));
+        server_.getTcpService()->setAcceptPauseTimeWhenExceedOpenFileLimit(
+            10);
+    }
+
+    bool listen()
+    {
+        int port_count = (conn_count_ + s_conns_per_port - 1) /
+            s_conns_per_port;
+        for (int i = 0; i < port_count; ++i) {
+            TcpService::SocketId socket_id =
+                server_.listen(SocketAddress("127.0.0.1", 0));
+            SocketAddress addr;
+            if (-1 == socket_id ||
+                server_.getTcpService()->getLocalAddress(
+                    socket_id, &addr) == false) {
+                return false;
+            }
+            addrs_.push_back(addr);
+        }
+
+        return true;
+    }
+
+    const std::vector<SocketAddress> &getAddresses() const
+    {
+        return addrs_;
+    }
+
+    // run until cond_cb returns true or timeout
+    bool runUntil(bool (IdleBench::*cond)() const, int timeout_ms)
+    {
+        cond_ = cond;
+        IOService::TimerId check_timer_id = io_service_.startTimer(10,
+            BRICKRED_BIND_MEM_FUNC(&IdleBench::onCheckTimer, this));
+        IOService::TimerId timeout_timer_id = io_service_.startTimer(
+            timeout_ms, BRICKRED_BIND_MEM_FUNC(&IdleBench::onTimeout, this),
+            1);
+        io_service_.loop();
+        io_service_.stopTimer(check_timer_id);
+        io_service_.stopTimer(timeout_timer_id);
+
+        return (this->*cond_)();
+    }
+
+    bool allOpened() const { return opened_ >= conn_count_; }
+    bool allClosed() const { return closed_ >= opened_; }
+    bool never() const { return false; }
+
+    int getOpened() const { return opened_; }
+    int getClosed() const { return closed_; }
+    int getErrors() const { return errors_; }
+    int getMessages() const { return messages_; }
+    size_t getConnectionCount() const
+    {
+        return server_.getConnectionCount();
+    }
+
+private:
+    void onCheckTimer(IOService::TimerId timer_id)
+    {
+        if ((this->*cond_)()) {
+            io_service_.quit();
+        }
+    }
+
+    void onTimeout(IOService::TimerId timer_id)
+    {
+        io_service_.quit();
+    }
+
+    void onOpen(WebSocketServer *server, TcpService::SocketId socket_id)
+    {
+        ++opened_;
+    }
+
+    void onMessage(WebSocketServer *server, TcpService::SocketId socket_id,
+                   int opcode, DynamicBuffer *message)
+    {
+        ++messages_;
+    }
+
+    void onError(WebSocketServer *server, TcpService::SocketId socket_id,
+                 WebSocketServer::Error error)
+    {
+        ++errors_;
+    }
+
+    void onClose(WebSocketServer *server, TcpService::SocketId socket_id)
+    {
+        ++closed_;
+    }
+
+private:
+    IOService io_service_;
+    WebSocketServer server_;
+    std::vector<SocketAddress> addrs_;
+    int conn_count_;
+    int opened_;
+    int closed_;
+    int errors_;
+    int messages_;
+    bool (IdleBench::*cond_)() const;
+};
+
+static void printUsage(const char *progname)
+{
+    ::fprintf(stderr, "usage: %s [-n connections] [-i ping_interval_ms] "
+              "[-t idle_seconds]\n", progname);
+}
+
+int main(int argc, char *argv[])
+{
+    int conn_count = 100000;
+    int ping_interval_ms = 1000;
+    int idle_seconds = 5;
+
+    CommandLineOption options;
+    options.addOption("n", CommandLineOption::ParameterType::REQUIRED);
+    options.addOption("i", CommandLineOption::ParameterType::REQUIRED);
+    options.addOption("t", CommandLineOption::ParameterType::REQUIRED);
+
+    if (options.parse(argc, argv) == false ||
+        options.getLeftArguments().empty() == false) {
+        printUsage(argv[0]);
+        return -1;
+    }
+    if (options.hasOption("n")) {
+        conn_count = ::atoi(options.getParameter("n").c_str());
+    }
+    if (options.hasOption("i")) {
+        ping_interval_ms = ::atoi(options.getParameter("i").c_str());
+    }
+    if (options.hasOption("t")) {
+        idle_seconds = ::atoi(options.getParameter("t").c_str());
+    }
+    if (conn_count <= 0 || ping_interval_ms <= 0 || idle_seconds <= 0) {
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    // every process has its own open file limit, clients are split
+    // into processes but the server holds all connections
+    int fd_limit = getOpenFileLimit() - s_reserved_fds;
+    if (conn_count > fd_limit) {
+        ::printf("open file limit %d, connections reduced from %d to %d\n",
+                 fd_limit + s_reserved_fds, conn_count, fd_limit);
+        conn_count = fd_limit;
+    }
+    ::signal(SIGPIPE, SIG_IGN);
+
+    IdleBench bench(conn_count, ping_interval_ms);
+    if (bench.listen() == false) {
+        ::fprintf(stderr, "listen failed: %s\n", ::strerror(errno));
+        return -1;
+    }
+    int64_t rss_before = getMemoryStatus("VmRSS");
+
+    std::vector<pid_t> clients;
+    for (int first = 0; first < conn_count; first += fd_limit) {
+        pid_t pid = ::fork();
+        if (-1 == pid) {
+            ::fprintf(stderr, "fork failed: %s\n", ::strerror(errno));
+            return -1;
+        } else if (0 == pid) {
+            runClient(bench.getAddresses(), first,
+                      std::min(fd_limit, conn_count - first));
+        }
+        clients.push_back(pid);
+    }
+
+    int64_t start = test::nowNanoseconds();
+    bool opened = bench.runUntil(&IdleBench::allOpened, 120000);
+    double open_seconds = (test::nowNanoseconds() - start) / 1e9;
+    int64_t rss_after = getMemoryStatus("VmRSS");
+
+    ::printf("connections: %d opened in %.2f s (%.0f/s)\n",
+             bench.getOpened(), open_seconds,
+             bench.getOpened() / open_seconds);
+    ::printf("rss: %ld kB before, %ld kB after, %.0f bytes/connection\n",
+             rss_before, rss_after, bench.getOpened() > 0 ?
+                 (rss_after - rss_before) * 1024.0 / bench.getOpened() : 0);
+
+    if (opened) {
+        // every connection is pinged and answers in each interval
+        double cpu_start = getCpuTime();
+        start = test::nowNanoseconds();
+        bench.runUntil(&IdleBench::never, idle_seconds * 1000);
+        double seconds = (test::nowNanoseconds() - start) / 1e9;
+        double cpu_time = getCpuTime() - cpu_start;
+        ::printf("idle %.1f s, ping interval %d ms: cpu %.3f s (%.2f%%), "
+                 "%.2f us/connection/ping\n",
+                 seconds, ping_interval_ms, cpu_time,
+                 cpu_time / seconds * 100.0,
+                 cpu_time * 1e6 / bench.getOpened() /
+                     (seconds * 1000 / ping_interval_ms));
+        ::printf("open after idle: %zd, errors: %d\n",
+                 bench.getConnectionCount(), bench.getErrors());
+    }
+
+    for (size_t i = 0; i < clients.size(); ++i) {
+        ::kill(clients[i], SIGKILL);
+        ::waitpid(clients[i], nullptr, 0);
+    }
+    start = test::nowNanoseconds();
+    bench.runUntil(&IdleBench::allClosed, 30000);
+    ::printf("closed: %d in %.2f s, rss peak: %ld kB\n",
+             bench.getClosed(), (test::nowNanoseconds() - start) / 1e9,
+             getMemoryStatus("VmHWM"));
+
+    if (opened == false) {
+        ::fprintf(stderr, "only %d of %d connections opened\n",
+                  bench.getOpened(), conn_count);
+        return -1;
+    }
+
+    return 0;
+}
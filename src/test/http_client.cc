@@ -1,4 +1,3 @@
-#include <cerrno>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
@@ -7,12 +6,9 @@
 
 #include "test/test_util.h"
 #include <brickred/command_line_option.h>
-#include <brickred/dynamic_buffer.h>
 #include <brickred/io_service.h>
 #include <brickred/socket_address.h>
-#include <brickred/string_util.h>
-#include <brickred/tcp_service.h>
-#include <brickred/protocol/http_protocol.h>
+#include <brickred/protocol/http_client.h>
 #include <brickred/protocol/http_request.h>
 #include <brickred/protocol/http_response.h>
 
@@ -23,39 +19,18 @@ static bool g_opt_print_hex = false;
 static std::string g_opt_host;
 static std::string g_opt_user_agent;
 
-class HttpClient {
+class HttpClientDemo {
 public:
-    HttpClient() : tcp_service_(io_service_), socket_id_(-1)
+    HttpClientDemo() : client_(io_service_), pending_count_(0)
     {
-        tcp_service_.setRecvMessageCallback(BRICKRED_BIND_MEM_FUNC(
-            &HttpClient::onRecvMessage, this));
-        tcp_service_.setPeerCloseCallback(BRICKRED_BIND_MEM_FUNC(
-            &HttpClient::onPeerClose, this));
-        tcp_service_.setErrorCallback(BRICKRED_BIND_MEM_FUNC(
-            &HttpClient::onError, this));
     }
 
-    ~HttpClient()
+    ~HttpClientDemo()
     {
     }
 
-    bool request(const SocketAddress &addr, const std::string &request_uri)
-    {
-        socket_id_ = tcp_service_.connect(addr);
-        if (-1 == socket_id_) {
-            ::fprintf(stderr, "[error] socket connect failed: %s\n",
-                     ::strerror(errno));
-            return false;
-        }
-
-        sendHttpRequest(addr, request_uri);
-        io_service_.loop();
-
-        return true;
-    }
-
-    void sendHttpRequest(const SocketAddress &addr,
-                         const std::string &request_uri)
+    bool request(const SocketAddress &addr, const std::string &request_uri,
+                 int count, int timeout_ms)
     {
         HttpRequest request;
         request.setVersion(HttpMessage::Version::HTTP_1_1);
@@ -64,21 +39,22 @@ public:
 
         if (g_opt_host.empty() == false) {
             request.setHeader("Host", g_opt_host);
-        } else {
-            request.setHeader("Host",
-                addr.getIp() + ":" + string_util::toString(addr.getPort()));
         }
         if (g_opt_user_agent.empty() == false) {
             request.setHeader("User-Agent", g_opt_user_agent);
         }
 
-        request.setHeader("Connection", "keep-alive");
-
-        DynamicBuffer buffer;
-        HttpProtocol::writeMessage(request, &buffer);
+        for (int i = 0; i < count; ++i) {
+            if (client_.sendRequest(addr, request, BRICKRED_BIND_MEM_FUNC(
+                    &HttpClientDemo::onResponse, this), timeout_ms) == -1) {
+                ::fprintf(stderr, "[error] send request failed\n");
+                return false;
+            }
+            ++pending_count_;
+        }
+        io_service_.loop();
 
-        tcp_service_.sendMessage(socket_id_,
-            buffer.readBegin(), buffer.readableBytes());
+        return true;
     }
 
     void printHttpResponse(const HttpResponse &response)
@@ -105,64 +81,32 @@ public:
         }
     }
 
-    void onRecvMessage(TcpService *service,
-                       TcpService::SocketId socket_id,
-                       DynamicBuffer *buffer)
+    void onResponse(HttpClient *client, HttpClient::RequestId request_id,
+                    HttpClient::ResultCode result, HttpResponse *response)
     {
-        HttpProtocol::RetCode ret = protocol_.recvMessage(buffer);
-        if (HttpProtocol::RetCode::WAITING_MORE_DATA == ret) {
-            return;
-
-        } else if (HttpProtocol::RetCode::ERROR == ret) {
-            ::printf("[error] recieve Message failed\n");
-            quit();
-
-        } else if (HttpProtocol::RetCode::MESSAGE_READY == ret) {
-            HttpResponse response;
-            if (protocol_.retrieveResponse(&response) == false) {
-                ::printf("[error] retrieve response failed\n");
-                quit();
-            }
-            printHttpResponse(response);
-            quit();
-            
+        if (HttpClient::ResultCode::OK == result) {
+            printHttpResponse(*response);
         } else {
-            quit();
+            ::printf("[error] request %ld failed: %d\n",
+                     request_id, (int)result);
         }
-    }
-
-    void onPeerClose(TcpService *service,
-                     TcpService::SocketId socket_id)
-    {
-        ::printf("[peer close] %lx\n", socket_id);
-        quit();
-    }
-
-    void onError(TcpService *service,
-                 TcpService::SocketId socket_id,
-                 int error)
-    {
-        ::printf("[error] %lx: %s\n", socket_id, ::strerror(error));
-        quit();
-    }
 
-    void quit()
-    {
-        tcp_service_.closeSocket(socket_id_);
-        io_service_.quit();
+        if (--pending_count_ == 0) {
+            io_service_.quit();
+        }
     }
 
 private:
     IOService io_service_;
-    TcpService tcp_service_;
-    TcpService::SocketId socket_id_;
-    HttpProtocol protocol_;
+    HttpClient client_;
+    int pending_count_;
 };
 
 static void printUsage(const char *progname)
 {
     ::fprintf(stderr, "usage: %s <ip>\n"
               "[-p <port>] [-r <request_uri>]\n"
+              "[-n <request_count>] [-t <timeout_ms>]\n"
               "[-H(hex_output)]\n"
               "[--user-agent <user_agent>]\n"
               "[--host <host>]\n",
@@ -174,10 +118,14 @@ int main(int argc, char *argv[])
     std::string ip;
     uint16_t port = 80;
     std::string request_uri = "/";
+    int request_count = 1;
+    int timeout_ms = 0;
 
     CommandLineOption options;
     options.addOption("p", CommandLineOption::ParameterType::REQUIRED);
     options.addOption("r", CommandLineOption::ParameterType::REQUIRED);
+    options.addOption("n", CommandLineOption::ParameterType::REQUIRED);
+    options.addOption("t", CommandLineOption::ParameterType::REQUIRED);
     options.addOption("H");
     options.addOption("host", CommandLineOption::ParameterType::REQUIRED);
     options.addOption("user-agent",
@@ -193,6 +141,12 @@ int main(int argc, char *argv[])
     if (options.hasOption("r")) {
         request_uri = options.getParameter("r");
     }
+    if (options.hasOption("n")) {
+        request_count = ::atoi(options.getParameter("n").c_str());
+    }
+    if (options.hasOption("t")) {
+        timeout_ms = ::atoi(options.getParameter("t").c_str());
+    }
     if (options.hasOption("H")) {
         g_opt_print_hex = true;
     }
@@ -208,8 +162,11 @@ int main(int argc, char *argv[])
     }
     ip = options.getLeftArguments()[0];
 
-    HttpClient client;
-    client.request(SocketAddress(ip, port), request_uri);
+    HttpClientDemo client;
+    if (client.request(SocketAddress(ip, port), request_uri,
+                       request_count, timeout_ms) == false) {
+        return -1;
+    }
 
     return 0;
 }
@@ -1,42 +1,240 @@
+#include <cstdint>
 #include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
 
+#include <brickred/command_line_option.h>
+#include <brickred/timestamp.h>
 #include <brickred/codec/md5.h>
 
 using namespace brickred;
 
-int main(int argc, char *argv[])
+// small files are read and hashed in groups of about this size,
+// larger files and stdin are streamed through Md5
+static const size_t s_group_bytes = 64 * 1024 * 1024;
+static const size_t s_stream_buffer_size = 64 * 1024;
+
+static void printUsage(const char *progname)
 {
-    FILE *fp = NULL;
+    ::fprintf(stderr, "usage: %s [-t] [-j threads] [file ...]\n"
+              "  -t  print throughput to stderr\n"
+              "  -j  threads hashing the files, default 1\n", progname);
+}
 
-    if (1 == argc) {
-        fp = stdin;
-    } else if (2 == argc) {
-        fp = ::fopen(argv[1], "rb");
-        if (NULL == fp) {
-            ::fprintf(stderr, "can not open file %s\n", argv[1]);
-            return -1;
-        }
-    } else {
-        ::fprintf(stderr, "usage: %s <file>\n", argv[0]);
-        return -1;
-    }
+static int64_t elapsedNanoseconds(const Timestamp &start,
+                                  const Timestamp &end)
+{
+    return (end.getSecond() - start.getSecond()) * 1000000000LL +
+           end.getNanoSecond() - start.getNanoSecond();
+}
 
-    codec::Md5 ctx;
-    char buffer[512];
+static bool readFile(FILE *fp, std::string *content)
+{
+    char buffer[64 * 1024];
 
     for (;;) {
         size_t count = ::fread(buffer, 1, sizeof(buffer), fp);
         if (count > 0) {
-            ctx.update(buffer, count);
+            content->append(buffer, count);
         }
         if (count < sizeof(buffer)) {
             break;
         }
     }
 
-    ::fclose(fp);
+    return ::ferror(fp) == 0;
+}
+
+class Md5Sum {
+public:
+    Md5Sum(int thread_count, bool print_file) :
+        thread_count_(thread_count), print_file_(print_file),
+        group_bytes_(0), total_files_(0), streamed_files_(0),
+        total_bytes_(0), hash_ns_(0),
+        stream_buffer_(s_stream_buffer_size)
+    {
+    }
+
+    void add(const std::string &file, std::string *content)
+    {
+        files_.push_back(file);
+        contents_.push_back(std::string());
+        contents_.back().swap(*content);
+        group_bytes_ += contents_.back().size();
+        if (group_bytes_ >= s_group_bytes) {
+            flush();
+        }
+    }
+
+    // all files of the group are hashed by one md5BatchParallel()
+    void flush()
+    {
+        size_t count = files_.size();
+        if (0 == count) {
+            return;
+        }
+
+        std::vector<const char *> buffers(count);
+        std::vector<size_t> sizes(count);
+        std::vector<char> hashes(count * 16);
+        for (size_t i = 0; i < count; ++i) {
+            buffers[i] = contents_[i].data();
+            sizes[i] = contents_[i].size();
+        }
+
+        Timestamp start;
+        start.setNow();
+        codec::md5BatchParallel(&buffers[0], &sizes[0], count,
+                                (char (*)[16])&hashes[0], thread_count_);
+        Timestamp end;
+        end.setNow();
+        hash_ns_ += elapsedNanoseconds(start, end);
+        total_files_ += count;
+        total_bytes_ += group_bytes_;
+
+        for (size_t i = 0; i < count; ++i) {
+            printHash(&hashes[i * 16], files_[i]);
+        }
+
+        files_.clear();
+        contents_.clear();
+        group_bytes_ = 0;
+    }
+
+    // the file is hashed piece by piece after the files added before
+    bool stream(const std::string &file, FILE *fp)
+    {
+        flush();
+
+        codec::Md5 md5;
+        for (;;) {
+            size_t count = ::fread(&stream_buffer_[0], 1,
+                                   stream_buffer_.size(), fp);
+            if (count > 0) {
+                Timestamp start;
+                start.setNow();
+                md5.update(&stream_buffer_[0], count);
+                Timestamp end;
+                end.setNow();
+                hash_ns_ += elapsedNanoseconds(start, end);
+                total_bytes_ += count;
+            }
+            if (count < stream_buffer_.size()) {
+                break;
+            }
+        }
+        if (::ferror(fp) != 0) {
+            return false;
+        }
+
+        char hash[16];
+        md5.digest(hash);
+        ++total_files_;
+        ++streamed_files_;
+        printHash(hash, file);
+
+        return true;
+    }
+
+    void printThroughput() const
+    {
+        ::fprintf(stderr, "%s x %d threads: %zu files (%zu streamed), "
+                  "%ld bytes in %.3f s, %.2f GB/s\n",
+                  codec::md5BatchGetImplName(codec::md5BatchGetImpl()),
+                  thread_count_, total_files_, streamed_files_, total_bytes_,
+                  hash_ns_ / 1e9,
+                  hash_ns_ > 0 ? (double)total_bytes_ / hash_ns_ : 0.0);
+    }
+
+private:
+    void printHash(const char *hash, const std::string &file) const
+    {
+        for (size_t i = 0; i < 16; ++i) {
+            ::printf("%02hhx", (unsigned char)hash[i]);
+        }
+        if (print_file_) {
+            ::printf("  %s", file.c_str());
+        }
+        ::printf("\n");
+    }
+
+private:
+    int thread_count_;
+    bool print_file_;
+    std::vector<std::string> files_;
+    std::vector<std::string> contents_;
+    size_t group_bytes_;
+    size_t total_files_;
+    size_t streamed_files_;
+    int64_t total_bytes_;
+    int64_t hash_ns_;
+    std::vector<char> stream_buffer_;
+};
+
+int main(int argc, char *argv[])
+{
+    CommandLineOption options;
+    options.addOption("t");
+    options.addOption("j", CommandLineOption::ParameterType::REQUIRED);
+
+    if (options.parse(argc, argv) == false) {
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    int thread_count = 1;
+    if (options.hasOption("j")) {
+        thread_count = ::atoi(options.getParameter("j").c_str());
+        if (thread_count <= 0) {
+            printUsage(argv[0]);
+            return -1;
+        }
+    }
+
+    // the file name is printed after the hash if there are several
+    const std::vector<std::string> &files = options.getLeftArguments();
+    Md5Sum md5_sum(thread_count, files.size() > 1);
+    std::string content;
+
+    if (files.empty()) {
+        if (md5_sum.stream("-", stdin) == false) {
+            ::fprintf(stderr, "can not read stdin\n");
+            return -1;
+        }
+    }
+    for (size_t i = 0; i < files.size(); ++i) {
+        FILE *fp = ::fopen(files[i].c_str(), "rb");
+        if (NULL == fp) {
+            ::fprintf(stderr, "can not open file %s\n", files[i].c_str());
+            return -1;
+        }
+
+        // only a regular file known to be small is read whole
+        struct stat st;
+        bool ret = false;
+        if (::fstat(::fileno(fp), &st) == 0 && S_ISREG(st.st_mode) &&
+            (size_t)st.st_size < s_group_bytes) {
+            ret = readFile(fp, &content);
+            if (ret) {
+                md5_sum.add(files[i], &content);
+            }
+            content.clear();
+        } else {
+            ret = md5_sum.stream(files[i], fp);
+        }
+        ::fclose(fp);
+        if (!ret) {
+            ::fprintf(stderr, "can not read file %s\n", files[i].c_str());
+            return -1;
+        }
+    }
+    md5_sum.flush();
 
-    ::printf("%s\n", ctx.digest().c_str());
+    if (options.hasOption("t")) {
+        md5_sum.printThroughput();
+    }
 
     return 0;
 }
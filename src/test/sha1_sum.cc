@@ -1,35 +1,88 @@
+#include <cstdint>
 #include <cstdio>
+#include <cstring>
+#include <vector>
 
+#include <brickred/command_line_option.h>
+#include <brickred/timestamp.h>
 #include <brickred/codec/sha1.h>
 
 using namespace brickred;
 
+static void printUsage(const char *progname)
+{
+    ::fprintf(stderr, "usage: %s [-t] [-i implementation] [file]\n"
+              "  -t  print throughput to stderr\n"
+              "  -i  scalar or sha_ni\n", progname);
+}
+
+static int64_t elapsedNanoseconds(const Timestamp &start,
+                                  const Timestamp &end)
+{
+    return (end.getSecond() - start.getSecond()) * 1000000000LL +
+           end.getNanoSecond() - start.getNanoSecond();
+}
+
 int main(int argc, char *argv[])
 {
+    CommandLineOption options;
+    options.addOption("t");
+    options.addOption("i", CommandLineOption::ParameterType::REQUIRED);
+
+    if (options.parse(argc, argv) == false ||
+        options.getLeftArguments().size() > 1) {
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    codec::Sha1 ctx;
+    if (options.hasOption("i")) {
+        const std::string &name = options.getParameter("i");
+        bool supported = false;
+        for (int i = (int)codec::Sha1::Impl::SCALAR;
+             i < (int)codec::Sha1::Impl::MAX; ++i) {
+            codec::Sha1::Impl impl = (codec::Sha1::Impl)i;
+            if (name == codec::Sha1::getImplName(impl)) {
+                supported = ctx.setImpl(impl);
+                break;
+            }
+        }
+        if (!supported) {
+            ::fprintf(stderr, "implementation %s is not supported\n",
+                      name.c_str());
+            return -1;
+        }
+    }
+
     FILE *fp = NULL;
 
-    if (1 == argc) {
+    if (options.getLeftArguments().empty()) {
         fp = stdin;
-    } else if (2 == argc) {
-        fp = ::fopen(argv[1], "rb");
+    } else {
+        const char *file = options.getLeftArguments()[0].c_str();
+        fp = ::fopen(file, "rb");
         if (NULL == fp) {
-            ::fprintf(stderr, "can not open file %s\n", argv[1]);
+            ::fprintf(stderr, "can not open file %s\n", file);
             return -1;
         }
-    } else {
-        ::fprintf(stderr, "usage: %s <file>\n", argv[0]);
-        return -1;
     }
 
-    codec::Sha1 ctx;
-    char buffer[512];
+    std::vector<char> buffer(64 * 1024);
+    int64_t total_bytes = 0;
+    int64_t hash_ns = 0;
 
     for (;;) {
-        size_t count = ::fread(buffer, 1, sizeof(buffer), fp);
+        size_t count = ::fread(&buffer[0], 1, buffer.size(), fp);
         if (count > 0) {
-            ctx.update(buffer, count);
+            Timestamp start;
+            start.setNow();
+            ctx.update(&buffer[0], count);
+            Timestamp end;
+            end.setNow();
+            hash_ns += elapsedNanoseconds(start, end);
+            total_bytes += count;
         }
-        if (count < sizeof(buffer)) {
+        if (count < buffer.size()) {
             break;
         }
     }
@@ -38,5 +91,12 @@ int main(int argc, char *argv[])
 
     ::printf("%s\n", ctx.digest().c_str());
 
+    if (options.hasOption("t")) {
+        ::fprintf(stderr, "%s: %ld bytes in %.3f s, %.2f GB/s\n",
+                  codec::Sha1::getImplName(ctx.getImpl()), total_bytes,
+                  hash_ns / 1e9,
+                  hash_ns > 0 ? (double)total_bytes / hash_ns : 0.0);
+    }
+
     return 0;
 }
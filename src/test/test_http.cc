@@ -0,0 +1,1555 @@
+#include <poll.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "test/test_util.h"
+#include <brickred/dynamic_buffer.h>
+#include <brickred/io_service.h>
+#include <brickred/socket_address.h>
+#include <brickred/tcp_socket.h>
+#include <brickred/thread.h>
+#include <brickred/timestamp.h>
+#include <brickred/protocol/http_client.h>
+#include <brickred/protocol/http_header_map.h>
+#include <brickred/protocol/http_protocol.h>
+#include <brickred/protocol/http_request.h>
+#include <brickred/protocol/http_request_view.h>
+#include <brickred/protocol/http_response.h>
+#include <brickred/protocol/http_router.h>
+#include <brickred/protocol/http_server.h>
+
+using namespace brickred;
+using namespace brickred::protocol;
+
+static std::string buildRequest(size_t header_size)
+{
+    std::string request = "GET /index.html HTTP/1.1\r\n";
+    for (int i = 0; request.size() < header_size; ++i) {
+        char header[64];
+        ::snprintf(header, sizeof(header),
+                   "X-Header-%04d: 0123456789abcdef\r\n", i);
+        request += header;
+    }
+    request += "\r\n";
+
+    return request;
+}
+
+// feed the request one byte per recvMessage() call
+static int64_t feedByteByByte(const std::string &request)
+{
+    HttpProtocol protocol;
+    protocol.setHeaderMaxSize(request.size() + 1);
+    DynamicBuffer buffer;
+
+    int64_t start = test::nowNanoseconds();
+    for (size_t i = 0; i < request.size(); ++i) {
+        buffer.reserveWritableBytes(1);
+        *buffer.writeBegin() = request[i];
+        buffer.write(1);
+
+        HttpProtocol::RetCode ret = protocol.recvMessage(&buffer);
+        if (HttpProtocol::RetCode::ERROR == ret) {
+            return -1;
+        }
+        if (HttpProtocol::RetCode::MESSAGE_READY == ret) {
+            if (i != request.size() - 1) {
+                return -1;
+            }
+            HttpRequest http_request;
+            if (protocol.retrieveRequest(&http_request) == false ||
+                http_request.getRequestUri() != "/index.html") {
+                return -1;
+            }
+            return test::nowNanoseconds() - start;
+        }
+    }
+
+    return -1;
+}
+
+static bool testByteByByte()
+{
+    // time of a linear parser doubles with the size,
+    // rescanning the buffer makes it 4 times
+    int64_t last_time = 0;
+    for (size_t size = 4 * 1024; size <= 32 * 1024; size *= 2) {
+        std::string request = buildRequest(size);
+        // take the best of 3 runs to filter out noise
+        int64_t time = -1;
+        for (int i = 0; i < 3; ++i) {
+            int64_t t = feedByteByByte(request);
+            if (t < 0) {
+                ::printf("byte by byte parse failed: size %zu\n", size);
+                return false;
+            }
+            if (time < 0 || t < time) {
+                time = t;
+            }
+        }
+
+        ::printf("header size: %6zu  time: %8.3fms  ns/byte: %.1f\n",
+                 request.size(), time / 1e6, (double)time / request.size());
+        if (last_time > 0 && time > last_time * 3) {
+            ::printf("parse time is not linear\n");
+            return false;
+        }
+        last_time = time;
+    }
+
+    return true;
+}
+
+static bool testHeaderTimeout()
+{
+    HttpProtocol protocol;
+    protocol.setHeaderTimeout(50);
+    DynamicBuffer buffer;
+
+    const char part1[] = "GET / HTTP/1.1\r\nHost: loc";
+    const char part2[] = "alhost\r\n\r\n";
+
+    buffer.writeBytes(part1, sizeof(part1) - 1);
+    if (protocol.recvMessage(&buffer) !=
+            HttpProtocol::RetCode::WAITING_MORE_DATA) {
+        return false;
+    }
+    Timestamp now;
+    now.setNow();
+    if (protocol.isHeaderTimeout(now)) {
+        return false;
+    }
+
+    ::usleep(100 * 1000);
+    now.setNow();
+    if (protocol.isHeaderTimeout(now) == false) {
+        return false;
+    }
+    buffer.writeBytes(part2, sizeof(part2) - 1);
+    if (protocol.recvMessage(&buffer) != HttpProtocol::RetCode::ERROR) {
+        return false;
+    }
+
+    // completed in time
+    protocol.reset();
+    buffer.clear();
+    buffer.writeBytes(part1, sizeof(part1) - 1);
+    buffer.writeBytes(part2, sizeof(part2) - 1);
+    if (protocol.recvMessage(&buffer) !=
+            HttpProtocol::RetCode::MESSAGE_READY) {
+        return false;
+    }
+
+    return true;
+}
+
+class BodyReceiver {
+public:
+    BodyReceiver() : header_count_(0), end_count_(0) {}
+
+    void onBody(HttpProtocol::BodyEvent event, const HttpMessage &message,
+                const char *data, size_t size)
+    {
+        if (HttpProtocol::BodyEvent::HEADER_COMPLETE == event) {
+            ++header_count_;
+        } else if (HttpProtocol::BodyEvent::DATA == event) {
+            body_.append(data, size);
+        } else {
+            ++end_count_;
+            trailer_ = message.getHeader("X-Trailer");
+        }
+    }
+
+    int header_count_;
+    int end_count_;
+    std::string body_;
+    std::string trailer_;
+};
+
+// feed the message in pieces of piece_size bytes
+static bool checkStreamingBody(const std::string &message,
+                               size_t piece_size,
+                               const std::string &expected_body,
+                               const std::string &expected_trailer)
+{
+    HttpProtocol protocol;
+    BodyReceiver receiver;
+    protocol.setBodyCallback(BRICKRED_BIND_MEM_FUNC(
+        &BodyReceiver::onBody, &receiver));
+    DynamicBuffer buffer;
+
+    for (size_t i = 0; i < message.size(); i += piece_size) {
+        buffer.writeBytes(message.data() + i,
+                          std::min(piece_size, message.size() - i));
+        HttpProtocol::RetCode ret = protocol.recvMessage(&buffer);
+        if (HttpProtocol::RetCode::ERROR == ret) {
+            return false;
+        }
+        if (HttpProtocol::RetCode::MESSAGE_READY == ret) {
+            HttpRequest request;
+            return i + piece_size >= message.size() &&
+                   protocol.retrieveRequest(&request) &&
+                   request.getBody().empty() &&
+                   buffer.readableBytes() == 0 &&
+                   1 == receiver.header_count_ &&
+                   1 == receiver.end_count_ &&
+                   receiver.body_ == expected_body &&
+                   receiver.trailer_ == expected_trailer;
+        }
+    }
+
+    return false;
+}
+
+static bool testStreamingBody()
+{
+    std::string body;
+    for (int i = 0; i < 1000; ++i) {
+        body += "0123456789";
+    }
+
+    // body is written by the chunked writer
+    DynamicBuffer chunked;
+    HttpRequest request;
+    request.setMethod(HttpRequest::Method::POST);
+    request.setRequestUri("/upload");
+    request.setVersion(HttpMessage::Version::HTTP_1_1);
+    request.setHeader("Transfer-Encoding", "chunked");
+    HttpProtocol::writeMessageHeader(request, &chunked);
+    for (size_t i = 0; i < body.size(); i += 3000) {
+        HttpProtocol::writeChunk(body.data() + i,
+            std::min((size_t)3000, body.size() - i), &chunked);
+    }
+    HttpProtocol::writeLastChunk(&chunked);
+    std::string chunked_message(chunked.readBegin(),
+                                chunked.readableBytes());
+    // with trailer header
+    std::string trailer_message = chunked_message;
+    trailer_message.replace(trailer_message.size() - 2, 2,
+                            "X-Trailer: done\r\n\r\n");
+
+    std::string length_message =
+        "POST /upload HTTP/1.1\r\nContent-Length: " +
+        std::to_string(body.size()) + "\r\n\r\n" + body;
+    std::string get_message = "GET / HTTP/1.1\r\n\r\n";
+
+    size_t piece_sizes[] = { 1, 7, 4096, 1000000 };
+    for (size_t i = 0;
+         i < sizeof(piece_sizes) / sizeof(piece_sizes[0]); ++i) {
+        if (checkStreamingBody(length_message, piece_sizes[i],
+                               body, "") == false ||
+            checkStreamingBody(chunked_message, piece_sizes[i],
+                               body, "") == false ||
+            checkStreamingBody(trailer_message, piece_sizes[i],
+                               body, "done") == false ||
+            checkStreamingBody(get_message, piece_sizes[i],
+                               "", "") == false) {
+            ::printf("streaming body failed: piece size %zu\n",
+                     piece_sizes[i]);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool testHeaderMap()
+{
+    HttpHeaderMap headers;
+    headers.set("Host", "localhost");
+    headers.set("X-First", "1");
+    headers.set("content-length", "10");
+    headers.set("X-Second", "2");
+    // replace keeps position and original name
+    headers.set("HOST", "example.com");
+
+    const char *names[] = { "Host", "X-First", "content-length", "X-Second" };
+    if (headers.size() != 4) {
+        return false;
+    }
+    size_t i = 0;
+    for (HttpHeaderMap::const_iterator iter = headers.begin();
+         iter != headers.end(); ++iter, ++i) {
+        if (iter->first != names[i]) {
+            return false;
+        }
+    }
+    if (headers.find("host")->second != "example.com" ||
+        headers.find(HttpHeaderMap::KnownHeader::CONTENT_LENGTH)->second !=
+            "10") {
+        return false;
+    }
+
+    // known header index is kept after erase
+    headers.erase("x-first");
+    if (headers.find("X-First") != headers.end() ||
+        headers.find(HttpHeaderMap::KnownHeader::CONTENT_LENGTH)->second !=
+            "10" ||
+        headers.find(HttpHeaderMap::KnownHeader::HOST)->second !=
+            "example.com") {
+        return false;
+    }
+    headers.erase("Content-Length");
+    if (headers.find(HttpHeaderMap::KnownHeader::CONTENT_LENGTH) !=
+            headers.end() ||
+        headers.find("X-Second")->second != "2") {
+        return false;
+    }
+
+    return true;
+}
+
+static bool testMethod()
+{
+    for (int i = (int)HttpRequest::Method::GET;
+         i < (int)HttpRequest::Method::MAX; ++i) {
+        HttpRequest::Method method = (HttpRequest::Method)i;
+        if (HttpRequest::MethodStrToEnum(
+                HttpRequest::MethodEnumToStr(method)) != method) {
+            return false;
+        }
+    }
+    const char *unknown[] = { "", "get", "GETS", "PUSH", "HEAP", "PATCHY" };
+    for (size_t i = 0; i < sizeof(unknown) / sizeof(unknown[0]); ++i) {
+        if (HttpRequest::MethodStrToEnum(unknown[i]) !=
+                HttpRequest::Method::UNKNOWN) {
+            return false;
+        }
+    }
+
+    // parsed by HttpProtocol
+    HttpProtocol protocol;
+    DynamicBuffer buffer;
+    const char message[] = "DELETE /users/1 HTTP/1.1\r\n\r\n";
+    buffer.writeBytes(message, sizeof(message) - 1);
+    HttpRequest request;
+    if (protocol.recvMessage(&buffer) !=
+            HttpProtocol::RetCode::MESSAGE_READY ||
+        protocol.retrieveRequest(&request) == false ||
+        request.getMethod() != HttpRequest::Method::DELETE) {
+        return false;
+    }
+
+    return true;
+}
+
+class RouteRecorder {
+public:
+    RouteRecorder() : route_(-1) {}
+
+    void onRoute0(const HttpRequest &, const HttpRouter::Params &params)
+    {
+        record(0, params);
+    }
+    void onRoute1(const HttpRequest &, const HttpRouter::Params &params)
+    {
+        record(1, params);
+    }
+    void onRoute2(const HttpRequest &, const HttpRouter::Params &params)
+    {
+        record(2, params);
+    }
+
+    void record(int route, const HttpRouter::Params &params)
+    {
+        route_ = route;
+        params_.clear();
+        for (size_t i = 0; i < params.size(); ++i) {
+            if (i > 0) {
+                params_ += ",";
+            }
+            params_.append(params[i].name);
+            params_ += "=";
+            params_.append(params[i].value);
+        }
+    }
+
+    int route_;
+    std::string params_;
+};
+
+static bool checkRoute(const HttpRouter &router, RouteRecorder *recorder,
+                       HttpRequest::Method method, const char *uri,
+                       int expected_route, const char *expected_params)
+{
+    HttpRequest request;
+    request.setMethod(method);
+    request.setRequestUri(uri);
+
+    recorder->route_ = -1;
+    recorder->params_.clear();
+    bool found = router.dispatch(request);
+    if (found != (expected_route >= 0) ||
+        recorder->route_ != expected_route ||
+        recorder->params_ != expected_params) {
+        ::printf("route mismatch: %s %s -> %d [%s]\n",
+                 HttpRequest::MethodEnumToStr(method).c_str(), uri,
+                 recorder->route_, recorder->params_.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+static bool testRouter()
+{
+    RouteRecorder recorder;
+    HttpRouter::Handler route0 = BRICKRED_BIND_MEM_FUNC(
+        &RouteRecorder::onRoute0, &recorder);
+    HttpRouter::Handler route1 = BRICKRED_BIND_MEM_FUNC(
+        &RouteRecorder::onRoute1, &recorder);
+    HttpRouter::Handler route2 = BRICKRED_BIND_MEM_FUNC(
+        &RouteRecorder::onRoute2, &recorder);
+
+    using Method = HttpRequest::Method;
+    HttpRouter router;
+    if (router.addRoute(Method::GET, "/users/list", route0) == false ||
+        router.addRoute(Method::GET, "/users/:id", route1) == false ||
+        router.addRoute(Method::PUT, "/users/:id", route2) == false ||
+        router.addRoute(Method::GET, "/users/:id/posts/:post", route2) ==
+            false ||
+        router.addRoute(Method::GET, "/user", route0) == false ||
+        router.addRoute(Method::GET, "/static/*path", route1) == false ||
+        router.addRoute(Method::DELETE, "/*", route2) == false) {
+        return false;
+    }
+    // invalid and conflicting routes
+    if (router.addRoute(Method::GET, "/users/list", route1) ||
+        router.addRoute(Method::GET, "/users/:name/x", route1) ||
+        router.addRoute(Method::GET, "users", route1) ||
+        router.addRoute(Method::GET, "/a:id", route1) ||
+        router.addRoute(Method::GET, "/a/:", route1) ||
+        router.addRoute(Method::GET, "/a/*rest/b", route1) ||
+        router.addRoute(Method::UNKNOWN, "/a", route1)) {
+        return false;
+    }
+
+    return
+        checkRoute(router, &recorder, Method::GET, "/users/list",
+                   0, "") &&
+        checkRoute(router, &recorder, Method::GET, "/users/lists",
+                   1, "id=lists") &&
+        checkRoute(router, &recorder, Method::GET, "/users/42?x=1",
+                   1, "id=42") &&
+        checkRoute(router, &recorder, Method::PUT, "/users/42",
+                   2, "id=42") &&
+        checkRoute(router, &recorder, Method::GET, "/users/42/posts/7",
+                   2, "id=42,post=7") &&
+        checkRoute(router, &recorder, Method::GET, "/user",
+                   0, "") &&
+        checkRoute(router, &recorder, Method::GET, "/users/",
+                   -1, "") &&
+        checkRoute(router, &recorder, Method::GET, "/static/js/a.js",
+                   1, "path=js/a.js") &&
+        checkRoute(router, &recorder, Method::GET, "/static/",
+                   1, "path=") &&
+        checkRoute(router, &recorder, Method::DELETE, "/anything/else",
+                   2, "=anything/else") &&
+        checkRoute(router, &recorder, Method::POST, "/users/list",
+                   -1, "");
+}
+
+static bool checkWriteMessage(const HttpMessage &message,
+                              const std::string &expected)
+{
+    DynamicBuffer buffer;
+    HttpProtocol::writeMessage(message, &buffer);
+    if (std::string(buffer.readBegin(), buffer.readableBytes()) !=
+            expected) {
+        ::printf("write message mismatch:\n%s\n",
+                 std::string(buffer.readBegin(),
+                             buffer.readableBytes()).c_str());
+        return false;
+    }
+
+    // header and body in two buffers
+    DynamicBuffer header_buffer;
+    struct iovec buffers[2];
+    int count = HttpProtocol::writeMessageV(message, &header_buffer,
+                                            buffers);
+    std::string gathered;
+    for (int i = 0; i < count; ++i) {
+        gathered.append((const char *)buffers[i].iov_base,
+                        buffers[i].iov_len);
+    }
+
+    return gathered == expected;
+}
+
+static bool testWriteMessage()
+{
+    HttpResponse response;
+    response.setVersion(HttpMessage::Version::HTTP_1_1);
+    response.setStatusCode(200);
+    response.setHeader("Content-Length", "5");
+    response.setBody("hello");
+    if (checkWriteMessage(response,
+            "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nhello") == false) {
+        return false;
+    }
+
+    // not precomputed
+    response.setStatusCode(299);
+    response.setReasonPhrase("Custom Status");
+    response.setVersion(HttpMessage::Version::HTTP_1_0);
+    response.setBody("");
+    response.setHeader("Content-Length", "0");
+    if (checkWriteMessage(response,
+            "HTTP/1.0 299 Custom Status\r\n"
+            "Content-Length: 0\r\n\r\n") == false) {
+        return false;
+    }
+
+    HttpRequest request;
+    request.setMethod(HttpRequest::Method::GET);
+    request.setRequestUri("/index.html");
+    request.setVersion(HttpMessage::Version::HTTP_1_1);
+    request.setHeader("Host", "localhost");
+    if (checkWriteMessage(request,
+            "GET /index.html HTTP/1.1\r\nHost: localhost\r\n\r\n") ==
+                false) {
+        return false;
+    }
+
+    // chunk size in hex
+    DynamicBuffer buffer;
+    std::string chunk(300, 'x');
+    HttpProtocol::writeChunk(chunk.data(), chunk.size(), &buffer);
+    HttpProtocol::writeLastChunk(&buffer);
+    if (std::string(buffer.readBegin(), buffer.readableBytes()) !=
+            "12c\r\n" + chunk + "\r\n0\r\n\r\n") {
+        return false;
+    }
+
+    return true;
+}
+
+class TestServer {
+public:
+    TestServer() : hold_(false), async_count_(0), cancel_count_(0)
+    {
+        server_.setRequestCallback(BRICKRED_BIND_MEM_FUNC(
+            &TestServer::onRequest, this));
+        server_.setRequestCancelCallback(BRICKRED_BIND_MEM_FUNC(
+            &TestServer::onRequestCancel, this));
+    }
+
+    HttpServer *getServer() { return &server_; }
+
+    bool start()
+    {
+        if (server_.listen(SocketAddress("127.0.0.1", 0)) == false ||
+            server_.getListenAddress(&addr_) == false) {
+            return false;
+        }
+        thread_.start(BRICKRED_BIND_MEM_FUNC(&HttpServer::run, &server_));
+        return true;
+    }
+
+    void stop()
+    {
+        server_.quit();
+        thread_.join();
+    }
+
+    // /slow is responded in a timer, /hold is never responded,
+    // /body is responded with a body
+    void onRequest(HttpServer *server, HttpServer::ConnectionId conn_id,
+                   const HttpRequest &request)
+    {
+        if (request.getRequestUri() == "/hold") {
+            hold_ = true;
+            return;
+        }
+        if (request.getRequestUri() == "/slow") {
+            async_conn_id_ = conn_id;
+            async_uri_ = request.getRequestUri();
+            server->getIOService(conn_id.reactor_index)->startTimer(50,
+                BRICKRED_BIND_MEM_FUNC(&TestServer::onSlowTimer, this), 1);
+            return;
+        }
+        if (request.getRequestUri() == "/body") {
+            HttpResponse response;
+            response.setVersion(HttpMessage::Version::HTTP_1_1);
+            response.setStatusCode(200);
+            response.setHeader("Content-Length", "5");
+            response.setBody("hello");
+            server_.sendResponse(conn_id, response);
+            return;
+        }
+        respond(conn_id, request.getRequestUri());
+    }
+
+    void onRequestCancel(HttpServer *server,
+                         HttpServer::ConnectionId conn_id)
+    {
+        ++cancel_count_;
+    }
+
+    void onSlowTimer(IOService::TimerId timer_id)
+    {
+        ++async_count_;
+        respond(async_conn_id_, async_uri_);
+    }
+
+    void respond(HttpServer::ConnectionId conn_id, const std::string &uri)
+    {
+        HttpResponse response;
+        response.setVersion(HttpMessage::Version::HTTP_1_1);
+        response.setStatusCode(200);
+        response.setHeader("X-Uri", uri);
+        response.setHeader("Content-Length", "0");
+        server_.sendResponse(conn_id, response);
+    }
+
+    const SocketAddress &getAddress() const { return addr_; }
+
+    bool hold_;
+    int async_count_;
+    int cancel_count_;
+
+private:
+    HttpServer server_;
+    Thread thread_;
+    SocketAddress addr_;
+    HttpServer::ConnectionId async_conn_id_;
+    std::string async_uri_;
+};
+
+// read until message_count responses are received or peer closed or
+// timeout, responses of TestServer have no body
+static std::string recvResponses(TcpSocket *socket, int message_count,
+                                 int timeout_ms, bool *closed)
+{
+    std::string data;
+    *closed = false;
+    int64_t deadline = test::nowNanoseconds() + timeout_ms * 1000000LL;
+
+    for (;;) {
+        int count = 0;
+        for (size_t pos = data.find("\r\n\r\n"); pos != std::string::npos;
+             pos = data.find("\r\n\r\n", pos + 4)) {
+            ++count;
+        }
+        if (count >= message_count && message_count > 0) {
+            return data;
+        }
+
+        int64_t remain_ms = (deadline - test::nowNanoseconds()) / 1000000;
+        if (remain_ms <= 0) {
+            return data;
+        }
+        struct pollfd pfd;
+        pfd.fd = socket->getDescriptor();
+        pfd.events = POLLIN;
+        if (::poll(&pfd, 1, remain_ms) <= 0) {
+            return data;
+        }
+        char buffer[4096];
+        int size = socket->recv(buffer, sizeof(buffer));
+        if (size <= 0) {
+            *closed = true;
+            return data;
+        }
+        data.append(buffer, size);
+    }
+}
+
+static bool sendString(TcpSocket *socket, const std::string &data)
+{
+    return socket->send(data.data(), data.size()) == (int)data.size();
+}
+
+static size_t countString(const std::string &data, const char *str)
+{
+    size_t count = 0;
+    for (size_t pos = data.find(str); pos != std::string::npos;
+         pos = data.find(str, pos + 1)) {
+        ++count;
+    }
+    return count;
+}
+
+static bool testServerKeepAlive()
+{
+    TestServer test_server;
+    test_server.getServer()->setKeepAliveMaxRequests(2);
+    if (test_server.start() == false) {
+        return false;
+    }
+
+    // pipelined, the async one keeps the order
+    TcpSocket socket;
+    bool closed = false;
+    bool ret = socket.activeOpen(test_server.getAddress()) &&
+        sendString(&socket, "GET /slow HTTP/1.1\r\n\r\n"
+                            "GET /fast HTTP/1.1\r\n\r\n"
+                            "GET /more HTTP/1.1\r\n\r\n");
+    std::string data = recvResponses(&socket, 3, 2000, &closed);
+    ret = ret && closed &&
+        countString(data, "HTTP/1.1 200") == 2 &&
+        data.find("X-Uri: /slow") < data.find("X-Uri: /fast") &&
+        data.find("/more") == std::string::npos &&
+        countString(data, "Connection: close") == 1 &&
+        1 == test_server.async_count_;
+    if (!ret) {
+        ::printf("keep alive max requests failed:\n%s\n", data.c_str());
+    }
+
+    // http/1.0 closes by default
+    TcpSocket socket2;
+    if (ret) {
+        ret = socket2.activeOpen(test_server.getAddress()) &&
+            sendString(&socket2, "GET /a HTTP/1.0\r\n\r\n");
+        data = recvResponses(&socket2, 2, 2000, &closed);
+        ret = ret && closed && countString(data, "HTTP/1.1 200") == 1;
+        if (!ret) {
+            ::printf("http/1.0 close failed:\n%s\n", data.c_str());
+        }
+    }
+
+    test_server.stop();
+    return ret;
+}
+
+static bool testServerTimeout()
+{
+    TestServer test_server;
+    test_server.getServer()->setHeaderTimeout(200);
+    test_server.getServer()->setBodyTimeout(200);
+    test_server.getServer()->setKeepAliveTimeout(300);
+    if (test_server.start() == false) {
+        return false;
+    }
+
+    bool closed = false;
+    int64_t start = test::nowNanoseconds();
+
+    // header is not completed
+    TcpSocket socket;
+    bool ret = socket.activeOpen(test_server.getAddress()) &&
+        sendString(&socket, "GET / HTTP/1.1\r\nHost: loc");
+    std::string data = recvResponses(&socket, 0, 2000, &closed);
+    ret = ret && closed && data.find("HTTP/1.1 408") == 0;
+    if (!ret) {
+        ::printf("header timeout failed:\n%s\n", data.c_str());
+    }
+
+    // body is not completed
+    TcpSocket socket2;
+    if (ret) {
+        ret = socket2.activeOpen(test_server.getAddress()) &&
+            sendString(&socket2, "POST / HTTP/1.1\r\n"
+                                 "Content-Length: 10\r\n\r\n01234");
+        data = recvResponses(&socket2, 0, 2000, &closed);
+        ret = ret && closed && data.find("HTTP/1.1 408") == 0;
+        if (!ret) {
+            ::printf("body timeout failed:\n%s\n", data.c_str());
+        }
+    }
+
+    // idle keep alive connection is closed silently
+    TcpSocket socket3;
+    if (ret) {
+        ret = socket3.activeOpen(test_server.getAddress()) &&
+            sendString(&socket3, "GET /a HTTP/1.1\r\n\r\n");
+        data = recvResponses(&socket3, 0, 2000, &closed);
+        ret = ret && closed && countString(data, "HTTP/1.1 200") == 1 &&
+            test::nowNanoseconds() - start < 1500 * 1000000LL;
+        if (!ret) {
+            ::printf("keep alive timeout failed:\n%s\n", data.c_str());
+        }
+    }
+
+    test_server.stop();
+    return ret;
+}
+
+static bool testServerConcurrentLimit()
+{
+    TestServer test_server;
+    test_server.getServer()->setMaxConcurrentRequests(1);
+    test_server.getServer()->setReactorCount(2);
+    if (test_server.start() == false) {
+        return false;
+    }
+
+    bool closed = false;
+    TcpSocket socket;
+    bool ret = socket.activeOpen(test_server.getAddress()) &&
+        sendString(&socket, "GET /hold HTTP/1.1\r\n\r\n");
+    for (int i = 0; i < 100 && !test_server.hold_; ++i) {
+        this_thread::sleepFor(10);
+    }
+    ret = ret && test_server.hold_;
+
+    TcpSocket socket2;
+    ret = ret && socket2.activeOpen(test_server.getAddress()) &&
+        sendString(&socket2, "GET /a HTTP/1.1\r\n\r\n");
+    std::string data = recvResponses(&socket2, 1, 2000, &closed);
+    ret = ret && data.find("HTTP/1.1 503") == 0;
+    if (!ret) {
+        ::printf("max concurrent requests failed:\n%s\n", data.c_str());
+    }
+
+    // the held request is released by closing the connection
+    socket.close();
+    this_thread::sleepFor(100);
+    ret = ret && sendString(&socket2, "GET /b HTTP/1.1\r\n\r\n");
+    data = recvResponses(&socket2, 1, 2000, &closed);
+    ret = ret && data.find("HTTP/1.1 200") == 0;
+    if (!ret) {
+        ::printf("concurrent request release failed:\n%s\n",
+                 data.c_str());
+    }
+
+    test_server.stop();
+    return ret;
+}
+
+static bool testServerCancel()
+{
+    TestServer test_server;
+    test_server.getServer()->setMaxPipelinedRequests(2);
+    if (test_server.start() == false) {
+        return false;
+    }
+
+    // the held request is cancelled when the peer closes
+    TcpSocket socket;
+    bool ret = socket.activeOpen(test_server.getAddress()) &&
+        sendString(&socket, "GET /hold HTTP/1.1\r\n\r\n");
+    for (int i = 0; i < 100 && !test_server.hold_; ++i) {
+        this_thread::sleepFor(10);
+    }
+    ret = ret && test_server.hold_;
+    socket.close();
+
+    // too many requests are pipelined after the held one
+    bool closed = false;
+    test_server.hold_ = false;
+    TcpSocket socket2;
+    ret = ret && socket2.activeOpen(test_server.getAddress()) &&
+        sendString(&socket2, "GET /hold HTTP/1.1\r\n\r\n");
+    for (int i = 0; i < 100 && !test_server.hold_; ++i) {
+        this_thread::sleepFor(10);
+    }
+    ret = ret && test_server.hold_ &&
+        sendString(&socket2, "GET /a HTTP/1.1\r\n\r\n"
+                             "GET /b HTTP/1.1\r\n\r\n");
+    std::string data = recvResponses(&socket2, 0, 2000, &closed);
+    ret = ret && closed && data.empty();
+
+    test_server.stop();
+    ret = ret && 2 == test_server.cancel_count_;
+    if (!ret) {
+        ::printf("request cancel failed, %d cancelled:\n%s\n",
+                 test_server.cancel_count_, data.c_str());
+    }
+
+    return ret;
+}
+
+static bool testServerHead()
+{
+    TestServer test_server;
+    if (test_server.start() == false) {
+        return false;
+    }
+
+    // the body is not sent, the next response follows the header
+    bool closed = false;
+    TcpSocket socket;
+    bool ret = socket.activeOpen(test_server.getAddress()) &&
+        sendString(&socket, "HEAD /body HTTP/1.1\r\n\r\n"
+                            "GET /body HTTP/1.1\r\n\r\n"
+                            "GET /a HTTP/1.1\r\n\r\n");
+    std::string data = recvResponses(&socket, 3, 2000, &closed);
+    ret = ret && countString(data, "Content-Length: 5\r\n") == 2 &&
+        countString(data, "hello") == 1 &&
+        data.find("\r\n\r\nHTTP/1.1 200") != std::string::npos;
+    if (!ret) {
+        ::printf("head response failed:\n%s\n", data.c_str());
+    }
+
+    test_server.stop();
+    return ret;
+}
+
+class ClientRecorder {
+public:
+    ClientRecorder(IOService *io_service, int expect_count) :
+        io_service_(io_service), expect_count_(expect_count),
+        ok_count_(0), uri_mismatch_count_(0), sending_(false),
+        reentered_count_(0)
+    {
+    }
+
+    // X-Uri of the response is checked with the request id order
+    void onResponse(HttpClient *client, HttpClient::RequestId request_id,
+                    HttpClient::ResultCode result, HttpResponse *response)
+    {
+        if (sending_) {
+            ++reentered_count_;
+        }
+        request_ids_.push_back(request_id);
+        results_.push_back(result);
+        if (HttpClient::ResultCode::OK == result) {
+            ++ok_count_;
+            if (response->getHeader("X-Uri") !=
+                    "/" + std::to_string(request_id)) {
+                ++uri_mismatch_count_;
+            }
+        }
+        if ((int)results_.size() >= expect_count_) {
+            io_service_->quit();
+        }
+    }
+
+    void wait(int timeout_ms)
+    {
+        IOService::TimerId timer_id = io_service_->startTimer(timeout_ms,
+            BRICKRED_BIND_MEM_FUNC(&ClientRecorder::onWaitTimeout, this), 1);
+        if ((int)results_.size() < expect_count_) {
+            io_service_->loop();
+        }
+        io_service_->stopTimer(timer_id);
+    }
+
+    void onWaitTimeout(IOService::TimerId timer_id)
+    {
+        io_service_->quit();
+    }
+
+    IOService *io_service_;
+    int expect_count_;
+    int ok_count_;
+    int uri_mismatch_count_;
+    // set around sendRequest(), the callback must not be called in it
+    bool sending_;
+    int reentered_count_;
+    std::vector<HttpClient::RequestId> request_ids_;
+    std::vector<HttpClient::ResultCode> results_;
+};
+
+static HttpRequest buildClientRequest(HttpClient::RequestId next_id)
+{
+    HttpRequest request;
+    request.setVersion(HttpMessage::Version::HTTP_1_1);
+    request.setMethod(HttpRequest::Method::GET);
+    request.setRequestUri("/" + std::to_string(next_id));
+    return request;
+}
+
+static bool testClientPool()
+{
+    TestServer test_server;
+    if (test_server.start() == false) {
+        return false;
+    }
+
+    IOService io_service;
+    HttpClient client(io_service);
+    client.setMaxConnectionsPerHost(2);
+    client.setMaxPipelinePerConnection(4);
+
+    // burst, pooled and pipelined
+    const int request_count = 100;
+    ClientRecorder recorder(&io_service, request_count);
+    size_t max_connection_count = 0;
+    for (int i = 1; i <= request_count; ++i) {
+        client.sendRequest(test_server.getAddress(), buildClientRequest(i),
+            BRICKRED_BIND_MEM_FUNC(&ClientRecorder::onResponse, &recorder));
+        max_connection_count =
+            std::max(max_connection_count, client.getConnectionCount());
+    }
+    recorder.wait(3000);
+    bool ret = request_count == recorder.ok_count_ &&
+        0 == recorder.uri_mismatch_count_ &&
+        max_connection_count <= 2 &&
+        client.getPendingRequestCount() == 0;
+    if (!ret) {
+        ::printf("pool burst failed: ok=%d mismatch=%d conn=%zu\n",
+                 recorder.ok_count_, recorder.uri_mismatch_count_,
+                 max_connection_count);
+    }
+
+    // sequential requests reuse one connection
+    if (ret) {
+        ClientRecorder recorder2(&io_service, 1);
+        client.setMaxConnectionsPerHost(8);
+        size_t connection_count = client.getConnectionCount();
+        for (int i = request_count + 1; ret && i <= request_count + 10; ++i) {
+            recorder2.results_.clear();
+            client.sendRequest(test_server.getAddress(),
+                buildClientRequest(i), BRICKRED_BIND_MEM_FUNC(
+                    &ClientRecorder::onResponse, &recorder2));
+            recorder2.wait(2000);
+            ret = recorder2.results_.size() == 1 &&
+                HttpClient::ResultCode::OK == recorder2.results_[0] &&
+                client.getConnectionCount() == connection_count;
+        }
+        if (!ret) {
+            ::printf("pool reuse failed\n");
+        }
+    }
+
+    test_server.stop();
+    return ret;
+}
+
+static bool testClientFailure()
+{
+    TestServer test_server;
+    if (test_server.start() == false) {
+        return false;
+    }
+
+    IOService io_service;
+    HttpClient client(io_service);
+
+    // response timeout
+    ClientRecorder recorder(&io_service, 1);
+    HttpRequest request = buildClientRequest(0);
+    request.setRequestUri("/hold");
+    client.sendRequest(test_server.getAddress(), request,
+        BRICKRED_BIND_MEM_FUNC(&ClientRecorder::onResponse, &recorder), 100);
+    recorder.wait(2000);
+    bool ret = recorder.results_.size() == 1 &&
+        HttpClient::ResultCode::TIMEOUT == recorder.results_[0] &&
+        client.getConnectionCount() == 0;
+    if (!ret) {
+        ::printf("request timeout failed\n");
+    }
+
+    // nobody listens on the port
+    SocketAddress closed_addr;
+    {
+        TcpSocket socket;
+        ret = ret && socket.passiveOpenNonblock(
+            SocketAddress("127.0.0.1", 0)) &&
+            socket.getLocalAddress(&closed_addr);
+    }
+    if (ret) {
+        ClientRecorder recorder2(&io_service, 2);
+        recorder2.sending_ = true;
+        HttpClient::RequestId id1 = client.sendRequest(closed_addr,
+            buildClientRequest(0),
+            BRICKRED_BIND_MEM_FUNC(&ClientRecorder::onResponse, &recorder2));
+        HttpClient::RequestId id2 = client.sendRequest(closed_addr,
+            buildClientRequest(0),
+            BRICKRED_BIND_MEM_FUNC(&ClientRecorder::onResponse, &recorder2));
+        recorder2.sending_ = false;
+        recorder2.wait(2000);
+        ret = recorder2.results_.size() == 2 &&
+            0 == recorder2.reentered_count_ &&
+            id1 == recorder2.request_ids_[0] &&
+            id2 == recorder2.request_ids_[1] &&
+            HttpClient::ResultCode::CONNECT_FAILED == recorder2.results_[0] &&
+            HttpClient::ResultCode::CONNECT_FAILED == recorder2.results_[1] &&
+            client.getPendingRequestCount() == 0;
+        if (!ret) {
+            ::printf("connect failed failed\n");
+        }
+    }
+
+    // tcp connect to a broadcast address fails at once
+    if (ret) {
+        ClientRecorder recorder3(&io_service, 1);
+        recorder3.sending_ = true;
+        HttpClient::RequestId id = client.sendRequest(
+            SocketAddress("255.255.255.255", 80), buildClientRequest(0),
+            BRICKRED_BIND_MEM_FUNC(&ClientRecorder::onResponse, &recorder3));
+        recorder3.sending_ = false;
+        recorder3.wait(2000);
+        ret = id != -1 && recorder3.results_.size() == 1 &&
+            0 == recorder3.reentered_count_ &&
+            id == recorder3.request_ids_[0] &&
+            HttpClient::ResultCode::CONNECT_FAILED == recorder3.results_[0] &&
+            client.getPendingRequestCount() == 0;
+        if (!ret) {
+            ::printf("connect failed at once failed\n");
+        }
+    }
+
+    test_server.stop();
+    return ret;
+}
+
+static bool testClientStaleConnection()
+{
+    TestServer test_server;
+    test_server.getServer()->setKeepAliveTimeout(100);
+    if (test_server.start() == false) {
+        return false;
+    }
+
+    IOService io_service;
+    HttpClient client(io_service);
+    client.setMaxConnectionsPerHost(1);
+
+    ClientRecorder recorder(&io_service, 1);
+    client.sendRequest(test_server.getAddress(), buildClientRequest(1),
+        BRICKRED_BIND_MEM_FUNC(&ClientRecorder::onResponse, &recorder));
+    recorder.wait(2000);
+    bool ret = recorder.ok_count_ == 1;
+
+    // the server closes the pooled connection while the client is not
+    // looping, so the close is found only after the next request is sent
+    for (int i = 0; ret && i < 2; ++i) {
+        ::usleep(300 * 1000);
+        HttpRequest request = buildClientRequest(2 + i);
+        if (1 == i) {
+            request.setMethod(HttpRequest::Method::POST);
+        }
+        ClientRecorder recorder2(&io_service, 1);
+        client.sendRequest(test_server.getAddress(), request,
+            BRICKRED_BIND_MEM_FUNC(&ClientRecorder::onResponse, &recorder2));
+        recorder2.wait(2000);
+        // post is not idempotent, so it is not sent again
+        HttpClient::ResultCode expect = (0 == i) ?
+            HttpClient::ResultCode::OK :
+            HttpClient::ResultCode::CONNECTION_CLOSED;
+        ret = recorder2.results_.size() == 1 &&
+            expect == recorder2.results_[0] &&
+            0 == recorder2.uri_mismatch_count_ &&
+            client.getPendingRequestCount() == 0;
+        if (!ret) {
+            ::printf("stale connection failed: round %d, %zu results\n",
+                     i, recorder2.results_.size());
+        }
+    }
+
+    test_server.stop();
+    return ret;
+}
+
+class OutputRecorder {
+public:
+    void onOutputV(const struct iovec *buffers, int count)
+    {
+        for (int i = 0; i < count; ++i) {
+            data_.append((const char *)buffers[i].iov_base,
+                         buffers[i].iov_len);
+        }
+    }
+
+    std::string data_;
+};
+
+static std::string writeMessageString(const HttpMessage &message)
+{
+    DynamicBuffer buffer;
+    HttpProtocol::writeMessage(message, &buffer);
+    return std::string(buffer.readBegin(), buffer.readableBytes());
+}
+
+static bool testOutputBatch()
+{
+    // only the iovec output callback is set
+    OutputRecorder recorder;
+    HttpProtocol protocol;
+    protocol.setOutputVCallback(BRICKRED_BIND_MEM_FUNC(
+        &OutputRecorder::onOutputV, &recorder));
+
+    HttpResponse response;
+    response.setVersion(HttpMessage::Version::HTTP_1_1);
+    response.setStatusCode(200);
+    response.setHeader("Content-Length", "5");
+    response.setBody("hello");
+    std::string expected = writeMessageString(response);
+
+    protocol.sendMessage(response);
+    protocol.beginOutputBatch();
+    protocol.sendMessage(response);
+    protocol.sendMessage(response);
+    protocol.endOutputBatch();
+    if (recorder.data_ != expected + expected + expected) {
+        return false;
+    }
+
+    // chunked message, in and out of output batch
+    recorder.data_.clear();
+    HttpResponse chunked;
+    chunked.setVersion(HttpMessage::Version::HTTP_1_1);
+    chunked.setStatusCode(200);
+    chunked.setHeader("Transfer-Encoding", "chunked");
+    DynamicBuffer chunked_buffer;
+    HttpProtocol::writeMessageHeader(chunked, &chunked_buffer);
+    HttpProtocol::writeChunk("hello", 5, &chunked_buffer);
+    HttpProtocol::writeLastChunk(&chunked_buffer);
+    expected.assign(chunked_buffer.readBegin(),
+                    chunked_buffer.readableBytes());
+
+    protocol.sendMessageHeader(chunked);
+    protocol.sendChunk("hello", 5);
+    protocol.sendLastChunk();
+    protocol.beginOutputBatch();
+    protocol.sendMessageHeader(chunked);
+    protocol.sendChunk("hello", 5);
+    protocol.sendLastChunk();
+    protocol.endOutputBatch();
+    if (recorder.data_ != expected + expected) {
+        return false;
+    }
+
+    // requests before a bad one are returned first
+    DynamicBuffer buffer;
+    const char *data = "GET /a HTTP/1.1\r\n\r\n"
+                       "GET /b HTTP/1.1\r\n\r\n"
+                       "GET /c HTTP/1.1\r\nbad header\r\n\r\n";
+    size_t size = ::strlen(data);
+    buffer.reserveWritableBytes(size);
+    ::memcpy(buffer.writeBegin(), data, size);
+    buffer.write(size);
+
+    std::vector<HttpRequest> requests;
+    if (protocol.recvRequests(&buffer, &requests) !=
+            HttpProtocol::RetCode::MESSAGE_READY ||
+        requests.size() != 2 ||
+        requests[1].getRequestUri() != "/b" ||
+        protocol.recvRequests(&buffer, &requests) !=
+            HttpProtocol::RetCode::ERROR ||
+        requests.size() != 2) {
+        return false;
+    }
+
+    return true;
+}
+
+static void appendString(DynamicBuffer *buffer, const std::string &data)
+{
+    buffer->reserveWritableBytes(data.size());
+    ::memcpy(buffer->writeBegin(), data.data(), data.size());
+    buffer->write(data.size());
+}
+
+static bool testPipelinedChunked()
+{
+    // the requests after the chunked one exceed body max size
+    HttpProtocol protocol;
+    protocol.setBodyMaxSize(64);
+    DynamicBuffer buffer;
+    appendString(&buffer, "POST /post HTTP/1.1\r\n"
+                          "Transfer-Encoding: chunked\r\n\r\n"
+                          "a\r\n0123456789\r\n"
+                          "a\r\nabcdefghij\r\n"
+                          "0\r\n\r\n");
+    for (int i = 0; i < 10; ++i) {
+        appendString(&buffer, "GET /next HTTP/1.1\r\n\r\n");
+    }
+
+    std::vector<HttpRequest> requests;
+    if (protocol.recvRequests(&buffer, &requests) !=
+            HttpProtocol::RetCode::MESSAGE_READY ||
+        requests.size() != 11 ||
+        requests[0].getBody() != "0123456789abcdefghij" ||
+        requests[10].getRequestUri() != "/next" ||
+        buffer.readableBytes() != 0) {
+        return false;
+    }
+
+    // the chunks themselves still exceed body max size
+    HttpProtocol protocol2;
+    protocol2.setBodyMaxSize(64);
+    DynamicBuffer buffer2;
+    appendString(&buffer2, "POST /post HTTP/1.1\r\n"
+                           "Transfer-Encoding: chunked\r\n\r\n"
+                           "28\r\n" + std::string(40, 'x') + "\r\n"
+                           "28\r\n" + std::string(40, 'x') + "\r\n"
+                           "0\r\n\r\n");
+    requests.clear();
+    if (protocol2.recvRequests(&buffer2, &requests) !=
+            HttpProtocol::RetCode::ERROR ||
+        requests.empty() == false) {
+        return false;
+    }
+
+    return true;
+}
+
+static HttpRequestView::RetCode parseView(HttpRequestView *view,
+                                          const std::string &request)
+{
+    return view->parse(request.data(), request.size());
+}
+
+static bool testRequestView()
+{
+    HttpRequestView view;
+
+    // every split gives the same result
+    std::string request = "POST /api/update?id=1 HTTP/1.1\r\n"
+                          "Host: api.example.com\r\n"
+                          "Connection: keep-alive\r\n"
+                          "X-Empty:\r\n"
+                          "Content-Length: 5\r\n"
+                          "\r\n"
+                          "hello";
+    for (size_t i = 0; i < request.size(); ++i) {
+        if (view.parse(request.data(), i) !=
+                HttpRequestView::RetCode::WAITING_MORE_DATA) {
+            ::printf("prefix %zu is not incomplete\n", i);
+            return false;
+        }
+    }
+    std::string pipelined = request + "GET / HTTP/1.1\r\n\r\n";
+    for (size_t i = request.size(); i <= pipelined.size(); ++i) {
+        if (view.parse(pipelined.data(), i) !=
+                HttpRequestView::RetCode::MESSAGE_READY ||
+            view.getMethod() != HttpRequest::Method::POST ||
+            view.getVersion() != HttpMessage::Version::HTTP_1_1 ||
+            view.getRequestUri() != "/api/update?id=1" ||
+            view.getHeaderCount() != 4 ||
+            view.getHeader("host") != "api.example.com" ||
+            view.hasHeader("x-empty") == false ||
+            view.getHeader("x-empty").empty() == false ||
+            view.isConnectionKeepAlive() == false ||
+            view.getContentLength() != 5 ||
+            view.getBody() != "hello" ||
+            view.getMessageSize() != request.size()) {
+            ::printf("parse of %zu bytes failed\n", i);
+            return false;
+        }
+    }
+
+    // header count limit
+    std::string headers = "GET / HTTP/1.1\r\n";
+    for (size_t i = 0; i < HttpRequestView::s_max_header_count; ++i) {
+        headers += "X-Header: value\r\n";
+    }
+    if (parseView(&view, headers + "\r\n") !=
+            HttpRequestView::RetCode::MESSAGE_READY ||
+        parseView(&view, headers + "X-More: value\r\n\r\n") !=
+            HttpRequestView::RetCode::ERROR) {
+        ::printf("header count limit failed\n");
+        return false;
+    }
+
+    // header size limit, incomplete header within the limit waits
+    std::string large = "GET / HTTP/1.1\r\nX-Large: " +
+                        std::string(4096, 'a') + "\r\n\r\n";
+    view.setHeaderMaxSize(large.size());
+    if (parseView(&view, large) != HttpRequestView::RetCode::MESSAGE_READY ||
+        parseView(&view, large.substr(0, large.size() - 1)) !=
+            HttpRequestView::RetCode::WAITING_MORE_DATA) {
+        ::printf("header size limit failed\n");
+        return false;
+    }
+    view.setHeaderMaxSize(large.size() - 1);
+    if (parseView(&view, large) != HttpRequestView::RetCode::ERROR ||
+        parseView(&view, large.substr(0, large.size() - 1)) !=
+            HttpRequestView::RetCode::ERROR) {
+        ::printf("header size exceed failed\n");
+        return false;
+    }
+    view.setHeaderMaxSize();
+
+    // repeated content-length must agree
+    if (parseView(&view, "POST / HTTP/1.1\r\n"
+                         "Content-Length: 2\r\n"
+                         "Content-Length: 2\r\n\r\nok") !=
+            HttpRequestView::RetCode::MESSAGE_READY ||
+        view.getBody() != "ok" ||
+        parseView(&view, "POST / HTTP/1.1\r\n"
+                         "Content-Length: 2\r\n"
+                         "Content-Length: 20\r\n\r\nok") !=
+            HttpRequestView::RetCode::ERROR ||
+        parseView(&view, "POST / HTTP/1.1\r\n"
+                         "Content-Length: 0\r\n"
+                         "content-length: 2\r\n\r\nok") !=
+            HttpRequestView::RetCode::ERROR) {
+        ::printf("repeated content-length failed\n");
+        return false;
+    }
+
+    // content-length with chunked
+    if (parseView(&view, "POST / HTTP/1.1\r\n"
+                         "Transfer-Encoding: chunked\r\n\r\n") !=
+            HttpRequestView::RetCode::MESSAGE_READY ||
+        view.isChunked() == false ||
+        parseView(&view, "POST / HTTP/1.1\r\n"
+                         "Content-Length: 5\r\n"
+                         "Transfer-Encoding: chunked\r\n\r\n") !=
+            HttpRequestView::RetCode::ERROR ||
+        parseView(&view, "POST / HTTP/1.1\r\n"
+                         "Transfer-Encoding: chunked\r\n"
+                         "Content-Length: 0\r\n\r\n") !=
+            HttpRequestView::RetCode::ERROR) {
+        ::printf("content-length with chunked failed\n");
+        return false;
+    }
+
+    // bare lf in a header
+    if (parseView(&view, "GET / HTTP/1.1\r\n"
+                         "X-Header: a\nContent-Length: 5\r\n\r\n") !=
+            HttpRequestView::RetCode::ERROR ||
+        parseView(&view, "GET / HTTP/1.1\r\n"
+                         "X-Header: a\n") !=
+            HttpRequestView::RetCode::ERROR ||
+        parseView(&view, "GET / HTTP/1.1\r\n"
+                         "\nX-Header: a\r\n\r\n") !=
+            HttpRequestView::RetCode::ERROR) {
+        ::printf("bare lf failed\n");
+        return false;
+    }
+
+    return true;
+}
+
+static bool testHeadResponse()
+{
+    // Content-Length of a HEAD response is not followed by a body
+    HttpProtocol protocol;
+    protocol.setHeadResponse(true);
+    DynamicBuffer buffer;
+    const char *data = "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\n"
+                       "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\n";
+    size_t size = ::strlen(data);
+    buffer.reserveWritableBytes(size);
+    ::memcpy(buffer.writeBegin(), data, size);
+    buffer.write(size);
+
+    HttpResponse response;
+    for (int i = 0; i < 2; ++i) {
+        if (protocol.recvMessage(&buffer) !=
+                HttpProtocol::RetCode::MESSAGE_READY ||
+            protocol.retrieveResponse(&response) == false) {
+            return false;
+        }
+    }
+    return buffer.readableBytes() == 0;
+}
+
+int main(void)
+{
+    ::printf("***parse header byte by byte***\n");
+    if (testByteByByte() == false) {
+        return -1;
+    }
+
+    ::printf("***header timeout***\n");
+    if (testHeaderTimeout() == false) {
+        ::printf("header timeout test failed\n");
+        return -1;
+    }
+    ::printf("ok\n");
+
+    ::printf("***header map***\n");
+    if (testHeaderMap() == false) {
+        ::printf("header map test failed\n");
+        return -1;
+    }
+    ::printf("ok\n");
+
+    ::printf("***method***\n");
+    if (testMethod() == false) {
+        ::printf("method test failed\n");
+        return -1;
+    }
+    ::printf("ok\n");
+
+    ::printf("***router***\n");
+    if (testRouter() == false) {
+        ::printf("router test failed\n");
+        return -1;
+    }
+    ::printf("ok\n");
+
+    ::printf("***write message***\n");
+    if (testWriteMessage() == false) {
+        ::printf("write message test failed\n");
+        return -1;
+    }
+    ::printf("ok\n");
+
+    ::printf("***streaming body***\n");
+    if (testStreamingBody() == false) {
+        return -1;
+    }
+    ::printf("ok\n");
+
+    ::printf("***server keep alive***\n");
+    if (testServerKeepAlive() == false) {
+        return -1;
+    }
+    ::printf("ok\n");
+
+    ::printf("***server timeout***\n");
+    if (testServerTimeout() == false) {
+        return -1;
+    }
+    ::printf("ok\n");
+
+    ::printf("***server concurrent limit***\n");
+    if (testServerConcurrentLimit() == false) {
+        return -1;
+    }
+    ::printf("ok\n");
+
+    ::printf("***server request cancel***\n");
+    if (testServerCancel() == false) {
+        return -1;
+    }
+    ::printf("ok\n");
+
+    ::printf("***server head***\n");
+    if (testServerHead() == false) {
+        return -1;
+    }
+    ::printf("ok\n");
+
+    ::printf("***output batch***\n");
+    if (testOutputBatch() == false) {
+        ::printf("output batch test failed\n");
+        return -1;
+    }
+    ::printf("ok\n");
+
+    ::printf("***pipelined chunked***\n");
+    if (testPipelinedChunked() == false) {
+        ::printf("pipelined chunked test failed\n");
+        return -1;
+    }
+    ::printf("ok\n");
+
+    ::printf("***request view***\n");
+    if (testRequestView() == false) {
+        ::printf("request view test failed\n");
+        return -1;
+    }
+    ::printf("ok\n");
+
+    ::printf("***head response***\n");
+    if (testHeadResponse() == false) {
+        ::printf("head response test failed\n");
+        return -1;
+    }
+    ::printf("ok\n");
+
+    ::printf("***client pool***\n");
+    if (testClientPool() == false) {
+        return -1;
+    }
+    ::printf("ok\n");
+
+    ::printf("***client failure***\n");
+    if (testClientFailure() == false) {
+        return -1;
+    }
+    ::printf("ok\n");
+
+    ::printf("***client stale connection***\n");
+    if (testClientStaleConnection() == false) {
+        return -1;
+    }
+    ::printf("ok\n");
+
+    return 0;
+}
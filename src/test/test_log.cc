@@ -1,17 +1,147 @@
 #include <cstdio>
+#include <cstring>
 #include <iostream>
 
 #include "test/test_util.h"
 #include <brickred/log_async_sink.h>
 #include <brickred/log_core.h>
 #include <brickred/log_file_sink.h>
+#include <brickred/log_record.h>
+#include <brickred/thread.h>
 
 using namespace brickred;
 using namespace test;
 
+static char log_msg[] = "Hello World! Hello World! Hello World!\n";
+
+template <typename... Args>
+static bool checkDeferredFormat(const char *expected,
+                                const char *format, const Args &... args)
+{
+    alignas(LogRecordHeader) char record[sizeof(LogRecordHeader) + 1024];
+    LogRecordWriter writer(record, sizeof(record));
+    writer.writeHeader(0, __FILE__, __LINE__, __func__, format);
+    (writer.writeArg(args), ...);
+
+    char buffer[256];
+    formatLogRecord(record, writer.size(), buffer, sizeof(buffer));
+    if (::strcmp(buffer, expected) != 0) {
+        ::printf("deferred format mismatch: [%s] != [%s]\n",
+                 buffer, expected);
+        return false;
+    }
+
+    return true;
+}
+
+static bool testDeferredFormat()
+{
+    std::string str("world");
+    short s = -1;
+    unsigned int u = 4000000000u;
+
+    return checkDeferredFormat("hello world 42 3.14\n",
+                               "hello %s %d %.2f\n", str, 42, 3.14159) &&
+           checkDeferredFormat("[  -7][ff][-1][4000000000][x]",
+                               "[%4d][%x][%hd][%u][%c]",
+                               -7, 255, s, u, 'x') &&
+           checkDeferredFormat("[ abc][abc  ][100%]",
+                               "[%*s][%-*s][%d%%]",
+                               4, "abc", 5, "abc", 100) &&
+           checkDeferredFormat("[1][(missing)", "[%d][%d]", 1) &&
+           checkDeferredFormat("[(bad arg)]", "[%s]", 1);
+}
+
+class LogThread {
+public:
+    LogThread() : log_count_(0), deferred_(false) {}
+    ~LogThread() {}
+
+    void init(int log_count, bool deferred)
+    {
+        log_count_ = log_count;
+        deferred_ = deferred;
+    }
+
+    void run()
+    {
+        for (int i = 0; i < log_count_; ++i) {
+            int64_t start = nowNanoseconds();
+            if (deferred_) {
+                LogCore::getInstance()->deferredLog(1, 0,
+                    __FILE__, __LINE__, __func__,
+                    "Hello %s! count: %d value: %.3f\n", "World", i, 0.5);
+            } else {
+                LogCore::getInstance()->log(1, 0,
+                    __FILE__, __LINE__, __func__,
+                    "Hello %s! count: %d value: %.3f\n", "World", i, 0.5);
+            }
+            histogram_.record(nowNanoseconds() - start);
+        }
+    }
+
+    const LatencyHistogram &getHistogram() const { return histogram_; }
+
+private:
+    int log_count_;
+    bool deferred_;
+    LatencyHistogram histogram_;
+};
+
+static bool testMultiThread(int thread_count, int log_count,
+                            bool deferred = false)
+{
+    LogCore::getInstance()->registerLogger(1);
+    UniquePtr<LogFileSink> file_sink(
+        new LogFileSink("test3_%Y_%m_%d.log"));
+    UniquePtr<LogAsyncSink> async_sink(
+        new LogAsyncSink(file_sink.get()));
+    file_sink.release();
+    if (LogCore::getInstance()->addSink(1, async_sink.get()) == false) {
+        return false;
+    }
+    async_sink.release();
+
+    UniquePtr<Thread[]> threads(new Thread[thread_count]);
+    UniquePtr<LogThread[]> log_threads(new LogThread[thread_count]);
+    for (int i = 0; i < thread_count; ++i) {
+        log_threads[i].init(log_count / thread_count, deferred);
+    }
+
+    int64_t start = nowNanoseconds();
+    for (int i = 0; i < thread_count; ++i) {
+        threads[i].start(BRICKRED_BIND_MEM_FUNC(
+            &LogThread::run, &log_threads[i]));
+    }
+    for (int i = 0; i < thread_count; ++i) {
+        threads[i].join();
+    }
+    int64_t log_end = nowNanoseconds();
+    // wait for all records written
+    LogCore::getInstance()->removeLogger(1);
+    int64_t flush_end = nowNanoseconds();
+
+    LatencyHistogram histogram;
+    for (int i = 0; i < thread_count; ++i) {
+        histogram.merge(log_threads[i].getHistogram());
+    }
+
+    ::printf("%s threads: %2d  records/s: %.0f (%.0f with flush)  "
+             "latency(ns): p50 %ld  p99 %ld  p999 %ld  max %ld\n",
+             deferred ? "deferred" : "formatted", thread_count,
+             histogram.getCount() * 1e9 / (log_end - start),
+             histogram.getCount() * 1e9 / (flush_end - start),
+             histogram.getPercentile(50),
+             histogram.getPercentile(99),
+             histogram.getPercentile(99.9),
+             histogram.getMax());
+
+    return true;
+}
+
 int main(void)
 {
-    char log_msg[] = "Hello World! Hello World! Hello World!\n";
+    LogCore::getInstance()->setMaxLoggerCount(2);
 
     {
         std::cout << "***log using log_file_sink***" << std::endl;
@@ -53,6 +183,33 @@ int main(void)
         LogCore::getInstance()->removeLogger(1);
     }
 
+    {
+        std::cout << "***log using log_async_sink in multi thread***"
+                  << std::endl;
+        int thread_counts[] = { 1, 4, 16 };
+        for (size_t i = 0;
+             i < sizeof(thread_counts) / sizeof(thread_counts[0]); ++i) {
+            if (testMultiThread(thread_counts[i], 1000000) == false) {
+                return -1;
+            }
+        }
+    }
+
+    {
+        std::cout << "***log using deferred format***" << std::endl;
+        if (testDeferredFormat() == false) {
+            return -1;
+        }
+        int thread_counts[] = { 1, 4 };
+        for (size_t i = 0;
+             i < sizeof(thread_counts) / sizeof(thread_counts[0]); ++i) {
+            if (testMultiThread(thread_counts[i], 1000000) == false ||
+                testMultiThread(thread_counts[i], 1000000, true) == false) {
+                return -1;
+            }
+        }
+    }
+
     {
         std::cout << "***log using fwrite directly***" << std::endl;
         TestTimer timer;
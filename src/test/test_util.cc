@@ -3,9 +3,11 @@
 #include <time.h>
 #include <unistd.h>
 #include <sys/times.h>
+#include <algorithm>
 #include <cstdio>
 #include <iostream>
 #include <iomanip>
+#include <vector>
 
 namespace test {
 
@@ -85,6 +87,194 @@ TestTimer::Impl::~Impl()
 
 ///////////////////////////////////////////////////////////////////////////////
 
+class LatencyHistogram::Impl {
+public:
+    // values below 2^SUB_BUCKET_BITS are recorded exactly,
+    // above that each power of two range is split into HALF_COUNT buckets
+    static const int SUB_BUCKET_BITS = 7;
+    static const int SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+    static const int HALF_COUNT = SUB_BUCKET_COUNT / 2;
+    static const int BUCKET_COUNT =
+        (64 - SUB_BUCKET_BITS + 1) * HALF_COUNT + HALF_COUNT;
+
+    Impl();
+    ~Impl();
+
+    void record(int64_t value);
+    void merge(const Impl &other);
+    void reset();
+
+    int64_t getCount() const { return count_; }
+    int64_t getMin() const { return count_ > 0 ? min_ : 0; }
+    int64_t getMax() const { return max_; }
+    double getMean() const;
+    int64_t getPercentile(double percentile) const;
+
+private:
+    static int bucketIndex(uint64_t value);
+    static int64_t bucketValue(int index);
+
+private:
+    std::vector<int64_t> buckets_;
+    int64_t count_;
+    int64_t min_;
+    int64_t max_;
+    double sum_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+LatencyHistogram::Impl::Impl() :
+    buckets_(BUCKET_COUNT, 0)
+{
+    reset();
+}
+
+LatencyHistogram::Impl::~Impl()
+{
+}
+
+int LatencyHistogram::Impl::bucketIndex(uint64_t value)
+{
+    if (value < (uint64_t)SUB_BUCKET_COUNT) {
+        return (int)value;
+    }
+    int shift = (63 - __builtin_clzll(value)) - (SUB_BUCKET_BITS - 1);
+
+    return shift * HALF_COUNT + (int)(value >> shift);
+}
+
+int64_t LatencyHistogram::Impl::bucketValue(int index)
+{
+    if (index < SUB_BUCKET_COUNT) {
+        return index;
+    }
+    int shift = index / HALF_COUNT - 1;
+    int64_t sub = index - shift * HALF_COUNT;
+
+    // middle of the bucket
+    return (sub << shift) + ((1LL << shift) >> 1);
+}
+
+void LatencyHistogram::Impl::record(int64_t value)
+{
+    if (value < 0) {
+        value = 0;
+    }
+    ++buckets_[bucketIndex(value)];
+    ++count_;
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+    sum_ += value;
+}
+
+void LatencyHistogram::Impl::merge(const Impl &other)
+{
+    for (int i = 0; i < BUCKET_COUNT; ++i) {
+        buckets_[i] += other.buckets_[i];
+    }
+    count_ += other.count_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+    sum_ += other.sum_;
+}
+
+void LatencyHistogram::Impl::reset()
+{
+    std::fill(buckets_.begin(), buckets_.end(), 0);
+    count_ = 0;
+    min_ = INT64_MAX;
+    max_ = 0;
+    sum_ = 0;
+}
+
+double LatencyHistogram::Impl::getMean() const
+{
+    return count_ > 0 ? sum_ / count_ : 0;
+}
+
+int64_t LatencyHistogram::Impl::getPercentile(double percentile) const
+{
+    if (0 == count_) {
+        return 0;
+    }
+
+    int64_t rank = (int64_t)(percentile / 100.0 * count_ + 0.5);
+    rank = std::max(rank, (int64_t)1);
+    rank = std::min(rank, count_);
+
+    int64_t seen = 0;
+    for (int i = 0; i < BUCKET_COUNT; ++i) {
+        seen += buckets_[i];
+        if (seen >= rank) {
+            return std::min(std::max(bucketValue(i), getMin()), max_);
+        }
+    }
+
+    return max_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+LatencyHistogram::LatencyHistogram() :
+    pimpl_(new Impl)
+{
+}
+
+LatencyHistogram::~LatencyHistogram()
+{
+}
+
+void LatencyHistogram::record(int64_t value)
+{
+    pimpl_->record(value);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other)
+{
+    pimpl_->merge(*other.pimpl_);
+}
+
+void LatencyHistogram::reset()
+{
+    pimpl_->reset();
+}
+
+int64_t LatencyHistogram::getCount() const
+{
+    return pimpl_->getCount();
+}
+
+int64_t LatencyHistogram::getMin() const
+{
+    return pimpl_->getMin();
+}
+
+int64_t LatencyHistogram::getMax() const
+{
+    return pimpl_->getMax();
+}
+
+double LatencyHistogram::getMean() const
+{
+    return pimpl_->getMean();
+}
+
+int64_t LatencyHistogram::getPercentile(double percentile) const
+{
+    return pimpl_->getPercentile(percentile);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int64_t nowNanoseconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 void hexdump(const char *buffer, size_t size)
 {
 #define LINE_CHAR_COUNT 16
@@ -2,6 +2,7 @@
 #define BRICKRED_TEST_TEST_UTIL_H
 
 #include <cstddef>
+#include <cstdint>
 #include <brickred/class_util.h>
 #include <brickred/unique_ptr.h>
 
@@ -19,6 +20,33 @@ private:
     brickred::UniquePtr<Impl> pimpl_;
 };
 
+// log-linear histogram (hdr style), relative error is within 1/64
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+    ~LatencyHistogram();
+
+    void record(int64_t value);
+    void merge(const LatencyHistogram &other);
+    void reset();
+
+    int64_t getCount() const;
+    int64_t getMin() const;
+    int64_t getMax() const;
+    double getMean() const;
+    // percentile is in [0, 100]
+    int64_t getPercentile(double percentile) const;
+
+private:
+    BRICKRED_NONCOPYABLE(LatencyHistogram)
+
+    class Impl;
+    brickred::UniquePtr<Impl> pimpl_;
+};
+
+// monotonic clock in nanoseconds
+int64_t nowNanoseconds();
+
 void hexdump(const char *buffer, size_t size);
 
 } // end of namespace test
@@ -0,0 +1,836 @@
+#include <sys/uio.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <brickred/dynamic_buffer.h>
+#include <brickred/io_service.h>
+#include <brickred/random.h>
+#include <brickred/socket_address.h>
+#include <brickred/tcp_service.h>
+#include <brickred/codec/utf8.h>
+#include <brickred/protocol/web_socket_deflate.h>
+#include <brickred/protocol/web_socket_mask.h>
+#include <brickred/protocol/web_socket_protocol.h>
+#include <brickred/protocol/web_socket_server.h>
+
+using namespace brickred;
+using namespace brickred::protocol;
+
+static const uint8_t s_mask_key[4] = { 0x37, 0xfa, 0x21, 0x3d };
+static const char s_handshake_request[] =
+    "GET / HTTP/1.1\r\n"
+    "Host: 127.0.0.1\r\n"
+    "Upgrade: websocket\r\n"
+    "Connection: Upgrade\r\n"
+    "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+    "Sec-WebSocket-Version: 13\r\n\r\n";
+
+// output of one side is the input of the other side
+class Pipe {
+public:
+    void write(const char *buffer, size_t size)
+    {
+        buffer_.reserveWritableBytes(size);
+        ::memcpy(buffer_.writeBegin(), buffer, size);
+        buffer_.write(size);
+    }
+
+    void writev(const struct iovec *buffers, int count)
+    {
+        for (int i = 0; i < count; ++i) {
+            write((const char *)buffers[i].iov_base, buffers[i].iov_len);
+        }
+    }
+
+    DynamicBuffer *getBuffer() { return &buffer_; }
+
+private:
+    DynamicBuffer buffer_;
+};
+
+static bool connect(WebSocketProtocol *client, Pipe *client_output,
+                    WebSocketProtocol *server, Pipe *server_output,
+                    Random *random)
+{
+    client->setOutputCallback(BRICKRED_BIND_MEM_FUNC(&Pipe::write,
+                                                     client_output));
+    server->setOutputCallback(BRICKRED_BIND_MEM_FUNC(&Pipe::write,
+                                                     server_output));
+
+    return client->startAsClient(SocketAddress("127.0.0.1", 80),
+                                 *random) &&
+        server->startAsServer() &&
+        server->recvMessage(client_output->getBuffer()) ==
+            WebSocketProtocol::RetCode::CONNECTION_ESTABLISHED &&
+        client->recvMessage(server_output->getBuffer()) ==
+            WebSocketProtocol::RetCode::CONNECTION_ESTABLISHED;
+}
+
+static bool recvEqual(WebSocketProtocol *protocol, Pipe *input,
+                      const std::string &expect)
+{
+    DynamicBuffer message;
+    return protocol->recvMessage(input->getBuffer()) ==
+            WebSocketProtocol::RetCode::MESSAGE_READY &&
+        protocol->retrieveMessage(&message) &&
+        message.readableBytes() == expect.size() &&
+        ::memcmp(message.readBegin(), expect.data(), expect.size()) == 0;
+}
+
+// every implementation matches the byte loop for all tails, key offsets
+// and alignments, in place or not
+static bool checkMask()
+{
+    std::vector<char> src(512 + 1);
+    std::vector<char> expect(src.size());
+    std::vector<char> dst(src.size());
+    for (size_t i = 0; i < src.size(); ++i) {
+        src[i] = (char)(i * 131 + 7);
+    }
+
+    for (int impl = (int)web_socket_mask::Impl::AUTO;
+         impl < (int)web_socket_mask::Impl::MAX; ++impl) {
+        for (size_t size = 0; size <= 512; ++size) {
+            for (size_t offset = 0; offset < 4; ++offset) {
+                for (size_t i = 0; i < size; ++i) {
+                    expect[i] = src[1 + i] ^ s_mask_key[(offset + i) & 3];
+                }
+                if (web_socket_mask::maskWith((web_socket_mask::Impl)impl,
+                        &dst[0], &src[1], size, s_mask_key,
+                        offset) == false) {
+                    break;
+                }
+                if (::memcmp(&dst[0], &expect[0], size) != 0) {
+                    return false;
+                }
+                // in place
+                web_socket_mask::maskWith((web_socket_mask::Impl)impl,
+                    &dst[0], &dst[0], size, s_mask_key, offset);
+                if (::memcmp(&dst[0], &src[1], size) != 0) {
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+static bool checkProtocol()
+{
+    Random random;
+    Pipe client_output;
+    Pipe server_output;
+    WebSocketProtocol client;
+    WebSocketProtocol server;
+    client.setMessageMaxSize(2 * 1024 * 1024);
+    server.setMessageMaxSize(2 * 1024 * 1024);
+
+    if (connect(&client, &client_output, &server, &server_output,
+                &random) == false) {
+        return false;
+    }
+
+    // every length encoding, both directions
+    size_t sizes[] = { 0, 1, 125, 126, 1000, 65535, 65536, 1024 * 1024 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        std::string message(sizes[i], '\0');
+        for (size_t j = 0; j < message.size(); ++j) {
+            message[j] = (char)random.nextInt(256);
+        }
+        client.sendMessage(message.data(), message.size());
+        if (recvEqual(&server, &client_output, message) == false) {
+            return false;
+        }
+        server.sendMessage(message.data(), message.size());
+        if (recvEqual(&client, &server_output, message) == false) {
+            return false;
+        }
+        // header and payload in two buffers
+        server.setOutputVCallback(BRICKRED_BIND_MEM_FUNC(&Pipe::writev,
+                                                         &server_output));
+        server.sendMessage(message.data(), message.size());
+        server.setOutputVCallback(WebSocketProtocol::OutputVCallback());
+        if (recvEqual(&client, &server_output, message) == false) {
+            return false;
+        }
+    }
+
+    // ping is answered by pong
+    client.sendPingFrame();
+    if (server.recvMessage(client_output.getBuffer()) !=
+            WebSocketProtocol::RetCode::PING_FRAME ||
+        client.recvMessage(server_output.getBuffer()) !=
+            WebSocketProtocol::RetCode::PONG_FRAME) {
+        return false;
+    }
+
+    return true;
+}
+
+static bool checkEncodeFrame()
+{
+    Random random;
+    Pipe client_output;
+    Pipe server_output;
+    WebSocketProtocol client;
+    WebSocketProtocol server;
+    if (connect(&client, &client_output, &server, &server_output,
+                &random) == false) {
+        return false;
+    }
+
+    size_t sizes[] = { 0, 125, 126, 65536 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        std::string message(sizes[i], 'y');
+        WebSocketProtocol::Frame frame =
+            WebSocketProtocol::encodeFrame(message.data(), message.size());
+        // copies share the bytes
+        WebSocketProtocol::Frame copy = frame;
+        if (copy.getData() != frame.getData() ||
+            server.sendEncodedFrame(copy) == false ||
+            recvEqual(&client, &server_output, message) == false) {
+            return false;
+        }
+        // a client can not send it
+        if (client.sendEncodedFrame(frame)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// both sides agree on permessage-deflate and messages round trip,
+// compressed or not
+static bool checkDeflate(bool no_context_takeover, int window_bits)
+{
+    Random random;
+    Pipe client_output;
+    Pipe server_output;
+    WebSocketProtocol client;
+    WebSocketProtocol server;
+    client.setDeflateEnabled(true);
+    client.setDeflateNoContextTakeover(no_context_takeover);
+    client.setDeflateMaxWindowBits(window_bits);
+    server.setDeflateEnabled(true);
+    server.setDeflateMaxWindowBits(window_bits);
+    if (connect(&client, &client_output, &server, &server_output,
+                &random) == false ||
+        client.isDeflateActive() == false ||
+        server.isDeflateActive() == false) {
+        return false;
+    }
+
+    for (int round = 0; round < 3; ++round) {
+        size_t sizes[] = { 0, 10, 64, 1000, 100000 };
+        for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+            // compressible, then random
+            std::string message(sizes[i], 'z');
+            for (size_t j = 0; j < message.size(); j += 7) {
+                message[j] = (char)('a' + j % 13);
+            }
+            std::string noise(sizes[i], '\0');
+            for (size_t j = 0; j < noise.size(); ++j) {
+                noise[j] = (char)random.nextInt(256);
+            }
+            client.sendMessage(message.data(), message.size());
+            client.sendMessage(noise.data(), noise.size());
+            if (recvEqual(&server, &client_output, message) == false ||
+                recvEqual(&server, &client_output, noise) == false) {
+                return false;
+            }
+            server.sendMessage(message.data(), message.size());
+            server.sendMessage(noise.data(), noise.size());
+            if (recvEqual(&client, &server_output, message) == false ||
+                recvEqual(&client, &server_output, noise) == false) {
+                return false;
+            }
+        }
+    }
+
+    // a message ended by an empty fragment, the following message is
+    // still inflated by the peer
+    {
+        std::string message(1000, 'f');
+        std::string next(500, 'n');
+        if (client.sendFragment(message.data(), message.size(),
+                                false) == false ||
+            client.sendFragment(message.data(), 0, true) == false ||
+            server.sendFragment(message.data(), message.size(),
+                                false) == false ||
+            server.sendFragment(message.data(), 0, true) == false) {
+            return false;
+        }
+        client.sendMessage(next.data(), next.size());
+        server.sendMessage(next.data(), next.size());
+        if (recvEqual(&server, &client_output, message) == false ||
+            recvEqual(&server, &client_output, next) == false ||
+            recvEqual(&client, &server_output, message) == false ||
+            recvEqual(&client, &server_output, next) == false) {
+            return false;
+        }
+    }
+
+    // a peer without the extension gets plain frames
+    Pipe plain_output;
+    Pipe deflate_output;
+    WebSocketProtocol plain;
+    WebSocketProtocol deflate;
+    deflate.setDeflateEnabled(true);
+    if (connect(&plain, &plain_output, &deflate, &deflate_output,
+                &random) == false ||
+        deflate.isDeflateActive()) {
+        return false;
+    }
+    std::string message(1000, 'p');
+    deflate.sendMessage(message.data(), message.size());
+    if (recvEqual(&plain, &deflate_output, message) == false) {
+        return false;
+    }
+
+    return true;
+}
+
+// moves at most size bytes of the input to buffer
+static void feed(Pipe *input, DynamicBuffer *buffer, size_t size)
+{
+    DynamicBuffer *from = input->getBuffer();
+    size = std::min(size, from->readableBytes());
+    buffer->reserveWritableBytes(size);
+    ::memcpy(buffer->writeBegin(), from->readBegin(), size);
+    buffer->write(size);
+    from->read(size);
+}
+
+// receives pieces of one message fed feed_size bytes at a time
+static bool recvStreamed(WebSocketProtocol *protocol, Pipe *input,
+                         size_t feed_size, std::string *message)
+{
+    DynamicBuffer buffer;
+    DynamicBuffer fragment;
+    message->clear();
+
+    while (input->getBuffer()->readableBytes() > 0 ||
+           buffer.readableBytes() > 0) {
+        feed(input, &buffer, feed_size);
+        for (;;) {
+            WebSocketProtocol::RetCode ret = protocol->recvMessage(&buffer);
+            if (WebSocketProtocol::RetCode::WAITING_MORE_DATA == ret) {
+                break;
+            } else if (WebSocketProtocol::RetCode::PING_FRAME == ret) {
+                continue;
+            } else if (ret != WebSocketProtocol::RetCode::FRAGMENT_READY) {
+                return false;
+            }
+            int opcode = 0;
+            bool fin = false;
+            if (protocol->retrieveFragment(&fragment, &opcode, &fin) ==
+                    false ||
+                opcode != 0x2) {
+                return false;
+            }
+            message->append(fragment.readBegin(), fragment.readableBytes());
+            if (fin) {
+                return input->getBuffer()->readableBytes() == 0 &&
+                    buffer.readableBytes() == 0;
+            }
+        }
+    }
+
+    return false;
+}
+
+// fragments sent by sendFragment() are reassembled by a normal peer and
+// returned in pieces no larger than the message max size in streaming
+// mode, with or without deflate
+static bool checkStreaming(bool deflate)
+{
+    Random random;
+    Pipe client_output;
+    Pipe server_output;
+    WebSocketProtocol client;
+    WebSocketProtocol server;
+    client.setDeflateEnabled(deflate);
+    server.setDeflateEnabled(deflate);
+    server.setStreamingEnabled(true);
+    server.setMessageMaxSize(4096);
+    if (connect(&client, &client_output, &server, &server_output,
+                &random) == false ||
+        client.isDeflateActive() != deflate) {
+        return false;
+    }
+
+    std::string message(300000, '\0');
+    for (size_t i = 0; i < message.size(); ++i) {
+        message[i] = (char)((i % 97 == 0) ? random.nextInt(256) : i % 11);
+    }
+    std::string received;
+
+    // one frame larger than the message max size
+    client.sendMessage(message.data(), message.size());
+    if (recvStreamed(&server, &client_output, 1000, &received) == false ||
+        received != message) {
+        return false;
+    }
+    // frames of 0 ~ 70000 bytes with a ping in the middle
+    size_t sizes[] = { 0, 1, 125, 126, 70000, 0, 29748, 200000 };
+    size_t offset = 0;
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        bool fin = i + 1 == sizeof(sizes) / sizeof(sizes[0]);
+        if (client.sendFragment(message.data() + offset, sizes[i],
+                                fin) == false) {
+            return false;
+        }
+        offset += sizes[i];
+        // a message can not be interleaved
+        if (!fin) {
+            client.sendMessage("x", 1);
+        }
+        if (i == 3) {
+            client.sendPingFrame();
+        }
+    }
+    if (recvStreamed(&server, &client_output, 7777, &received) == false ||
+        received != message) {
+        return false;
+    }
+    server_output.getBuffer()->clear();
+
+    // a normal peer reassembles the fragments
+    server.setStreamingEnabled(false);
+    server.setMessageMaxSize(1024 * 1024);
+    client.sendFragment(message.data(), 1000, false);
+    client.sendFragment(message.data() + 1000, message.size() - 1000, true);
+    if (recvEqual(&server, &client_output, message) == false) {
+        return false;
+    }
+    // and so does a client
+    server.sendFragment(message.data(), 100, false);
+    server.sendFragment(message.data() + 100, 0, false);
+    server.sendFragment(message.data() + 100, message.size() - 100, true);
+    if (recvEqual(&client, &server_output, message) == false) {
+        return false;
+    }
+
+    return true;
+}
+
+// every implementation agrees with the scalar one on sequences at any
+// offset of a block, and the validator agrees for any split
+static bool checkUtf8()
+{
+    static const char *valid[] = {
+        "a", "\xc2\x80", "\xdf\xbf", "\xe0\xa0\x80", "\xed\x9f\xbf",
+        "\xee\x80\x80", "\xef\xbf\xbf", "\xf0\x90\x80\x80",
+        "\xf4\x8f\xbf\xbf", "\xce\xba\xe1\xbd\xb9\xcf\x83\xce\xbc\xce\xb5"
+    };
+    static const char *invalid[] = {
+        "\x80", "\xbf", "\xc0\x80", "\xc1\xbf", "\xc2", "\xc2\x41",
+        "\xe0\x80\x80", "\xe0\x9f\xbf", "\xed\xa0\x80", "\xed\xbf\xbf",
+        "\xf0\x80\x80\x80", "\xf0\x8f\xbf\xbf", "\xf4\x90\x80\x80",
+        "\xf5\x80\x80\x80", "\xfe", "\xff", "\xe0\xa0", "\xf0\x90\x80",
+        "\xc2\x80\x80", "\xf8\x88\x80\x80\x80"
+    };
+    // ascii and multibyte neighbours
+    static const char *fills[] = { "x", "\xc3\xa9" };
+
+    std::vector<std::pair<std::string, bool>> cases;
+    for (size_t f = 0; f < sizeof(fills) / sizeof(fills[0]); ++f) {
+        for (size_t offset = 0; offset < 70; ++offset) {
+            for (size_t i = 0; i < sizeof(valid) / sizeof(valid[0]); ++i) {
+                std::string text;
+                while (text.size() < offset) {
+                    text += fills[f];
+                }
+                text += valid[i];
+                cases.push_back(std::make_pair(text, true));
+                cases.push_back(std::make_pair(text + fills[f] + text, true));
+            }
+            for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]);
+                 ++i) {
+                std::string text;
+                while (text.size() < offset) {
+                    text += fills[f];
+                }
+                text += invalid[i];
+                cases.push_back(std::make_pair(text, false));
+                cases.push_back(std::make_pair(text + std::string(70, 'y'),
+                                               false));
+            }
+        }
+    }
+    // random code points with one byte changed
+    Random random;
+    for (int i = 0; i < 2000; ++i) {
+        std::string text;
+        while (text.size() < (size_t)random.nextInt(200)) {
+            text += valid[random.nextInt(sizeof(valid) / sizeof(valid[0]))];
+        }
+        cases.push_back(std::make_pair(text, true));
+        if (text.empty() == false) {
+            text[random.nextInt(text.size())] = (char)random.nextInt(256);
+            bool expect = false;
+            codec::utf8::validateWith(codec::utf8::Impl::SCALAR,
+                                      text.data(), text.size(), &expect);
+            cases.push_back(std::make_pair(text, expect));
+        }
+    }
+
+    for (size_t i = 0; i < cases.size(); ++i) {
+        const std::string &text = cases[i].first;
+        for (int impl = (int)codec::utf8::Impl::AUTO;
+             impl < (int)codec::utf8::Impl::MAX; ++impl) {
+            bool valid = false;
+            if (codec::utf8::validateWith((codec::utf8::Impl)impl,
+                    text.data(), text.size(), &valid) &&
+                valid != cases[i].second) {
+                return false;
+            }
+        }
+        // split in two pieces at every byte
+        if (text.size() > 40) {
+            continue;
+        }
+        codec::utf8::Validator validator;
+        for (size_t cut = 0; cut <= text.size(); ++cut) {
+            bool valid = validator.update(text.data(), cut);
+            valid = validator.update(text.data() + cut,
+                                     text.size() - cut) && valid;
+            if ((validator.finish() && valid) != cases[i].second) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// text messages are sent as text and invalid utf-8 fails the receiver,
+// also when split in the middle of a character
+static bool checkTextFrame()
+{
+    std::string text = "\xe4\xbd\xa0\xe5\xa5\xbd, world \xf0\x9f\x98\x80";
+    std::string bad = text;
+    bad[1] = 'x';
+
+    for (int streaming = 0; streaming < 2; ++streaming) {
+        Random random;
+        Pipe client_output;
+        Pipe server_output;
+        WebSocketProtocol client;
+        WebSocketProtocol server;
+        server.setStreamingEnabled(streaming);
+        if (connect(&client, &client_output, &server, &server_output,
+                    &random) == false) {
+            return false;
+        }
+
+        DynamicBuffer message;
+        int opcode = 0;
+        bool fin = false;
+        client.sendTextMessage(text.data(), text.size());
+        client.sendTextFragment(text.data(), 1, false);
+        client.sendTextFragment(text.data() + 1, 3, false);
+        // the opcode of a message can not change
+        if (client.sendFragment(text.data(), 1, false)) {
+            return false;
+        }
+        client.sendTextFragment(text.data() + 4, text.size() - 4, true);
+        for (int i = 0; i < 2; ++i) {
+            std::string received;
+            do {
+                if (server.recvMessage(client_output.getBuffer()) ==
+                        WebSocketProtocol::RetCode::MESSAGE_READY) {
+                    if (server.retrieveMessage(&message, &opcode) == false) {
+                        return false;
+                    }
+                    fin = true;
+                } else if (server.retrieveFragment(&message, &opcode,
+                                                   &fin) == false) {
+                    return false;
+                }
+                received.append(message.readBegin(), message.readableBytes());
+            } while (!fin);
+            if (opcode != 0x1 || received != text) {
+                return false;
+            }
+        }
+        client.sendMessage(bad.data(), bad.size());
+        if (server.recvMessage(client_output.getBuffer()) ==
+                WebSocketProtocol::RetCode::ERROR) {
+            return false;
+        }
+        server.retrieveMessage(&message);
+        server.retrieveFragment(&message, &opcode, &fin);
+        client.sendTextMessage(bad.data(), bad.size());
+        if (server.recvMessage(client_output.getBuffer()) !=
+                WebSocketProtocol::RetCode::ERROR) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// checks timeouts and close handshake of the server with clients
+// behaving differently
+class ServerCheck {
+public:
+    enum class Behavior {
+        SILENT,
+        NO_PONG,
+        PONG,
+        MESSAGE,
+        CLOSE,
+        MAX
+    };
+
+    struct Result {
+        bool opened;
+        bool closed;
+        int error;
+        int message_opcode;
+        std::string message;
+    };
+
+    ServerCheck() : client_(io_service_), server_(io_service_)
+    {
+        client_.setRecvMessageCallback(BRICKRED_BIND_MEM_FUNC(
+            &ServerCheck::onClientRecv, this));
+        server_.setHandshakeTimeout(100);
+        server_.setPingInterval(100);
+        server_.setPingTimeout(100);
+        server_.setCloseTimeout(100);
+        server_.setOpenCallback(BRICKRED_BIND_MEM_FUNC(
+            &ServerCheck::onOpen, this));
+        server_.setMessageCallback(BRICKRED_BIND_MEM_FUNC(
+            &ServerCheck::onMessage, this));
+        server_.setErrorCallback(BRICKRED_BIND_MEM_FUNC(
+            &ServerCheck::onError, this));
+        server_.setCloseCallback(BRICKRED_BIND_MEM_FUNC(
+            &ServerCheck::onClose, this));
+    }
+
+    bool run()
+    {
+        TcpService::SocketId listen_id =
+            server_.listen(SocketAddress("127.0.0.1", 0));
+        SocketAddress addr;
+        if (-1 == listen_id || server_.getTcpService()->getLocalAddress(
+                listen_id, &addr) == false) {
+            return false;
+        }
+
+        for (int i = 0; i < (int)Behavior::MAX; ++i) {
+            TcpService::SocketId socket_id = client_.connect(addr);
+            SocketAddress local_addr;
+            if (-1 == socket_id ||
+                client_.getLocalAddress(socket_id, &local_addr) == false) {
+                return false;
+            }
+            behaviors_[socket_id] = (Behavior)i;
+            ports_[local_addr.getPort()] = (Behavior)i;
+            results_[i].opened = false;
+            results_[i].closed = false;
+            results_[i].error = -1;
+            results_[i].message_opcode = -1;
+            if (Behavior::SILENT != (Behavior)i) {
+                client_.sendMessage(socket_id, s_handshake_request,
+                                    sizeof(s_handshake_request) - 1);
+            }
+        }
+
+        io_service_.startTimer(600, BRICKRED_BIND_MEM_FUNC(
+            &ServerCheck::onTimeout, this), 1);
+        io_service_.loop();
+
+        const Result &silent = results_[(int)Behavior::SILENT];
+        const Result &no_pong = results_[(int)Behavior::NO_PONG];
+        const Result &pong = results_[(int)Behavior::PONG];
+        const Result &message = results_[(int)Behavior::MESSAGE];
+        const Result &close = results_[(int)Behavior::CLOSE];
+
+        return silent.opened == false && silent.closed == false &&
+               (int)WebSocketServer::Error::HANDSHAKE_TIMEOUT ==
+                   silent.error &&
+               no_pong.opened && no_pong.closed &&
+               (int)WebSocketServer::Error::PING_TIMEOUT == no_pong.error &&
+               pong.opened && pong.closed == false && -1 == pong.error &&
+               message.opened && message.closed &&
+               (int)WebSocketServer::Error::CLOSE_TIMEOUT == message.error &&
+               0x1 == message.message_opcode && "hi" == message.message &&
+               close.opened && close.closed && -1 == close.error &&
+               server_.getConnectionCount() == 1;
+    }
+
+private:
+    Result *getResult(TcpService::SocketId socket_id)
+    {
+        SocketAddress addr;
+        if (server_.getTcpService()->getPeerAddress(
+                socket_id, &addr) == false ||
+            ports_.find(addr.getPort()) == ports_.end()) {
+            return nullptr;
+        }
+
+        return &results_[(int)ports_[addr.getPort()]];
+    }
+
+    void onClientRecv(TcpService *service, TcpService::SocketId socket_id,
+                      DynamicBuffer *buffer)
+    {
+        // masked frames with a zero mask key
+        static const char pong_frame[] = { '\x8a', '\x80', 0, 0, 0, 0 };
+        static const char text_frame[] = {
+            '\x81', '\x82', 0, 0, 0, 0, 'h', 'i' };
+        static const char close_frame[] = { '\x88', '\x80', 0, 0, 0, 0 };
+
+        Behavior behavior = behaviors_[socket_id];
+        std::string data(buffer->readBegin(), buffer->readableBytes());
+        buffer->read(buffer->readableBytes());
+
+        // the handshake response comes first
+        if (data.compare(0, 12, "HTTP/1.1 101") == 0) {
+            if (Behavior::MESSAGE == behavior) {
+                service->sendMessage(socket_id,
+                                     text_frame, sizeof(text_frame));
+            } else if (Behavior::CLOSE == behavior) {
+                service->sendMessage(socket_id,
+                                     close_frame, sizeof(close_frame));
+            }
+            return;
+        }
+        if (Behavior::PONG == behavior &&
+            data.find('\x89') != std::string::npos) {
+            service->sendMessage(socket_id, pong_frame, sizeof(pong_frame));
+        }
+    }
+
+    void onOpen(WebSocketServer *server, TcpService::SocketId socket_id)
+    {
+        Result *result = getResult(socket_id);
+        if (result != nullptr) {
+            result->opened = true;
+        }
+    }
+
+    void onMessage(WebSocketServer *server, TcpService::SocketId socket_id,
+                   int opcode, DynamicBuffer *message)
+    {
+        Result *result = getResult(socket_id);
+        if (result != nullptr) {
+            result->message_opcode = opcode;
+            result->message.assign(message->readBegin(),
+                                   message->readableBytes());
+        }
+        server->close(socket_id);
+    }
+
+    void onError(WebSocketServer *server, TcpService::SocketId socket_id,
+                 WebSocketServer::Error error)
+    {
+        Result *result = getResult(socket_id);
+        if (result != nullptr) {
+            result->error = (int)error;
+        }
+    }
+
+    void onClose(WebSocketServer *server, TcpService::SocketId socket_id)
+    {
+        Result *result = getResult(socket_id);
+        if (result != nullptr) {
+            result->closed = true;
+        }
+    }
+
+    void onTimeout(IOService::TimerId timer_id)
+    {
+        io_service_.quit();
+    }
+
+private:
+    IOService io_service_;
+    TcpService client_;
+    WebSocketServer server_;
+    std::map<TcpService::SocketId, Behavior> behaviors_;
+    std::map<uint16_t, Behavior> ports_;
+    Result results_[(int)Behavior::MAX];
+};
+
+int main(void)
+{
+    ::printf("***mask***\n");
+    if (checkMask() == false) {
+        ::printf("mask test failed\n");
+        return -1;
+    }
+    ::printf("ok\n");
+
+    ::printf("***protocol***\n");
+    if (checkProtocol() == false) {
+        ::printf("protocol test failed\n");
+        return -1;
+    }
+    ::printf("ok\n");
+
+    ::printf("***encode frame***\n");
+    if (checkEncodeFrame() == false) {
+        ::printf("encode frame test failed\n");
+        return -1;
+    }
+    ::printf("ok\n");
+
+    ::printf("***utf8***\n");
+    if (checkUtf8() == false) {
+        ::printf("utf8 test failed\n");
+        return -1;
+    }
+    ::printf("ok\n");
+
+    ::printf("***text frame***\n");
+    if (checkTextFrame() == false) {
+        ::printf("text frame test failed\n");
+        return -1;
+    }
+    ::printf("ok\n");
+
+    ::printf("***streaming***\n");
+    if (checkStreaming(false) == false ||
+        (WebSocketDeflate::isSupported() && checkStreaming(true) == false)) {
+        ::printf("streaming test failed\n");
+        return -1;
+    }
+    ::printf("ok\n");
+
+    ::printf("***server timeout and close***\n");
+    {
+        ServerCheck check;
+        if (check.run() == false) {
+            ::printf("server timeout and close test failed\n");
+            return -1;
+        }
+    }
+    ::printf("ok\n");
+
+    if (WebSocketDeflate::isSupported() == false) {
+        ::printf("***deflate***\nnot built with zlib, skipped\n");
+        return 0;
+    }
+    ::printf("***deflate***\n");
+    if (checkDeflate(false, 15) == false ||
+        checkDeflate(true, 15) == false ||
+        checkDeflate(false, 9) == false) {
+        ::printf("deflate test failed\n");
+        return -1;
+    }
+    ::printf("ok\n");
+
+    return 0;
+}
@@ -0,0 +1,468 @@
+#include <sys/resource.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <brickred/io_service.h>
+#include <brickred/socket_address.h>
+#include <brickred/tcp_service.h>
+#include <brickred/tcp_socket.h>
+#include <brickred/timestamp.h>
+#include <brickred/unique_ptr.h>
+#include <brickred/protocol/web_socket_protocol.h>
+
+using namespace brickred;
+using namespace brickred::protocol;
+
+static char patternByte(size_t offset)
+{
+    return (char)(offset * 131 + offset / 251);
+}
+
+// the server sends buffers by MSG_ZEROCOPY to a raw client socket,
+// a released buffer is overwritten at once, so the client receives
+// broken data if a buffer is released while kernel still reads it
+class ZeroCopyTest {
+public:
+    enum class Mode {
+        READ_ALL,
+        CLOSE_IN_FLIGHT,
+        DESTROY_IN_FLIGHT,
+        LINGER_TIMEOUT,
+    };
+
+    ZeroCopyTest(Mode mode, size_t buffer_size, int buffer_count) :
+        mode_(mode), service_(new TcpService(io_service_)),
+        buffer_size_(buffer_size), buffers_(buffer_count),
+        socket_id_(-1), client_reading_(Mode::READ_ALL == mode),
+        client_closed_(false), received_(0), broken_(false),
+        released_count_(0), released_at_close_(0),
+        out_of_order_(false), timeout_(false), close_cpu_time_(0)
+    {
+        for (size_t i = 0; i < buffers_.size(); ++i) {
+            buffers_[i].resize(buffer_size_);
+            for (size_t j = 0; j < buffer_size_; ++j) {
+                buffers_[i][j] = patternByte(i * buffer_size_ + j);
+            }
+        }
+        service_->setZeroCopyThreshold(1);
+        service_->setNewConnectionCallback(BRICKRED_BIND_MEM_FUNC(
+            &ZeroCopyTest::onNewConnection, this));
+    }
+
+    bool run()
+    {
+        TcpService::SocketId listen_id =
+            service_->listen(SocketAddress("127.0.0.1", 0));
+        SocketAddress addr;
+        if (listen_id < 0 ||
+            service_->getLocalAddress(listen_id, &addr) == false ||
+            client_.activeOpenNonblock(addr) == false) {
+            ::printf("connect failed: %s\n", ::strerror(errno));
+            return false;
+        }
+        io_service_.startTimer(1, BRICKRED_BIND_MEM_FUNC(
+            &ZeroCopyTest::onClientTimer, this));
+        io_service_.startTimer(10000, BRICKRED_BIND_MEM_FUNC(
+            &ZeroCopyTest::onTimeout, this), 1);
+        io_service_.loop();
+
+        if (timeout_) {
+            ::printf("timeout, %zu bytes received, %d buffers released\n",
+                     received_, released_count_);
+            return false;
+        }
+        if (broken_) {
+            ::printf("data broken at %zu\n", received_);
+            return false;
+        }
+        if (out_of_order_) {
+            ::printf("buffers released out of order\n");
+            return false;
+        }
+
+        if (Mode::READ_ALL == mode_) {
+            return true;
+        }
+        if (released_at_close_ != 0) {
+            ::printf("buffer in flight released on close\n");
+            return false;
+        }
+        if (Mode::LINGER_TIMEOUT == mode_) {
+            return checkLingerTimeout();
+        }
+        if (Mode::DESTROY_IN_FLIGHT == mode_) {
+            service_.reset();
+            if (released_count_ != (int)buffers_.size()) {
+                ::printf("buffer in flight not released on destroy\n");
+                return false;
+            }
+        } else if (0 == received_) {
+            ::printf("data queued before close not sent\n");
+            return false;
+        }
+
+        return true;
+    }
+
+private:
+    static int64_t cpuTimeMillisecond()
+    {
+        struct rusage usage;
+        ::getrusage(RUSAGE_SELF, &usage);
+        return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000 +
+               (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000;
+    }
+
+    bool checkLingerTimeout()
+    {
+        Timestamp now;
+        now.setNow();
+        int64_t wall_time = now.distanceMillisecond(close_time_);
+        int64_t cpu_time = cpuTimeMillisecond() - close_cpu_time_;
+        if (wall_time < LINGER_TIME_MSEC) {
+            ::printf("buffer in flight released before linger deadline\n");
+            return false;
+        }
+        // hang up of the peer must not make the reactor spin
+        if (cpu_time * 2 > wall_time) {
+            ::printf("reactor spins while lingering, cpu %ldms of %ldms\n",
+                     cpu_time, wall_time);
+            return false;
+        }
+
+        return true;
+    }
+
+    void onNewConnection(TcpService *service,
+                         TcpService::SocketId from_socket_id,
+                         TcpService::SocketId socket_id)
+    {
+        socket_id_ = socket_id;
+        if (Mode::LINGER_TIMEOUT == mode_) {
+            // the peer closes and never reads, so the socket is hung up
+            // and the completions never arrive
+            client_.shutdownWrite();
+            service->setZeroCopyLingerTime(LINGER_TIME_MSEC);
+        }
+        for (size_t i = 0; i < buffers_.size(); ++i) {
+            service->sendMessageZeroCopy(socket_id, &buffers_[i][0],
+                buffer_size_, BRICKRED_BIND_MEM_FUNC(
+                    &ZeroCopyTest::onBufferRelease, this));
+        }
+
+        if (Mode::CLOSE_IN_FLIGHT == mode_) {
+            // the client is not reading, the buffer is still in flight
+            service->closeSocket(socket_id);
+            released_at_close_ = released_count_;
+            client_reading_ = true;
+        } else if (Mode::DESTROY_IN_FLIGHT == mode_) {
+            released_at_close_ = released_count_;
+            io_service_.quit();
+        } else if (Mode::LINGER_TIMEOUT == mode_) {
+            close_time_.setNow();
+            close_cpu_time_ = cpuTimeMillisecond();
+            service->closeSocket(socket_id);
+            released_at_close_ = released_count_;
+        }
+    }
+
+    void onBufferRelease(TcpService *service,
+                         TcpService::SocketId socket_id, const char *buffer)
+    {
+        if (released_count_ >= (int)buffers_.size()) {
+            out_of_order_ = true;
+            return;
+        }
+        if (socket_id != socket_id_ ||
+            buffer != &buffers_[released_count_][0]) {
+            out_of_order_ = true;
+        }
+        ::memset(&buffers_[released_count_][0], 0, buffer_size_);
+        ++released_count_;
+    }
+
+    void onClientTimer(IOService::TimerId timer_id)
+    {
+        while (client_reading_ && !client_closed_) {
+            char buffer[64 * 1024];
+            int size = client_.recv(buffer, sizeof(buffer));
+            if (size < 0 && EAGAIN == errno) {
+                break;
+            }
+            if (size <= 0) {
+                client_closed_ = true;
+                break;
+            }
+            for (int i = 0; i < size && !broken_; ++i) {
+                if (buffer[i] != patternByte(received_ + i)) {
+                    received_ += i;
+                    broken_ = true;
+                }
+            }
+            if (broken_) {
+                io_service_.quit();
+                return;
+            }
+            received_ += size;
+        }
+
+        bool all_released = released_count_ == (int)buffers_.size();
+        if ((Mode::READ_ALL == mode_ &&
+             received_ == buffer_size_ * buffers_.size() && all_released) ||
+            (Mode::CLOSE_IN_FLIGHT == mode_ &&
+             client_closed_ && all_released) ||
+            (Mode::LINGER_TIMEOUT == mode_ && all_released)) {
+            io_service_.quit();
+        }
+    }
+
+    void onTimeout(IOService::TimerId timer_id)
+    {
+        timeout_ = true;
+        io_service_.quit();
+    }
+
+private:
+    static const int LINGER_TIME_MSEC = 500;
+
+    Mode mode_;
+    IOService io_service_;
+    UniquePtr<TcpService> service_;
+    TcpSocket client_;
+    size_t buffer_size_;
+    std::vector<std::vector<char> > buffers_;
+    TcpService::SocketId socket_id_;
+    bool client_reading_;
+    bool client_closed_;
+    size_t received_;
+    bool broken_;
+    int released_count_;
+    int released_at_close_;
+    bool out_of_order_;
+    bool timeout_;
+    Timestamp close_time_;
+    int64_t close_cpu_time_;
+};
+
+// a shared frame is broadcast to two clients, the first one reads all,
+// then the second one is closed while the frame is in flight and the frame
+// is dropped by the caller, memory of the frame is reused and overwritten
+// at once if the frame is freed before kernel is done with it
+class BroadcastTest {
+public:
+    BroadcastTest(size_t payload_size, int frame_count) :
+        service_(io_service_), frame_count_(frame_count), accepted_(0),
+        reading_(false), closed_(false), broken_(false), timeout_(false)
+    {
+        std::string payload(payload_size, '\0');
+        for (size_t i = 0; i < payload_size; ++i) {
+            payload[i] = patternByte(i);
+        }
+        frame_ = WebSocketProtocol::encodeFrame(payload.data(),
+                                                payload.size());
+        frame_data_.assign(frame_.getData(), frame_.getSize());
+        received_[0] = received_[1] = 0;
+
+        service_.setZeroCopyThreshold(1);
+        service_.setNewConnectionCallback(BRICKRED_BIND_MEM_FUNC(
+            &BroadcastTest::onNewConnection, this));
+    }
+
+    ~BroadcastTest()
+    {
+        for (size_t i = 0; i < scribbles_.size(); ++i) {
+            delete[] scribbles_[i];
+        }
+    }
+
+    bool run()
+    {
+        TcpService::SocketId listen_id =
+            service_.listen(SocketAddress("127.0.0.1", 0));
+        SocketAddress addr;
+        if (listen_id < 0 ||
+            service_.getLocalAddress(listen_id, &addr) == false ||
+            clients_[0].activeOpenNonblock(addr) == false ||
+            clients_[1].activeOpenNonblock(addr) == false) {
+            ::printf("connect failed: %s\n", ::strerror(errno));
+            return false;
+        }
+        io_service_.startTimer(1, BRICKRED_BIND_MEM_FUNC(
+            &BroadcastTest::onClientTimer, this));
+        io_service_.startTimer(10000, BRICKRED_BIND_MEM_FUNC(
+            &BroadcastTest::onTimeout, this), 1);
+        io_service_.loop();
+
+        size_t total = frame_data_.size() * frame_count_;
+        if (timeout_ || broken_ || received_[0] != total ||
+            0 == received_[1] || received_[1] > total) {
+            ::printf("%s, %zu and %zu of %zu bytes received\n",
+                     timeout_ ? "timeout" : broken_ ? "data broken" :
+                     "data lost", received_[0], received_[1], total);
+            return false;
+        }
+
+        return true;
+    }
+
+private:
+    void onNewConnection(TcpService *service,
+                         TcpService::SocketId from_socket_id,
+                         TcpService::SocketId socket_id)
+    {
+        socket_ids_[accepted_++] = socket_id;
+        if (accepted_ < 2) {
+            return;
+        }
+        for (int i = 0; i < frame_count_; ++i) {
+            WebSocketProtocol::broadcastFrame(service, socket_ids_, 2,
+                                              frame_);
+        }
+        reading_ = true;
+    }
+
+    void onCloseTimer(IOService::TimerId timer_id)
+    {
+        service_.closeSocket(socket_ids_[1]);
+
+        // reuse the memory if the frame is freed
+        size_t block_size = frame_data_.size() + 64;
+        frame_ = WebSocketProtocol::Frame();
+        for (int i = 0; i < 4; ++i) {
+            char *scribble = new char[block_size];
+            ::memset(scribble, 0, block_size);
+            scribbles_.push_back(scribble);
+        }
+        closed_ = true;
+    }
+
+    // return false on eof or error
+    bool readClient(int index)
+    {
+        for (;;) {
+            char buffer[64 * 1024];
+            int size = clients_[index].recv(buffer, sizeof(buffer));
+            if (size < 0 && EAGAIN == errno) {
+                return true;
+            }
+            if (size <= 0) {
+                return false;
+            }
+            for (int i = 0; i < size; ++i) {
+                if (buffer[i] != frame_data_[
+                        (received_[index] + i) % frame_data_.size()]) {
+                    broken_ = true;
+                    return false;
+                }
+            }
+            received_[index] += size;
+        }
+    }
+
+    void onClientTimer(IOService::TimerId timer_id)
+    {
+        if (!reading_) {
+            return;
+        }
+
+        // the second client starts reading after it is closed
+        if (!closed_) {
+            readClient(0);
+            if (received_[0] == frame_data_.size() * frame_count_) {
+                reading_ = false;
+                io_service_.startTimer(50, BRICKRED_BIND_MEM_FUNC(
+                    &BroadcastTest::onCloseTimer, this), 1);
+                io_service_.startTimer(60, BRICKRED_BIND_MEM_FUNC(
+                    &BroadcastTest::onResumeTimer, this), 1);
+            }
+        } else if (readClient(1) == false) {
+            io_service_.quit();
+        }
+    }
+
+    void onResumeTimer(IOService::TimerId timer_id)
+    {
+        reading_ = true;
+    }
+
+    void onTimeout(IOService::TimerId timer_id)
+    {
+        timeout_ = true;
+        io_service_.quit();
+    }
+
+private:
+    IOService io_service_;
+    TcpService service_;
+    TcpSocket clients_[2];
+    TcpService::SocketId socket_ids_[2];
+    WebSocketProtocol::Frame frame_;
+    std::string frame_data_;
+    std::vector<char *> scribbles_;
+    int frame_count_;
+    int accepted_;
+    bool reading_;
+    bool closed_;
+    bool broken_;
+    bool timeout_;
+    size_t received_[2];
+};
+
+int main(void)
+{
+    ::printf("***send and release in order***\n");
+    {
+        ZeroCopyTest test(ZeroCopyTest::Mode::READ_ALL, 1024 * 1024, 8);
+        if (test.run() == false) {
+            return -1;
+        }
+    }
+    ::printf("ok\n");
+
+    // the buffer is larger than the socket buffers of both sides
+    ::printf("***close while in flight***\n");
+    {
+        ZeroCopyTest test(ZeroCopyTest::Mode::CLOSE_IN_FLIGHT,
+                          32 * 1024 * 1024, 1);
+        if (test.run() == false) {
+            return -1;
+        }
+    }
+    ::printf("ok\n");
+
+    ::printf("***destroy while in flight***\n");
+    {
+        ZeroCopyTest test(ZeroCopyTest::Mode::DESTROY_IN_FLIGHT,
+                          32 * 1024 * 1024, 1);
+        if (test.run() == false) {
+            return -1;
+        }
+    }
+    ::printf("ok\n");
+
+    ::printf("***linger timeout after peer hang up***\n");
+    {
+        ZeroCopyTest test(ZeroCopyTest::Mode::LINGER_TIMEOUT,
+                          32 * 1024 * 1024, 1);
+        if (test.run() == false) {
+            return -1;
+        }
+    }
+    ::printf("ok\n");
+
+    // the frame is smaller than the mmap threshold of malloc
+    ::printf("***broadcast close while in flight***\n");
+    {
+        BroadcastTest test(64 * 1024, 128);
+        if (test.run() == false) {
+            return -1;
+        }
+    }
+    ::printf("ok\n");
+
+    return 0;
+}
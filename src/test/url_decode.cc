@@ -1,32 +1,135 @@
-#include <iostream>
-#include <fstream>
-#include <sstream>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
 
+#include <brickred/command_line_option.h>
+#include <brickred/dynamic_buffer.h>
+#include <brickred/timestamp.h>
 #include <brickred/codec/url.h>
 
 using namespace brickred;
 
+static void printUsage(const char *progname)
+{
+    ::fprintf(stderr, "usage: %s [-t] [-p] [-i implementation] [file]\n"
+              "  -t  print throughput to stderr\n"
+              "  -p  decode in place in a DynamicBuffer\n"
+              "  -i  scalar, ssse3 or avx2, can not be used with -p\n",
+              progname);
+}
+
+static int64_t elapsedNanoseconds(const Timestamp &start,
+                                  const Timestamp &end)
+{
+    return (end.getSecond() - start.getSecond()) * 1000000000LL +
+           end.getNanoSecond() - start.getNanoSecond();
+}
+
+static bool readFile(FILE *fp, DynamicBuffer *content)
+{
+    for (;;) {
+        content->reserveWritableBytes(64 * 1024);
+        size_t count = ::fread(content->writeBegin(), 1,
+                               content->writableBytes(), fp);
+        content->write(count);
+        if (0 == count) {
+            break;
+        }
+    }
+
+    return ::ferror(fp) == 0;
+}
+
 int main(int argc, char *argv[])
 {
-    std::stringstream ss;
+    CommandLineOption options;
+    options.addOption("t");
+    options.addOption("p");
+    options.addOption("i", CommandLineOption::ParameterType::REQUIRED);
 
-    if (1 == argc) {
-        ss << std::cin.rdbuf();
+    if (options.parse(argc, argv) == false ||
+        options.getLeftArguments().size() > 1 ||
+        (options.hasOption("p") && options.hasOption("i"))) {
+        printUsage(argv[0]);
+        return -1;
+    }
 
-    } else if (2 == argc) {
-        std::ifstream fs(argv[1]);
-        if (fs.is_open() == false) {
-            ::fprintf(stderr, "can not open file %s\n", argv[1]);
+    codec::UrlImpl impl = codec::urlGetImpl();
+    if (options.hasOption("i")) {
+        const std::string &name = options.getParameter("i");
+        impl = codec::UrlImpl::MAX;
+        for (int i = (int)codec::UrlImpl::SCALAR;
+             i < (int)codec::UrlImpl::MAX; ++i) {
+            if (name == codec::urlGetImplName((codec::UrlImpl)i)) {
+                impl = (codec::UrlImpl)i;
+                break;
+            }
+        }
+    }
+
+    FILE *fp = NULL;
+
+    if (options.getLeftArguments().empty()) {
+        fp = stdin;
+    } else {
+        const char *file = options.getLeftArguments()[0].c_str();
+        fp = ::fopen(file, "rb");
+        if (NULL == fp) {
+            ::fprintf(stderr, "can not open file %s\n", file);
             return -1;
         }
-        ss << fs.rdbuf();
+    }
+
+    DynamicBuffer input;
+    bool ret = readFile(fp, &input);
+    ::fclose(fp);
+    if (!ret) {
+        ::fprintf(stderr, "can not read input\n");
+        return -1;
+    }
+
+    size_t input_size = input.readableBytes();
+    std::vector<char> output;
+    const char *result = nullptr;
+    int count = 0;
+    Timestamp start;
+    Timestamp end;
 
+    if (options.hasOption("p")) {
+        start.setNow();
+        ret = codec::urlDecode(&input);
+        end.setNow();
+        result = input.readBegin();
+        count = ret ? (int)input.readableBytes() : -1;
     } else {
-        ::fprintf(stderr, "usage: %s <file>\n", argv[0]);
+        output.resize(input_size + 1);
+        start.setNow();
+        ret = codec::urlDecodeWith(impl, input.readBegin(), input_size,
+                                   &output[0], output.size(), &count);
+        end.setNow();
+        if (!ret) {
+            ::fprintf(stderr, "implementation %s is not supported\n",
+                      options.getParameter("i").c_str());
+            return -1;
+        }
+        result = &output[0];
+    }
+    int64_t decode_ns = elapsedNanoseconds(start, end);
+
+    if (count < 0) {
+        ::fprintf(stderr, "url decode failed\n");
         return -1;
     }
+    ::fwrite(result, 1, count, stdout);
 
-    std::cout << codec::urlDecode(ss.str());
+    if (options.hasOption("t")) {
+        ::fprintf(stderr, "%s%s: %zu bytes in %.3f ms, %.2f MB/s\n",
+                  codec::urlGetImplName(impl),
+                  options.hasOption("p") ? " in place" : "", input_size,
+                  decode_ns / 1e6, decode_ns > 0 ?
+                      input_size * 1000.0 / decode_ns : 0.0);
+    }
 
     return 0;
 }
@@ -1,32 +1,118 @@
-#include <iostream>
-#include <fstream>
-#include <sstream>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
 
+#include <brickred/command_line_option.h>
+#include <brickred/timestamp.h>
 #include <brickred/codec/url.h>
 
 using namespace brickred;
 
+static void printUsage(const char *progname)
+{
+    ::fprintf(stderr, "usage: %s [-t] [-i implementation] [file]\n"
+              "  -t  print throughput to stderr\n"
+              "  -i  scalar, ssse3 or avx2\n", progname);
+}
+
+static int64_t elapsedNanoseconds(const Timestamp &start,
+                                  const Timestamp &end)
+{
+    return (end.getSecond() - start.getSecond()) * 1000000000LL +
+           end.getNanoSecond() - start.getNanoSecond();
+}
+
+static bool readFile(FILE *fp, std::string *content)
+{
+    char buffer[64 * 1024];
+
+    for (;;) {
+        size_t count = ::fread(buffer, 1, sizeof(buffer), fp);
+        if (count > 0) {
+            content->append(buffer, count);
+        }
+        if (count < sizeof(buffer)) {
+            break;
+        }
+    }
+
+    return ::ferror(fp) == 0;
+}
+
 int main(int argc, char *argv[])
 {
-    std::stringstream ss;
+    CommandLineOption options;
+    options.addOption("t");
+    options.addOption("i", CommandLineOption::ParameterType::REQUIRED);
 
-    if (1 == argc) {
-        ss << std::cin.rdbuf();
+    if (options.parse(argc, argv) == false ||
+        options.getLeftArguments().size() > 1) {
+        printUsage(argv[0]);
+        return -1;
+    }
 
-    } else if (2 == argc) {
-        std::ifstream fs(argv[1]);
-        if (fs.is_open() == false) {
-            ::fprintf(stderr, "can not open file %s\n", argv[1]);
-            return -1;
+    codec::UrlImpl impl = codec::urlGetImpl();
+    if (options.hasOption("i")) {
+        const std::string &name = options.getParameter("i");
+        impl = codec::UrlImpl::MAX;
+        for (int i = (int)codec::UrlImpl::SCALAR;
+             i < (int)codec::UrlImpl::MAX; ++i) {
+            if (name == codec::urlGetImplName((codec::UrlImpl)i)) {
+                impl = (codec::UrlImpl)i;
+                break;
+            }
         }
-        ss << fs.rdbuf();
+    }
 
+    FILE *fp = NULL;
+
+    if (options.getLeftArguments().empty()) {
+        fp = stdin;
     } else {
-        ::fprintf(stderr, "usage: %s <file>\n", argv[0]);
+        const char *file = options.getLeftArguments()[0].c_str();
+        fp = ::fopen(file, "rb");
+        if (NULL == fp) {
+            ::fprintf(stderr, "can not open file %s\n", file);
+            return -1;
+        }
+    }
+
+    std::string input;
+    bool ret = readFile(fp, &input);
+    ::fclose(fp);
+    if (!ret) {
+        ::fprintf(stderr, "can not read input\n");
         return -1;
     }
 
-    std::cout << codec::urlEncode(ss.str());
+    std::vector<char> output(input.size() * 3 + 1);
+    int count = 0;
+
+    Timestamp start;
+    start.setNow();
+    if (codec::urlEncodeWith(impl, input.data(), input.size(),
+                             &output[0], output.size(), &count) == false) {
+        ::fprintf(stderr, "implementation %s is not supported\n",
+                  options.getParameter("i").c_str());
+        return -1;
+    }
+    Timestamp end;
+    end.setNow();
+    int64_t encode_ns = elapsedNanoseconds(start, end);
+
+    if (count < 0) {
+        ::fprintf(stderr, "url encode failed\n");
+        return -1;
+    }
+    ::fwrite(&output[0], 1, count, stdout);
+
+    if (options.hasOption("t")) {
+        ::fprintf(stderr, "%s: %zu bytes in %.3f ms, %.2f MB/s\n",
+                  codec::urlGetImplName(impl), input.size(),
+                  encode_ns / 1e6, encode_ns > 0 ?
+                      input.size() * 1000.0 / encode_ns : 0.0);
+    }
 
     return 0;
 }
@@ -0,0 +1,124 @@
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <brickred/dynamic_buffer.h>
+#include <brickred/io_service.h>
+#include <brickred/socket_address.h>
+#include <brickred/tcp_service.h>
+
+using namespace brickred;
+
+// keep sending a shared blob to every connection,
+// the blob is sent by MSG_ZEROCOPY when it reaches the threshold
+class ZeroCopyServer {
+public:
+    ZeroCopyServer(size_t blob_size, size_t zero_copy_threshold) :
+        tcp_service_(io_service_),
+        blob_(blob_size, 'x'), blob_ref_count_(0)
+    {
+        tcp_service_.setNewConnectionCallback(BRICKRED_BIND_MEM_FUNC(
+            &ZeroCopyServer::onNewConnection, this));
+        tcp_service_.setRecvMessageCallback(BRICKRED_BIND_MEM_FUNC(
+            &ZeroCopyServer::onRecvMessage, this));
+        tcp_service_.setPeerCloseCallback(BRICKRED_BIND_MEM_FUNC(
+            &ZeroCopyServer::onPeerClose, this));
+        tcp_service_.setErrorCallback(BRICKRED_BIND_MEM_FUNC(
+            &ZeroCopyServer::onError, this));
+        tcp_service_.setZeroCopyThreshold(zero_copy_threshold);
+    }
+
+    ~ZeroCopyServer()
+    {
+    }
+
+    bool run(const SocketAddress &addr)
+    {
+        if (tcp_service_.listen(addr) < 0) {
+            ::fprintf(stderr, "socket listen failed: %s\n",
+                      ::strerror(errno));
+            return false;
+        }
+
+        io_service_.loop();
+
+        return true;
+    }
+
+    void sendBlob(TcpService *service, TcpService::SocketId socket_id)
+    {
+        ++blob_ref_count_;
+        if (service->sendMessageZeroCopy(socket_id,
+                blob_.c_str(), blob_.size(),
+                BRICKRED_BIND_MEM_FUNC(&ZeroCopyServer::onBlobRelease, this),
+                BRICKRED_BIND_MEM_FUNC(&ZeroCopyServer::sendBlob, this))
+                    == false) {
+            service->closeSocket(socket_id);
+        }
+    }
+
+    void onBlobRelease(TcpService *service,
+                       TcpService::SocketId socket_id,
+                       const char *buffer)
+    {
+        --blob_ref_count_;
+    }
+
+    void onNewConnection(TcpService *service,
+                         TcpService::SocketId from_socket_id,
+                         TcpService::SocketId socket_id)
+    {
+        static int conn_num = 0;
+        ::printf("[new connection][%d] %lx from %lx\n",
+                 ++conn_num, socket_id, from_socket_id);
+        sendBlob(service, socket_id);
+    }
+
+    void onRecvMessage(TcpService *service,
+                       TcpService::SocketId socket_id,
+                       DynamicBuffer *buffer)
+    {
+        buffer->read(buffer->readableBytes());
+    }
+
+    void onPeerClose(TcpService *service,
+                     TcpService::SocketId socket_id)
+    {
+        ::printf("[peer close] %lx\n", socket_id);
+        service->closeSocket(socket_id);
+        ::printf("[blob ref count] %d\n", blob_ref_count_);
+    }
+
+    void onError(TcpService *service,
+                 TcpService::SocketId socket_id,
+                 int error)
+    {
+        ::printf("[error] %lx: %s\n", socket_id, ::strerror(error));
+        service->closeSocket(socket_id);
+        ::printf("[blob ref count] %d\n", blob_ref_count_);
+    }
+
+private:
+    IOService io_service_;
+    TcpService tcp_service_;
+    std::string blob_;
+    int blob_ref_count_;
+};
+
+int main(int argc, char *argv[])
+{
+    if (argc < 5) {
+        ::fprintf(stderr, "usage: %s <ip> <port> "
+                  "<blob_size> <zero_copy_threshold>\n", argv[0]);
+        return -1;
+    }
+
+    ZeroCopyServer server(::atoi(argv[3]), ::atoi(argv[4]));
+    if (server.run(SocketAddress(argv[1], ::atoi(argv[2]))) == false) {
+        return -1;
+    }
+
+    return 0;
+}